@@ -5,6 +5,8 @@
 namespace ktl {
 using std::max;
 using std::min;
+using std::sort;
+using std::unique;
 }  // namespace ktl
 #else
 #include <algorithm_impl.hpp>
@@ -563,6 +565,164 @@ ForwardIt rotate(ForwardIt first, ForwardIt new_first, ForwardIt last) {
   return algo::details::rotate_left(first, new_first, last);
 }
 
+namespace algo::details {
+inline constexpr ptrdiff_t INSERTION_SORT_THRESHOLD{16};
+
+template <class RandomAccessIt, class Compare>
+void insertion_sort(RandomAccessIt first,
+                    RandomAccessIt last,
+                    Compare& comp) {
+  if (first == last) {
+    return;
+  }
+  for (auto it = next(first); it != last; ++it) {
+    auto value{move(*it)};
+    auto hole{it};
+    for (; hole != first && comp(value, *prev(hole)); --hole) {
+      *hole = move(*prev(hole));
+    }
+    *hole = move(value);
+  }
+}
+
+template <class RandomAccessIt, class Compare>
+void sift_down(RandomAccessIt first,
+               ptrdiff_t idx,
+               ptrdiff_t count,
+               Compare& comp) {
+  auto value{move(first[idx])};
+  for (ptrdiff_t child = 2 * idx + 1; child < count; child = 2 * idx + 1) {
+    if (child + 1 < count && comp(first[child], first[child + 1])) {
+      ++child;
+    }
+    if (!comp(value, first[child])) {
+      break;
+    }
+    first[idx] = move(first[child]);
+    idx = child;
+  }
+  first[idx] = move(value);
+}
+
+template <class RandomAccessIt, class Compare>
+void heap_sort(RandomAccessIt first, RandomAccessIt last, Compare& comp) {
+  const ptrdiff_t count{last - first};
+  for (ptrdiff_t idx = count / 2; idx > 0; --idx) {
+    sift_down(first, idx - 1, count, comp);
+  }
+  for (ptrdiff_t heap_size = count - 1; heap_size > 0; --heap_size) {
+    iter_swap(first, first + heap_size);
+    sift_down(first, 0, heap_size, comp);
+  }
+}
+
+template <class RandomAccessIt, class Compare>
+void move_median_to_first(RandomAccessIt result,
+                          RandomAccessIt a,
+                          RandomAccessIt b,
+                          RandomAccessIt c,
+                          Compare& comp) {
+  if (comp(*a, *b)) {
+    if (comp(*b, *c)) {
+      iter_swap(result, b);
+    } else if (comp(*a, *c)) {
+      iter_swap(result, c);
+    } else {
+      iter_swap(result, a);
+    }
+  } else if (comp(*a, *c)) {
+    iter_swap(result, a);
+  } else if (comp(*b, *c)) {
+    iter_swap(result, c);
+  } else {
+    iter_swap(result, b);
+  }
+}
+
+// The median of three is placed at first, so neither scan can run out of
+// the range without bound checks
+template <class RandomAccessIt, class Compare>
+RandomAccessIt partition_by_pivot(RandomAccessIt first,
+                                  RandomAccessIt last,
+                                  Compare& comp) {
+  move_median_to_first(first, first + 1, first + (last - first) / 2,
+                       prev(last), comp);
+  const RandomAccessIt pivot{first};
+  ++first;
+  for (;;) {
+    while (comp(*first, *pivot)) {
+      ++first;
+    }
+    --last;
+    while (comp(*pivot, *last)) {
+      --last;
+    }
+    if (!(first < last)) {
+      return first;
+    }
+    iter_swap(first, last);
+    ++first;
+  }
+}
+
+// Quicksort falls back to heapsort on too deep recursion and leaves short
+// subranges for the final insertion sort
+template <class RandomAccessIt, class Compare>
+void introsort_loop(RandomAccessIt first,
+                    RandomAccessIt last,
+                    size_t depth_limit,
+                    Compare& comp) {
+  while (last - first > INSERTION_SORT_THRESHOLD) {
+    if (depth_limit == 0) {
+      heap_sort(first, last, comp);
+      return;
+    }
+    --depth_limit;
+    const RandomAccessIt cut{partition_by_pivot(first, last, comp)};
+    introsort_loop(cut, last, depth_limit, comp);
+    last = cut;
+  }
+}
+}  // namespace algo::details
+
+// Not stable; O(N log N) comparisons in the worst case
+template <class RandomAccessIt, class Compare>
+void sort(RandomAccessIt first, RandomAccessIt last, Compare comp) {
+  if (last - first < 2) {
+    return;
+  }
+  size_t depth_limit{0};
+  for (auto count = last - first; count > 1; count /= 2) {
+    depth_limit += 2;
+  }
+  algo::details::introsort_loop(first, last, depth_limit, comp);
+  algo::details::insertion_sort(first, last, comp);
+}
+
+template <class RandomAccessIt>
+void sort(RandomAccessIt first, RandomAccessIt last) {
+  sort(first, last, less<>{});
+}
+
+template <class ForwardIt, class BinaryPredicate>
+ForwardIt unique(ForwardIt first, ForwardIt last, BinaryPredicate pred) {
+  if (first == last) {
+    return last;
+  }
+  ForwardIt result{first};
+  while (++first != last) {
+    if (!pred(*result, *first) && ++result != first) {
+      *result = move(*first);
+    }
+  }
+  return ++result;
+}
+
+template <class ForwardIt>
+ForwardIt unique(ForwardIt first, ForwardIt last) {
+  return unique(first, last, equal_to<>{});
+}
+
 template <class LhsForwardIt, class RhsForwardIt>
 constexpr RhsForwardIt swap_ranges(LhsForwardIt lhs_first,
                                    LhsForwardIt lhs_last,
@@ -8,7 +8,10 @@ using basic_allocator = std::allocator<Ty>;
 using std::allocator_traits;
 }  // namespace ktl
 #else
+#include <algorithm_impl.hpp>
+#include <exception.hpp>
 #include <heap.hpp>
+#include <limits.hpp>
 #include <memory_impl.hpp>
 #include <memory_type_traits.hpp>
 #include <new_delete.hpp>
@@ -156,6 +159,233 @@ template <class Ty>
 using tagged_non_paged_allocator =
     tagged_allocator<Ty, NonPagedPool, static_cast<align_val_t>(alignof(Ty))>;
 
+/*
+ * Arena which serves allocations by bumping a pointer inside the current
+ * block. When the block is exhausted, a new one is taken from the pool and
+ * chained to the previous ones. Deallocation is a no-op: all the memory is
+ * released at once by release() or by the destructor.
+ *
+ * An initial buffer (e.g. on the stack) may be provided; it is used first and
+ * is never freed by the arena.
+ */
+class monotonic_buffer : non_relocatable {
+  struct block_header {
+    block_header* prev;
+    size_t size;
+  };
+
+ public:
+  static constexpr size_t DEFAULT_BLOCK_SIZE{1024};
+  static constexpr size_t MAX_BLOCK_SIZE{16 * crt::MEMORY_PAGE_SIZE};
+  static constexpr size_t GROWTH_MULTIPLIER{2};
+
+ public:
+  explicit monotonic_buffer(crt::pool_type_t pool_type = PagedPool,
+                            size_t initial_block_size = DEFAULT_BLOCK_SIZE,
+                            crt::pool_tag_t pool_tag = crt::DEFAULT_HEAP_TAG)
+      : m_initial_block_size{initial_block_size},
+        m_next_block_size{initial_block_size},
+        m_pool_type{pool_type},
+        m_pool_tag{pool_tag} {}
+
+  monotonic_buffer(void* buffer,
+                   size_t buffer_size,
+                   crt::pool_type_t pool_type = PagedPool,
+                   crt::pool_tag_t pool_tag = crt::DEFAULT_HEAP_TAG)
+      : m_initial_buffer{static_cast<byte*>(buffer)},
+        m_initial_buffer_size{buffer_size},
+        m_current{m_initial_buffer},
+        m_end{m_initial_buffer + buffer_size},
+        m_initial_block_size{(max)(buffer_size, DEFAULT_BLOCK_SIZE)},
+        m_next_block_size{m_initial_block_size},
+        m_pool_type{pool_type},
+        m_pool_tag{pool_tag} {}
+
+  ~monotonic_buffer() noexcept { release(); }
+
+  void* allocate(size_t bytes_count, align_val_t alignment) {
+    if (void* const ptr = try_bump(bytes_count, alignment); ptr) {
+      return ptr;
+    }
+    return allocate_from_new_block(bytes_count, alignment);
+  }
+
+  // Memory is released by release() or on destruction
+  static void deallocate([[maybe_unused]] void* ptr,
+                         [[maybe_unused]] size_t bytes_count,
+                         [[maybe_unused]] align_val_t alignment) noexcept {}
+
+  // Frees all blocks taken from the pool and rewinds to the initial buffer
+  void release() noexcept {
+    while (block_header* const block = m_last_block) {
+      m_last_block = block->prev;
+      deallocate_memory(free_request_builder{block, block->size}
+                            .set_pool_tag(m_pool_tag)
+                            .build());
+    }
+    m_current = m_initial_buffer;
+    m_end = m_initial_buffer + m_initial_buffer_size;
+    m_next_block_size = m_initial_block_size;
+  }
+
+  [[nodiscard]] size_t get_remaining_bytes() const noexcept {
+    return static_cast<size_t>(m_end - m_current);
+  }
+
+  [[nodiscard]] crt::pool_type_t get_pool_type() const noexcept {
+    return m_pool_type;
+  }
+
+  [[nodiscard]] crt::pool_tag_t get_pool_tag() const noexcept {
+    return m_pool_tag;
+  }
+
+ private:
+  void* try_bump(size_t bytes_count, align_val_t alignment) noexcept {
+    if (!m_current) {
+      return nullptr;
+    }
+    const auto align_mask{static_cast<uintptr_t>(alignment) - 1};
+    const auto current{reinterpret_cast<uintptr_t>(m_current)};
+    const auto end{reinterpret_cast<uintptr_t>(m_end)};
+    const auto aligned{(current + align_mask) & ~align_mask};
+    if (aligned < current || aligned > end || end - aligned < bytes_count) {
+      return nullptr;
+    }
+    m_current = reinterpret_cast<byte*>(aligned + bytes_count);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  NOINLINE void* allocate_from_new_block(size_t bytes_count,
+                                         align_val_t alignment) {
+    constexpr size_t max_size{(numeric_limits<size_t>::max)()};
+    const auto align{static_cast<size_t>(alignment)};
+    if (bytes_count > max_size - sizeof(block_header) - align) {
+      throw bad_alloc{};
+    }
+    const size_t block_size{(max)(m_next_block_size,
+                                  sizeof(block_header) + bytes_count + align)};
+    void* const buffer{allocate_memory<OnAllocationFailure::ThrowException>(
+        alloc_request_builder{block_size, m_pool_type}
+            .set_pool_tag(m_pool_tag)
+            .build())};
+
+    auto* const block{static_cast<block_header*>(buffer)};
+    block->prev = m_last_block;
+    block->size = block_size;
+    m_last_block = block;
+
+    m_current = reinterpret_cast<byte*>(block + 1);
+    m_end = static_cast<byte*>(buffer) + block_size;
+    m_next_block_size =
+        (min)(m_next_block_size * GROWTH_MULTIPLIER, MAX_BLOCK_SIZE);
+
+    return try_bump(bytes_count, alignment);
+  }
+
+ private:
+  byte* m_initial_buffer{nullptr};
+  size_t m_initial_buffer_size{0};
+  byte* m_current{nullptr};
+  byte* m_end{nullptr};
+  block_header* m_last_block{nullptr};
+  size_t m_initial_block_size;
+  size_t m_next_block_size;
+  crt::pool_type_t m_pool_type;
+  crt::pool_tag_t m_pool_tag;
+};
+
+// monotonic_buffer with an embedded initial buffer
+template <size_t BufferSize>
+class inline_monotonic_buffer : public monotonic_buffer {
+ public:
+  explicit inline_monotonic_buffer(
+      crt::pool_type_t pool_type = PagedPool,
+      crt::pool_tag_t pool_tag = crt::DEFAULT_HEAP_TAG)
+      : monotonic_buffer(m_storage, BufferSize, pool_type, pool_tag) {}
+
+ private:
+  alignas(static_cast<size_t>(
+      crt::DEFAULT_ALLOCATION_ALIGNMENT)) byte m_storage[BufferSize];
+};
+
+template <class Ty>
+class monotonic_allocator {
+ public:
+  using value_type = Ty;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using propagate_on_container_copy_assignment = true_type;
+  using propagate_on_container_move_assignment = true_type;
+  using propagate_on_container_swap = true_type;
+  using is_always_equal = false_type;
+  using enable_delete_null = true_type;
+
+  template <class OtherTy>
+  struct rebind {
+    using other = monotonic_allocator<OtherTy>;
+  };
+
+  static constexpr auto ALIGNMENT{static_cast<align_val_t>(alignof(Ty))};
+
+ public:
+  constexpr monotonic_allocator(monotonic_buffer& buffer) noexcept
+      : m_buffer{addressof(buffer)} {}
+
+  template <class OtherTy>
+  constexpr monotonic_allocator(
+      const monotonic_allocator<OtherTy>& other) noexcept
+      : m_buffer{addressof(other.get_buffer())} {}
+
+  Ty* allocate(size_t object_count) {
+    if (object_count > (numeric_limits<size_t>::max)() / sizeof(value_type)) {
+      throw bad_alloc{};
+    }
+    return allocate_bytes(object_count * sizeof(value_type));
+  }
+
+  Ty* allocate_bytes(size_t bytes_count) {
+    return static_cast<Ty*>(m_buffer->allocate(bytes_count, ALIGNMENT));
+  }
+
+  void deallocate(Ty* ptr, size_t object_count) noexcept {
+    deallocate_bytes(ptr, object_count * sizeof(value_type));
+  }
+
+  void deallocate_bytes(Ty* ptr, size_t bytes_count) noexcept {
+    m_buffer->deallocate(ptr, bytes_count, ALIGNMENT);
+  }
+
+  [[nodiscard]] constexpr monotonic_buffer& get_buffer() const noexcept {
+    return *m_buffer;
+  }
+
+  void swap(monotonic_allocator& other) noexcept {
+    ktl::swap(m_buffer, other.m_buffer);
+  }
+
+ private:
+  monotonic_buffer* m_buffer;
+};
+
+template <class Ty, class OtherTy>
+constexpr bool operator==(const monotonic_allocator<Ty>& lhs,
+                          const monotonic_allocator<OtherTy>& rhs) noexcept {
+  return addressof(lhs.get_buffer()) == addressof(rhs.get_buffer());
+}
+
+template <class Ty, class OtherTy>
+constexpr bool operator!=(const monotonic_allocator<Ty>& lhs,
+                          const monotonic_allocator<OtherTy>& rhs) noexcept {
+  return !(lhs == rhs);
+}
+
+template <class Ty>
+void swap(monotonic_allocator<Ty>& lhs,
+          monotonic_allocator<Ty>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
 template <class Alloc>
 struct allocator_traits {
   using allocator_type = Alloc;
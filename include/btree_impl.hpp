@@ -0,0 +1,1130 @@
+#pragma once
+#include <basic_types.hpp>
+#include <algorithm.hpp>
+#include <allocator.hpp>
+#include <functional.hpp>
+#include <initializer_list.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <limits.hpp>
+#include <memory.hpp>
+#include <tuple.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+namespace ktl {
+namespace bt::details {
+template <class Key, class Ty>
+struct btree_traits {
+  static constexpr bool is_map = !is_void_v<Ty>;
+  static constexpr bool is_set = !is_map;
+
+  using value_type = conditional_t<is_set, Key, pair<Key, Ty>>;
+
+  [[nodiscard]] static constexpr const Key& get_key(
+      const value_type& value) noexcept {
+    if constexpr (is_map) {
+      return value.first;
+    } else {
+      return value;
+    }
+  }
+};
+
+/*
+ * Values per node: a leaf takes about NodeSize bytes, so a lookup touches a
+ * few cache lines per level. At least 3 values are needed to split a node
+ * into two non-empty halves and a separator
+ */
+template <class Ty>
+constexpr size_t calc_slot_count(size_t node_size) noexcept {
+  constexpr size_t HEADER_SIZE{2 * sizeof(void*)};
+  const size_t slot_count{
+      node_size > HEADER_SIZE ? (node_size - HEADER_SIZE) / sizeof(Ty) : 0};
+  return (max)(slot_count, size_t{3});
+}
+
+template <class Ty, size_t SlotCount>
+struct btree_internal_node;
+
+template <class Ty, size_t SlotCount>
+struct btree_node {
+  using internal_type = btree_internal_node<Ty, SlotCount>;
+
+  [[nodiscard]] Ty& value(size_t idx) noexcept {
+    return *reinterpret_cast<Ty*>(addressof(slots[idx]));
+  }
+
+  [[nodiscard]] const Ty& value(size_t idx) const noexcept {
+    return *reinterpret_cast<const Ty*>(addressof(slots[idx]));
+  }
+
+  [[nodiscard]] btree_node* child(size_t idx) const noexcept {
+    return static_cast<const internal_type*>(this)->children[idx];
+  }
+
+  internal_type* parent;
+  uint16_t position;  // Index in parent's children
+  uint16_t count;
+  bool leaf;
+  aligned_storage_t<sizeof(Ty), alignof(Ty)> slots[SlotCount];
+};
+
+// Internal nodes also hold values: children[idx] precedes value(idx)
+template <class Ty, size_t SlotCount>
+struct btree_internal_node : btree_node<Ty, SlotCount> {
+  btree_node<Ty, SlotCount>* children[SlotCount + 1];
+};
+
+template <class Ty, size_t SlotCount>
+class btree_iterator_base {
+ protected:
+  using node_type = btree_node<Ty, SlotCount>;
+
+ protected:
+  btree_iterator_base() noexcept = default;
+  btree_iterator_base(node_type* node, size_t pos) noexcept
+      : m_node{node}, m_pos{pos} {}
+
+  void increment() noexcept {
+    if (m_node->leaf) {
+      if (++m_pos < m_node->count) {
+        return;
+      }
+      // Climb while the subtree is exhausted; the end stays in the leaf
+      node_type* node{m_node};
+      size_t pos{m_pos};
+      while (pos == node->count && node->parent) {
+        pos = node->position;
+        node = node->parent;
+      }
+      if (pos != node->count) {
+        m_node = node;
+        m_pos = pos;
+      }
+    } else {
+      m_node = m_node->child(m_pos + 1);
+      while (!m_node->leaf) {
+        m_node = m_node->child(0);
+      }
+      m_pos = 0;
+    }
+  }
+
+  void decrement() noexcept {
+    if (m_node->leaf) {
+      while (!m_pos && m_node->parent) {
+        m_pos = m_node->position;
+        m_node = m_node->parent;
+      }
+      --m_pos;
+    } else {
+      m_node = m_node->child(m_pos);
+      while (!m_node->leaf) {
+        m_node = m_node->child(m_node->count);
+      }
+      m_pos = m_node->count - 1u;
+    }
+  }
+
+ protected:
+  node_type* m_node{nullptr};
+  size_t m_pos{0};
+};
+
+/*
+ * In-memory B-tree keeping values sorted by Compare. Values live in all
+ * nodes, and each node stores a few cache lines of them contiguously, so
+ * lookups and range scans mostly walk arrays instead of chasing pointers.
+ *
+ * Unlike std::map, values are moved between nodes: insertion and erasure
+ * invalidate all iterators, pointers and references
+ */
+template <class Key,
+          class Ty,
+          class Compare,
+          class BytesAllocator,
+          bool IsMulti,
+          size_t NodeSize>
+class btree {
+ private:
+  using traits_type = btree_traits<Key, Ty>;
+  using AlBytesTraits = allocator_traits<BytesAllocator>;
+
+ public:
+  static constexpr bool is_map = traits_type::is_map;
+  static constexpr bool is_set = traits_type::is_set;
+  static constexpr bool is_multi = IsMulti;
+
+  using key_type = Key;
+  using mapped_type = Ty;
+  using value_type = typename traits_type::value_type;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using key_compare = Compare;
+  using allocator_type = BytesAllocator;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+
+  static constexpr size_t SLOT_COUNT{calc_slot_count<value_type>(NodeSize)};
+  static constexpr size_t MIN_SLOT_COUNT{SLOT_COUNT / 2};
+
+ private:
+  using node_type = btree_node<value_type, SLOT_COUNT>;
+  using internal_type = btree_internal_node<value_type, SLOT_COUNT>;
+  using iterator_base = btree_iterator_base<value_type, SLOT_COUNT>;
+
+  static_assert(SLOT_COUNT <= (numeric_limits<uint16_t>::max)(),
+                "node is too large");
+
+ public:
+  template <bool IsConst>
+  class btree_iterator : iterator_base {
+   public:
+    using iterator_category = bidirectional_iterator_tag;
+    using value_type = typename btree::value_type;
+    using difference_type = ptrdiff_t;
+    using pointer = conditional_t<IsConst, const value_type*, value_type*>;
+    using reference = conditional_t<IsConst, const value_type&, value_type&>;
+
+   public:
+    btree_iterator() noexcept = default;
+
+    template <bool OtherConst,
+              enable_if_t<IsConst && !OtherConst, int> = 0>
+    btree_iterator(const btree_iterator<OtherConst>& other) noexcept
+        : iterator_base{other.m_node, other.m_pos} {}
+
+    reference operator*() const noexcept {
+      return this->m_node->value(this->m_pos);
+    }
+
+    pointer operator->() const noexcept { return addressof(**this); }
+
+    btree_iterator& operator++() noexcept {
+      this->increment();
+      return *this;
+    }
+
+    btree_iterator operator++(int) noexcept {
+      btree_iterator tmp{*this};
+      this->increment();
+      return tmp;
+    }
+
+    btree_iterator& operator--() noexcept {
+      this->decrement();
+      return *this;
+    }
+
+    btree_iterator operator--(int) noexcept {
+      btree_iterator tmp{*this};
+      this->decrement();
+      return tmp;
+    }
+
+    template <bool OtherConst>
+    bool operator==(const btree_iterator<OtherConst>& other) const noexcept {
+      return this->m_node == other.m_node && this->m_pos == other.m_pos;
+    }
+
+    template <bool OtherConst>
+    bool operator!=(const btree_iterator<OtherConst>& other) const noexcept {
+      return !(*this == other);
+    }
+
+   private:
+    btree_iterator(node_type* node, size_t pos) noexcept
+        : iterator_base{node, pos} {}
+
+    friend class btree;
+    template <bool>
+    friend class btree_iterator;
+  };
+
+  using iterator = btree_iterator<false>;
+  using const_iterator = btree_iterator<true>;
+  using insert_return_type =
+      conditional_t<IsMulti, iterator, pair<iterator, bool>>;
+
+ public:
+  btree() noexcept(is_nothrow_default_constructible_v<Compare>&&
+                       is_nothrow_default_constructible_v<allocator_type>) =
+      default;
+
+  explicit btree(const Compare& comp,
+                 const allocator_type& alloc = allocator_type{})
+      : m_comp{comp}, m_alc{alloc} {}
+
+  template <class InputIt>
+  btree(InputIt first,
+        InputIt last,
+        const Compare& comp = Compare{},
+        const allocator_type& alloc = allocator_type{})
+      : m_comp{comp}, m_alc{alloc} {
+    try {
+      insert(first, last);
+    } catch (...) {
+      clear();
+      throw;
+    }
+  }
+
+  btree(initializer_list<value_type> init,
+        const Compare& comp = Compare{},
+        const allocator_type& alloc = allocator_type{})
+      : btree(init.begin(), init.end(), comp, alloc) {}
+
+  // Values come sorted, so each one is appended to the rightmost leaf
+  btree(const btree& other)
+      : m_comp{other.m_comp},
+        m_alc{AlBytesTraits::select_on_container_copy_construction(
+            other.m_alc)} {
+    try {
+      for (const auto& value : other) {
+        insert_at(m_rightmost, m_rightmost ? m_rightmost->count : 0, value);
+      }
+    } catch (...) {
+      clear();
+      throw;
+    }
+  }
+
+  btree(btree&& other) noexcept
+      : m_comp{move(other.m_comp)},
+        m_alc{move(other.m_alc)},
+        m_root{exchange(other.m_root, nullptr)},
+        m_leftmost{exchange(other.m_leftmost, nullptr)},
+        m_rightmost{exchange(other.m_rightmost, nullptr)},
+        m_size{exchange(other.m_size, 0)} {}
+
+  btree& operator=(const btree& other) {
+    if (this != addressof(other)) {
+      btree tmp{other};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  btree& operator=(btree&& other) noexcept {
+    if (this != addressof(other)) {
+      btree tmp{move(other)};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  btree& operator=(initializer_list<value_type> init) {
+    btree tmp{init, m_comp, m_alc};
+    swap(tmp);
+    return *this;
+  }
+
+  ~btree() noexcept { clear(); }
+
+  void swap(btree& other) noexcept {
+    using ktl::swap;
+    swap(m_comp, other.m_comp);
+    swap(m_alc, other.m_alc);
+    swap(m_root, other.m_root);
+    swap(m_leftmost, other.m_leftmost);
+    swap(m_rightmost, other.m_rightmost);
+    swap(m_size, other.m_size);
+  }
+
+  [[nodiscard]] iterator begin() noexcept { return {m_leftmost, 0}; }
+  [[nodiscard]] const_iterator begin() const noexcept {
+    return {m_leftmost, 0};
+  }
+  [[nodiscard]] const_iterator cbegin() const noexcept { return begin(); }
+
+  // The end is the position after the last value of the rightmost leaf
+  [[nodiscard]] iterator end() noexcept {
+    return {m_rightmost, m_rightmost ? m_rightmost->count : 0u};
+  }
+  [[nodiscard]] const_iterator end() const noexcept {
+    return {m_rightmost, m_rightmost ? m_rightmost->count : 0u};
+  }
+  [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+  [[nodiscard]] size_type size() const noexcept { return m_size; }
+  [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+  [[nodiscard]] size_type max_size() const noexcept {
+    return (numeric_limits<size_type>::max)() / sizeof(value_type);
+  }
+
+  [[nodiscard]] key_compare key_comp() const { return m_comp; }
+
+  void clear() noexcept {
+    if (m_root) {
+      destroy_subtree(m_root);
+      m_root = nullptr;
+      m_leftmost = nullptr;
+      m_rightmost = nullptr;
+      m_size = 0;
+    }
+  }
+
+  insert_return_type insert(const value_type& value) { return emplace(value); }
+  insert_return_type insert(value_type&& value) { return emplace(move(value)); }
+
+  iterator insert(const_iterator hint, const value_type& value) {
+    return emplace_hint(hint, value);
+  }
+
+  iterator insert(const_iterator hint, value_type&& value) {
+    return emplace_hint(hint, move(value));
+  }
+
+  template <class InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      emplace_hint(end(), *first);
+    }
+  }
+
+  void insert(initializer_list<value_type> init) {
+    insert(init.begin(), init.end());
+  }
+
+  template <class... Types>
+  insert_return_type emplace(Types&&... args) {
+    if constexpr (is_value_type_v<Types...>) {
+      return insert_value(forward<Types>(args)...);
+    } else {
+      return insert_value(value_type(forward<Types>(args)...));
+    }
+  }
+
+  // Costs O(1) besides splitting if the value belongs right before hint
+  template <class... Types>
+  iterator emplace_hint(const_iterator hint, Types&&... args) {
+    if constexpr (is_value_type_v<Types...>) {
+      return insert_value_hint(hint, forward<Types>(args)...);
+    } else {
+      return insert_value_hint(hint, value_type(forward<Types>(args)...));
+    }
+  }
+
+  template <class... Types, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>> try_emplace(
+      const key_type& key,
+      Types&&... args) {
+    return try_emplace_impl(key, forward<Types>(args)...);
+  }
+
+  template <class... Types, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>> try_emplace(
+      key_type&& key,
+      Types&&... args) {
+    return try_emplace_impl(move(key), forward<Types>(args)...);
+  }
+
+  template <class Mapped, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>>
+  insert_or_assign(const key_type& key, Mapped&& obj) {
+    auto result{try_emplace_impl(key, forward<Mapped>(obj))};
+    if (!result.second) {
+      result.first->second = forward<Mapped>(obj);
+    }
+    return result;
+  }
+
+  template <class Mapped, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>>
+  insert_or_assign(key_type&& key, Mapped&& obj) {
+    auto result{try_emplace_impl(move(key), forward<Mapped>(obj))};
+    if (!result.second) {
+      result.first->second = forward<Mapped>(obj);
+    }
+    return result;
+  }
+
+  template <class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, Q&> operator[](const key_type& key) {
+    return try_emplace_impl(key).first->second;
+  }
+
+  template <class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, Q&> operator[](key_type&& key) {
+    return try_emplace_impl(move(key)).first->second;
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <class Q = mapped_type>
+  [[nodiscard]] enable_if_t<!is_void_v<Q>, Q&> at(const key_type& key) {
+    const auto it{find(key)};
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  template <class Q = mapped_type>
+  [[nodiscard]] enable_if_t<!is_void_v<Q>, const Q&> at(
+      const key_type& key) const {
+    const auto it{find(key)};
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  // Returns iterator to the value following the erased one
+  iterator erase(const_iterator pos) {
+    node_type* leaf{pos.m_node};
+    size_t idx{pos.m_pos};
+    const bool internal_erase{!leaf->leaf};
+    if (internal_erase) {
+      // Replace the value with its predecessor, which is always in a leaf
+      node_type* const node{leaf};
+      leaf = node->child(idx);
+      while (!leaf->leaf) {
+        leaf = leaf->child(leaf->count);
+      }
+      destroy_at(addressof(node->value(idx)));
+      relocate_value(leaf, leaf->count - 1u, node, idx);
+      idx = leaf->count - 1u;
+    } else {
+      destroy_at(addressof(leaf->value(idx)));
+      relocate_values(leaf, idx + 1, leaf, idx, leaf->count - idx - 1u);
+    }
+    --leaf->count;
+    --m_size;
+
+    iterator next{rebalance_after_erase(leaf, idx)};
+    if (internal_erase) {
+      // The predecessor took place of the erased value
+      ++next;
+    }
+    return next;
+  }
+
+  iterator erase(iterator pos) { return erase(const_iterator{pos}); }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    size_t count{static_cast<size_t>(distance(first, last))};
+    iterator it{first.m_node, first.m_pos};
+    for (; count; --count) {
+      it = erase(it);
+    }
+    return it;
+  }
+
+  size_type erase(const key_type& key) {
+    if constexpr (IsMulti) {
+      const auto [first, last]{equal_range(key)};
+      const size_t count{static_cast<size_t>(distance(first, last))};
+      erase(first, last);
+      return count;
+    } else {
+      const auto it{find(key)};
+      if (it == end()) {
+        return 0;
+      }
+      erase(it);
+      return 1;
+    }
+  }
+
+  [[nodiscard]] iterator find(const key_type& key) {
+    return make_mutable(find_impl(key));
+  }
+
+  [[nodiscard]] const_iterator find(const key_type& key) const {
+    return find_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] iterator find(const K& key) {
+    return make_mutable(find_impl(key));
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] const_iterator find(const K& key) const {
+    return find_impl(key);
+  }
+
+  [[nodiscard]] bool contains(const key_type& key) const {
+    return find_impl(key) != end();
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] bool contains(const K& key) const {
+    return find_impl(key) != end();
+  }
+
+  [[nodiscard]] size_type count(const key_type& key) const {
+    return count_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] size_type count(const K& key) const {
+    return count_impl(key);
+  }
+
+  [[nodiscard]] iterator lower_bound(const key_type& key) {
+    return make_mutable(lower_bound_impl(key));
+  }
+
+  [[nodiscard]] const_iterator lower_bound(const key_type& key) const {
+    return lower_bound_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] iterator lower_bound(const K& key) {
+    return make_mutable(lower_bound_impl(key));
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] const_iterator lower_bound(const K& key) const {
+    return lower_bound_impl(key);
+  }
+
+  [[nodiscard]] iterator upper_bound(const key_type& key) {
+    return make_mutable(upper_bound_impl(key));
+  }
+
+  [[nodiscard]] const_iterator upper_bound(const key_type& key) const {
+    return upper_bound_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] iterator upper_bound(const K& key) {
+    return make_mutable(upper_bound_impl(key));
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] const_iterator upper_bound(const K& key) const {
+    return upper_bound_impl(key);
+  }
+
+  [[nodiscard]] pair<iterator, iterator> equal_range(const key_type& key) {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  [[nodiscard]] pair<const_iterator, const_iterator> equal_range(
+      const key_type& key) const {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] pair<iterator, iterator> equal_range(const K& key) {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] pair<const_iterator, const_iterator> equal_range(
+      const K& key) const {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  bool operator==(const btree& other) const {
+    return m_size == other.m_size && equal(begin(), end(), other.begin());
+  }
+
+  bool operator!=(const btree& other) const { return !operator==(other); }
+
+ private:
+  template <class... Types>
+  static constexpr bool is_value_type_v =
+      sizeof...(Types) == 1 &&
+      (is_same_v<remove_cv_t<remove_reference_t<Types>>, value_type> && ...);
+
+  [[nodiscard]] const key_type& key_of(const node_type* node,
+                                       size_t idx) const noexcept {
+    return traits_type::get_key(node->value(idx));
+  }
+
+  [[nodiscard]] static iterator make_mutable(const_iterator it) noexcept {
+    return {it.m_node, it.m_pos};
+  }
+
+  // Position after the last value of a leaf belongs to its ancestor
+  [[nodiscard]] static iterator normalize(node_type* node, size_t pos) noexcept {
+    node_type* const leaf{node};
+    const size_t leaf_pos{pos};
+    while (pos == node->count && node->parent) {
+      pos = node->position;
+      node = node->parent;
+    }
+    return pos != node->count ? iterator{node, pos} : iterator{leaf, leaf_pos};
+  }
+
+  template <class K>
+  [[nodiscard]] size_t lower_bound_in(const node_type* node,
+                                      const K& key) const {
+    size_t first{0};
+    size_t count{node->count};
+    while (count) {
+      const size_t half{count / 2};
+      if (m_comp(key_of(node, first + half), key)) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return first;
+  }
+
+  template <class K>
+  [[nodiscard]] size_t upper_bound_in(const node_type* node,
+                                      const K& key) const {
+    size_t first{0};
+    size_t count{node->count};
+    while (count) {
+      const size_t half{count / 2};
+      if (!m_comp(key, key_of(node, first + half))) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return first;
+  }
+
+  template <class K>
+  [[nodiscard]] const_iterator lower_bound_impl(const K& key) const {
+    node_type* node{m_root};
+    if (!node) {
+      return end();
+    }
+    for (;;) {
+      const size_t pos{lower_bound_in(node, key)};
+      // Keys are unique, so an equal one is the bound itself
+      if constexpr (!IsMulti) {
+        if (pos != node->count && !m_comp(key, key_of(node, pos))) {
+          return {node, pos};
+        }
+      }
+      if (node->leaf) {
+        return normalize(node, pos);
+      }
+      node = node->child(pos);
+    }
+  }
+
+  template <class K>
+  [[nodiscard]] const_iterator upper_bound_impl(const K& key) const {
+    node_type* node{m_root};
+    if (!node) {
+      return end();
+    }
+    for (;;) {
+      const size_t pos{upper_bound_in(node, key)};
+      if (node->leaf) {
+        return normalize(node, pos);
+      }
+      node = node->child(pos);
+    }
+  }
+
+  template <class K>
+  [[nodiscard]] const_iterator find_impl(const K& key) const {
+    const const_iterator it{lower_bound_impl(key)};
+    return it == end() || m_comp(key, traits_type::get_key(*it)) ? end() : it;
+  }
+
+  template <class K>
+  [[nodiscard]] size_t count_impl(const K& key) const {
+    if constexpr (IsMulti) {
+      return static_cast<size_t>(
+          distance(lower_bound_impl(key), upper_bound_impl(key)));
+    } else {
+      return find_impl(key) != end() ? 1 : 0;
+    }
+  }
+
+  template <class OtherKey, class... Types>
+  pair<iterator, bool> try_emplace_impl(OtherKey&& key, Types&&... args) {
+    return insert_unique(key, piecewise_construct,
+                         forward_as_tuple(forward<OtherKey>(key)),
+                         forward_as_tuple(forward<Types>(args)...));
+  }
+
+  template <class Value>
+  insert_return_type insert_value(Value&& value) {
+    if constexpr (IsMulti) {
+      return insert_multi(forward<Value>(value));
+    } else {
+      return insert_unique(traits_type::get_key(value), forward<Value>(value));
+    }
+  }
+
+  // Constructs the value only if the key is absent. Key may refer to args
+  template <class K, class... Types>
+  pair<iterator, bool> insert_unique(const K& key, Types&&... args) {
+    node_type* node{m_root};
+    if (!node) {
+      return {insert_at(nullptr, 0, forward<Types>(args)...), true};
+    }
+    for (;;) {
+      const size_t pos{lower_bound_in(node, key)};
+      if (pos != node->count && !m_comp(key, key_of(node, pos))) {
+        return {iterator{node, pos}, false};
+      }
+      if (node->leaf) {
+        return {insert_at(node, pos, forward<Types>(args)...), true};
+      }
+      node = node->child(pos);
+    }
+  }
+
+  // Equal keys keep the order of insertion
+  template <class Value>
+  iterator insert_multi(Value&& value) {
+    const key_type& key{traits_type::get_key(value)};
+    node_type* node{m_root};
+    if (!node) {
+      return insert_at(nullptr, 0, forward<Value>(value));
+    }
+    for (;;) {
+      const size_t pos{upper_bound_in(node, key)};
+      if (node->leaf) {
+        return insert_at(node, pos, forward<Value>(value));
+      }
+      node = node->child(pos);
+    }
+  }
+
+  template <class Value>
+  iterator insert_value_hint(const_iterator hint, Value&& value) {
+    const key_type& key{traits_type::get_key(value)};
+    const auto fits_before{[this, &key](const const_iterator& it) {
+      if constexpr (IsMulti) {
+        return !m_comp(traits_type::get_key(*it), key);
+      } else {
+        return m_comp(key, traits_type::get_key(*it));
+      }
+    }};
+    const auto fits_after{[this, &key](const const_iterator& it) {
+      if constexpr (IsMulti) {
+        return !m_comp(key, traits_type::get_key(*it));
+      } else {
+        return m_comp(traits_type::get_key(*it), key);
+      }
+    }};
+
+    if ((hint == end() || fits_before(hint)) &&
+        (hint == begin() || fits_after(--const_iterator{hint}))) {
+      // Insertion always happens in a leaf, right after the predecessor
+      if (!m_root) {
+        return insert_at(nullptr, 0, forward<Value>(value));
+      }
+      node_type* node{hint.m_node};
+      size_t pos{hint.m_pos};
+      if (!node->leaf) {
+        node = node->child(pos);
+        while (!node->leaf) {
+          node = node->child(node->count);
+        }
+        pos = node->count;
+      }
+      return insert_at(node, pos, forward<Value>(value));
+    }
+    if constexpr (IsMulti) {
+      return insert_multi(forward<Value>(value));
+    } else {
+      return insert_unique(key, forward<Value>(value)).first;
+    }
+  }
+
+  // Inserts a new value before pos of a leaf; nullptr means an empty tree
+  template <class... Types>
+  iterator insert_at(node_type* node, size_t pos, Types&&... args) {
+    if (!node) {
+      node = allocate_node(true);
+      try {
+        construct_at(addressof(node->value(0)), forward<Types>(args)...);
+      } catch (...) {
+        deallocate_node(node);
+        throw;
+      }
+      node->count = 1;
+      m_root = node;
+      m_leftmost = node;
+      m_rightmost = node;
+      m_size = 1;
+      return {node, 0};
+    }
+
+    if (node->count == SLOT_COUNT) {
+      split_for_insert(node, pos);
+    }
+    relocate_values(node, pos, node, pos + 1, node->count - pos);
+    try {
+      construct_at(addressof(node->value(pos)), forward<Types>(args)...);
+    } catch (...) {
+      relocate_values(node, pos + 1, node, pos, node->count - pos);
+      throw;
+    }
+    ++node->count;
+    ++m_size;
+    return {node, pos};
+  }
+
+  /*
+   * Makes room in a full node, splitting full ancestors first. Updates node
+   * and pos to the place of the value to be inserted. Every intermediate
+   * state is a valid tree, so a failed allocation only leaves nodes less full
+   */
+  void split_for_insert(node_type*& node, size_t& pos) {
+    if (!node->parent) {
+      internal_type* const root{
+          static_cast<internal_type*>(allocate_node(false))};
+      set_child(root, 0, node);
+      m_root = root;
+    } else if (node->parent->count == SLOT_COUNT) {
+      node_type* parent{node->parent};
+      size_t parent_pos{node->position};
+      split_for_insert(parent, parent_pos);
+    }
+    split(node, pos);
+  }
+
+  // The parent must have room for the separator
+  void split(node_type*& node, size_t& pos) {
+    const size_t count{node->count};
+    // Sequential insertions leave full nodes behind
+    const size_t mid{pos == count ? count - 2 : pos == 0 ? 1 : count / 2};
+    const size_t moved{count - mid - 1};
+
+    node_type* const right{allocate_node(node->leaf)};
+    relocate_values(node, mid + 1, right, 0, moved);
+    if (!node->leaf) {
+      for (size_t idx = 0; idx <= moved; ++idx) {
+        set_child(right, idx, node->child(mid + 1 + idx));
+      }
+    }
+    right->count = static_cast<uint16_t>(moved);
+
+    internal_type* const parent{node->parent};
+    const size_t at{node->position};
+    relocate_values(parent, at, parent, at + 1, parent->count - at);
+    for (size_t idx = parent->count; idx > at; --idx) {
+      set_child(parent, idx + 1, parent->child(idx));
+    }
+    relocate_value(node, mid, parent, at);
+    set_child(parent, at + 1, right);
+    ++parent->count;
+    node->count = static_cast<uint16_t>(mid);
+
+    if (node == m_rightmost) {
+      m_rightmost = right;
+    }
+    if (pos > mid) {
+      node = right;
+      pos -= mid + 1;
+    }
+  }
+
+  /*
+   * Restores the occupancy after a value was erased from the leaf. pos is
+   * the place of the following value, which is tracked through merges and
+   * rotations
+   */
+  iterator rebalance_after_erase(node_type* leaf, size_t pos) noexcept {
+    node_type* node{leaf};
+    for (;;) {
+      internal_type* const parent{node->parent};
+      if (!parent) {
+        if (!node->count) {
+          if (node->leaf) {
+            deallocate_node(node);
+            m_root = nullptr;
+            m_leftmost = nullptr;
+            m_rightmost = nullptr;
+            return end();
+          }
+          m_root = node->child(0);
+          m_root->parent = nullptr;
+          m_root->position = 0;
+          deallocate_node(node);
+        }
+        break;
+      }
+      if (node->count >= MIN_SLOT_COUNT) {
+        break;
+      }
+
+      const size_t idx{node->position};
+      node_type* const left{idx ? parent->child(idx - 1) : nullptr};
+      node_type* const right{idx < parent->count ? parent->child(idx + 1)
+                                                 : nullptr};
+      if (left && left->count + node->count < SLOT_COUNT) {
+        if (leaf == node) {
+          leaf = left;
+          pos += left->count + 1u;
+        }
+        merge(left, node);
+      } else if (right && node->count + right->count < SLOT_COUNT) {
+        merge(node, right);
+      } else {
+        if (left) {
+          rotate_right(left, node);
+          if (leaf == node) {
+            ++pos;
+          }
+        } else {
+          rotate_left(node, right);
+        }
+        break;
+      }
+      node = parent;
+    }
+    return normalize(leaf, pos);
+  }
+
+  // Moves the separator and right into left, then frees right
+  void merge(node_type* left, node_type* right) noexcept {
+    internal_type* const parent{left->parent};
+    const size_t idx{left->position};
+    const size_t base{left->count};
+
+    relocate_value(parent, idx, left, base);
+    relocate_values(right, 0, left, base + 1, right->count);
+    if (!left->leaf) {
+      for (size_t child = 0; child <= right->count; ++child) {
+        set_child(left, base + 1 + child, right->child(child));
+      }
+    }
+    left->count = static_cast<uint16_t>(base + 1 + right->count);
+
+    relocate_values(parent, idx + 1, parent, idx, parent->count - idx - 1u);
+    for (size_t child = idx + 2; child <= parent->count; ++child) {
+      set_child(parent, child - 1, parent->child(child));
+    }
+    --parent->count;
+
+    if (right == m_rightmost) {
+      m_rightmost = left;
+    }
+    deallocate_node(right);
+  }
+
+  // Moves the last value of left up and the separator down into node
+  void rotate_right(node_type* left, node_type* node) noexcept {
+    internal_type* const parent{node->parent};
+    const size_t idx{node->position - 1u};
+
+    relocate_values(node, 0, node, 1, node->count);
+    relocate_value(parent, idx, node, 0);
+    relocate_value(left, left->count - 1u, parent, idx);
+    if (!node->leaf) {
+      for (size_t child = node->count + 1u; child > 0; --child) {
+        set_child(node, child, node->child(child - 1));
+      }
+      set_child(node, 0, left->child(left->count));
+    }
+    --left->count;
+    ++node->count;
+  }
+
+  // Moves the separator down into node and the first value of right up
+  void rotate_left(node_type* node, node_type* right) noexcept {
+    internal_type* const parent{node->parent};
+    const size_t idx{node->position};
+
+    relocate_value(parent, idx, node, node->count);
+    relocate_value(right, 0, parent, idx);
+    relocate_values(right, 1, right, 0, right->count - 1u);
+    if (!node->leaf) {
+      set_child(node, node->count + 1u, right->child(0));
+      for (size_t child = 0; child < right->count; ++child) {
+        set_child(right, child, right->child(child + 1));
+      }
+    }
+    ++node->count;
+    --right->count;
+  }
+
+  static void set_child(node_type* node,
+                        size_t idx,
+                        node_type* child) noexcept {
+    static_cast<internal_type*>(node)->children[idx] = child;
+    child->parent = static_cast<internal_type*>(node);
+    child->position = static_cast<uint16_t>(idx);
+  }
+
+  static void relocate_value(node_type* src,
+                             size_t src_pos,
+                             node_type* dst,
+                             size_t dst_pos) noexcept {
+    value_type& value{src->value(src_pos)};
+    construct_at(addressof(dst->value(dst_pos)), move(value));
+    destroy_at(addressof(value));
+  }
+
+  // Ranges may overlap if both are in the same node
+  static void relocate_values(node_type* src,
+                              size_t src_pos,
+                              node_type* dst,
+                              size_t dst_pos,
+                              size_t count) noexcept {
+    if (src == dst && dst_pos > src_pos) {
+      for (size_t idx = count; idx > 0; --idx) {
+        relocate_value(src, src_pos + idx - 1, dst, dst_pos + idx - 1);
+      }
+    } else {
+      for (size_t idx = 0; idx < count; ++idx) {
+        relocate_value(src, src_pos + idx, dst, dst_pos + idx);
+      }
+    }
+  }
+
+  node_type* allocate_node(bool leaf) {
+    void* const buffer{AlBytesTraits::allocate_bytes(
+        m_alc, leaf ? sizeof(node_type) : sizeof(internal_type))};
+    // Slots and children are left uninitialized
+    node_type* const node{leaf ? ::new (buffer) node_type
+                               : ::new (buffer) internal_type};
+    node->parent = nullptr;
+    node->position = 0;
+    node->count = 0;
+    node->leaf = leaf;
+    return node;
+  }
+
+  void deallocate_node(node_type* node) noexcept {
+    AlBytesTraits::deallocate_bytes(
+        m_alc, node, node->leaf ? sizeof(node_type) : sizeof(internal_type));
+  }
+
+  void destroy_subtree(node_type* node) noexcept {
+    if (!node->leaf) {
+      for (size_t idx = 0; idx <= node->count; ++idx) {
+        destroy_subtree(node->child(idx));
+      }
+    }
+    if constexpr (!is_trivially_destructible_v<value_type>) {
+      for (size_t idx = 0; idx < node->count; ++idx) {
+        destroy_at(addressof(node->value(idx)));
+      }
+    }
+    deallocate_node(node);
+  }
+
+ private:
+  Compare m_comp{};
+  allocator_type m_alc{};
+  node_type* m_root{nullptr};
+  node_type* m_leftmost{nullptr};
+  node_type* m_rightmost{nullptr};
+  size_t m_size{0};
+};
+
+template <class Key,
+          class Ty,
+          class Compare,
+          class BytesAllocator,
+          bool IsMulti,
+          size_t NodeSize>
+void swap(btree<Key, Ty, Compare, BytesAllocator, IsMulti, NodeSize>& lhs,
+          btree<Key, Ty, Compare, BytesAllocator, IsMulti, NodeSize>&
+              rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace bt::details
+}  // namespace ktl
@@ -0,0 +1,638 @@
+#pragma once
+#include <basic_types.hpp>
+#include <allocator.hpp>
+#include <crt_attributes.hpp>
+#include <hash.hpp>
+#include <hash_table_impl.hpp>
+#include <ktlexcept.hpp>
+#include <limits.hpp>
+#include <memory.hpp>
+#include <mutex.hpp>
+#include <optional.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+namespace ktl {
+struct cache_stats {
+  size_t hits{0};
+  size_t misses{0};
+  size_t evictions{0};
+};
+
+namespace un::details {
+inline constexpr uint32_t CACHE_NIL{(numeric_limits<uint32_t>::max)()};
+
+// Distinct type keeps overloads for indices and keys unambiguous
+enum class cache_slot_index : uint32_t {};
+
+/*
+ * Entries never move: the robin-hood table shifts its elements on insertion
+ * and erasure, so it stores indices of slots only, and the replacement
+ * policy keeps its links right in the slots
+ */
+template <class Key, class Ty, class Node>
+struct cache_slot {
+  using entry_type = pair<Key, Ty>;
+
+  entry_type& entry() noexcept {
+    return *reinterpret_cast<entry_type*>(addressof(storage));
+  }
+
+  const entry_type& entry() const noexcept {
+    return *reinterpret_cast<const entry_type*>(addressof(storage));
+  }
+
+  Node node;
+  aligned_storage_t<sizeof(entry_type), alignof(entry_type)> storage;
+};
+
+template <class Slot, class Hash>
+struct cache_slot_hash : Hash {
+  using is_transparent = void;
+
+  cache_slot_hash(const Hash& h, const Slot* slots_) noexcept(
+      is_nothrow_copy_constructible_v<Hash>)
+      : Hash(h), slots{slots_} {}
+
+  size_t operator()(cache_slot_index idx) const {
+    return Hash::operator()(slots[static_cast<uint32_t>(idx)].entry().first);
+  }
+
+  template <class Key>
+  size_t operator()(const Key& key) const {
+    return Hash::operator()(key);
+  }
+
+  const Slot* slots;
+};
+
+template <class Slot, class KeyEqual>
+struct cache_slot_equal : KeyEqual {
+  using is_transparent = void;
+
+  cache_slot_equal(const KeyEqual& equal, const Slot* slots_) noexcept(
+      is_nothrow_copy_constructible_v<KeyEqual>)
+      : KeyEqual(equal), slots{slots_} {}
+
+  // Keys of different slots are always different
+  bool operator()(cache_slot_index lhs, cache_slot_index rhs) const noexcept {
+    return lhs == rhs;
+  }
+
+  template <class Key>
+  bool operator()(const Key& key, cache_slot_index idx) const {
+    return KeyEqual::operator()(
+        key, slots[static_cast<uint32_t>(idx)].entry().first);
+  }
+
+  const Slot* slots;
+};
+
+// Evicts the least recently used entry
+class lru_policy {
+ public:
+  struct node_type {
+    uint32_t prev;
+    uint32_t next;  // Also links free slots
+  };
+
+ public:
+  template <class Slot>
+  void attach(Slot* slots, uint32_t idx) noexcept {
+    node_type& node{slots[idx].node};
+    node.prev = CACHE_NIL;
+    node.next = m_head;
+    if (m_head != CACHE_NIL) {
+      slots[m_head].node.prev = idx;
+    } else {
+      m_tail = idx;
+    }
+    m_head = idx;
+  }
+
+  template <class Slot>
+  void detach(Slot* slots, uint32_t idx) noexcept {
+    const node_type& node{slots[idx].node};
+    if (node.prev != CACHE_NIL) {
+      slots[node.prev].node.next = node.next;
+    } else {
+      m_head = node.next;
+    }
+    if (node.next != CACHE_NIL) {
+      slots[node.next].node.prev = node.prev;
+    } else {
+      m_tail = node.prev;
+    }
+  }
+
+  template <class Slot>
+  void touch(Slot* slots, uint32_t idx) noexcept {
+    if (idx != m_head) {
+      detach(slots, idx);
+      attach(slots, idx);
+    }
+  }
+
+  template <class Slot>
+  [[nodiscard]] uint32_t victim([[maybe_unused]] Slot* slots,
+                                [[maybe_unused]] size_t capacity) noexcept {
+    return m_tail;
+  }
+
+  void reset() noexcept {
+    m_head = CACHE_NIL;
+    m_tail = CACHE_NIL;
+  }
+
+ private:
+  uint32_t m_head{CACHE_NIL};
+  uint32_t m_tail{CACHE_NIL};
+};
+
+/*
+ * Approximates LRU with the "second chance" sweep: a hit only sets a flag,
+ * so it doesn't write to other entries. New entries aren't referenced, so a
+ * single scan doesn't flush entries which are actually in use
+ */
+class clock_policy {
+ public:
+  struct node_type {
+    uint32_t next;  // Links free slots only
+    bool referenced;
+  };
+
+ public:
+  template <class Slot>
+  void attach(Slot* slots, uint32_t idx) noexcept {
+    slots[idx].node.referenced = false;
+  }
+
+  template <class Slot>
+  void detach([[maybe_unused]] Slot* slots,
+              [[maybe_unused]] uint32_t idx) noexcept {}
+
+  template <class Slot>
+  void touch(Slot* slots, uint32_t idx) noexcept {
+    slots[idx].node.referenced = true;
+  }
+
+  // Called only when the cache is full, so all slots are occupied
+  template <class Slot>
+  [[nodiscard]] uint32_t victim(Slot* slots, size_t capacity) noexcept {
+    while (slots[m_hand].node.referenced) {
+      slots[m_hand].node.referenced = false;
+      advance(capacity);
+    }
+    const uint32_t idx{m_hand};
+    advance(capacity);
+    return idx;
+  }
+
+  void reset() noexcept { m_hand = 0; }
+
+ private:
+  void advance(size_t capacity) noexcept {
+    if (++m_hand == capacity) {
+      m_hand = 0;
+    }
+  }
+
+ private:
+  uint32_t m_hand{0};
+};
+
+/*
+ * Cache of a fixed capacity. All memory is allocated by the constructor; the
+ * index table is reserved for the whole capacity, so it never grows unless
+ * the hash is too bad for robin-hood hashing to fit all keys
+ */
+template <class Key,
+          class Ty,
+          class Hash,
+          class KeyEqual,
+          class BytesAllocator,
+          class Policy>
+class fixed_cache : non_relocatable {
+ public:
+  using key_type = Key;
+  using mapped_type = Ty;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using allocator_type = BytesAllocator;
+
+ private:
+  using node_type = typename Policy::node_type;
+  using slot_type = cache_slot<Key, Ty, node_type>;
+  using entry_type = typename slot_type::entry_type;
+  using slot_hasher = cache_slot_hash<slot_type, Hash>;
+  using slot_key_equal = cache_slot_equal<slot_type, KeyEqual>;
+  using index_table = Table<true,
+                            cache_slot_index,
+                            void,
+                            slot_hasher,
+                            slot_key_equal,
+                            BytesAllocator,
+                            80>;
+  using AlBytesTraits = allocator_traits<allocator_type>;
+
+ public:
+  explicit fixed_cache(size_type capacity,
+                       const Hash& h = Hash{},
+                       const KeyEqual& equal = KeyEqual{},
+                       const allocator_type& alloc = allocator_type{})
+      : m_alc{alloc},
+        m_capacity{check_capacity(capacity)},
+        m_slots{allocate_slots(m_alc, m_capacity)},
+        m_index{0, slot_hasher{h, m_slots}, slot_key_equal{equal, m_slots},
+                alloc} {
+    try {
+      m_index.reserve(m_capacity);
+    } catch (...) {
+      deallocate_slots();
+      throw;
+    }
+  }
+
+  ~fixed_cache() noexcept {
+    destroy_entries();
+    deallocate_slots();
+  }
+
+  // Returns nullptr on miss; a hit marks the entry as recently used
+  [[nodiscard]] Ty* get(const key_type& key) {
+    const auto it{m_index.find(key)};
+    if (it == m_index.end()) {
+      ++m_stats.misses;
+      return nullptr;
+    }
+    ++m_stats.hits;
+    const auto idx{static_cast<uint32_t>(*it)};
+    m_policy.touch(m_slots, idx);
+    return addressof(m_slots[idx].entry().second);
+  }
+
+  // Neither updates recency nor counts as a hit or a miss
+  [[nodiscard]] const Ty* peek(const key_type& key) const {
+    const auto it{m_index.find(key)};
+    if (it == m_index.end()) {
+      return nullptr;
+    }
+    return addressof(m_slots[static_cast<uint32_t>(*it)].entry().second);
+  }
+
+  [[nodiscard]] bool contains(const key_type& key) const {
+    return m_index.find(key) != m_index.end();
+  }
+
+  // Inserts or assigns the value evicting an entry if the cache is full
+  template <class ValueTy>
+  Ty& put(const key_type& key, ValueTy&& value) {
+    return put_impl(key, forward<ValueTy>(value));
+  }
+
+  template <class ValueTy>
+  Ty& put(key_type&& key, ValueTy&& value) {
+    return put_impl(move(key), forward<ValueTy>(value));
+  }
+
+  bool erase(const key_type& key) {
+    const auto it{m_index.find(key)};
+    if (it == m_index.end()) {
+      return false;
+    }
+    const auto idx{static_cast<uint32_t>(*it)};
+    m_index.erase(it);
+    m_policy.detach(m_slots, idx);
+    destroy_at(addressof(m_slots[idx].entry()));
+    release_slot(idx);
+    return true;
+  }
+
+  // Keeps statistics
+  void clear() noexcept {
+    destroy_entries();
+    m_index.clear();
+    m_policy.reset();
+    m_free = CACHE_NIL;
+    m_used = 0;
+  }
+
+  [[nodiscard]] size_type size() const noexcept { return m_index.size(); }
+  [[nodiscard]] size_type capacity() const noexcept { return m_capacity; }
+  [[nodiscard]] bool empty() const noexcept { return m_index.empty(); }
+
+  [[nodiscard]] const cache_stats& stats() const noexcept { return m_stats; }
+  void reset_stats() noexcept { m_stats = cache_stats{}; }
+
+ private:
+  template <class KeyTy, class ValueTy>
+  Ty& put_impl(KeyTy&& key, ValueTy&& value) {
+    const auto it{m_index.find(key)};
+    if (it != m_index.end()) {
+      const auto idx{static_cast<uint32_t>(*it)};
+      Ty& target{m_slots[idx].entry().second};
+      target = forward<ValueTy>(value);
+      m_policy.touch(m_slots, idx);
+      return target;
+    }
+
+    const uint32_t idx{m_index.size() == m_capacity ? evict() : acquire_slot()};
+    entry_type* const entry{addressof(m_slots[idx].entry())};
+    try {
+      construct_at(entry, forward<KeyTy>(key), forward<ValueTy>(value));
+    } catch (...) {
+      release_slot(idx);
+      throw;
+    }
+    try {
+      m_index.insert(static_cast<cache_slot_index>(idx));
+    } catch (...) {
+      destroy_at(entry);
+      release_slot(idx);
+      throw;
+    }
+    m_policy.attach(m_slots, idx);
+    return entry->second;
+  }
+
+  uint32_t evict() {
+    const uint32_t idx{m_policy.victim(m_slots, m_capacity)};
+    m_index.erase(static_cast<cache_slot_index>(idx));
+    m_policy.detach(m_slots, idx);
+    destroy_at(addressof(m_slots[idx].entry()));
+    ++m_stats.evictions;
+    return idx;
+  }
+
+  uint32_t acquire_slot() noexcept {
+    if (m_free == CACHE_NIL) {
+      return m_used++;
+    }
+    return exchange(m_free, m_slots[m_free].node.next);
+  }
+
+  void release_slot(uint32_t idx) noexcept {
+    m_slots[idx].node.next = exchange(m_free, idx);
+  }
+
+  void destroy_entries() noexcept {
+    if constexpr (!is_trivially_destructible_v<entry_type>) {
+      for (const auto idx : m_index) {
+        destroy_at(addressof(m_slots[static_cast<uint32_t>(idx)].entry()));
+      }
+    }
+  }
+
+  static size_type check_capacity(size_type capacity) {
+    throw_exception_if_not<length_error>(
+        capacity && capacity < CACHE_NIL, "cache capacity is out of range");
+    return capacity;
+  }
+
+  static slot_type* allocate_slots(allocator_type& alc, size_type capacity) {
+    return reinterpret_cast<slot_type*>(
+        AlBytesTraits::allocate_bytes(alc, capacity * sizeof(slot_type)));
+  }
+
+  void deallocate_slots() noexcept {
+    AlBytesTraits::deallocate_bytes(m_alc, reinterpret_cast<byte*>(m_slots),
+                                    m_capacity * sizeof(slot_type));
+  }
+
+ private:
+  allocator_type m_alc;
+  size_type m_capacity;
+  slot_type* m_slots;
+  index_table m_index;
+  Policy m_policy{};
+  uint32_t m_free{CACHE_NIL};
+  uint32_t m_used{0};
+  cache_stats m_stats{};
+};
+
+/*
+ * Splits the capacity between ShardCount caches with their own locks. The
+ * shard is selected by the upper bits of the mixed hash: the lower ones are
+ * used by the index tables inside the shards
+ */
+template <class Cache,
+          size_t ShardCount,
+          class Mutex,
+          template <typename, align_val_t>
+          class BasicAllocator>
+class sharded_cache : non_relocatable {
+ public:
+  using key_type = typename Cache::key_type;
+  using mapped_type = typename Cache::mapped_type;
+  using size_type = size_t;
+  using hasher = typename Cache::hasher;
+  using key_equal = typename Cache::key_equal;
+  using allocator_type = typename Cache::allocator_type;
+  using mutex_type = Mutex;
+
+  static constexpr size_type SHARD_COUNT{ShardCount};
+
+  static_assert(ShardCount && !(ShardCount & (ShardCount - 1)),
+                "ShardCount must be a power of 2");
+
+ private:
+  ALIGN(crt::CACHE_LINE_SIZE) struct shard {
+    shard(size_type capacity,
+          const hasher& h,
+          const key_equal& equal,
+          const allocator_type& alloc)
+        : cache(capacity, h, equal, alloc) {}
+
+    mutable mutex_type lock;
+    Cache cache;
+  };
+
+  using shard_allocator_type =
+      BasicAllocator<shard, static_cast<align_val_t>(alignof(shard))>;
+  using shard_allocator_traits_type = allocator_traits<shard_allocator_type>;
+
+ public:
+  // The capacity is rounded up to a multiple of ShardCount
+  explicit sharded_cache(size_type capacity,
+                         const hasher& h = hasher{},
+                         const key_equal& equal = key_equal{},
+                         const allocator_type& alloc = allocator_type{})
+      : m_hash{h},
+        m_shards{shard_allocator_traits_type::allocate(m_shard_alc,
+                                                        ShardCount)} {
+    const size_type shard_capacity{(capacity + ShardCount - 1) / ShardCount};
+    size_type constructed{0};
+    try {
+      for (; constructed < ShardCount; ++constructed) {
+        construct_at(m_shards + constructed, shard_capacity, h, equal, alloc);
+      }
+    } catch (...) {
+      destroy_shards(constructed);
+      throw;
+    }
+  }
+
+  ~sharded_cache() noexcept { destroy_shards(ShardCount); }
+
+  // Copies the value out because it may be evicted as soon as the lock is
+  // released
+  [[nodiscard]] optional<mapped_type> get(const key_type& key) {
+    shard& target{select(key)};
+    lock_guard guard{target.lock};
+    if (const auto* value = target.cache.get(key); value) {
+      return *value;
+    }
+    return nullopt;
+  }
+
+  [[nodiscard]] bool contains(const key_type& key) const {
+    const shard& target{select(key)};
+    lock_guard guard{target.lock};
+    return target.cache.contains(key);
+  }
+
+  template <class ValueTy>
+  void put(const key_type& key, ValueTy&& value) {
+    shard& target{select(key)};
+    lock_guard guard{target.lock};
+    target.cache.put(key, forward<ValueTy>(value));
+  }
+
+  template <class ValueTy>
+  void put(key_type&& key, ValueTy&& value) {
+    shard& target{select(key)};
+    lock_guard guard{target.lock};
+    target.cache.put(move(key), forward<ValueTy>(value));
+  }
+
+  bool erase(const key_type& key) {
+    shard& target{select(key)};
+    lock_guard guard{target.lock};
+    return target.cache.erase(key);
+  }
+
+  void clear() noexcept {
+    for (size_type idx = 0; idx < ShardCount; ++idx) {
+      lock_guard guard{m_shards[idx].lock};
+      m_shards[idx].cache.clear();
+    }
+  }
+
+  // Shards are locked one by one, so the result may be outdated
+  [[nodiscard]] size_type size() const noexcept {
+    size_type total{0};
+    for (size_type idx = 0; idx < ShardCount; ++idx) {
+      lock_guard guard{m_shards[idx].lock};
+      total += m_shards[idx].cache.size();
+    }
+    return total;
+  }
+
+  [[nodiscard]] size_type capacity() const noexcept {
+    return m_shards[0].cache.capacity() * ShardCount;
+  }
+
+  [[nodiscard]] cache_stats stats() const noexcept {
+    cache_stats total;
+    for (size_type idx = 0; idx < ShardCount; ++idx) {
+      lock_guard guard{m_shards[idx].lock};
+      const cache_stats& stats{m_shards[idx].cache.stats()};
+      total.hits += stats.hits;
+      total.misses += stats.misses;
+      total.evictions += stats.evictions;
+    }
+    return total;
+  }
+
+ private:
+  shard& select(const key_type& key) const {
+    if constexpr (ShardCount == 1) {
+      return m_shards[0];
+    } else {
+      const size_t mixed{hash_int(m_hash(key))};
+      return m_shards[mixed >> (sizeof(size_t) * CHAR_BIT - calc_shard_bits())];
+    }
+  }
+
+  static constexpr size_t calc_shard_bits() noexcept {
+    size_t bits{0};
+    while ((size_t{1} << bits) < ShardCount) {
+      ++bits;
+    }
+    return bits;
+  }
+
+  void destroy_shards(size_type count) noexcept {
+    for (size_type idx = 0; idx < count; ++idx) {
+      destroy_at(m_shards + idx);
+    }
+    shard_allocator_traits_type::deallocate(m_shard_alc, m_shards, ShardCount);
+  }
+
+ private:
+  shard_allocator_type m_shard_alc{};
+  hasher m_hash;
+  shard* m_shards;
+};
+}  // namespace un::details
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>>
+using lru_cache = un::details::fixed_cache<Key,
+                                           Ty,
+                                           Hash,
+                                           KeyEqual,
+                                           BytesAllocator,
+                                           un::details::lru_policy>;
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>>
+using lru_cache_non_paged =
+    un::details::fixed_cache<Key,
+                             Ty,
+                             Hash,
+                             KeyEqual,
+                             BytesAllocator,
+                             un::details::lru_policy>;
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>>
+using clock_cache = un::details::fixed_cache<Key,
+                                             Ty,
+                                             Hash,
+                                             KeyEqual,
+                                             BytesAllocator,
+                                             un::details::clock_policy>;
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>>
+using clock_cache_non_paged =
+    un::details::fixed_cache<Key,
+                             Ty,
+                             Hash,
+                             KeyEqual,
+                             BytesAllocator,
+                             un::details::clock_policy>;
+
+// Usable at DISPATCH_LEVEL: memory is non-paged and shards are spin-locked
+template <class Cache,
+          size_t ShardCount = 16,
+          class Mutex = spin_lock<>,
+          template <typename, align_val_t> class BasicAllocator =
+              aligned_non_paged_allocator>
+using sharded_cache =
+    un::details::sharded_cache<Cache, ShardCount, Mutex, BasicAllocator>;
+}  // namespace ktl
@@ -0,0 +1,594 @@
+#pragma once
+#include <basic_types.hpp>
+#include <algorithm.hpp>
+#include <allocator.hpp>
+#include <assert.hpp>
+#include <initializer_list.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <limits.hpp>
+#include <memory.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+namespace ktl {
+namespace dq::details {
+template <class Ty>
+constexpr size_t calc_chunk_capacity(size_t chunk_size) noexcept {
+  return (max)(size_t{1}, chunk_size / sizeof(Ty));
+}
+}  // namespace dq::details
+
+/*
+ * Double-ended queue keeping the elements in chunks of ChunkSize bytes which
+ * are referenced from a small chunk index. Pushing and popping at both ends
+ * takes O(1), never moves the elements and never needs a contiguous block
+ * larger than a chunk, except the index itself which holds a pointer per
+ * chunk.
+ *
+ * Pointers and references to the elements stay valid until the elements are
+ * popped; iterators are invalidated by any push since the index may be
+ * reallocated. Insertion and erasure in the middle aren't supported
+ */
+template <class Ty,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t ChunkSize = crt::MEMORY_PAGE_SIZE>
+class deque {
+ private:
+  using AlBytesTraits = allocator_traits<BytesAllocator>;
+
+ public:
+  using value_type = Ty;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using allocator_type = BytesAllocator;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using pointer = value_type*;
+  using const_pointer = const value_type*;
+
+  static constexpr size_t CHUNK_CAPACITY{
+      dq::details::calc_chunk_capacity<value_type>(ChunkSize)};
+
+  static_assert(alignof(value_type) <=
+                    static_cast<size_t>(crt::DEFAULT_ALLOCATION_ALIGNMENT),
+                "over-aligned types aren't supported");
+
+ private:
+  static constexpr size_t CHUNK_BYTES{CHUNK_CAPACITY * sizeof(value_type)};
+  static constexpr size_t MIN_INDEX_SIZE{8};
+
+ public:
+  template <bool IsConst>
+  class deque_iterator {
+   public:
+    using iterator_category = random_access_iterator_tag;
+    using value_type = typename deque::value_type;
+    using difference_type = ptrdiff_t;
+    using pointer = conditional_t<IsConst, const value_type*, value_type*>;
+    using reference = conditional_t<IsConst, const value_type&, value_type&>;
+
+   public:
+    deque_iterator() noexcept = default;
+
+    template <bool OtherConst,
+              enable_if_t<IsConst && !OtherConst, int> = 0>
+    deque_iterator(const deque_iterator<OtherConst>& other) noexcept
+        : m_chunks{other.m_chunks}, m_pos{other.m_pos} {}
+
+    reference operator*() const noexcept {
+      return m_chunks[m_pos / CHUNK_CAPACITY][m_pos % CHUNK_CAPACITY];
+    }
+
+    pointer operator->() const noexcept { return addressof(**this); }
+
+    reference operator[](difference_type offset) const noexcept {
+      return *(*this + offset);
+    }
+
+    deque_iterator& operator++() noexcept {
+      ++m_pos;
+      return *this;
+    }
+
+    deque_iterator operator++(int) noexcept {
+      deque_iterator tmp{*this};
+      ++m_pos;
+      return tmp;
+    }
+
+    deque_iterator& operator--() noexcept {
+      --m_pos;
+      return *this;
+    }
+
+    deque_iterator operator--(int) noexcept {
+      deque_iterator tmp{*this};
+      --m_pos;
+      return tmp;
+    }
+
+    deque_iterator& operator+=(difference_type offset) noexcept {
+      m_pos += static_cast<size_t>(offset);
+      return *this;
+    }
+
+    deque_iterator& operator-=(difference_type offset) noexcept {
+      m_pos -= static_cast<size_t>(offset);
+      return *this;
+    }
+
+    deque_iterator operator+(difference_type offset) const noexcept {
+      deque_iterator tmp{*this};
+      return tmp += offset;
+    }
+
+    friend deque_iterator operator+(difference_type offset,
+                                    const deque_iterator& it) noexcept {
+      return it + offset;
+    }
+
+    deque_iterator operator-(difference_type offset) const noexcept {
+      deque_iterator tmp{*this};
+      return tmp -= offset;
+    }
+
+    template <bool OtherConst>
+    difference_type operator-(
+        const deque_iterator<OtherConst>& other) const noexcept {
+      return static_cast<difference_type>(m_pos - other.m_pos);
+    }
+
+    template <bool OtherConst>
+    bool operator==(const deque_iterator<OtherConst>& other) const noexcept {
+      return m_pos == other.m_pos;
+    }
+
+    template <bool OtherConst>
+    bool operator!=(const deque_iterator<OtherConst>& other) const noexcept {
+      return !(*this == other);
+    }
+
+    template <bool OtherConst>
+    bool operator<(const deque_iterator<OtherConst>& other) const noexcept {
+      return m_pos < other.m_pos;
+    }
+
+    template <bool OtherConst>
+    bool operator>(const deque_iterator<OtherConst>& other) const noexcept {
+      return other < *this;
+    }
+
+    template <bool OtherConst>
+    bool operator<=(const deque_iterator<OtherConst>& other) const noexcept {
+      return !(other < *this);
+    }
+
+    template <bool OtherConst>
+    bool operator>=(const deque_iterator<OtherConst>& other) const noexcept {
+      return !(*this < other);
+    }
+
+   private:
+    deque_iterator(value_type* const* chunks, size_t pos) noexcept
+        : m_chunks{chunks}, m_pos{pos} {}
+
+    friend class deque;
+    template <bool>
+    friend class deque_iterator;
+
+   private:
+    value_type* const* m_chunks{nullptr};
+    size_t m_pos{0};
+  };
+
+  using iterator = deque_iterator<false>;
+  using const_iterator = deque_iterator<true>;
+
+ public:
+  deque() noexcept(is_nothrow_default_constructible_v<allocator_type>) =
+      default;
+
+  explicit deque(const allocator_type& alloc) : m_alc{alloc} {}
+
+  explicit deque(size_type count,
+                 const allocator_type& alloc = allocator_type{})
+      : m_alc{alloc} {
+    try {
+      resize(count);
+    } catch (...) {
+      release_all();
+      throw;
+    }
+  }
+
+  deque(size_type count,
+        const value_type& value,
+        const allocator_type& alloc = allocator_type{})
+      : m_alc{alloc} {
+    try {
+      resize(count, value);
+    } catch (...) {
+      release_all();
+      throw;
+    }
+  }
+
+  template <class InputIt,
+            enable_if_t<is_base_of_v<input_iterator_tag,
+                                     typename iterator_traits<
+                                         InputIt>::iterator_category>,
+                        int> = 0>
+  deque(InputIt first,
+        InputIt last,
+        const allocator_type& alloc = allocator_type{})
+      : m_alc{alloc} {
+    try {
+      for (; first != last; ++first) {
+        emplace_back(*first);
+      }
+    } catch (...) {
+      release_all();
+      throw;
+    }
+  }
+
+  deque(initializer_list<value_type> init,
+        const allocator_type& alloc = allocator_type{})
+      : deque(init.begin(), init.end(), alloc) {}
+
+  deque(const deque& other)
+      : deque(other.begin(),
+              other.end(),
+              AlBytesTraits::select_on_container_copy_construction(
+                  other.m_alc)) {}
+
+  deque(deque&& other) noexcept
+      : m_alc{move(other.m_alc)},
+        m_index{exchange(other.m_index, nullptr)},
+        m_index_size{exchange(other.m_index_size, 0)},
+        m_spare{exchange(other.m_spare, nullptr)},
+        m_first{exchange(other.m_first, 0)},
+        m_size{exchange(other.m_size, 0)} {}
+
+  deque& operator=(const deque& other) {
+    if (this != addressof(other)) {
+      deque tmp{other};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  deque& operator=(deque&& other) noexcept {
+    if (this != addressof(other)) {
+      deque tmp{move(other)};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  deque& operator=(initializer_list<value_type> init) {
+    deque tmp{init, m_alc};
+    swap(tmp);
+    return *this;
+  }
+
+  ~deque() noexcept { release_all(); }
+
+  void swap(deque& other) noexcept {
+    using ktl::swap;
+    swap(m_alc, other.m_alc);
+    swap(m_index, other.m_index);
+    swap(m_index_size, other.m_index_size);
+    swap(m_spare, other.m_spare);
+    swap(m_first, other.m_first);
+    swap(m_size, other.m_size);
+  }
+
+  allocator_type get_allocator() const { return m_alc; }
+
+  [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+  size_type size() const noexcept { return m_size; }
+
+  constexpr size_type max_size() const noexcept {
+    return (numeric_limits<size_type>::max)() / 2;
+  }
+
+  iterator begin() noexcept { return {m_index, m_first}; }
+  const_iterator begin() const noexcept { return {m_index, m_first}; }
+  const_iterator cbegin() const noexcept { return begin(); }
+
+  iterator end() noexcept { return {m_index, m_first + m_size}; }
+  const_iterator end() const noexcept { return {m_index, m_first + m_size}; }
+  const_iterator cend() const noexcept { return end(); }
+
+  reference operator[](size_type idx) noexcept {
+    assert_with_msg(idx < size(), "index is out of range");
+    return element_at(m_first + idx);
+  }
+
+  const_reference operator[](size_type idx) const noexcept {
+    assert_with_msg(idx < size(), "index is out of range");
+    return element_at(m_first + idx);
+  }
+
+  reference at(size_type idx) {
+    throw_exception_if_not<out_of_range>(idx < size(),
+                                         "index is out of range");
+    return element_at(m_first + idx);
+  }
+
+  const_reference at(size_type idx) const {
+    throw_exception_if_not<out_of_range>(idx < size(),
+                                         "index is out of range");
+    return element_at(m_first + idx);
+  }
+
+  reference front() noexcept {
+    assert_with_msg(!empty(), "front() called at empty deque");
+    return element_at(m_first);
+  }
+
+  const_reference front() const noexcept {
+    assert_with_msg(!empty(), "front() called at empty deque");
+    return element_at(m_first);
+  }
+
+  reference back() noexcept {
+    assert_with_msg(!empty(), "back() called at empty deque");
+    return element_at(m_first + m_size - 1);
+  }
+
+  const_reference back() const noexcept {
+    assert_with_msg(!empty(), "back() called at empty deque");
+    return element_at(m_first + m_size - 1);
+  }
+
+  void push_back(const value_type& value) { emplace_back(value); }
+  void push_back(value_type&& value) { emplace_back(move(value)); }
+
+  template <class... Types>
+  reference emplace_back(Types&&... args) {
+    if (m_first + m_size == m_index_size * CHUNK_CAPACITY) {
+      grow_index(false);
+    }
+    value_type* place{
+        construct_in_slot(m_first + m_size, forward<Types>(args)...)};
+    ++m_size;
+    return *place;
+  }
+
+  void push_front(const value_type& value) { emplace_front(value); }
+  void push_front(value_type&& value) { emplace_front(move(value)); }
+
+  template <class... Types>
+  reference emplace_front(Types&&... args) {
+    if (m_first == 0) {
+      grow_index(true);
+    }
+    value_type* place{construct_in_slot(m_first - 1, forward<Types>(args)...)};
+    --m_first;
+    ++m_size;
+    return *place;
+  }
+
+  void pop_back() noexcept {
+    assert_with_msg(!empty(), "pop_back() called at empty deque");
+    const size_t pos{m_first + m_size - 1};
+    destroy_at(addressof(element_at(pos)));
+    --m_size;
+    if (pos % CHUNK_CAPACITY == 0 || empty()) {
+      release_chunk(pos / CHUNK_CAPACITY);
+    }
+    recenter_if_empty();
+  }
+
+  void pop_front() noexcept {
+    assert_with_msg(!empty(), "pop_front() called at empty deque");
+    const size_t pos{m_first};
+    destroy_at(addressof(element_at(pos)));
+    ++m_first;
+    --m_size;
+    if (m_first % CHUNK_CAPACITY == 0 || empty()) {
+      release_chunk(pos / CHUNK_CAPACITY);
+    }
+    recenter_if_empty();
+  }
+
+  void resize(size_type count) {
+    while (m_size > count) {
+      pop_back();
+    }
+    while (m_size < count) {
+      emplace_back();
+    }
+  }
+
+  void resize(size_type count, const value_type& value) {
+    while (m_size > count) {
+      pop_back();
+    }
+    while (m_size < count) {
+      emplace_back(value);
+    }
+  }
+
+  void clear() noexcept {
+    if (empty()) {
+      return;
+    }
+    if constexpr (!is_trivially_destructible_v<value_type>) {
+      for (auto& value : *this) {
+        destroy_at(addressof(value));
+      }
+    }
+    const size_t first_chunk{m_first / CHUNK_CAPACITY},
+        last_chunk{(m_first + m_size - 1) / CHUNK_CAPACITY};
+    for (size_t chunk_idx = first_chunk; chunk_idx <= last_chunk;
+         ++chunk_idx) {
+      release_chunk(chunk_idx);
+    }
+    m_size = 0;
+    recenter_if_empty();
+  }
+
+  // Releases the spare chunk and the index of an empty deque
+  void shrink_to_fit() noexcept {
+    deallocate_chunk(exchange(m_spare, nullptr));
+    if (empty()) {
+      deallocate_index(m_index, m_index_size);
+      m_index = nullptr;
+      m_index_size = 0;
+      m_first = 0;
+    }
+  }
+
+ private:
+  reference element_at(size_t pos) noexcept {
+    return m_index[pos / CHUNK_CAPACITY][pos % CHUNK_CAPACITY];
+  }
+
+  const_reference element_at(size_t pos) const noexcept {
+    return m_index[pos / CHUNK_CAPACITY][pos % CHUNK_CAPACITY];
+  }
+
+  template <class... Types>
+  value_type* construct_in_slot(size_t pos, Types&&... args) {
+    value_type*& chunk{m_index[pos / CHUNK_CAPACITY]};
+    const bool new_chunk{chunk == nullptr};
+    if (new_chunk) {
+      chunk = allocate_chunk();
+    }
+    value_type* place{chunk + pos % CHUNK_CAPACITY};
+    try {
+      construct_at(place, forward<Types>(args)...);
+    } catch (...) {
+      if (new_chunk) {
+        release_chunk(pos / CHUNK_CAPACITY);
+      }
+      throw;
+    }
+    return place;
+  }
+
+  // Moves the used part of the index to its middle, reallocating it when
+  // less than a half of it is free. Only the chunk pointers are copied
+  void grow_index(bool at_front) {
+    const size_t first_chunk{m_first / CHUNK_CAPACITY},
+        used_chunks{m_size == 0 ? 0
+                                : (m_first + m_size - 1) / CHUNK_CAPACITY -
+                                      first_chunk + 1};
+    size_t new_size{m_index_size};
+    value_type** new_index{m_index};
+    if (used_chunks + 1 > m_index_size / 2) {
+      new_size = (max)(MIN_INDEX_SIZE, 2 * m_index_size);
+      new_index = allocate_index(new_size);
+    }
+
+    const size_t new_first_chunk{(new_size - used_chunks) / 2};
+    assert_with_msg(at_front ? new_first_chunk > 0
+                             : new_first_chunk + used_chunks < new_size,
+                    "no free index slot after growth");
+    (void)at_front;
+    if (new_index == m_index) {
+      memmove(new_index + new_first_chunk, m_index + first_chunk,
+              used_chunks * sizeof(value_type*));
+      clear_index(new_index, 0, new_first_chunk);
+      clear_index(new_index, new_first_chunk + used_chunks, new_size);
+    } else if (m_index) {
+      memcpy(new_index + new_first_chunk, m_index + first_chunk,
+             used_chunks * sizeof(value_type*));
+      deallocate_index(m_index, m_index_size);
+    }
+    m_index = new_index;
+    m_index_size = new_size;
+    m_first = new_first_chunk * CHUNK_CAPACITY + m_first % CHUNK_CAPACITY;
+  }
+
+  void recenter_if_empty() noexcept {
+    if (empty()) {
+      m_first = m_index_size / 2 * CHUNK_CAPACITY + CHUNK_CAPACITY / 2;
+    }
+  }
+
+  value_type* allocate_chunk() {
+    if (m_spare) {
+      return exchange(m_spare, nullptr);
+    }
+    return reinterpret_cast<value_type*>(
+        AlBytesTraits::allocate_bytes(m_alc, CHUNK_BYTES));
+  }
+
+  // One released chunk is kept to avoid allocating it again when the deque
+  // shrinks and grows around a chunk boundary
+  void release_chunk(size_t chunk_idx) noexcept {
+    value_type* chunk{exchange(m_index[chunk_idx], nullptr)};
+    deallocate_chunk(exchange(m_spare, chunk));
+  }
+
+  void deallocate_chunk(value_type* chunk) noexcept {
+    if (chunk) {
+      AlBytesTraits::deallocate_bytes(m_alc, chunk, CHUNK_BYTES);
+    }
+  }
+
+  value_type** allocate_index(size_t index_size) {
+    auto** index{reinterpret_cast<value_type**>(AlBytesTraits::allocate_bytes(
+        m_alc, index_size * sizeof(value_type*)))};
+    clear_index(index, 0, index_size);
+    return index;
+  }
+
+  void deallocate_index(value_type** index, size_t index_size) noexcept {
+    if (index) {
+      AlBytesTraits::deallocate_bytes(m_alc, index,
+                                      index_size * sizeof(value_type*));
+    }
+  }
+
+  static void clear_index(value_type** index,
+                          size_t first,
+                          size_t last) noexcept {
+    for (; first < last; ++first) {
+      index[first] = nullptr;
+    }
+  }
+
+  void release_all() noexcept {
+    clear();
+    shrink_to_fit();
+  }
+
+ private:
+  allocator_type m_alc{};
+  value_type** m_index{nullptr};
+  size_t m_index_size{0};
+  value_type* m_spare{nullptr};
+  size_t m_first{0};
+  size_t m_size{0};
+};
+
+template <class Ty, class BytesAllocator, size_t ChunkSize>
+void swap(deque<Ty, BytesAllocator, ChunkSize>& lhs,
+          deque<Ty, BytesAllocator, ChunkSize>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+template <class Ty, class BytesAllocator, size_t ChunkSize>
+bool operator==(const deque<Ty, BytesAllocator, ChunkSize>& lhs,
+                const deque<Ty, BytesAllocator, ChunkSize>& rhs) {
+  return lhs.size() == rhs.size() &&
+         equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <class Ty, class BytesAllocator, size_t ChunkSize>
+bool operator!=(const deque<Ty, BytesAllocator, ChunkSize>& lhs,
+                const deque<Ty, BytesAllocator, ChunkSize>& rhs) {
+  return !(lhs == rhs);
+}
+
+template <class Ty,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t ChunkSize = crt::MEMORY_PAGE_SIZE>
+using deque_non_paged = deque<Ty, BytesAllocator, ChunkSize>;
+}  // namespace ktl
@@ -0,0 +1,577 @@
+#pragma once
+#include <basic_types.hpp>
+#include <algorithm.hpp>
+#include <allocator.hpp>
+#include <functional.hpp>
+#include <initializer_list.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <tuple.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+#include <vector.hpp>
+
+namespace ktl {
+namespace ft::details {
+template <class Key, class Ty>
+struct flat_tree_traits {
+  static constexpr bool is_map = !is_void_v<Ty>;
+  static constexpr bool is_set = !is_map;
+
+  using value_type = conditional_t<is_set, Key, pair<Key, Ty>>;
+
+  [[nodiscard]] static constexpr const Key& get_key(
+      const value_type& value) noexcept {
+    if constexpr (is_map) {
+      return value.first;
+    } else {
+      return value;
+    }
+  }
+};
+
+/*
+ * Values are kept sorted by Compare in a vector, so lookups are binary
+ * searches over a contiguous array and iteration is a linear scan. Suits
+ * small and read-mostly containers: insertion and erasure move the following
+ * values and cost O(N).
+ *
+ * Ranges are inserted in bulk with one sort and one pass removing duplicates.
+ * Insertion and erasure invalidate all iterators, pointers and references
+ */
+template <class Key, class Ty, class Compare, class Allocator, bool IsMulti>
+class flat_tree {
+ private:
+  using traits_type = flat_tree_traits<Key, Ty>;
+
+ public:
+  static constexpr bool is_map = traits_type::is_map;
+  static constexpr bool is_set = traits_type::is_set;
+  static constexpr bool is_multi = IsMulti;
+
+  using key_type = Key;
+  using mapped_type = Ty;
+  using value_type = typename traits_type::value_type;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using key_compare = Compare;
+  using allocator_type = Allocator;
+  using container_type = vector<value_type, allocator_type>;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+  using insert_return_type =
+      conditional_t<IsMulti, iterator, pair<iterator, bool>>;
+
+ public:
+  flat_tree() = default;
+
+  explicit flat_tree(const Compare& comp,
+                     const allocator_type& alloc = allocator_type{})
+      : m_comp{comp}, m_values(alloc) {}
+
+  // Of equivalent keys in the range an unspecified one is kept
+  template <class InputIt>
+  flat_tree(InputIt first,
+            InputIt last,
+            const Compare& comp = Compare{},
+            const allocator_type& alloc = allocator_type{})
+      : m_comp{comp}, m_values(first, last, alloc) {
+    sort_and_remove_duplicates(0);
+  }
+
+  flat_tree(initializer_list<value_type> init,
+            const Compare& comp = Compare{},
+            const allocator_type& alloc = allocator_type{})
+      : flat_tree(init.begin(), init.end(), comp, alloc) {}
+
+  // Takes the values in any order like the range constructor
+  explicit flat_tree(container_type values, const Compare& comp = Compare{})
+      : m_comp{comp}, m_values(move(values)) {
+    sort_and_remove_duplicates(0);
+  }
+
+  flat_tree(const flat_tree&) = default;
+  flat_tree(flat_tree&&) = default;
+  flat_tree& operator=(const flat_tree&) = default;
+  flat_tree& operator=(flat_tree&&) = default;
+
+  flat_tree& operator=(initializer_list<value_type> init) {
+    flat_tree tmp{init, m_comp, m_values.get_allocator()};
+    swap(tmp);
+    return *this;
+  }
+
+  ~flat_tree() noexcept = default;
+
+  void swap(flat_tree& other) noexcept {
+    using ktl::swap;
+    swap(m_comp, other.m_comp);
+    m_values.swap(other.m_values);
+  }
+
+  [[nodiscard]] iterator begin() noexcept { return m_values.begin(); }
+  [[nodiscard]] const_iterator begin() const noexcept {
+    return m_values.begin();
+  }
+  [[nodiscard]] const_iterator cbegin() const noexcept { return begin(); }
+
+  [[nodiscard]] iterator end() noexcept { return m_values.end(); }
+  [[nodiscard]] const_iterator end() const noexcept { return m_values.end(); }
+  [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+  [[nodiscard]] size_type size() const noexcept { return m_values.size(); }
+  [[nodiscard]] bool empty() const noexcept { return m_values.empty(); }
+  [[nodiscard]] size_type max_size() const noexcept {
+    return m_values.max_size();
+  }
+
+  [[nodiscard]] size_type capacity() const noexcept {
+    return m_values.capacity();
+  }
+
+  void reserve(size_type count) { m_values.reserve(count); }
+  void shrink_to_fit() { m_values.shrink_to_fit(); }
+
+  [[nodiscard]] key_compare key_comp() const { return m_comp; }
+  [[nodiscard]] allocator_type get_allocator() const {
+    return m_values.get_allocator();
+  }
+
+  [[nodiscard]] const container_type& values() const noexcept {
+    return m_values;
+  }
+
+  // Moves the sorted values out leaving the container empty
+  [[nodiscard]] container_type extract() && {
+    container_type values{move(m_values)};
+    m_values.clear();
+    return values;
+  }
+
+  void clear() noexcept { m_values.clear(); }
+
+  insert_return_type insert(const value_type& value) { return emplace(value); }
+  insert_return_type insert(value_type&& value) { return emplace(move(value)); }
+
+  iterator insert(const_iterator hint, const value_type& value) {
+    return emplace_hint(hint, value);
+  }
+
+  iterator insert(const_iterator hint, value_type&& value) {
+    return emplace_hint(hint, move(value));
+  }
+
+  // Appends the range, sorts it and merges with the present values, so
+  // the cost is O(N + M log M) instead of O(N * M) for one by one insertion.
+  // Present values win over equivalent ones from the range
+  template <class InputIt>
+  void insert(InputIt first, InputIt last) {
+    const size_t old_size{m_values.size()};
+    try {
+      for (; first != last; ++first) {
+        m_values.emplace_back(*first);
+      }
+      sort_and_remove_duplicates(old_size);
+    } catch (...) {
+      m_values.erase(begin() + static_cast<ptrdiff_t>(old_size), end());
+      throw;
+    }
+  }
+
+  void insert(initializer_list<value_type> init) {
+    insert(init.begin(), init.end());
+  }
+
+  template <class... Types>
+  insert_return_type emplace(Types&&... args) {
+    if constexpr (is_value_type_v<Types...>) {
+      return insert_value(forward<Types>(args)...);
+    } else {
+      return insert_value(value_type(forward<Types>(args)...));
+    }
+  }
+
+  // Skips the search if the value belongs right before hint
+  template <class... Types>
+  iterator emplace_hint(const_iterator hint, Types&&... args) {
+    if constexpr (is_value_type_v<Types...>) {
+      return insert_value_hint(hint, forward<Types>(args)...);
+    } else {
+      return insert_value_hint(hint, value_type(forward<Types>(args)...));
+    }
+  }
+
+  template <class... Types, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>> try_emplace(
+      const key_type& key,
+      Types&&... args) {
+    return try_emplace_impl(key, forward<Types>(args)...);
+  }
+
+  template <class... Types, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>> try_emplace(
+      key_type&& key,
+      Types&&... args) {
+    return try_emplace_impl(move(key), forward<Types>(args)...);
+  }
+
+  template <class Mapped, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>>
+  insert_or_assign(const key_type& key, Mapped&& obj) {
+    auto result{try_emplace_impl(key, forward<Mapped>(obj))};
+    if (!result.second) {
+      result.first->second = forward<Mapped>(obj);
+    }
+    return result;
+  }
+
+  template <class Mapped, class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, pair<iterator, bool>>
+  insert_or_assign(key_type&& key, Mapped&& obj) {
+    auto result{try_emplace_impl(move(key), forward<Mapped>(obj))};
+    if (!result.second) {
+      result.first->second = forward<Mapped>(obj);
+    }
+    return result;
+  }
+
+  template <class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, Q&> operator[](const key_type& key) {
+    return try_emplace_impl(key).first->second;
+  }
+
+  template <class Q = mapped_type>
+  enable_if_t<!is_void_v<Q> && !IsMulti, Q&> operator[](key_type&& key) {
+    return try_emplace_impl(move(key)).first->second;
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <class Q = mapped_type>
+  [[nodiscard]] enable_if_t<!is_void_v<Q>, Q&> at(const key_type& key) {
+    const auto it{find(key)};
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  template <class Q = mapped_type>
+  [[nodiscard]] enable_if_t<!is_void_v<Q>, const Q&> at(
+      const key_type& key) const {
+    const auto it{find(key)};
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  // Returns iterator to the value following the erased one
+  iterator erase(const_iterator pos) { return m_values.erase(pos); }
+
+  iterator erase(iterator pos) { return erase(const_iterator{pos}); }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    return m_values.erase(first, last);
+  }
+
+  size_type erase(const key_type& key) {
+    if constexpr (IsMulti) {
+      const auto [first, last]{equal_range(key)};
+      const size_t count{static_cast<size_t>(distance(first, last))};
+      erase(first, last);
+      return count;
+    } else {
+      const auto it{find(key)};
+      if (it == end()) {
+        return 0;
+      }
+      erase(it);
+      return 1;
+    }
+  }
+
+  [[nodiscard]] iterator find(const key_type& key) {
+    return make_mutable(find_impl(key));
+  }
+
+  [[nodiscard]] const_iterator find(const key_type& key) const {
+    return find_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] iterator find(const K& key) {
+    return make_mutable(find_impl(key));
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] const_iterator find(const K& key) const {
+    return find_impl(key);
+  }
+
+  [[nodiscard]] bool contains(const key_type& key) const {
+    return find_impl(key) != end();
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] bool contains(const K& key) const {
+    return find_impl(key) != end();
+  }
+
+  [[nodiscard]] size_type count(const key_type& key) const {
+    return count_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] size_type count(const K& key) const {
+    return count_impl(key);
+  }
+
+  [[nodiscard]] iterator lower_bound(const key_type& key) {
+    return make_mutable(lower_bound_impl(key));
+  }
+
+  [[nodiscard]] const_iterator lower_bound(const key_type& key) const {
+    return lower_bound_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] iterator lower_bound(const K& key) {
+    return make_mutable(lower_bound_impl(key));
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] const_iterator lower_bound(const K& key) const {
+    return lower_bound_impl(key);
+  }
+
+  [[nodiscard]] iterator upper_bound(const key_type& key) {
+    return make_mutable(upper_bound_impl(key));
+  }
+
+  [[nodiscard]] const_iterator upper_bound(const key_type& key) const {
+    return upper_bound_impl(key);
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] iterator upper_bound(const K& key) {
+    return make_mutable(upper_bound_impl(key));
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] const_iterator upper_bound(const K& key) const {
+    return upper_bound_impl(key);
+  }
+
+  [[nodiscard]] pair<iterator, iterator> equal_range(const key_type& key) {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  [[nodiscard]] pair<const_iterator, const_iterator> equal_range(
+      const key_type& key) const {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] pair<iterator, iterator> equal_range(const K& key) {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  [[nodiscard]] pair<const_iterator, const_iterator> equal_range(
+      const K& key) const {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  bool operator==(const flat_tree& other) const {
+    return m_values == other.m_values;
+  }
+
+  bool operator!=(const flat_tree& other) const { return !operator==(other); }
+
+ private:
+  template <class... Types>
+  static constexpr bool is_value_type_v =
+      sizeof...(Types) == 1 &&
+      (is_same_v<remove_cv_t<remove_reference_t<Types>>, value_type> && ...);
+
+  [[nodiscard]] iterator make_mutable(const_iterator it) noexcept {
+    return begin() + (it - cbegin());
+  }
+
+  // Search is branchless over the contiguous storage
+  template <class K>
+  [[nodiscard]] const_iterator lower_bound_impl(const K& key) const {
+    return ktl::lower_bound(
+        begin(), end(), key, [this](const value_type& value, const K& key) {
+          return m_comp(traits_type::get_key(value), key);
+        });
+  }
+
+  template <class K>
+  [[nodiscard]] const_iterator upper_bound_impl(const K& key) const {
+    return ktl::upper_bound(
+        begin(), end(), key, [this](const K& key, const value_type& value) {
+          return m_comp(key, traits_type::get_key(value));
+        });
+  }
+
+  template <class K>
+  [[nodiscard]] const_iterator find_impl(const K& key) const {
+    const const_iterator it{lower_bound_impl(key)};
+    return it == end() || m_comp(key, traits_type::get_key(*it)) ? end() : it;
+  }
+
+  template <class K>
+  [[nodiscard]] size_t count_impl(const K& key) const {
+    if constexpr (IsMulti) {
+      return static_cast<size_t>(
+          distance(lower_bound_impl(key), upper_bound_impl(key)));
+    } else {
+      return find_impl(key) != end() ? 1 : 0;
+    }
+  }
+
+  template <class OtherKey, class... Types>
+  pair<iterator, bool> try_emplace_impl(OtherKey&& key, Types&&... args) {
+    return insert_unique(key, piecewise_construct,
+                         forward_as_tuple(forward<OtherKey>(key)),
+                         forward_as_tuple(forward<Types>(args)...));
+  }
+
+  template <class Value>
+  insert_return_type insert_value(Value&& value) {
+    if constexpr (IsMulti) {
+      return insert_multi(forward<Value>(value));
+    } else {
+      return insert_unique(traits_type::get_key(value), forward<Value>(value));
+    }
+  }
+
+  // Constructs the value only if the key is absent. Key may refer to args
+  template <class K, class... Types>
+  pair<iterator, bool> insert_unique(const K& key, Types&&... args) {
+    const const_iterator pos{lower_bound_impl(key)};
+    if (pos != end() && !m_comp(key, traits_type::get_key(*pos))) {
+      return {make_mutable(pos), false};
+    }
+    return {m_values.emplace(pos, forward<Types>(args)...), true};
+  }
+
+  // Equal keys keep the order of insertion
+  template <class Value>
+  iterator insert_multi(Value&& value) {
+    const const_iterator pos{upper_bound_impl(traits_type::get_key(value))};
+    return m_values.emplace(pos, forward<Value>(value));
+  }
+
+  template <class Value>
+  iterator insert_value_hint(const_iterator hint, Value&& value) {
+    const key_type& key{traits_type::get_key(value)};
+    bool fits{true};
+    if constexpr (IsMulti) {
+      fits = (hint == begin() ||
+              !m_comp(key, traits_type::get_key(*prev(hint)))) &&
+             (hint == end() || !m_comp(traits_type::get_key(*hint), key));
+    } else {
+      fits = (hint == begin() ||
+              m_comp(traits_type::get_key(*prev(hint)), key)) &&
+             (hint == end() || m_comp(key, traits_type::get_key(*hint)));
+    }
+    if (fits) {
+      return m_values.emplace(hint, forward<Value>(value));
+    }
+    if constexpr (IsMulti) {
+      return insert_multi(forward<Value>(value));
+    } else {
+      return insert_unique(key, forward<Value>(value)).first;
+    }
+  }
+
+  [[nodiscard]] bool less_by_key(const value_type& lhs,
+                                 const value_type& rhs) const {
+    return m_comp(traits_type::get_key(lhs), traits_type::get_key(rhs));
+  }
+
+  // Values past sorted_count are sorted, stripped of the keys which are
+  // already present (unless IsMulti) and merged with the sorted prefix
+  void sort_and_remove_duplicates(size_t sorted_count) {
+    const iterator middle{begin() + static_cast<ptrdiff_t>(sorted_count)};
+    ktl::sort(middle, end(),
+              [this](const value_type& lhs, const value_type& rhs) {
+                return less_by_key(lhs, rhs);
+              });
+
+    iterator last{end()};
+    if constexpr (!IsMulti) {
+      // Sorted values are equivalent unless the former is less
+      last = ktl::unique(middle, last,
+                         [this](const value_type& lhs, const value_type& rhs) {
+                           return !less_by_key(lhs, rhs);
+                         });
+      if (sorted_count != 0) {
+        last = remove_present(middle, last);
+      }
+    }
+    m_values.erase(last, end());
+    if (sorted_count != 0 && middle != end()) {
+      merge_sorted(sorted_count);
+    }
+  }
+
+  iterator remove_present(iterator first, iterator last) {
+    const const_iterator sorted_last{first};
+    iterator result{first};
+    for (; first != last; ++first) {
+      const key_type& key{traits_type::get_key(*first)};
+      const const_iterator pos{ktl::lower_bound(
+          cbegin(), sorted_last, key,
+          [this](const value_type& value, const key_type& key) {
+            return m_comp(traits_type::get_key(value), key);
+          })};
+      if (pos == sorted_last || m_comp(key, traits_type::get_key(*pos))) {
+        if (result != first) {
+          *result = move(*first);
+        }
+        ++result;
+      }
+    }
+    return result;
+  }
+
+  // Merges [begin, begin + sorted_count) with the sorted tail into a new
+  // buffer; equivalent keys from the prefix go first
+  void merge_sorted(size_t sorted_count) {
+    container_type merged(m_values.get_allocator());
+    merged.reserve(m_values.size());
+    iterator lhs{begin()}, rhs{begin() + static_cast<ptrdiff_t>(sorted_count)};
+    const iterator lhs_last{rhs}, rhs_last{end()};
+    while (lhs != lhs_last && rhs != rhs_last) {
+      if (less_by_key(*rhs, *lhs)) {
+        merged.push_back(move(*rhs++));
+      } else {
+        merged.push_back(move(*lhs++));
+      }
+    }
+    for (; lhs != lhs_last; ++lhs) {
+      merged.push_back(move(*lhs));
+    }
+    for (; rhs != rhs_last; ++rhs) {
+      merged.push_back(move(*rhs));
+    }
+    m_values.swap(merged);
+  }
+
+ private:
+  Compare m_comp{};
+  container_type m_values;
+};
+
+template <class Key, class Ty, class Compare, class Allocator, bool IsMulti>
+void swap(flat_tree<Key, Ty, Compare, Allocator, IsMulti>& lhs,
+          flat_tree<Key, Ty, Compare, Allocator, IsMulti>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace ft::details
+}  // namespace ktl
@@ -0,0 +1,662 @@
+#pragma once
+#include <basic_types.hpp>
+#include <algorithm.hpp>
+#include <allocator.hpp>
+#include <functional.hpp>
+#include <hash.hpp>
+#include <hash_table_impl.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <memory.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+namespace ktl {
+namespace un::details {
+/*
+ * Minimal perfect hashing by the "hash, displace and compress" scheme
+ * (D. Belazzougui, F. C. Botelho, M. Dietzfelbinger, "Hash, displace, and
+ * compress", 2009) without compression of the displacements.
+ *
+ * Keys are distributed into buckets of up to CHD_BUCKET_LOAD keys on average
+ * by the first mixing of their hashes: heavier buckets make the displacements
+ * smaller, but the search for them gets much longer. Buckets are placed
+ * from the largest to the smallest: for each bucket with several keys the
+ * smallest displacement which sends all its keys into free slots is searched
+ * for; keys of single-key buckets are just put into the remaining free slots,
+ * and their displacements store the slot itself. A lookup is therefore one
+ * access to the displacements and one key comparison.
+ */
+inline constexpr size_t CHD_BUCKET_LOAD{2};
+inline constexpr uint32_t CHD_DIRECT_SLOT{0x80000000u};
+inline constexpr uint32_t CHD_MAX_DISPLACEMENT{1u << 20};
+inline constexpr uint64_t CHD_MAX_SEED{64};
+
+// fmix64 from MurmurHash3
+[[nodiscard]] constexpr uint64_t chd_mix(uint64_t hash,
+                                         uint64_t seed) noexcept {
+  uint64_t value{hash ^ (seed * UINT64_C(0x9E3779B97F4A7C15))};
+  value ^= value >> 33;
+  value *= UINT64_C(0xff51afd7ed558ccd);
+  value ^= value >> 33;
+  value *= UINT64_C(0xc4ceb9fe1a85ec53);
+  value ^= value >> 33;
+  return value;
+}
+
+// Power of 2, so that the bucket is selected by a mask
+[[nodiscard]] constexpr size_t chd_bucket_count(size_t key_count) noexcept {
+  size_t bucket_count{1};
+  while (bucket_count * CHD_BUCKET_LOAD < key_count) {
+    bucket_count <<= 1;
+  }
+  return bucket_count;
+}
+
+// Size of the scratch buffer (in size_t) needed by chd_build()
+[[nodiscard]] constexpr size_t chd_scratch_size(size_t key_count) noexcept {
+  const size_t bucket_count{chd_bucket_count(key_count)};
+  return 4 * key_count + 2 * bucket_count + 3;
+}
+
+struct chd_params {
+  uint64_t seed;
+  size_t bucket_mask;
+};
+
+[[nodiscard]] constexpr size_t chd_bucket(const chd_params& params,
+                                          size_t hash) noexcept {
+  return static_cast<size_t>(chd_mix(hash, params.seed)) & params.bucket_mask;
+}
+
+[[nodiscard]] constexpr size_t chd_slot(uint32_t displacement,
+                                        size_t hash,
+                                        size_t key_count) noexcept {
+  if (displacement & CHD_DIRECT_SLOT) {
+    return displacement & ~CHD_DIRECT_SLOT;
+  }
+  // Multiply-shift range reduction instead of the division
+  const uint64_t mixed{chd_mix(hash, displacement) >> 32};
+  return static_cast<size_t>((mixed * key_count) >> 32);
+}
+
+/*
+ * Groups keys by buckets with a counting sort: keys of the i-th bucket are
+ * keys_by_bucket[bucket_first[i], bucket_first[i + 1])
+ */
+constexpr void chd_group_by_buckets(const size_t* hashes,
+                                    size_t key_count,
+                                    const chd_params& params,
+                                    size_t* bucket_of,
+                                    size_t* keys_by_bucket,
+                                    size_t* bucket_first) noexcept {
+  const size_t bucket_count{params.bucket_mask + 1};
+  for (size_t idx = 0; idx <= bucket_count; ++idx) {
+    bucket_first[idx] = 0;
+  }
+  for (size_t idx = 0; idx < key_count; ++idx) {
+    bucket_of[idx] = chd_bucket(params, hashes[idx]);
+    ++bucket_first[bucket_of[idx] + 1];
+  }
+  for (size_t idx = 0; idx < bucket_count; ++idx) {
+    bucket_first[idx + 1] += bucket_first[idx];
+  }
+  for (size_t idx = 0; idx < key_count; ++idx) {
+    const size_t pos{bucket_first[bucket_of[idx]]++};
+    keys_by_bucket[pos] = idx;
+  }
+  for (size_t idx = bucket_count; idx > 0; --idx) {
+    bucket_first[idx] = bucket_first[idx - 1];
+  }
+  bucket_first[0] = 0;
+}
+
+/*
+ * Keys with equal hashes share a slot with any seed, so they are looked for
+ * before the search. Equal hashes fall into the same bucket, and buckets are
+ * small, so only keys of the same bucket are compared. Throws
+ * invalid_argument if keys repeat and runtime_error if hashes of different
+ * keys are equal. keys_equal(i, j) compares the i-th and the j-th keys
+ */
+template <class KeysEqual>
+constexpr void chd_check_hashes(const size_t* hashes,
+                                size_t key_count,
+                                size_t bucket_mask,
+                                size_t* scratch,
+                                KeysEqual keys_equal) {
+  const size_t bucket_count{bucket_mask + 1};
+  size_t* const bucket_of{scratch};
+  size_t* const keys_by_bucket{bucket_of + key_count};
+  size_t* const bucket_first{keys_by_bucket + key_count};
+  chd_group_by_buckets(hashes, key_count, {0, bucket_mask}, bucket_of,
+                       keys_by_bucket, bucket_first);
+
+  // Duplicates are reported even if a collision is met before them
+  bool collision_found{false};
+  for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+    const size_t last{bucket_first[bucket + 1]};
+    for (size_t lhs = bucket_first[bucket]; lhs < last; ++lhs) {
+      for (size_t rhs = lhs + 1; rhs < last; ++rhs) {
+        const size_t lhs_key{keys_by_bucket[lhs]};
+        const size_t rhs_key{keys_by_bucket[rhs]};
+        if (hashes[lhs_key] != hashes[rhs_key]) {
+          continue;
+        }
+        if (keys_equal(lhs_key, rhs_key)) {
+          throw_exception<invalid_argument>(
+              "keys of a frozen table must be unique");
+        }
+        collision_found = true;
+      }
+    }
+  }
+  if (collision_found) {
+    throw_exception<runtime_error>(
+        "hashes of different keys of a frozen table are equal");
+  }
+}
+
+/*
+ * Fills displacements[chd_bucket_count(key_count)] and slots[key_count] (the
+ * slot of the i-th key). Returns false if keys can't be placed with this seed
+ */
+constexpr bool chd_try_build(const size_t* hashes,
+                             size_t key_count,
+                             const chd_params& params,
+                             uint32_t* displacements,
+                             size_t* slots,
+                             size_t* scratch) noexcept {
+  const size_t bucket_count{params.bucket_mask + 1};
+  size_t* const bucket_of{scratch};
+  size_t* const keys_by_bucket{bucket_of + key_count};
+  size_t* const taken{keys_by_bucket + key_count};
+  size_t* const bucket_first{taken + key_count};
+  size_t* const bucket_order{bucket_first + bucket_count + 1};
+  size_t* const size_first{bucket_order + bucket_count};
+
+  chd_group_by_buckets(hashes, key_count, params, bucket_of, keys_by_bucket,
+                       bucket_first);
+  for (size_t idx = 0; idx < key_count; ++idx) {
+    taken[idx] = false;
+  }
+
+  // Order buckets by decreasing size with another one
+  size_t max_size{0};
+  for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+    max_size = (max)(max_size, bucket_first[bucket + 1] - bucket_first[bucket]);
+  }
+  for (size_t size = 0; size <= max_size + 1; ++size) {
+    size_first[size] = 0;
+  }
+  for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+    const size_t size{bucket_first[bucket + 1] - bucket_first[bucket]};
+    ++size_first[max_size - size + 1];
+  }
+  for (size_t size = 0; size <= max_size; ++size) {
+    size_first[size + 1] += size_first[size];
+  }
+  for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+    const size_t size{bucket_first[bucket + 1] - bucket_first[bucket]};
+    bucket_order[size_first[max_size - size]++] = bucket;
+  }
+
+  size_t free_slot{0};
+  for (size_t pos = 0; pos < bucket_count; ++pos) {
+    const size_t bucket{bucket_order[pos]};
+    const size_t* const first{keys_by_bucket + bucket_first[bucket]};
+    const size_t size{bucket_first[bucket + 1] - bucket_first[bucket]};
+
+    if (size == 0) {
+      displacements[bucket] = 0;
+    } else if (size == 1) {
+      while (taken[free_slot]) {
+        ++free_slot;
+      }
+      taken[free_slot] = true;
+      slots[*first] = free_slot;
+      displacements[bucket] =
+          static_cast<uint32_t>(free_slot) | CHD_DIRECT_SLOT;
+    } else {
+      uint32_t displacement{1};
+      for (; displacement < CHD_MAX_DISPLACEMENT; ++displacement) {
+        size_t placed{0};
+        for (; placed < size; ++placed) {
+          const size_t slot{
+              chd_slot(displacement, hashes[first[placed]], key_count)};
+          if (taken[slot]) {
+            break;
+          }
+          taken[slot] = true;
+          slots[first[placed]] = slot;
+        }
+        if (placed == size) {
+          break;
+        }
+        for (size_t idx = 0; idx < placed; ++idx) {
+          taken[slots[first[idx]]] = false;
+        }
+      }
+      if (displacement == CHD_MAX_DISPLACEMENT) {
+        return false;
+      }
+      displacements[bucket] = displacement;
+    }
+  }
+  return true;
+}
+
+/*
+ * Builds the perfect hash. Throws length_error if the number of keys doesn't
+ * fit into displacements, invalid_argument if keys repeat and runtime_error
+ * if hashes of different keys are equal or no seed fits
+ */
+template <class KeysEqual>
+constexpr chd_params chd_build(const size_t* hashes,
+                               size_t key_count,
+                               uint32_t* displacements,
+                               size_t* slots,
+                               size_t* scratch,
+                               KeysEqual keys_equal) {
+  if (key_count >= CHD_DIRECT_SLOT) {
+    throw_exception<length_error>("too many keys for perfect hashing");
+  }
+  const size_t bucket_mask{chd_bucket_count(key_count) - 1};
+  chd_check_hashes(hashes, key_count, bucket_mask, scratch, keys_equal);
+  for (uint64_t seed = 0; seed < CHD_MAX_SEED; ++seed) {
+    const chd_params params{seed, bucket_mask};
+    if (chd_try_build(hashes, key_count, params, displacements, slots,
+                      scratch)) {
+      return params;
+    }
+  }
+  throw_exception<runtime_error>("perfect hash for frozen table not found");
+}
+
+template <class Key, class Ty>
+struct frozen_traits {
+  static constexpr bool is_map = !is_void_v<Ty>;
+  static constexpr bool is_set = !is_map;
+
+  using value_type = conditional_t<is_set, Key, pair<Key, Ty>>;
+
+  [[nodiscard]] static constexpr const Key& get_key(
+      const value_type& value) noexcept {
+    if constexpr (is_map) {
+      return value.first;
+    } else {
+      return value;
+    }
+  }
+};
+
+/*
+ * Immutable hash table built once from a range. Entries are stored
+ * contiguously in the same allocation as the displacements, and every lookup
+ * touches exactly one entry
+ */
+template <class Key, class Ty, class Hash, class KeyEqual, class BytesAllocator>
+class frozen_table : WrapHash<Hash>, WrapKeyEqual<KeyEqual> {
+ private:
+  using traits_type = frozen_traits<Key, Ty>;
+  using WHash = WrapHash<Hash>;
+  using WKeyEqual = WrapKeyEqual<KeyEqual>;
+  using AlBytesTraits = allocator_traits<BytesAllocator>;
+
+ public:
+  static constexpr bool is_map = traits_type::is_map;
+  static constexpr bool is_set = traits_type::is_set;
+
+  using key_type = Key;
+  using mapped_type = Ty;
+  using value_type = typename traits_type::value_type;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using allocator_type = BytesAllocator;
+  using iterator = const value_type*;
+  using const_iterator = const value_type*;
+
+ public:
+  frozen_table() noexcept(noexcept(Hash()) && noexcept(KeyEqual())) = default;
+
+  template <class ForwardIt>
+  frozen_table(ForwardIt first,
+               ForwardIt last,
+               const Hash& h = Hash{},
+               const KeyEqual& equal = KeyEqual{},
+               const allocator_type& alloc = allocator_type{})
+      : WHash(h), WKeyEqual(equal), m_alc{alloc} {
+    build(first, static_cast<size_t>(distance(first, last)));
+  }
+
+  frozen_table(const frozen_table& other)
+      : WHash(static_cast<const WHash&>(other)),
+        WKeyEqual(static_cast<const WKeyEqual&>(other)),
+        m_alc{AlBytesTraits::select_on_container_copy_construction(
+            other.m_alc)},
+        m_params{other.m_params} {
+    if (other.m_size) {
+      allocate(other.m_size);
+      memcpy(m_displacements, other.m_displacements,
+             calc_displacements_bytes(m_size));
+      uninitialized_copy(other.begin(), other.end(), m_entries);
+    }
+  }
+
+  frozen_table(frozen_table&& other) noexcept
+      : WHash(move(static_cast<WHash&>(other))),
+        WKeyEqual(move(static_cast<WKeyEqual&>(other))),
+        m_alc{move(other.m_alc)},
+        m_entries{exchange(other.m_entries, nullptr)},
+        m_displacements{exchange(other.m_displacements, nullptr)},
+        m_size{exchange(other.m_size, 0)},
+        m_params{other.m_params} {}
+
+  frozen_table& operator=(const frozen_table& other) {
+    if (this != addressof(other)) {
+      frozen_table tmp{other};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  frozen_table& operator=(frozen_table&& other) noexcept {
+    if (this != addressof(other)) {
+      frozen_table tmp{move(other)};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  ~frozen_table() noexcept { destroy(); }
+
+  void swap(frozen_table& other) noexcept {
+    using ktl::swap;
+    swap(static_cast<WHash&>(*this), static_cast<WHash&>(other));
+    swap(static_cast<WKeyEqual&>(*this), static_cast<WKeyEqual&>(other));
+    swap(m_alc, other.m_alc);
+    swap(m_entries, other.m_entries);
+    swap(m_displacements, other.m_displacements);
+    swap(m_size, other.m_size);
+    swap(m_params, other.m_params);
+  }
+
+  [[nodiscard]] const_iterator find(const key_type& key) const {
+    if (!m_size) {
+      return end();
+    }
+    const size_t hash{WHash::operator()(key)};
+    const uint32_t displacement{m_displacements[chd_bucket(m_params, hash)]};
+    const value_type* const entry{m_entries +
+                                  chd_slot(displacement, hash, m_size)};
+    return WKeyEqual::operator()(key, traits_type::get_key(*entry)) ? entry
+                                                                    : end();
+  }
+
+  [[nodiscard]] size_t count(const key_type& key) const {
+    return find(key) != end() ? 1 : 0;
+  }
+
+  [[nodiscard]] bool contains(const key_type& key) const {
+    return find(key) != end();
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <typename Q = mapped_type>
+  [[nodiscard]] enable_if_t<!is_void_v<Q>, const Q&> at(
+      const key_type& key) const {
+    const auto it{find(key)};
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] const_iterator begin() const noexcept { return m_entries; }
+  [[nodiscard]] const_iterator cbegin() const noexcept { return begin(); }
+  [[nodiscard]] const_iterator end() const noexcept {
+    return m_entries + m_size;
+  }
+  [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+  [[nodiscard]] size_type size() const noexcept { return m_size; }
+  [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+
+  // Bytes allocated for entries and displacements
+  [[nodiscard]] size_t memory_usage() const noexcept {
+    return m_size ? calc_bytes_count(m_size) : 0;
+  }
+
+ private:
+  template <class ForwardIt>
+  void build(ForwardIt first, size_t key_count) {
+    if (!key_count) {
+      return;
+    }
+    // Hashes, slots and scratch buffer are released after build
+    const size_t scratch_count{2 * key_count + chd_scratch_size(key_count)};
+    auto* const buffer{reinterpret_cast<size_t*>(AlBytesTraits::allocate_bytes(
+        m_alc, scratch_count * sizeof(size_t)))};
+    size_t* const hashes{buffer};
+    size_t* const slots{hashes + key_count};
+    size_t* const scratch{slots + key_count};
+    try {
+      ForwardIt it{first};
+      for (size_t idx = 0; idx < key_count; ++idx, ++it) {
+        hashes[idx] = WHash::operator()(traits_type::get_key(*it));
+      }
+      allocate(key_count);
+      // Only keys with equal hashes are compared
+      const auto keys_equal{[this, first](size_t lhs, size_t rhs) {
+        return WKeyEqual::operator()(traits_type::get_key(*next(first, lhs)),
+                                     traits_type::get_key(*next(first, rhs)));
+      }};
+      m_params = chd_build(hashes, key_count, m_displacements, slots, scratch,
+                           keys_equal);
+      construct_entries(first, slots);
+    } catch (...) {
+      release();
+      AlBytesTraits::deallocate_bytes(m_alc, reinterpret_cast<byte*>(buffer),
+                                      scratch_count * sizeof(size_t));
+      throw;
+    }
+    AlBytesTraits::deallocate_bytes(m_alc, reinterpret_cast<byte*>(buffer),
+                                    scratch_count * sizeof(size_t));
+  }
+
+  template <class ForwardIt>
+  void construct_entries(ForwardIt first, const size_t* slots) {
+    size_t constructed{0};
+    try {
+      for (; constructed < m_size; ++constructed, ++first) {
+        construct_at(m_entries + slots[constructed], *first);
+      }
+    } catch (...) {
+      for (size_t idx = 0; idx < constructed; ++idx) {
+        destroy_at(m_entries + slots[idx]);
+      }
+      throw;
+    }
+  }
+
+  // Displacements go first: their alignment is weaker than of entries
+  void allocate(size_t key_count) {
+    auto* const buffer{
+        AlBytesTraits::allocate_bytes(m_alc, calc_bytes_count(key_count))};
+    m_displacements = reinterpret_cast<uint32_t*>(buffer);
+    m_entries = reinterpret_cast<value_type*>(
+        buffer + calc_displacements_bytes(key_count));
+    m_size = key_count;
+  }
+
+  // Releases storage without destroying entries
+  void release() noexcept {
+    if (m_size) {
+      AlBytesTraits::deallocate_bytes(
+          m_alc, reinterpret_cast<byte*>(m_displacements),
+          calc_bytes_count(m_size));
+      m_entries = nullptr;
+      m_displacements = nullptr;
+      m_size = 0;
+    }
+  }
+
+  void destroy() noexcept {
+    if constexpr (!is_trivially_destructible_v<value_type>) {
+      for (size_t idx = 0; idx < m_size; ++idx) {
+        destroy_at(m_entries + idx);
+      }
+    }
+    release();
+  }
+
+  [[nodiscard]] static size_t calc_displacements_bytes(
+      size_t key_count) noexcept {
+    constexpr size_t ALIGNMENT{alignof(value_type)};
+    const size_t bytes_count{chd_bucket_count(key_count) * sizeof(uint32_t)};
+    return (bytes_count + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  }
+
+  [[nodiscard]] static size_t calc_bytes_count(size_t key_count) {
+    return calc_displacements_bytes(key_count) +
+           key_count * sizeof(value_type);
+  }
+
+ private:
+  allocator_type m_alc{};
+  value_type* m_entries{nullptr};
+  uint32_t* m_displacements{nullptr};
+  size_t m_size{0};
+  chd_params m_params{0, 0};
+};
+
+/*
+ * Immutable hash table of N entries which may be built at compile time.
+ * Requires a constexpr hasher and default constructible, copy assignable
+ * value_type. The build needs (6 * N + 2 * bucket count + 3) size_t of
+ * scratch: it stays on the stack only during constant evaluation and is
+ * taken from the non-paged pool at runtime, where large tables wouldn't fit
+ * into the kernel stack
+ */
+template <class Key, class Ty, size_t N, class Hash, class KeyEqual>
+class fixed_frozen_table {
+ private:
+  using traits_type = frozen_traits<Key, Ty>;
+
+  static constexpr size_t BUCKET_COUNT{chd_bucket_count(N)};
+  static constexpr size_t SCRATCH_COUNT{2 * N + chd_scratch_size(N)};
+
+  using scratch_allocator = basic_non_paged_allocator<size_t>;
+
+ public:
+  static constexpr bool is_map = traits_type::is_map;
+  static constexpr bool is_set = traits_type::is_set;
+
+  using key_type = Key;
+  using mapped_type = Ty;
+  using value_type = typename traits_type::value_type;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using iterator = const value_type*;
+  using const_iterator = const value_type*;
+
+  static_assert(N > 0, "fixed frozen table can't be empty");
+
+ public:
+  constexpr explicit fixed_frozen_table(const value_type (&values)[N],
+                                        const Hash& h = Hash{},
+                                        const KeyEqual& equal = KeyEqual{})
+      : m_hash{h}, m_equal{equal} {
+    if (is_constant_evaluated()) {
+      build_on_stack(values);
+    } else {
+      build_on_heap(values);
+    }
+  }
+
+  [[nodiscard]] constexpr const_iterator find(const key_type& key) const {
+    const size_t hash{m_hash(key)};
+    const uint32_t displacement{m_displacements[chd_bucket(m_params, hash)]};
+    const value_type* const entry{m_entries + chd_slot(displacement, hash, N)};
+    return m_equal(key, traits_type::get_key(*entry)) ? entry : end();
+  }
+
+  [[nodiscard]] constexpr size_t count(const key_type& key) const {
+    return find(key) != end() ? 1 : 0;
+  }
+
+  [[nodiscard]] constexpr bool contains(const key_type& key) const {
+    return find(key) != end();
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <typename Q = mapped_type>
+  [[nodiscard]] constexpr enable_if_t<!is_void_v<Q>, const Q&> at(
+      const key_type& key) const {
+    const auto it{find(key)};
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] constexpr const_iterator begin() const noexcept {
+    return m_entries;
+  }
+  [[nodiscard]] constexpr const_iterator cbegin() const noexcept {
+    return begin();
+  }
+  [[nodiscard]] constexpr const_iterator end() const noexcept {
+    return m_entries + N;
+  }
+  [[nodiscard]] constexpr const_iterator cend() const noexcept { return end(); }
+
+  [[nodiscard]] constexpr size_type size() const noexcept { return N; }
+  [[nodiscard]] constexpr bool empty() const noexcept { return false; }
+
+ private:
+  constexpr void build_on_stack(const value_type (&values)[N]) {
+    size_t buffer[SCRATCH_COUNT]{};
+    build(values, buffer);
+  }
+
+  void build_on_heap(const value_type (&values)[N]) {
+    scratch_allocator alloc;
+    size_t* const buffer{alloc.allocate(SCRATCH_COUNT)};
+    try {
+      build(values, buffer);
+    } catch (...) {
+      alloc.deallocate(buffer, SCRATCH_COUNT);
+      throw;
+    }
+    alloc.deallocate(buffer, SCRATCH_COUNT);
+  }
+
+  constexpr void build(const value_type (&values)[N], size_t* buffer) {
+    size_t* const hashes{buffer};
+    size_t* const slots{hashes + N};
+    size_t* const scratch{slots + N};
+    for (size_t idx = 0; idx < N; ++idx) {
+      hashes[idx] = m_hash(traits_type::get_key(values[idx]));
+    }
+    // Only keys with equal hashes are compared
+    const auto keys_equal{[this, &values](size_t lhs, size_t rhs) {
+      return m_equal(traits_type::get_key(values[lhs]),
+                     traits_type::get_key(values[rhs]));
+    }};
+    m_params =
+        chd_build(hashes, N, m_displacements, slots, scratch, keys_equal);
+    for (size_t idx = 0; idx < N; ++idx) {
+      m_entries[slots[idx]] = values[idx];
+    }
+  }
+
+  Hash m_hash;
+  KeyEqual m_equal;
+  value_type m_entries[N]{};
+  uint32_t m_displacements[BUCKET_COUNT]{};
+  chd_params m_params{0, 0};
+};
+}  // namespace un::details
+}  // namespace ktl
@@ -1,12 +1,15 @@
 #pragma once
 #include <basic_types.hpp>
+#include <intrinsic.hpp>
 #include <smart_pointer.hpp>
 #include <string.hpp>
 #include <type_traits.hpp>
 #include <utility.hpp>
 
 namespace ktl {
-inline size_t hash_bytes(const void* ptr, size_t len) noexcept {
+namespace hs::details {
+// MurmurHash64A by Austin Appleby
+inline size_t murmur_hash_64a(const void* ptr, size_t len) noexcept {
   static constexpr uint64_t m = UINT64_C(0xc6a4a7935bd1e995);
   static constexpr uint64_t seed = UINT64_C(0xe17a1465);
   static constexpr unsigned int r = 47;
@@ -53,7 +56,109 @@ inline size_t hash_bytes(const void* ptr, size_t len) noexcept {
   return static_cast<size_t>(h);
 }
 
-inline size_t hash_int(uint64_t x) noexcept {
+#if BITNESS == 64
+/*
+ * wyhash (final version 4) by Wang Yi, public domain. Inputs longer than 48
+ * bytes are consumed in three independent 16-byte lanes, so the
+ * multiplications don't wait for each other
+ */
+inline constexpr uint64_t WYHASH_SECRET[]{
+    UINT64_C(0xa0761d6478bd642f), UINT64_C(0xe7037ed1a0b428db),
+    UINT64_C(0x8ebc6af09c88c6e3), UINT64_C(0x589965cc75374cc3)};
+
+inline void wy_multiply(uint64_t& lhs, uint64_t& rhs) noexcept {
+  uint64_t high;
+  lhs = _umul128(lhs, rhs, &high);
+  rhs = high;
+}
+
+inline uint64_t wy_mix(uint64_t lhs, uint64_t rhs) noexcept {
+  wy_multiply(lhs, rhs);
+  return lhs ^ rhs;
+}
+
+inline uint64_t wy_read_8(const uint8_t* ptr) noexcept {
+  return unaligned_load<uint64_t>(ptr);
+}
+
+inline uint64_t wy_read_4(const uint8_t* ptr) noexcept {
+  return unaligned_load<uint32_t>(ptr);
+}
+
+// 1 to 3 bytes
+inline uint64_t wy_read_3(const uint8_t* ptr, size_t len) noexcept {
+  return (static_cast<uint64_t>(ptr[0]) << 16U) |
+         (static_cast<uint64_t>(ptr[len >> 1U]) << 8U) | ptr[len - 1];
+}
+
+inline size_t wyhash(const void* ptr, size_t len, uint64_t seed) noexcept {
+  const auto* data = static_cast<const uint8_t*>(ptr);
+  seed ^= wy_mix(seed ^ WYHASH_SECRET[0], WYHASH_SECRET[1]);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      const size_t shift = (len >> 3U) << 2U;
+      a = (wy_read_4(data) << 32U) | wy_read_4(data + shift);
+      b = (wy_read_4(data + len - 4) << 32U) |
+          wy_read_4(data + len - 4 - shift);
+    } else if (len > 0) {
+      a = wy_read_3(data, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t left = len;
+    if (left > 48) {
+      uint64_t lane1 = seed, lane2 = seed;
+      do {
+        seed = wy_mix(wy_read_8(data) ^ WYHASH_SECRET[1],
+                      wy_read_8(data + 8) ^ seed);
+        lane1 = wy_mix(wy_read_8(data + 16) ^ WYHASH_SECRET[2],
+                       wy_read_8(data + 24) ^ lane1);
+        lane2 = wy_mix(wy_read_8(data + 32) ^ WYHASH_SECRET[3],
+                       wy_read_8(data + 40) ^ lane2);
+        data += 48;
+        left -= 48;
+      } while (left > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (left > 16) {
+      seed = wy_mix(wy_read_8(data) ^ WYHASH_SECRET[1],
+                    wy_read_8(data + 8) ^ seed);
+      data += 16;
+      left -= 16;
+    }
+    a = wy_read_8(data + left - 16);
+    b = wy_read_8(data + left - 8);
+  }
+
+  a ^= WYHASH_SECRET[1];
+  b ^= seed;
+  wy_multiply(a, b);
+  return static_cast<size_t>(
+      wy_mix(a ^ WYHASH_SECRET[0] ^ len, b ^ WYHASH_SECRET[1]));
+}
+
+inline size_t wyhash(const void* ptr, size_t len) noexcept {
+  return wyhash(ptr, len, UINT64_C(0xe17a1465));
+}
+#endif
+}  // namespace hs::details
+
+/*
+ * wyhash is used on x64 where a 64x64->128 bit multiplication is a single
+ * instruction; define KTL_HASH_BYTES_MURMUR to get MurmurHash64A anywhere
+ */
+inline size_t hash_bytes(const void* ptr, size_t len) noexcept {
+#if BITNESS == 64 && !defined(KTL_HASH_BYTES_MURMUR)
+  return hs::details::wyhash(ptr, len);
+#else
+  return hs::details::murmur_hash_64a(ptr, len);
+#endif
+}
+
+constexpr size_t hash_int(uint64_t x) noexcept {
   // inspired by lemire's strongly universal hashing
   // https://lemire.me/blog/2018/08/15/fast-strongly-universal-64-bit-hashing-everywhere/
   //
@@ -120,18 +225,18 @@ struct hash<intrusive_ptr<Ty>> {
 
 template <typename Enum>
 struct hash<Enum, enable_if_t<is_enum_v<Enum>>> {
-  size_t operator()(Enum e) const noexcept {
+  constexpr size_t operator()(Enum e) const noexcept {
     using underlying_t = underlying_type_t<Enum>;
     return hash<underlying_t>{}(static_cast<underlying_t>(e));
   }
 };
 
-#define HASH_INT(Ty)                                  \
-  template <>                                         \
-  struct hash<Ty> {                                   \
-    size_t operator()(const Ty& obj) const noexcept { \
-      return hash_int(static_cast<uint64_t>(obj));    \
-    }                                                 \
+#define HASH_INT(Ty)                                            \
+  template <>                                                   \
+  struct hash<Ty> {                                             \
+    constexpr size_t operator()(const Ty& obj) const noexcept { \
+      return hash_int(static_cast<uint64_t>(obj));              \
+    }                                                           \
   }
 
 // see https://en.cppreference.com/w/cpp/utility/hash
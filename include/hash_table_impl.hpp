@@ -51,6 +51,8 @@
 #include <type_traits.hpp>
 #include <utility.hpp>
 
+#include <xmmintrin.h>
+
 #define COUNT_TRAILING_ZEROES(x)                                  \
   [](size_t mask) noexcept -> int {                               \
     unsigned long index;                                          \
@@ -60,10 +62,33 @@
   }(x)
 
 namespace ktl {
+#ifdef KTL_HASH_TABLE_STATS
+// Snapshot of the hash table state for diagnostics; see Table::stats()
+struct hash_table_stats {
+  static constexpr size_t HISTOGRAM_SIZE{16};
+
+  size_t size{0};
+  size_t bucket_count{0};
+  size_t load_factor_percent{0};  // Floating point is unavailable in kernel
+  size_t max_info{0};
+  size_t max_probe_distance{0};
+  // The last entry also counts all longer distances
+  size_t probe_histogram[HISTOGRAM_SIZE]{};
+  size_t rehash_count{0};
+  size_t info_overflow_count{0};
+  size_t table_bytes{0};
+  size_t pool_bytes{0};
+  size_t pool_blocks{0};
+};
+#endif
+
 namespace un::details {
 // Allocates bulks of memory for objects of type Ty. This deallocates the memory
 // in the destructor, and keeps a linked list of the allocated memory around.
-// Overhead per allocation is the size of a pointer.
+// Overhead per allocation is a small header (next block pointer and size), so
+// blocks whose nodes are all free can be given back with compact().
+// Unlike slab_allocator, the memory comes from the table's own BytesAllocator
+// and is owned by a single table, so it is released at once in reset().
 template <class Ty,
           class BytesAllocator,
           size_t MinNumAllocs = 4,
@@ -95,7 +120,12 @@ class BulkPoolAllocator {
       is_nothrow_move_constructible_v<allocator_type>)
       : m_bytes_alc{move(other.m_bytes_alc)},
         mHead{exchange(other.mHead, nullptr)},
-        mListForFree{exchange(other.mListForFree, nullptr)} {}
+        mListForFree{exchange(other.mListForFree, nullptr)} {
+#ifdef KTL_HASH_TABLE_STATS
+    m_bytes_count = exchange(other.m_bytes_count, 0);
+    m_blocks_count = exchange(other.m_blocks_count, 0);
+#endif
+  }
 
   BulkPoolAllocator& operator=(BulkPoolAllocator&& other) noexcept(
       is_nothrow_move_assignable_v<allocator_type>) {
@@ -103,6 +133,10 @@ class BulkPoolAllocator {
     m_bytes_alc = move(other.m_bytes_alc);
     mHead = exchange(other.mHead, nullptr);
     mListForFree = exchange(other.mListForFree, nullptr);
+#ifdef KTL_HASH_TABLE_STATS
+    m_bytes_count = exchange(other.m_bytes_count, 0);
+    m_blocks_count = exchange(other.m_blocks_count, 0);
+#endif
     return *this;
   }
 
@@ -118,11 +152,16 @@ class BulkPoolAllocator {
   // Deallocates all allocated memory.
   void reset() noexcept {
     while (mListForFree) {
-      Ty* tmp = *mListForFree;
-      AlBytesTraits::deallocate_bytes(m_bytes_alc, mListForFree, ALIGNED_SIZE);
-      mListForFree = reinterpret_cast_no_cast_align_warning<Ty**>(tmp);
+      BlockHeader* const next = mListForFree->next;
+      AlBytesTraits::deallocate_bytes(m_bytes_alc, mListForFree,
+                                      mListForFree->bytes);
+      mListForFree = next;
     }
     mHead = nullptr;
+#ifdef KTL_HASH_TABLE_STATS
+    m_bytes_count = 0;
+    m_blocks_count = 0;
+#endif
   }
 
   // allocates, but does NOT initialize. Use in-place new constructor, e.g.
@@ -165,7 +204,7 @@ class BulkPoolAllocator {
   // Otherwise it is reused and freed in the destructor.
   void addOrFree(void* ptr, size_t numBytes) noexcept {
     // calculate number of available elements in ptr
-    if (numBytes < ALIGNMENT + ALIGNED_SIZE) {
+    if (numBytes < HEADER_SIZE + ALIGNED_SIZE) {
       // not enough data for at least one element. Free and return.
       deallocate_bytes(ptr, numBytes);
     } else {
@@ -179,9 +218,143 @@ class BulkPoolAllocator {
     swap(m_bytes_alc, other.m_bytes_alc);
     swap(mHead, other.mHead);
     swap(mListForFree, other.mListForFree);
+#ifdef KTL_HASH_TABLE_STATS
+    swap(m_bytes_count, other.m_bytes_count);
+    swap(m_blocks_count, other.m_blocks_count);
+#endif
+  }
+
+  // Returns blocks whose nodes are all in the free list to the bytes
+  // allocator. Live nodes are never moved, so pointers and references to the
+  // elements stay valid. Costs O(B log B + F) for B blocks and F free nodes and
+  // needs a temporary array of B entries; if that can't be allocated, nothing
+  // is released.
+  void compact() noexcept {
+    size_t block_count{0};
+    for (auto* block = mListForFree; block; block = block->next) {
+      ++block_count;
+    }
+    if (!block_count || !mHead) {
+      return;
+    }
+
+    auto* const usage = static_cast<BlockUsage*>(
+        allocate_scratch(block_count * sizeof(BlockUsage)));
+    if (!usage) {
+      return;
+    }
+
+    size_t idx{0};
+    for (auto* block = mListForFree; block; block = block->next, ++idx) {
+      usage[idx] = {block, 0};
+    }
+    sort_by_address(usage, block_count);
+
+    for (Ty* node = mHead; node; node = next_free(node)) {
+      ++find_owner(usage, block_count, node)->free_count;
+    }
+
+    bool released{false};
+    for (idx = 0; idx < block_count; ++idx) {
+      BlockUsage& entry = usage[idx];
+      entry.released = entry.free_count == capacity_of(entry.block);
+      released |= entry.released;
+    }
+
+    if (released) {
+      Ty** link = &mHead;  // keep the order of the surviving free nodes
+      for (Ty* node = mHead; node; node = next_free(node)) {
+        if (!find_owner(usage, block_count, node)->released) {
+          *link = node;
+          link = reinterpret_cast_no_cast_align_warning<Ty**>(node);
+        }
+      }
+      *link = nullptr;
+
+      BlockHeader** block_link = &mListForFree;
+      while (BlockHeader* const block = *block_link) {
+        const BlockUsage* const entry = find_owner(
+            usage, block_count, reinterpret_cast<char*>(block) + HEADER_SIZE);
+        if (entry->released) {
+          *block_link = block->next;
+#ifdef KTL_HASH_TABLE_STATS
+          m_bytes_count -= block->bytes;
+          --m_blocks_count;
+#endif
+          AlBytesTraits::deallocate_bytes(m_bytes_alc, block, block->bytes);
+        } else {
+          block_link = &block->next;
+        }
+      }
+    }
+
+    deallocate_bytes(usage, block_count * sizeof(BlockUsage));
   }
 
+#ifdef KTL_HASH_TABLE_STATS
+  void collect_stats(hash_table_stats& stats) const noexcept {
+    stats.pool_bytes = m_bytes_count;
+    stats.pool_blocks = m_blocks_count;
+  }
+#endif
+
  private:
+  struct BlockHeader {
+    BlockHeader* next;
+    size_t bytes;
+  };
+
+  struct BlockUsage {
+    BlockHeader* block;
+    size_t free_count;
+    bool released;
+  };
+
+  static Ty* next_free(Ty* node) noexcept {
+    return *reinterpret_cast_no_cast_align_warning<Ty**>(node);
+  }
+
+  [[nodiscard]] static size_t capacity_of(const BlockHeader* block) noexcept {
+    return (block->bytes - HEADER_SIZE) / ALIGNED_SIZE;
+  }
+
+  // blocks are few, so insertion sort is fine here
+  static void sort_by_address(BlockUsage* usage, size_t count) noexcept {
+    for (size_t idx = 1; idx < count; ++idx) {
+      const BlockUsage entry = usage[idx];
+      size_t pos = idx;
+      for (; pos > 0 && less<>{}(entry.block, usage[pos - 1].block); --pos) {
+        usage[pos] = usage[pos - 1];
+      }
+      usage[pos] = entry;
+    }
+  }
+
+  // returns the last block starting at or before ptr; ptr is always inside it
+  static BlockUsage* find_owner(BlockUsage* usage,
+                                size_t count,
+                                const void* ptr) noexcept {
+    size_t first{0};
+    while (count > 1) {
+      const size_t half = count / 2;
+      if (!less<>{}(ptr, usage[first + half].block)) {
+        first += half;
+        count -= half;
+      } else {
+        count = half;
+      }
+    }
+    return usage + first;
+  }
+
+  void* allocate_scratch(size_t bytes_count) noexcept {
+    try {
+      return allocate_bytes(bytes_count);
+    } catch (...) {
+      return nullptr;
+    }
+  }
+
   // iterates the list of allocated memory to calculate how many to alloc next.
   // Recalculating this each time saves us a size_t member.
   // This ignores the fact that memory blocks might have been added manually
@@ -191,28 +364,29 @@ class BulkPoolAllocator {
     size_t numAllocs = MinNumAllocs;
 
     while (numAllocs * 2 <= MaxNumAllocs && tmp) {
-      auto x = reinterpret_cast<Ty***>(tmp);
-      tmp = *x;
+      tmp = tmp->next;
       numAllocs *= 2;
     }
 
     return numAllocs;
   }
 
-  // WARNING: Underflow if numBytes < ALIGNMENT! This is guarded in addOrFree().
+  // WARNING: Underflow if numBytes < HEADER_SIZE! This is guarded in
+  // addOrFree().
   void add(void* ptr, const size_t numBytes) noexcept {
-    const size_t numElements = (numBytes - ALIGNMENT) / ALIGNED_SIZE;
-
-    auto data = reinterpret_cast<Ty**>(ptr);
+    const size_t numElements = (numBytes - HEADER_SIZE) / ALIGNED_SIZE;
 
     // link free list
-    auto x = reinterpret_cast<Ty***>(data);
-    *x = mListForFree;
-    mListForFree = data;
+    auto* const block = ::new (ptr) BlockHeader{mListForFree, numBytes};
+    mListForFree = block;
+#ifdef KTL_HASH_TABLE_STATS
+    m_bytes_count += numBytes;
+    ++m_blocks_count;
+#endif
 
     // create linked list for newly allocated data
     auto* const headT = reinterpret_cast_no_cast_align_warning<Ty*>(
-        reinterpret_cast<char*>(ptr) + ALIGNMENT);
+        reinterpret_cast<char*>(ptr) + HEADER_SIZE);
 
     auto* const head = reinterpret_cast<char*>(headT);
 
@@ -234,8 +408,8 @@ class BulkPoolAllocator {
   NOINLINE Ty* performAllocation() {
     size_t const numElementsToAlloc = calcNumElementsToAlloc();
 
-    // alloc new memory: [prev |Ty, Ty, ... Ty]
-    size_t const bytes = ALIGNMENT + ALIGNED_SIZE * numElementsToAlloc;
+    // alloc new memory: [prev, size |Ty, Ty, ... Ty]
+    size_t const bytes = HEADER_SIZE + ALIGNED_SIZE * numElementsToAlloc;
     add(allocate_bytes(bytes), bytes);
     return mHead;
   }
@@ -246,6 +420,9 @@ class BulkPoolAllocator {
   static constexpr size_t ALIGNED_SIZE =
       ((sizeof(Ty) - 1) / ALIGNMENT + 1) * ALIGNMENT;
 
+  static constexpr size_t HEADER_SIZE =
+      ((sizeof(BlockHeader) - 1) / ALIGNMENT + 1) * ALIGNMENT;
+
   static_assert(MinNumAllocs >= 1, "MinNumAllocs");
   static_assert(MaxNumAllocs >= MinNumAllocs, "MaxNumAllocs");
   static_assert(ALIGNED_SIZE >= sizeof(Ty*), "ALIGNED_SIZE");
@@ -255,7 +432,11 @@ class BulkPoolAllocator {
  private:
   allocator_type m_bytes_alc;
   Ty* mHead{nullptr};
-  Ty** mListForFree{nullptr};
+  BlockHeader* mListForFree{nullptr};
+#ifdef KTL_HASH_TABLE_STATS
+  size_t m_bytes_count{0};
+  size_t m_blocks_count{0};
+#endif
 };
 
 template <class Ty,
@@ -298,6 +479,14 @@ class NodeAllocator<Ty, BytesAllocator, MinSize, MaxSize, true> {
     deallocate_bytes(ptr, bytes_count);
   }
 
+  // nothing is pooled
+  void compact() noexcept {}
+
+#ifdef KTL_HASH_TABLE_STATS
+  // nodes are stored in the table itself
+  void collect_stats([[maybe_unused]] hash_table_stats& stats) const noexcept {}
+#endif
+
  private:
   allocator_type m_bytes_alc;
 };
@@ -313,6 +502,11 @@ struct identity_hash {
     return static_cast<size_t>(obj);
   }
 };
+
+// hints the processor to bring the cache line into all cache levels
+inline void prefetch(const void* ptr) noexcept {
+  _mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+}
 }  // namespace un::details
 
 struct is_transparent_tag {};
@@ -376,6 +570,30 @@ struct WrapKeyEqual : public Ty {
 // end() without the
 //   need for a idx variable.
 //
+// Image written by Table::write_image(): the header is followed by the nodes
+// and the info bytes exactly as they are placed in memory. Sizes are 64-bit
+// to keep the header layout the same for all platforms
+struct table_image_header {
+  static constexpr uint32_t MAGIC{0x484C544B};  // "KTLH"
+  static constexpr uint32_t VERSION{1};
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t node_size;
+  uint32_t node_alignment;
+  uint32_t max_load_factor;
+  uint32_t info_inc;
+  uint32_t info_hash_shift;
+  uint32_t data_offset;
+  uint64_t num_elements;
+  uint64_t mask;
+  uint64_t max_num_elements_allowed;
+  uint64_t data_size;
+};
+
+template <class Table>
+class table_image_view;
+
 // According to STL, order of templates has effect on throughput. That's why
 // I've moved the boolean to the front.
 // https://www.reddit.com/r/cpp/comments/ahp6iu/compile_time_binary_size_reductions_and_cs_future/eeguck4/
@@ -414,6 +632,7 @@ class Table
   using size_type = size_t;
   using hasher = Hash;
   using key_equal = KeyEqual;
+  using hash_type = size_t;
   using Self = Table<IsFlat,
                      key_type,
                      mapped_type,
@@ -442,6 +661,8 @@ class Table
   // type needs to be wider than uint8_t.
   using InfoType = uint32_t;
 
+  friend class table_image_view<Self>;
+
   // DataNode ////////////////////////////////////////////////////////
 
   // Primary template for the data node. We have special implementations for
@@ -798,19 +1019,26 @@ class Table
   // Lower bits are used for indexing into the array (2^n size)
   // The upper 1-5 bits need to be a reasonable good hash, to save comparisons.
   template <typename HashKey>
-  void keyToIdx(HashKey&& key, size_t* idx, InfoType* info) const {
+  [[nodiscard]] size_t hashKey(HashKey const& key) const {
     // for a user-specified hash that is *not* robin_hood::hash, apply
     // robin_hood::hash as an additional mixing step. This serves as a bad hash
     // prevention, if the given data is badly mixed.
     using Mix = typename conditional<is_same_v<hash<key_type>, hasher>,
                                      identity_hash<size_t>, hash<size_t>>::type;
+    return Mix{}(WHash::operator()(key));
+  }
 
+  void hashToIdx(size_t h, size_t* idx, InfoType* info) const noexcept {
     // the lower InitialInfoNumBits are reserved for info.
-    auto h = Mix{}(WHash::operator()(key));
     *info = mInfoInc + static_cast<InfoType>((h & InfoMask) >> mInfoHashShift);
     *idx = (h >> InitialInfoNumBits) & mMask;
   }
 
+  template <typename HashKey>
+  void keyToIdx(HashKey&& key, size_t* idx, InfoType* info) const {
+    hashToIdx(hashKey(key), idx, info);
+  }
+
   // forwards the index by one, wrapping around at the end
   void next(InfoType* info, size_t* idx) const noexcept {
     *idx = *idx + 1;
@@ -865,10 +1093,21 @@ class Table
   // copy of find(), except that it returns iterator instead of const_iterator.
   template <typename Other>
   [[nodiscard]] size_t findIdx(Other const& key) const {
+    return findIdxWithHash(key, hashKey(key));
+  }
+
+  template <typename Other>
+  [[nodiscard]] size_t findIdxWithHash(Other const& key, size_t h) const {
     size_t idx{};
     InfoType info{};
-    keyToIdx(key, &idx, &info);
+    hashToIdx(h, &idx, &info);
+    return findIdxFrom(key, idx, info);
+  }
 
+  template <typename Other>
+  [[nodiscard]] size_t findIdxFrom(Other const& key,
+                                   size_t idx,
+                                   InfoType info) const {
     do {
       // unrolling this twice gives a bit of a speedup. More unrolling did not
       // help.
@@ -885,6 +1124,10 @@ class Table
     } while (info <= mInfo[idx]);
 
     // nothing found!
+    return endIdx();
+  }
+
+  [[nodiscard]] size_t endIdx() const noexcept {
     return mMask == 0
                ? 0
                : static_cast<size_t>(distance(
@@ -892,6 +1135,27 @@ class Table
                      reinterpret_cast_no_cast_align_warning<Node*>(mInfo)));
   }
 
+  // Hashes a batch of keys and prefetches all their buckets before probing
+  // any of them, so the cache misses overlap
+  template <typename Other, typename Fn>
+  void findManyIdx(Other const* keys, size_t count, Fn&& fn) const {
+    constexpr size_t BatchSize = 16;
+
+    size_t idxs[BatchSize];
+    InfoType infos[BatchSize];
+    for (size_t first = 0; first < count; first += BatchSize) {
+      const size_t batch = (min)(count - first, BatchSize);
+      for (size_t i = 0; i < batch; ++i) {
+        hashToIdx(hashKey(keys[first + i]), idxs + i, infos + i);
+        prefetch(mInfo + idxs[i]);
+        prefetch(mKeyVals + idxs[i]);
+      }
+      for (size_t i = 0; i < batch; ++i) {
+        fn(first + i, findIdxFrom(keys[first + i], idxs[i], infos[i]));
+      }
+    }
+  }
+
   void cloneData(const Table& o) {
     Cloner<Table, IsFlat && is_trivially_copyable_v<Node>>()(o, *this);
   }
@@ -1028,6 +1292,7 @@ class Table
       // set other's mask to 0 so its destructor won't do anything
       o.init();
     }
+    mMinLoadFactor100 = o.mMinLoadFactor100;
   }
 
   Table& operator=(Table&& o) noexcept {
@@ -1052,6 +1317,7 @@ class Table
         // nothing in the other map => just clear us.
         clear();
       }
+      mMinLoadFactor100 = o.mMinLoadFactor100;
     }
     return *this;
   }
@@ -1076,6 +1342,7 @@ class Table
       mInfoHashShift = o.mInfoHashShift;
       cloneData(o);
     }
+    mMinLoadFactor100 = o.mMinLoadFactor100;
   }
 
   // Creates a copy of the given map. Copy constructor of each entry is used.
@@ -1086,6 +1353,7 @@ class Table
       // prevent assigning of itself
       return *this;
     }
+    mMinLoadFactor100 = o.mMinLoadFactor100;
 
     // we keep using the old allocator and not assign the new one, because we
     // want to keep the memory available. when it is the same size.
@@ -1115,7 +1383,8 @@ class Table
       // realloc.
       if (0 != mMask) {
         // only deallocate if we actually have data!
-        deallocate_bytes(mKeyVals, mNumElements * sizeof(Node));
+        deallocate_bytes(mKeyVals,
+                         calcNumBytesTotal(calcNumElementsWithBuffer(mMask + 1)));
       }
 
       auto const numElementsWithBuffer = calcNumElementsWithBuffer(o.mMask + 1);
@@ -1368,6 +1637,65 @@ class Table
     return iterator{mKeyVals + idx, mInfo + idx};
   }
 
+  // Returns the hash used by the table for the key. It doesn't depend on the
+  // table state, so it may be computed once and reused across rehashes.
+  hash_type hash_key(
+      const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return hashKey(key);
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<Self_::is_transparent, hash_type>::type hash_key(
+      const OtherKey& key) const {
+    return hashKey(key);
+  }
+
+  // Same as find(), but with the hash obtained from hash_key()
+  const_iterator find_with_hash(
+      const key_type& key,
+      hash_type h) const {  // NOLINT(modernize-use-nodiscard)
+    const size_t idx = findIdxWithHash(key, h);
+    return const_iterator{mKeyVals + idx, mInfo + idx};
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  typename enable_if<Self_::is_transparent,  // NOLINT(modernize-use-nodiscard)
+                     const_iterator>::type   // NOLINT(modernize-use-nodiscard)
+  find_with_hash(const OtherKey& key, hash_type h) const {
+    const size_t idx = findIdxWithHash(key, h);
+    return const_iterator{mKeyVals + idx, mInfo + idx};
+  }
+
+  iterator find_with_hash(const key_type& key, hash_type h) {
+    const size_t idx = findIdxWithHash(key, h);
+    return iterator{mKeyVals + idx, mInfo + idx};
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  typename enable_if<Self_::is_transparent, iterator>::type find_with_hash(
+      const OtherKey& key,
+      hash_type h) {
+    const size_t idx = findIdxWithHash(key, h);
+    return iterator{mKeyVals + idx, mInfo + idx};
+  }
+
+  // Stores find(keys[i]) to out[i] for each of count keys. The buckets are
+  // prefetched in batches, so lookups of the batch don't wait for each other.
+  void find_many(const key_type* keys,
+                 size_t count,
+                 const_iterator* out) const {
+    findManyIdx(keys, count, [this, out](size_t pos, size_t idx) {
+      out[pos] = const_iterator{mKeyVals + idx, mInfo + idx};
+    });
+  }
+
+  void find_many(const key_type* keys, size_t count, iterator* out) {
+    findManyIdx(keys, count, [this, out](size_t pos, size_t idx) {
+      out[pos] = iterator{mKeyVals + idx, mInfo + idx};
+    });
+  }
+
   iterator begin() {
     if (empty()) {
       return end();
@@ -1433,6 +1761,7 @@ class Table
           WKeyEqual::operator()(key, mKeyVals[idx].getFirst())) {
         shiftDown(idx);
         --mNumElements;
+        shrinkIfSparse();
         return 1;
       }
       next(&info, &idx);
@@ -1456,6 +1785,36 @@ class Table
     reserve(count, false);
   }
 
+  // Rehashes into the smallest bucket array that holds the current elements
+  // and gives the bulk pool blocks without live nodes back to the allocator.
+  // Node maps keep their elements in place, so only iterators are invalidated
+  void shrink_to_fit() {
+    if (empty()) {
+      destroy();
+      init();
+    } else if (const size_t numBuckets = calcNumBucketsFor(mNumElements);
+               numBuckets < mMask + 1) {
+      rehashPowerOfTwo(numBuckets, false);
+    }
+    DataPool::compact();
+  }
+
+  // Enables automatic shrinking: once erase(key) drops the load factor below
+  // percent, the table is shrunk to twice the room its elements need and the
+  // pool is compacted, which invalidates iterators. erase(iterator) never
+  // shrinks, so erasing while iterating stays safe. 0 disables the policy; the
+  // threshold must be below a quarter of the max load factor so that shrinking
+  // and growing can't alternate
+  void set_min_load_factor(size_t percent) {
+    throw_exception_if_not<invalid_argument>(
+        percent < MaxLoadFactor100 / 4, "min load factor is too high");
+    mMinLoadFactor100 = static_cast<uint32_t>(percent);
+  }
+
+  [[nodiscard]] size_t min_load_factor() const noexcept {
+    return mMinLoadFactor100;
+  }
+
   size_type size() const noexcept {  // NOLINT(modernize-use-nodiscard)
     return mNumElements;
   }
@@ -1481,6 +1840,107 @@ class Table
 
   [[nodiscard]] size_t mask() const noexcept { return mMask; }
 
+  // Flat tables of trivially copyable elements can be saved into a
+  // position-independent image, which is restored without rehashing: either
+  // by copying with load_image() or in place with table_image_view. The image
+  // is valid only for the same Hash, KeyEqual and platform
+  [[nodiscard]] size_t image_size() const noexcept {
+    return calcImageDataOffset() +
+           (mMask ? calcNumBytesTotal(calcNumElementsWithBuffer(mMask + 1))
+                  : 0);
+  }
+
+  void write_image(void* buffer, size_t buffer_size) const {
+    static_assert(IsFlat && is_trivially_copyable_v<value_type>,
+                  "only flat tables of trivially copyable types have images");
+    throw_exception_if_not<length_error>(buffer_size >= image_size(),
+                                         "buffer is too small for the image");
+    auto* const image{static_cast<byte*>(buffer)};
+    const size_t dataOffset{calcImageDataOffset()};
+    table_image_header header{};
+    header.magic = table_image_header::MAGIC;
+    header.version = table_image_header::VERSION;
+    header.node_size = static_cast<uint32_t>(sizeof(Node));
+    header.node_alignment = static_cast<uint32_t>(alignof(Node));
+    header.max_load_factor = static_cast<uint32_t>(MaxLoadFactor100);
+    header.info_inc = mInfoInc;
+    header.info_hash_shift = mInfoHashShift;
+    header.data_offset = static_cast<uint32_t>(dataOffset);
+    header.num_elements = mNumElements;
+    header.mask = mMask;
+    header.max_num_elements_allowed = mMaxNumElementsAllowed;
+    header.data_size = image_size() - dataOffset;
+    memset(image, 0, dataOffset);
+    memcpy(image, addressof(header), sizeof(header));
+    if (!mMask) {
+      return;
+    }
+
+    // empty nodes are uninitialized: zero them instead of leaking memory
+    auto const numElementsWithBuffer = calcNumElementsWithBuffer(mMask + 1);
+    byte* const nodes{image + dataOffset};
+    for (size_t idx = 0; idx < numElementsWithBuffer; ++idx) {
+      if (mInfo[idx]) {
+        memcpy(nodes + idx * sizeof(Node), mKeyVals + idx, sizeof(Node));
+      } else {
+        memset(nodes + idx * sizeof(Node), 0, sizeof(Node));
+      }
+    }
+    memcpy(nodes + numElementsWithBuffer * sizeof(Node), mInfo,
+           calcNumBytesInfo(numElementsWithBuffer));
+  }
+
+  // Replaces the content with a copy of the image. Throws invalid_argument if
+  // the image doesn't match the table type
+  void load_image(const void* image, size_t image_size) {
+    static_assert(IsFlat && is_trivially_copyable_v<value_type>,
+                  "only flat tables of trivially copyable types have images");
+    const table_image_header header{readImageHeader(image, image_size)};
+    Node* keyVals{nullptr};
+    if (header.mask) {
+      keyVals = reinterpret_cast<Node*>(
+          this->allocate_bytes(static_cast<size_t>(header.data_size)));
+      memcpy(keyVals, static_cast<const byte*>(image) + header.data_offset,
+             static_cast<size_t>(header.data_size));
+    }
+    destroy();
+    init();
+    if (keyVals) {
+      assignImage(keyVals, header);
+    }
+  }
+
+#ifdef KTL_HASH_TABLE_STATS
+  // Walks through the info bytes, so it's O(bucket_count)
+  [[nodiscard]] hash_table_stats stats() const noexcept {
+    hash_table_stats stats;
+    stats.size = mNumElements;
+    stats.rehash_count = mRehashCount;
+    stats.info_overflow_count = mInfoOverflowCount;
+    DataPool::collect_stats(stats);
+    if (!mMask) {
+      return stats;
+    }
+    stats.bucket_count = mMask + 1;
+    stats.load_factor_percent = mNumElements * 100 / stats.bucket_count;
+
+    auto const numElementsWithBuffer = calcNumElementsWithBuffer(mMask + 1);
+    stats.table_bytes = calcNumBytesTotal(numElementsWithBuffer);
+    for (size_t idx = 0; idx < numElementsWithBuffer; ++idx) {
+      const InfoType info{mInfo[idx]};
+      if (info) {
+        // info is mInfoInc per step from the ideal bucket plus hash bits
+        const size_t distance{info / mInfoInc - 1};
+        stats.max_info = (max)(stats.max_info, static_cast<size_t>(info));
+        stats.max_probe_distance = (max)(stats.max_probe_distance, distance);
+        ++stats.probe_histogram[(min)(distance,
+                                      hash_table_stats::HISTOGRAM_SIZE - 1)];
+      }
+    }
+    return stats;
+  }
+#endif
+
   [[nodiscard]] size_t calcMaxNumElementsAllowed(
       size_t maxElements) const noexcept {
     if (maxElements <= (numeric_limits<size_t>::max)() / 100) {
@@ -1541,26 +2001,64 @@ class Table
   }
 
   void reserve(size_t c, bool forceRehash) {
-    auto const minElementsAllowed = (max)(c, mNumElements);
+    auto const newSize = calcNumBucketsFor((max)(c, mNumElements));
+
+    // only actually do anything when the new size is bigger than the old one.
+    // This prevents to continuously allocate for each reserve() call.
+    if (forceRehash || newSize > mMask + 1) {
+      rehashPowerOfTwo(newSize);
+    }
+  }
+
+  // smallest power of two number of buckets that holds count elements
+  [[nodiscard]] size_t calcNumBucketsFor(size_t count) const {
     auto newSize = InitialNumElements;
-    while (calcMaxNumElementsAllowed(newSize) < minElementsAllowed &&
-           newSize != 0) {
+    while (calcMaxNumElementsAllowed(newSize) < count && newSize != 0) {
       newSize *= 2;
     }
     if (!newSize) {
       throwOverflowError();
     }
+    return newSize;
+  }
 
-    // only actually do anything when the new size is bigger than the old one.
-    // This prevents to continuously allocate for each reserve() call.
-    if (forceRehash || newSize > mMask + 1) {
-      rehashPowerOfTwo(newSize);
+  // called after erasing by key, see set_min_load_factor(). Shrinking is
+  // optional, so the bigger table is kept if the smaller array can't be
+  // allocated. Anything thrown while moving the elements is propagated, just
+  // like when growing
+  void shrinkIfSparse() {
+    if (!mMinLoadFactor100 || mMask + 1 <= InitialNumElements ||
+        mNumElements * 100 >= (mMask + 1) * mMinLoadFactor100) {
+      return;
+    }
+    const size_t numBuckets = calcNumBucketsFor(mNumElements * 2);
+    if (numBuckets >= mMask + 1) {
+      return;
     }
+    Node* keyVals;
+    try {
+      keyVals = allocateData(numBuckets);
+    } catch (const bad_alloc&) {
+      return;
+    }
+    rehashPowerOfTwo(numBuckets, keyVals, false);
+    DataPool::compact();
   }
 
   // reserves space for at least the specified number of elements.
-  // only works if numBuckets if power of two
-  void rehashPowerOfTwo(size_t numBuckets) {
+  // only works if numBuckets if power of two. The old array is put into the
+  // pool of a node map unless recycleOld is false
+  void rehashPowerOfTwo(size_t numBuckets, bool recycleOld = true) {
+    rehashPowerOfTwo(numBuckets, allocateData(numBuckets), recycleOld);
+  }
+
+  // moves the elements into keyVals, which is allocated by allocateData()
+  // for numBuckets. If a move throws, the elements which haven't been moved
+  // yet are destroyed and the old array is released
+  void rehashPowerOfTwo(size_t numBuckets, Node* keyVals, bool recycleOld) {
+#ifdef KTL_HASH_TABLE_STATS
+    ++mRehashCount;
+#endif
     Node* const oldKeyVals = mKeyVals;
     uint8_t const* const oldInfo = mInfo;
 
@@ -1568,27 +2066,100 @@ class Table
         calcNumElementsWithBuffer(mMask + 1);
 
     // resize operation: move stuff
-    init_data(numBuckets);
+    init_data(numBuckets, keyVals);
     if (oldMaxElementsWithBuffer > 1) {
-      for (size_t i = 0; i < oldMaxElementsWithBuffer; ++i) {
-        if (oldInfo[i] != 0) {
-          insert_move(move(oldKeyVals[i]));
-          // destroy the node but DON'Ty destroy the data.
-          destroy_at(oldKeyVals + i);
+      size_t i = 0;
+      try {
+        for (; i < oldMaxElementsWithBuffer; ++i) {
+          if (oldInfo[i] != 0) {
+            insert_move(move(oldKeyVals[i]));
+            // destroy the node but DON'Ty destroy the data.
+            destroy_at(oldKeyVals + i);
+          }
+        }
+      } catch (...) {
+        for (; i < oldMaxElementsWithBuffer; ++i) {
+          if (oldInfo[i] != 0) {
+            oldKeyVals[i].destroy(*this);
+            destroy_at(oldKeyVals + i);
+          }
         }
+        this->deallocate_bytes(oldKeyVals,
+                               calcNumBytesTotal(oldMaxElementsWithBuffer));
+        throw;
       }
 
       // this check is not necessary as it's guarded by the previous if, but it
       // helps silence g++'s overeager "attempt to free a non-heap object 'map'
       // [-Werror=free-nonheap-object]" warning.
       if (oldKeyVals != reinterpret_cast_no_cast_align_warning<Node*>(&mMask)) {
-        // don't destroy old data: put it into the pool instead
-        DataPool::addOrFree(oldKeyVals,
-                            calcNumBytesTotal(oldMaxElementsWithBuffer));
+        const size_t oldBytesTotal{calcNumBytesTotal(oldMaxElementsWithBuffer)};
+        if (recycleOld) {
+          // don't destroy old data: put it into the pool instead
+          DataPool::addOrFree(oldKeyVals, oldBytesTotal);
+        } else {
+          this->deallocate_bytes(oldKeyVals, oldBytesTotal);
+        }
       }
     }
   }
 
+  [[nodiscard]] static constexpr size_t calcImageDataOffset() noexcept {
+    constexpr size_t alignment{(max)(alignof(Node), alignof(uint64_t))};
+    return (sizeof(table_image_header) + alignment - 1) / alignment *
+           alignment;
+  }
+
+  table_image_header readImageHeader(const void* image,
+                                     size_t image_size) const {
+    throw_exception_if_not<invalid_argument>(
+        image_size >= sizeof(table_image_header), "image is truncated");
+    table_image_header header;
+    memcpy(addressof(header), image, sizeof(header));
+    throw_exception_if_not<invalid_argument>(
+        header.magic == table_image_header::MAGIC &&
+            header.version == table_image_header::VERSION,
+        "not a table image");
+    throw_exception_if_not<invalid_argument>(
+        header.node_size == sizeof(Node) &&
+            header.node_alignment == alignof(Node) &&
+            header.max_load_factor == MaxLoadFactor100 &&
+            header.data_offset == calcImageDataOffset(),
+        "image was written by another table type");
+
+    const uint64_t buckets{header.mask + 1};
+    const bool validShape{
+        header.mask < (numeric_limits<size_t>::max)() &&
+        !(buckets & header.mask) && header.num_elements <= buckets &&
+        header.info_hash_shift < InitialInfoNumBits &&
+        header.info_inc == (InitialInfoInc >> header.info_hash_shift)};
+    throw_exception_if_not<invalid_argument>(validShape,
+                                             "image header is corrupted");
+    const uint64_t dataSize{
+        header.mask ? calcNumBytesTotal(calcNumElementsWithBuffer(
+                          static_cast<size_t>(buckets)))
+                    : 0};
+    throw_exception_if_not<invalid_argument>(
+        header.data_size == dataSize && header.data_offset <= image_size &&
+            header.data_size <= image_size - header.data_offset,
+        "image is truncated");
+    return header;
+  }
+
+  // keyVals must hold nodes followed by info bytes of the image
+  void assignImage(Node* keyVals, const table_image_header& header) noexcept {
+    auto const numElementsWithBuffer =
+        calcNumElementsWithBuffer(static_cast<size_t>(header.mask) + 1);
+    mKeyVals = keyVals;
+    mInfo = reinterpret_cast<uint8_t*>(mKeyVals + numElementsWithBuffer);
+    mNumElements = static_cast<size_t>(header.num_elements);
+    mMask = static_cast<size_t>(header.mask);
+    mMaxNumElementsAllowed =
+        static_cast<size_t>(header.max_num_elements_allowed);
+    mInfoInc = header.info_inc;
+    mInfoHashShift = header.info_hash_shift;
+  }
+
   [[noreturn]] static void throwOverflowError() {
     throw_exception<overflow_error>("robin_hood map overflow");
   }
@@ -1615,17 +2186,26 @@ class Table
   }
 
   void init_data(size_t max_elements) {
-    mNumElements = 0;
-    mMask = max_elements - 1;
-    mMaxNumElementsAllowed = calcMaxNumElementsAllowed(max_elements);
+    init_data(max_elements, allocateData(max_elements));
+  }
 
+  // allocated separately so that the table is left untouched if this throws
+  Node* allocateData(size_t max_elements) {
     auto const numElementsWithBuffer = calcNumElementsWithBuffer(max_elements);
-
-    // calloc also zeroes everything
     auto const numBytesTotal = calcNumBytesTotal(numElementsWithBuffer);
-    mKeyVals = reinterpret_cast<Node*>(this->allocate_bytes(numBytesTotal));
-    memset(mKeyVals, 0, numBytesTotal);
+    return reinterpret_cast<Node*>(this->allocate_bytes(numBytesTotal));
+  }
+
+  // only the info bytes need to be cleared: nodes are constructed in place,
+  // and touching the whole array at once is a latency spike for huge tables
+  void init_data(size_t max_elements, Node* keyVals) noexcept {
+    auto const numElementsWithBuffer = calcNumElementsWithBuffer(max_elements);
+    mKeyVals = keyVals;
+    mNumElements = 0;
+    mMask = max_elements - 1;
+    mMaxNumElementsAllowed = calcMaxNumElementsAllowed(max_elements);
     mInfo = reinterpret_cast<uint8_t*>(mKeyVals + numElementsWithBuffer);
+    memset(mInfo, 0, calcNumBytesInfo(numElementsWithBuffer));
 
     // set sentinel
     mInfo[numElementsWithBuffer] = 1;
@@ -1753,6 +2333,9 @@ class Table
     }
     // we got space left, try to make info smaller
     mInfoInc = static_cast<uint8_t>(mInfoInc >> 1U);
+#ifdef KTL_HASH_TABLE_STATS
+    ++mInfoOverflowCount;
+#endif
 
     // remove one bit of the hash, leaving more space for the distance info.
     // This is extremely fast because we can operate on 8 bytes at once.
@@ -1806,7 +2389,8 @@ class Table
     // non-heap object 'fm'
     // [-Werror=free-nonheap-object]
     if (mKeyVals != reinterpret_cast_no_cast_align_warning<Node*>(&mMask)) {
-      this->deallocate_bytes(mKeyVals, mNumElements * sizeof(Node));
+      this->deallocate_bytes(
+          mKeyVals, calcNumBytesTotal(calcNumElementsWithBuffer(mMask + 1)));
     }
   }
 
@@ -1829,9 +2413,110 @@ class Table
   size_t mMaxNumElementsAllowed = 0;                          // 8 byte 40
   InfoType mInfoInc = InitialInfoInc;                         // 4 byte 44
   InfoType mInfoHashShift =
-      InitialInfoHashShift;  // 4 byte 48
-                             // 16 byte 56 if NodeAllocator
+      InitialInfoHashShift;        // 4 byte 48
+  uint32_t mMinLoadFactor100 = 0;  // 4 byte 52, reuses the padding
+                                   // 16 byte 68 if NodeAllocator
+#ifdef KTL_HASH_TABLE_STATS
+  // describe this object only: aren't transferred by copying or moving
+  size_t mRehashCount = 0;
+  size_t mInfoOverflowCount = 0;
+#endif
+};
+
+// Read-only table over an image written by Table::write_image(). Nothing is
+// copied or rehashed, so the image must outlive the view and stay unchanged
+template <class Table>
+class table_image_view : non_copyable {
+ public:
+  using table_type = Table;
+  using key_type = typename Table::key_type;
+  using mapped_type = typename Table::mapped_type;
+  using value_type = typename Table::value_type;
+  using size_type = typename Table::size_type;
+  using hasher = typename Table::hasher;
+  using key_equal = typename Table::key_equal;
+  using const_iterator = typename Table::const_iterator;
+
+  static_assert(Table::is_flat && is_trivially_copyable_v<value_type>,
+                "only flat tables of trivially copyable types have images");
+
+ public:
+  // Throws invalid_argument if the image doesn't match the table type, is
+  // misaligned or was built with another hash
+  table_image_view(const void* image,
+                   size_t image_size,
+                   const hasher& h = hasher{},
+                   const key_equal& equal = key_equal{})
+      : m_table(0, h, equal) {
+    const table_image_header header{
+        m_table.readImageHeader(image, image_size)};
+    if (!header.mask) {
+      return;
+    }
+    const auto* const data{static_cast<const byte*>(image) +
+                           header.data_offset};
+    throw_exception_if_not<invalid_argument>(
+        reinterpret_cast<uintptr_t>(data) % alignof(typename Table::Node) == 0,
+        "image is misaligned");
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    m_table.assignImage(reinterpret_cast<typename Table::Node*>(
+                            const_cast<byte*>(data)),
+                        header);
+
+    // A different hash would make lookups silently fail
+    if (const auto it = m_table.cbegin(); it != m_table.cend()) {
+      if (m_table.find(m_table.getFirstConst(*it)) != it) {
+        m_table.init();
+        throw_exception<invalid_argument>(
+            "image was built with another hash");
+      }
+    }
+  }
+
+  table_image_view(table_image_view&& other) noexcept
+      : m_table(move(other.m_table)) {}
+
+  table_image_view& operator=(table_image_view&& other) noexcept {
+    if (this != addressof(other)) {
+      m_table.init();
+      m_table = move(other.m_table);
+    }
+    return *this;
+  }
+
+  // The image isn't owned: detach it before the table is destroyed
+  ~table_image_view() noexcept { m_table.init(); }
+
+  [[nodiscard]] const_iterator find(const key_type& key) const {
+    return m_table.find(key);
+  }
+
+  [[nodiscard]] size_t count(const key_type& key) const {
+    return m_table.count(key);
+  }
+
+  [[nodiscard]] bool contains(const key_type& key) const {
+    return m_table.contains(key);
+  }
+
+  [[nodiscard]] const_iterator begin() const noexcept {
+    return m_table.begin();
+  }
+  [[nodiscard]] const_iterator end() const noexcept { return m_table.end(); }
+
+  [[nodiscard]] size_type size() const noexcept { return m_table.size(); }
+  [[nodiscard]] bool empty() const noexcept { return m_table.empty(); }
+
+  // Gives access to the rest of the lookup interface, e.g. find_many()
+  [[nodiscard]] const table_type& table() const noexcept { return m_table; }
+
+ private:
+  table_type m_table;
 };
 
 }  // namespace un::details
+
+// e.g. table_image_view<unordered_flat_map<uint64_t, uint32_t>>
+template <class Table>
+using table_image_view = un::details::table_image_view<Table>;
 }  // namespace ktl
\ No newline at end of file
@@ -0,0 +1,585 @@
+#pragma once
+#include <basic_types.hpp>
+#include <hash_table_impl.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+namespace ktl {
+namespace un::details {
+/*
+ * Flat robin-hood table which grows without moving all elements at once.
+ *
+ * When the table is full, the current array becomes the old one and an empty
+ * array of twice the size is allocated. After that, each insertion and erasure
+ * by key moves at most MigrationStep elements from the old array to the new
+ * one, so the cost of a rehash is spread over the following operations.
+ * Lookups check both arrays until the old one is drained.
+ *
+ * The new array is still allocated and its info bytes are cleared in one
+ * call, which is much cheaper than moving the elements. Any insertion or
+ * erasure by key invalidates iterators. erase() by iterator doesn't migrate,
+ * so the returned iterator stays valid.
+ */
+template <typename Key,
+          typename Ty,
+          typename Hash,
+          typename KeyEqual,
+          class BytesAllocator,
+          size_t MaxLoadFactor100,
+          size_t MigrationStep>
+class incremental_table {
+ public:
+  using table_type =
+      Table<true, Key, Ty, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
+
+  static constexpr bool is_flat = true;
+  static constexpr bool is_map = table_type::is_map;
+  static constexpr bool is_set = table_type::is_set;
+
+  using key_type = typename table_type::key_type;
+  using mapped_type = typename table_type::mapped_type;
+  using value_type = typename table_type::value_type;
+  using size_type = typename table_type::size_type;
+  using hasher = typename table_type::hasher;
+  using key_equal = typename table_type::key_equal;
+  using hash_type = typename table_type::hash_type;
+
+  static_assert(MigrationStep >= 2,
+                "the old array must be drained before the new one is full");
+
+ private:
+  // Iterates over the current array and then over the old one
+  template <bool IsConst>
+  class Iter {
+   private:
+    using table_iterator = conditional_t<IsConst,
+                                         typename table_type::const_iterator,
+                                         typename table_type::iterator>;
+    using owner_pointer = conditional_t<IsConst,
+                                        const incremental_table*,
+                                        incremental_table*>;
+
+   public:
+    using difference_type = typename table_iterator::difference_type;
+    using value_type = typename table_iterator::value_type;
+    using reference = typename table_iterator::reference;
+    using pointer = typename table_iterator::pointer;
+    using iterator_category = forward_iterator_tag;
+
+    Iter() = default;
+
+    template <bool OtherIsConst,
+              typename = typename enable_if<IsConst && !OtherIsConst>::type>
+    // NOLINTNEXTLINE(hicpp-explicit-conversions)
+    Iter(Iter<OtherIsConst> const& other) noexcept
+        : m_owner{other.m_owner}, m_it{other.m_it}, m_in_old{other.m_in_old} {}
+
+    Iter& operator++() noexcept {
+      ++m_it;
+      skip_current_end();
+      return *this;
+    }
+
+    Iter operator++(int) noexcept {
+      Iter tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    reference operator*() const { return *m_it; }
+
+    pointer operator->() const { return m_it.operator->(); }
+
+    template <bool O>
+    bool operator==(Iter<O> const& o) const noexcept {
+      return m_it == o.m_it;
+    }
+
+    template <bool O>
+    bool operator!=(Iter<O> const& o) const noexcept {
+      return m_it != o.m_it;
+    }
+
+   private:
+    Iter(owner_pointer owner, table_iterator it, bool in_old) noexcept
+        : m_owner{owner}, m_it{it}, m_in_old{in_old} {}
+
+    void skip_current_end() noexcept {
+      if (!m_in_old && m_it == m_owner->m_current.end()) {
+        m_it = m_owner->m_old.begin();
+        m_in_old = true;
+      }
+    }
+
+    template <bool>
+    friend class Iter;
+    friend class incremental_table;
+
+    owner_pointer m_owner{nullptr};
+    table_iterator m_it{};
+    bool m_in_old{false};
+  };
+
+ public:
+  using iterator = Iter<false>;
+  using const_iterator = Iter<true>;
+
+ public:
+  incremental_table() = default;
+
+  explicit incremental_table(size_t bucket_count,
+                             const Hash& h = Hash{},
+                             const KeyEqual& equal = KeyEqual{})
+      : m_current(bucket_count, h, equal), m_old(bucket_count, h, equal) {}
+
+  template <class BytesAlloc>
+  incremental_table(size_t bucket_count,
+                    const Hash& h,
+                    const KeyEqual& equal,
+                    BytesAlloc&& alloc)
+      : m_current(bucket_count, h, equal, alloc),
+        m_old(bucket_count, h, equal, forward<BytesAlloc>(alloc)) {}
+
+  template <typename InputIt>
+  incremental_table(InputIt first,
+                    InputIt last,
+                    size_t bucket_count = 0,
+                    const Hash& h = Hash{},
+                    const KeyEqual& equal = KeyEqual{})
+      : incremental_table(bucket_count, h, equal) {
+    insert(first, last);
+  }
+
+  // The copy is made without a pending migration
+  incremental_table(const incremental_table& other)
+      : m_current(other.m_current), m_old(other.m_old) {
+    m_current.reserve(m_current.size() + m_old.size());
+    m_current.insert(m_old.begin(), m_old.end());
+    release_old();
+  }
+
+  // Table steals the arrays on move, so the cursor stays valid
+  incremental_table(incremental_table&& other) noexcept
+      : m_current(move(other.m_current)),
+        m_old(move(other.m_old)),
+        m_cursor(other.m_cursor) {
+    other.m_cursor = other.m_old.end();
+    if (!is_rehashing()) {
+      m_cursor = m_old.end();
+    }
+  }
+
+  // NOLINTNEXTLINE(bugprone-unhandled-self-assignment,cert-oop54-cpp)
+  incremental_table& operator=(const incremental_table& other) {
+    if (this != addressof(other)) {
+      incremental_table tmp{other};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  incremental_table& operator=(incremental_table&& other) noexcept {
+    if (this != addressof(other)) {
+      incremental_table tmp{move(other)};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  ~incremental_table() = default;
+
+  void swap(incremental_table& other) noexcept {
+    // Table steals the arrays on move, so the cursors stay valid
+    using ktl::swap;
+    swap(m_current, other.m_current);
+    swap(m_old, other.m_old);
+    swap(m_cursor, other.m_cursor);
+    if (!is_rehashing()) {
+      m_cursor = m_old.end();
+    }
+    if (!other.is_rehashing()) {
+      other.m_cursor = other.m_old.end();
+    }
+  }
+
+  void clear() {
+    m_current.clear();
+    release_old();
+  }
+
+  bool operator==(const incremental_table& other) const {
+    if (other.size() != size()) {
+      return false;
+    }
+    for (const auto& entry : other) {
+      if (!has(entry)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const incremental_table& other) const {
+    return !operator==(other);
+  }
+
+  template <typename Q = mapped_type>
+  typename enable_if<!is_void<Q>::value, Q&>::type operator[](
+      const key_type& key) {
+    return try_emplace(key).first->second;
+  }
+
+  template <typename Q = mapped_type>
+  typename enable_if<!is_void<Q>::value, Q&>::type operator[](key_type&& key) {
+    return try_emplace(move(key)).first->second;
+  }
+
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(value_type(*first));
+    }
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> emplace(Args&&... args) {
+    value_type value(forward<Args>(args)...);
+    return insert(move(value));
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    return insert_with(key, [&] {
+      return m_current.try_emplace(key, forward<Args>(args)...);
+    });
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+    return insert_with(key, [&] {
+      return m_current.try_emplace(move(key), forward<Args>(args)...);
+    });
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace([[maybe_unused]] const_iterator hint,
+                                   const key_type& key,
+                                   Args&&... args) {
+    return try_emplace(key, forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace([[maybe_unused]] const_iterator hint,
+                                   key_type&& key,
+                                   Args&&... args) {
+    return try_emplace(move(key), forward<Args>(args)...);
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign(const key_type& key, Mapped&& obj) {
+    return insert_or_assign_impl(key, forward<Mapped>(obj));
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign(key_type&& key, Mapped&& obj) {
+    return insert_or_assign_impl(move(key), forward<Mapped>(obj));
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign([[maybe_unused]] const_iterator hint,
+                                        const key_type& key,
+                                        Mapped&& obj) {
+    return insert_or_assign_impl(key, forward<Mapped>(obj));
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign([[maybe_unused]] const_iterator hint,
+                                        key_type&& key,
+                                        Mapped&& obj) {
+    return insert_or_assign_impl(move(key), forward<Mapped>(obj));
+  }
+
+  pair<iterator, bool> insert(const value_type& keyval) {
+    return insert_with(get_key(keyval),
+                       [&] { return m_current.insert(keyval); });
+  }
+
+  pair<iterator, bool> insert(value_type&& keyval) {
+    return insert_with(get_key(keyval),
+                       [&] { return m_current.insert(move(keyval)); });
+  }
+
+  // Returns 1 if key is found, 0 otherwise.
+  size_t count(const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return find(key) != end() ? 1 : 0;
+  }
+
+  bool contains(const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return bool_cast(count(key));
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <typename Q = mapped_type>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<!is_void<Q>::value, Q&>::type at(key_type const& key) {
+    auto it = find(key);
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <typename Q = mapped_type>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<!is_void<Q>::value, Q const&>::type at(
+      key_type const& key) const {
+    auto it = find(key);
+    if (it == end()) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return it->second;
+  }
+
+  const_iterator find(
+      const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return find_impl(*this, key, m_current.hash_key(key));
+  }
+
+  iterator find(const key_type& key) {
+    return find_impl(*this, key, m_current.hash_key(key));
+  }
+
+  iterator begin() {
+    iterator it{this, m_current.begin(), false};
+    it.skip_current_end();
+    return it;
+  }
+  const_iterator begin() const {  // NOLINT(modernize-use-nodiscard)
+    return cbegin();
+  }
+  const_iterator cbegin() const {  // NOLINT(modernize-use-nodiscard)
+    const_iterator it{this, m_current.cbegin(), false};
+    it.skip_current_end();
+    return it;
+  }
+
+  iterator end() { return iterator{this, m_old.end(), true}; }
+  const_iterator end() const {  // NOLINT(modernize-use-nodiscard)
+    return cend();
+  }
+  const_iterator cend() const {  // NOLINT(modernize-use-nodiscard)
+    return const_iterator{this, m_old.cend(), true};
+  }
+
+  iterator erase(iterator pos) { return erase(const_iterator{pos}); }
+
+  // Erases element at pos, returns iterator to the next element.
+  iterator erase(const_iterator pos) {
+    if (!pos.m_in_old) {
+      iterator next{this, m_current.erase(pos.m_it), false};
+      next.skip_current_end();
+      return next;
+    }
+    auto next{erase_old(pos.m_it)};
+    return is_rehashing() ? iterator{this, next, true} : end();
+  }
+
+  size_t erase(const key_type& key) {
+    migrate(MigrationStep);
+    const hash_type h{m_current.hash_key(key)};
+    if (m_current.erase(key)) {
+      return 1;
+    }
+    if (is_rehashing()) {
+      if (auto it = m_old.find_with_hash(key, h); it != m_old.end()) {
+        erase_old(it);
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  // Finishes pending migration and rehashes the table at once
+  void rehash(size_t count) {
+    finish_migration();
+    m_current.rehash(count);
+  }
+
+  // Finishes pending migration and makes room for count elements at once
+  void reserve(size_t count) {
+    finish_migration();
+    m_current.reserve(count);
+  }
+
+  size_type size() const noexcept {  // NOLINT(modernize-use-nodiscard)
+    return m_current.size() + m_old.size();
+  }
+
+  size_type max_size() const noexcept {  // NOLINT(modernize-use-nodiscard)
+    return m_current.max_size();
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+  [[nodiscard]] size_t mask() const noexcept { return m_current.mask(); }
+
+  // Elements of the old array are still waiting for migration
+  [[nodiscard]] bool is_rehashing() const noexcept { return !m_old.empty(); }
+
+ private:
+  template <typename Q = mapped_type>
+  [[nodiscard]] typename enable_if<!is_void<Q>::value, bool>::type has(
+      const value_type& e) const {
+    auto it = find(e.first);
+    return it != end() && it->second == e.second;
+  }
+
+  template <typename Q = mapped_type>
+  [[nodiscard]] typename enable_if<is_void<Q>::value, bool>::type has(
+      const value_type& e) const {
+    return find(e) != end();
+  }
+
+  [[nodiscard]] static const key_type& get_key(
+      const value_type& value) noexcept {
+    if constexpr (is_map) {
+      return value.first;
+    } else {
+      return value;
+    }
+  }
+
+  template <class Self>
+  static auto find_impl(Self& self, const key_type& key, hash_type h) {
+    using iterator_type =
+        conditional_t<is_const_v<Self>, const_iterator, iterator>;
+
+    auto* owner{addressof(self)};
+    if (auto it = self.m_current.find_with_hash(key, h);
+        it != self.m_current.end()) {
+      return iterator_type{owner, it, false};
+    }
+    return iterator_type{owner, self.m_old.find_with_hash(key, h), true};
+  }
+
+  template <class Inserter>
+  pair<iterator, bool> insert_with(const key_type& key, Inserter inserter) {
+    const hash_type h{m_current.hash_key(key)};
+    if (auto it = find_impl(*this, key, h); it != end()) {
+      return {it, false};
+    }
+    if (is_full()) {
+      start_migration();
+    }
+    migrate(MigrationStep);
+    auto [it, inserted]{inserter()};
+    return {iterator{this, it, false}, inserted};
+  }
+
+  template <typename OtherKey, typename Mapped>
+  pair<iterator, bool> insert_or_assign_impl(OtherKey&& key, Mapped&& obj) {
+    auto [it, inserted]{try_emplace(forward<OtherKey>(key),
+                                    forward<Mapped>(obj))};
+    if (!inserted) {
+      it->second = forward<Mapped>(obj);
+    }
+    return {it, inserted};
+  }
+
+  [[nodiscard]] bool is_full() const noexcept {
+    const size_t mask{m_current.mask()};
+    return mask &&
+           m_current.size() >= m_current.calcMaxNumElementsAllowed(mask + 1);
+  }
+
+  // The current array becomes the old one. If the new array can't be
+  // allocated, the current one is given back, so the table stays unchanged
+  void start_migration() {
+    finish_migration();
+    const size_t bucket_count{(m_current.mask() + 1) * 2};
+    m_old = move(m_current);
+    m_cursor = m_old.begin();
+    try {
+      m_current.reserve(m_old.calcMaxNumElementsAllowed(bucket_count));
+    } catch (...) {
+      m_current = move(m_old);
+      release_old();
+      throw;
+    }
+  }
+
+  void finish_migration() {
+    migrate(m_old.size());
+  }
+
+  void migrate(size_t count) {
+    if (!is_rehashing()) {
+      return;
+    }
+    for (; count > 0 && m_cursor != m_old.end(); --count) {
+      m_current.insert(move(*m_cursor));
+      m_cursor = m_old.erase(m_cursor);
+    }
+    if (m_cursor == m_old.end()) {
+      release_old();
+    }
+  }
+
+  /*
+   * All slots before the cursor are already free, so erasure can only shift
+   * elements at or after it
+   */
+  typename table_type::iterator erase_old(
+      typename table_type::const_iterator pos) {
+    const bool at_cursor{pos == m_cursor};
+    auto next{m_old.erase(pos)};
+    if (at_cursor) {
+      m_cursor = next;
+    }
+    if (m_old.empty()) {
+      release_old();
+      return m_old.end();
+    }
+    return next;
+  }
+
+  // Table::clear() keeps the array, so it's released by moving out
+  void release_old() noexcept {
+    { [[maybe_unused]] const table_type released{move(m_old)}; }
+    m_cursor = m_old.end();
+  }
+
+ private:
+  table_type m_current;
+  table_type m_old;
+  typename table_type::iterator m_cursor{m_old.end()};
+};
+
+template <typename Key,
+          typename Ty,
+          typename Hash,
+          typename KeyEqual,
+          class BytesAllocator,
+          size_t MaxLoadFactor100,
+          size_t MigrationStep>
+void swap(incremental_table<Key,
+                            Ty,
+                            Hash,
+                            KeyEqual,
+                            BytesAllocator,
+                            MaxLoadFactor100,
+                            MigrationStep>& lhs,
+          incremental_table<Key,
+                            Ty,
+                            Hash,
+                            KeyEqual,
+                            BytesAllocator,
+                            MaxLoadFactor100,
+                            MigrationStep>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace un::details
+}  // namespace ktl
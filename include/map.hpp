@@ -0,0 +1,70 @@
+#pragma once
+#include <basic_types.hpp>
+#include <allocator.hpp>
+#include <btree_impl.hpp>
+#include <flat_tree_impl.hpp>
+#include <functional.hpp>
+
+namespace ktl {
+// Ordered map on a B-tree; see btree for details. less<> enables lookups by
+// any type comparable with Key
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_map =
+    bt::details::btree<Key, Ty, Compare, BytesAllocator, false, NodeSize>;
+
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_map_non_paged =
+    bt::details::btree<Key, Ty, Compare, BytesAllocator, false, NodeSize>;
+
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_multimap =
+    bt::details::btree<Key, Ty, Compare, BytesAllocator, true, NodeSize>;
+
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_multimap_non_paged =
+    bt::details::btree<Key, Ty, Compare, BytesAllocator, true, NodeSize>;
+
+// Ordered map on a sorted vector; see flat_tree for details. Lookups are
+// branchless binary searches, insertion and erasure cost O(N)
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class Allocator = basic_paged_allocator<pair<Key, Ty>>>
+using flat_map = ft::details::flat_tree<Key, Ty, Compare, Allocator, false>;
+
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class Allocator = basic_non_paged_allocator<pair<Key, Ty>>>
+using flat_map_non_paged =
+    ft::details::flat_tree<Key, Ty, Compare, Allocator, false>;
+
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class Allocator = basic_paged_allocator<pair<Key, Ty>>>
+using flat_multimap = ft::details::flat_tree<Key, Ty, Compare, Allocator, true>;
+
+template <class Key,
+          class Ty,
+          class Compare = less<Key>,
+          class Allocator = basic_non_paged_allocator<pair<Key, Ty>>>
+using flat_multimap_non_paged =
+    ft::details::flat_tree<Key, Ty, Compare, Allocator, true>;
+}  // namespace ktl
@@ -320,6 +320,11 @@ inline constexpr bool enable_transfer_without_allocator_v =
     !has_construct_v<Allocator,
                      typename iterator_traits<OutputIt>::pointer,
                      typename iterator_traits<InputIt>::reference>;
+
+template <class Ty, class Allocator>
+inline constexpr bool enable_relocation_without_allocator_v =
+    is_trivially_relocatable_v<Ty> && !has_construct_v<Allocator, Ty*, Ty&&> &&
+    !has_destroy_v<Allocator, Ty*>;
 }  // namespace mm::details
 
 template <class InputIt, class NoThrowForwardIt>
@@ -605,6 +610,29 @@ NoThrowForwardIt uninitialized_move_n_unchecked(InputIt first,
   }
 }
 
+// Moves objects to the uninitialized memory and destroys the source ones.
+// Trivially relocatable objects are transferred by memmove(), so the ranges
+// may overlap only for them
+template <class Ty, class Allocator>
+Ty* uninitialized_relocate_n(Ty* first,
+                             size_t count,
+                             Ty* dest,
+                             Allocator& alloc) noexcept(
+    mm::details::enable_relocation_without_allocator_v<Ty, Allocator> ||
+    is_nothrow_move_constructible_v<Ty>) {
+  if constexpr (mm::details::enable_relocation_without_allocator_v<
+                    Ty, Allocator>) {
+    if (count != 0) {  // The buffers may be null
+      mm::details::uninitialized_copy_trivial_impl(first, count, dest);
+    }
+    return dest + count;
+  } else {
+    Ty* last{uninitialized_move_n_unchecked(first, count, dest, alloc)};
+    destroy_n(first, count, alloc);
+    return last;
+  }
+}
+
 namespace mm::details {
 template <class Backout>
 struct uninitialized_construct_helper : Backout {
@@ -0,0 +1,62 @@
+#pragma once
+#include <basic_types.hpp>
+#include <allocator.hpp>
+#include <btree_impl.hpp>
+#include <flat_tree_impl.hpp>
+#include <functional.hpp>
+
+namespace ktl {
+// Ordered set on a B-tree; see btree for details. less<> enables lookups by
+// any type comparable with Key
+template <class Key,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_set =
+    bt::details::btree<Key, void, Compare, BytesAllocator, false, NodeSize>;
+
+template <class Key,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_set_non_paged =
+    bt::details::btree<Key, void, Compare, BytesAllocator, false, NodeSize>;
+
+template <class Key,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_multiset =
+    bt::details::btree<Key, void, Compare, BytesAllocator, true, NodeSize>;
+
+template <class Key,
+          class Compare = less<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t NodeSize = 4 * crt::CACHE_LINE_SIZE>
+using btree_multiset_non_paged =
+    bt::details::btree<Key, void, Compare, BytesAllocator, true, NodeSize>;
+
+// Ordered set on a sorted vector; see flat_tree for details
+template <class Key,
+          class Compare = less<Key>,
+          class Allocator = basic_paged_allocator<Key>>
+using flat_set = ft::details::flat_tree<Key, void, Compare, Allocator, false>;
+
+template <class Key,
+          class Compare = less<Key>,
+          class Allocator = basic_non_paged_allocator<Key>>
+using flat_set_non_paged =
+    ft::details::flat_tree<Key, void, Compare, Allocator, false>;
+
+template <class Key,
+          class Compare = less<Key>,
+          class Allocator = basic_paged_allocator<Key>>
+using flat_multiset =
+    ft::details::flat_tree<Key, void, Compare, Allocator, true>;
+
+template <class Key,
+          class Compare = less<Key>,
+          class Allocator = basic_non_paged_allocator<Key>>
+using flat_multiset_non_paged =
+    ft::details::flat_tree<Key, void, Compare, Allocator, true>;
+}  // namespace ktl
@@ -0,0 +1,230 @@
+#pragma once
+#include <exception.hpp>
+#include <heap.hpp>
+#include <limits.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#include <ntddk.h>
+
+namespace ktl {
+// NOLINTNEXTLINE(clang-diagnostic-four-char-constants)
+inline constexpr crt::pool_tag_t SLAB_HEAP_TAG{'sLTK'};  //!< Reversed 'KTLs'
+
+struct slab_heap_stats {
+  size_t slab_count;        //!< Slabs allocated from the pool
+  size_t empty_slab_count;  //!< Fully free slabs kept for reuse
+  size_t object_count;      //!< Objects currently allocated
+  size_t object_capacity;   //!< Objects which fit into the allocated slabs
+};
+
+namespace mm::details {
+inline constexpr size_t SLAB_OBJECT_SIZES[]{16,  32,  48,  64,  96,
+                                           128, 192, 256, 384, 512};
+
+struct slab_descriptor;
+
+struct slab_size_class {
+  slab_descriptor* partial{nullptr};  // Doubly-linked
+  slab_descriptor* empty{nullptr};    // Singly-linked
+  size_t slab_count{0};
+  size_t empty_slab_count{0};
+  size_t object_count{0};
+};
+}  // namespace mm::details
+
+/*
+ * Carves page-sized slabs into objects of a fixed size class. Free objects are
+ * tracked by a per-slab bitmap which lives in a separate non-paged descriptor,
+ * so the heap lock never touches pageable memory. Fully free slabs are kept
+ * for reuse up to a per-class limit and returned to the pool after that (or by
+ * release_empty_slabs()). Blocks which are too large or over-aligned are passed
+ * straight to the pool.
+ *
+ * Allocation and deallocation are allowed at IRQL <= DISPATCH_LEVEL for
+ * non-paged pools and at IRQL <= APC_LEVEL for paged ones.
+ */
+class slab_heap : non_relocatable {
+ public:
+  static constexpr size_t SLAB_SIZE{crt::MEMORY_PAGE_SIZE};
+  static constexpr size_t OBJECT_ALIGNMENT{16};
+  static constexpr size_t SIZE_CLASS_COUNT{
+      sizeof(mm::details::SLAB_OBJECT_SIZES) /
+      sizeof(mm::details::SLAB_OBJECT_SIZES[0])};
+  static constexpr size_t MAX_OBJECT_SIZE{
+      mm::details::SLAB_OBJECT_SIZES[SIZE_CLASS_COUNT - 1]};
+  static constexpr size_t DEFAULT_MAX_EMPTY_SLABS{4};  // Per size class
+
+ public:
+  constexpr explicit slab_heap(
+      crt::pool_type_t pool_type,
+      crt::pool_tag_t pool_tag = SLAB_HEAP_TAG,
+      size_t max_empty_slabs = DEFAULT_MAX_EMPTY_SLABS) noexcept
+      : m_pool_type{pool_type},
+        m_pool_tag{pool_tag},
+        m_max_empty_slabs{max_empty_slabs} {}
+
+  // Only empty slabs are released, so all objects must be freed before
+  ~slab_heap() noexcept;
+
+  [[nodiscard]] static constexpr bool is_slab_allocation(
+      size_t bytes_count,
+      align_val_t alignment) noexcept {
+    return bytes_count <= MAX_OBJECT_SIZE &&
+           static_cast<size_t>(alignment) <= OBJECT_ALIGNMENT;
+  }
+
+  [[nodiscard]] static constexpr size_t get_size_class(
+      size_t bytes_count) noexcept {
+    size_t size_class{0};
+    while (size_class < SIZE_CLASS_COUNT - 1 &&
+           bytes_count > mm::details::SLAB_OBJECT_SIZES[size_class]) {
+      ++size_class;
+    }
+    return size_class;
+  }
+
+  [[nodiscard]] static constexpr size_t get_object_size(
+      size_t size_class) noexcept {
+    return mm::details::SLAB_OBJECT_SIZES[size_class];
+  }
+
+  // Returns nullptr on failure
+  [[nodiscard]] void* allocate(size_t bytes_count,
+                               align_val_t alignment) noexcept;
+  void deallocate(void* ptr,
+                  size_t bytes_count,
+                  align_val_t alignment) noexcept;
+
+  void release_empty_slabs() noexcept;
+
+  [[nodiscard]] slab_heap_stats get_stats() const noexcept;
+  [[nodiscard]] slab_heap_stats get_stats(size_t size_class) const noexcept;
+
+  [[nodiscard]] constexpr crt::pool_type_t get_pool_type() const noexcept {
+    return m_pool_type;
+  }
+
+  [[nodiscard]] constexpr crt::pool_tag_t get_pool_tag() const noexcept {
+    return m_pool_tag;
+  }
+
+ private:
+  void* take_object(mm::details::slab_size_class& target) noexcept;
+  mm::details::slab_descriptor* create_slab(size_t size_class) noexcept;
+  void destroy_slab(mm::details::slab_descriptor* slab) noexcept;
+  slab_heap_stats make_stats(size_t size_class) const noexcept;
+
+ private:
+  crt::pool_type_t m_pool_type;
+  crt::pool_tag_t m_pool_tag;
+  size_t m_max_empty_slabs;
+  mutable KSPIN_LOCK m_lock{};
+  mm::details::slab_size_class m_classes[SIZE_CLASS_COUNT]{};
+};
+
+/*
+ * Heaps used by default-constructed slab allocators. Constant-initialized,
+ * so they can be used from constructors of other global objects
+ */
+template <crt::pool_type_t PoolType>
+inline slab_heap default_slab_heap{PoolType};
+
+template <class Ty, crt::pool_type_t PoolType = PagedPool>
+class slab_allocator {
+ public:
+  using value_type = Ty;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using propagate_on_container_copy_assignment = true_type;
+  using propagate_on_container_move_assignment = true_type;
+  using propagate_on_container_swap = true_type;
+  using is_always_equal = false_type;
+  using enable_delete_null = true_type;
+
+  template <class OtherTy>
+  struct rebind {
+    using other = slab_allocator<OtherTy, PoolType>;
+  };
+
+  static constexpr auto ALIGNMENT{static_cast<align_val_t>(alignof(Ty))};
+
+ public:
+  constexpr slab_allocator() noexcept
+      : m_heap{addressof(default_slab_heap<PoolType>)} {}
+
+  constexpr explicit slab_allocator(slab_heap& heap) noexcept
+      : m_heap{addressof(heap)} {}
+
+  template <class OtherTy>
+  constexpr slab_allocator(
+      const slab_allocator<OtherTy, PoolType>& other) noexcept
+      : m_heap{addressof(other.get_heap())} {}
+
+  Ty* allocate() { return allocate_bytes(sizeof(value_type)); }
+
+  Ty* allocate(size_t object_count) {
+    if (object_count > (numeric_limits<size_t>::max)() / sizeof(value_type)) {
+      throw bad_array_new_length{};
+    }
+    return allocate_bytes(object_count * sizeof(value_type));
+  }
+
+  Ty* allocate_bytes(size_t bytes_count) {
+    void* const buffer{m_heap->allocate(bytes_count, ALIGNMENT)};
+    if (!buffer) {
+      throw bad_alloc{};
+    }
+    return static_cast<Ty*>(buffer);
+  }
+
+  void deallocate(Ty* ptr) noexcept {
+    deallocate_bytes(ptr, sizeof(value_type));
+  }
+
+  void deallocate(Ty* ptr, size_t object_count) noexcept {
+    deallocate_bytes(ptr, object_count * sizeof(value_type));
+  }
+
+  void deallocate_bytes(Ty* ptr, size_t bytes_count) noexcept {
+    m_heap->deallocate(ptr, bytes_count, ALIGNMENT);
+  }
+
+  [[nodiscard]] constexpr slab_heap& get_heap() const noexcept {
+    return *m_heap;
+  }
+
+  void swap(slab_allocator& other) noexcept {
+    ktl::swap(m_heap, other.m_heap);
+  }
+
+ private:
+  slab_heap* m_heap;
+};
+
+template <class Ty, class OtherTy, crt::pool_type_t PoolType>
+constexpr bool operator==(
+    const slab_allocator<Ty, PoolType>& lhs,
+    const slab_allocator<OtherTy, PoolType>& rhs) noexcept {
+  return addressof(lhs.get_heap()) == addressof(rhs.get_heap());
+}
+
+template <class Ty, class OtherTy, crt::pool_type_t PoolType>
+constexpr bool operator!=(
+    const slab_allocator<Ty, PoolType>& lhs,
+    const slab_allocator<OtherTy, PoolType>& rhs) noexcept {
+  return !(lhs == rhs);
+}
+
+template <class Ty, crt::pool_type_t PoolType>
+void swap(slab_allocator<Ty, PoolType>& lhs,
+          slab_allocator<Ty, PoolType>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+template <class Ty>
+using slab_paged_allocator = slab_allocator<Ty, PagedPool>;
+
+template <class Ty>
+using slab_non_paged_allocator = slab_allocator<Ty, NonPagedPool>;
+}  // namespace ktl
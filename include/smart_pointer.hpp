@@ -1513,6 +1513,21 @@ constexpr Ty* get_pointer(const intrusive_ptr<Ty>& ptr) noexcept {
   return ptr.get();
 }
 
+// Smart pointers never point to themselves, so containers can move them with
+// memcpy() without touching the reference counters
+template <class Ty, class Dx>
+struct is_trivially_relocatable<unique_ptr<Ty, Dx> >
+    : is_trivially_relocatable<Dx> {};
+
+template <class Ty>
+struct is_trivially_relocatable<shared_ptr<Ty> > : true_type {};
+
+template <class Ty>
+struct is_trivially_relocatable<weak_ptr<Ty> > : true_type {};
+
+template <class Ty>
+struct is_trivially_relocatable<intrusive_ptr<Ty> > : true_type {};
+
 namespace mm::details {
 template <class Alloc, typename SizeTy>
 struct alloc_temporary_guard_delete {
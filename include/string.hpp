@@ -884,6 +884,33 @@ class basic_winnt_string {
     native_string_traits_type::set_size(get_native_str(), new_size);
   }
 
+  // The appended characters are left uninitialized and must be overwritten
+  void resize_uninitialized(size_type new_size) {
+    reserve(new_size);
+    native_string_traits_type::set_size(get_native_str(), new_size);
+  }
+
+  // Appends count uninitialized characters and returns a pointer to the first
+  // of them
+  value_type* append_uninitialized(size_type count) {
+    const size_type old_size{size()};
+    concat_with_optimal_growth(
+        []([[maybe_unused]] value_type* dst,
+           [[maybe_unused]] size_type ch_count) noexcept {},
+        count);
+    return data() + old_size;
+  }
+
+  // Calls op(data(), new_size) on a buffer of at least new_size characters
+  // and sets the size to the value returned by op
+  template <class Operation>
+  void resize_and_overwrite(size_type new_size, Operation op) {
+    reserve(new_size);
+    const auto final_size{static_cast<size_type>(op(data(), new_size))};
+    assert_with_msg(final_size <= new_size, "too many characters are written");
+    native_string_traits_type::set_size(get_native_str(), final_size);
+  }
+
   void swap(basic_winnt_string& other) noexcept { ktl::swap(*this, other); }
 
   template <size_t BufferSize, class ChAlloc>
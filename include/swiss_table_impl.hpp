@@ -0,0 +1,1112 @@
+#pragma once
+#include <basic_types.hpp>
+#include <algorithm.hpp>
+#include <allocator.hpp>
+#include <functional.hpp>
+#include <hash.hpp>
+#include <hash_table_impl.hpp>
+#include <intrinsic.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <limits.hpp>
+#include <tuple.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#ifdef _M_AMD64
+#include <emmintrin.h>
+#endif
+
+namespace ktl {
+namespace un::details {
+/*
+ * Control bytes of the swiss_table. Full slots store the lower 7 bits of the
+ * hash, so all special values have the sign bit set
+ */
+using ctrl_t = int8_t;
+
+inline constexpr ctrl_t CTRL_EMPTY{-128};    // 0b10000000
+inline constexpr ctrl_t CTRL_DELETED{-2};    // 0b11111110
+inline constexpr ctrl_t CTRL_SENTINEL{-1};   // 0b11111111
+
+[[nodiscard]] constexpr bool is_full(ctrl_t ctrl) noexcept {
+  return ctrl >= 0;
+}
+
+[[nodiscard]] inline uint32_t count_trailing_zeros(uint64_t value) noexcept {
+  unsigned long index;
+#if BITNESS == 64
+  _BitScanForward64(&index, value);
+#else
+  if (!_BitScanForward(&index, static_cast<unsigned long>(value))) {
+    _BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+    index += 32;
+  }
+#endif
+  return static_cast<uint32_t>(index);
+}
+
+[[nodiscard]] inline uint32_t count_leading_zeros(uint64_t value) noexcept {
+  unsigned long index;
+#if BITNESS == 64
+  _BitScanReverse64(&index, value);
+#else
+  if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32))) {
+    index += 32;
+  } else {
+    _BitScanReverse(&index, static_cast<unsigned long>(value));
+  }
+#endif
+  return 63 - static_cast<uint32_t>(index);
+}
+
+/*
+ * Set of matching positions of a group: each position is represented by
+ * 2^Shift bits of which only the highest one may be set
+ */
+template <class MaskTy, uint32_t Width, uint32_t Shift>
+class group_bit_mask {
+ public:
+  constexpr explicit group_bit_mask(MaskTy mask) noexcept : m_mask{mask} {}
+
+  group_bit_mask& operator++() noexcept {
+    m_mask &= m_mask - 1;
+    return *this;
+  }
+
+  [[nodiscard]] uint32_t operator*() const noexcept { return lowest(); }
+
+  [[nodiscard]] constexpr explicit operator bool() const noexcept {
+    return m_mask != 0;
+  }
+
+  [[nodiscard]] uint32_t lowest() const noexcept {
+    return count_trailing_zeros(m_mask) >> Shift;
+  }
+
+  [[nodiscard]] uint32_t leading_zeros() const noexcept {
+    constexpr uint32_t EXTRA_BITS{
+        static_cast<uint32_t>(sizeof(uint64_t) * CHAR_BIT) -
+        (Width << Shift)};
+    return (count_leading_zeros(m_mask) - EXTRA_BITS) >> Shift;
+  }
+
+  [[nodiscard]] uint32_t trailing_zeros() const noexcept {
+    return m_mask ? lowest() : Width;
+  }
+
+  group_bit_mask begin() const noexcept { return *this; }
+  group_bit_mask end() const noexcept { return group_bit_mask{0}; }
+
+  friend bool operator!=(const group_bit_mask& lhs,
+                         const group_bit_mask& rhs) noexcept {
+    return lhs.m_mask != rhs.m_mask;
+  }
+
+ private:
+  MaskTy m_mask;
+};
+
+#ifdef _M_AMD64
+// Matches 16 control bytes at once with SSE2
+class ctrl_group_sse2 {
+ public:
+  static constexpr size_t WIDTH{16};
+
+  using bit_mask = group_bit_mask<uint32_t, WIDTH, 0>;
+
+ public:
+  explicit ctrl_group_sse2(const ctrl_t* pos) noexcept
+      : m_ctrl{_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))} {}
+
+  [[nodiscard]] bit_mask match(ctrl_t hash) const noexcept {
+    return bit_mask{to_mask(_mm_cmpeq_epi8(_mm_set1_epi8(hash), m_ctrl))};
+  }
+
+  [[nodiscard]] bit_mask match_empty() const noexcept {
+    return match(CTRL_EMPTY);
+  }
+
+  [[nodiscard]] bit_mask match_empty_or_deleted() const noexcept {
+    return bit_mask{
+        to_mask(_mm_cmpgt_epi8(_mm_set1_epi8(CTRL_SENTINEL), m_ctrl))};
+  }
+
+  [[nodiscard]] uint32_t count_leading_empty_or_deleted() const noexcept {
+    const uint32_t mask{
+        to_mask(_mm_cmpgt_epi8(_mm_set1_epi8(CTRL_SENTINEL), m_ctrl))};
+    return count_trailing_zeros(mask + 1);
+  }
+
+ private:
+  static uint32_t to_mask(__m128i value) noexcept {
+    return static_cast<uint32_t>(_mm_movemask_epi8(value));
+  }
+
+ private:
+  __m128i m_ctrl;
+};
+#endif
+
+/*
+ * Matches 8 control bytes at once inside a general-purpose register.
+ * Used where XMM registers are unavailable without saving the extended
+ * processor state. match() may report false positives next to a real match,
+ * which are rejected by the key comparison
+ */
+class ctrl_group_swar {
+ public:
+  static constexpr size_t WIDTH{8};
+
+  using bit_mask = group_bit_mask<uint64_t, WIDTH, 3>;
+
+ public:
+  explicit ctrl_group_swar(const ctrl_t* pos) noexcept
+      : m_ctrl{unaligned_load<uint64_t>(pos)} {}
+
+  [[nodiscard]] bit_mask match(ctrl_t hash) const noexcept {
+    const uint64_t value{m_ctrl ^ (LSBS * static_cast<uint8_t>(hash))};
+    return bit_mask{(value - LSBS) & ~value & MSBS};
+  }
+
+  [[nodiscard]] bit_mask match_empty() const noexcept {
+    return bit_mask{(m_ctrl & ~(m_ctrl << 6)) & MSBS};
+  }
+
+  [[nodiscard]] bit_mask match_empty_or_deleted() const noexcept {
+    return bit_mask{(m_ctrl & ~(m_ctrl << 7)) & MSBS};
+  }
+
+  [[nodiscard]] uint32_t count_leading_empty_or_deleted() const noexcept {
+    constexpr uint64_t GAPS{0x00FEFEFEFEFEFEFEull};
+    return (count_trailing_zeros(((~m_ctrl & (m_ctrl >> 7)) | GAPS) + 1) +
+            7) >>
+           3;
+  }
+
+ private:
+  static constexpr uint64_t MSBS{0x8080808080808080ull};
+  static constexpr uint64_t LSBS{0x0101010101010101ull};
+
+ private:
+  uint64_t m_ctrl;
+};
+
+#ifdef _M_AMD64
+using ctrl_group = ctrl_group_sse2;
+#else
+using ctrl_group = ctrl_group_swar;
+#endif
+
+/*
+ * Control bytes of a table without storage: the sentinel stops iteration
+ * and the empty bytes stop lookups
+ */
+template <size_t Width>
+struct empty_ctrl_group {
+  static constexpr ctrl_t make(size_t idx) noexcept {
+    return idx == 0 ? CTRL_SENTINEL : CTRL_EMPTY;
+  }
+
+  template <size_t... Indices>
+  static constexpr auto make_bytes(index_sequence<Indices...>) noexcept {
+    struct bytes_t {
+      ctrl_t value[Width];
+    };
+    return bytes_t{{make(Indices)...}};
+  }
+
+  static constexpr auto bytes{make_bytes(make_index_sequence<Width>{})};
+};
+
+/*
+ * Open-addressing hash table with SIMD group probing ("Swiss table",
+ * M. Kulukundis, "Designing a Fast, Efficient, Cache-friendly Hash Table",
+ * CppCon 2017).
+ *
+ * Memory layout: [slot, slot, ... slot | ctrl, ctrl, ... ctrl, clones ]
+ *
+ * * Each slot has a control byte: empty, deleted (tombstone), or the lower
+ *   7 bits of the hash (H2) of the element stored in the slot. A lookup
+ *   probes groups of ctrl_group::WIDTH control bytes starting at the position
+ *   given by the rest of the hash (H1) and compares keys only for the bytes
+ *   matching H2. The probing stops at the first group with an empty byte.
+ *
+ * * The sentinel byte after the last slot stops iteration and the first
+ *   WIDTH - 1 control bytes are cloned after it, so a group may be loaded
+ *   from any position without wrapping around.
+ *
+ * The number of slots is 2^n - 1, so it serves as a mask for positions.
+ * Elements are stored in place and never move except on rehash, so value_type
+ * must be nothrow move constructible. Interface is the same as of the flat
+ * variant of Table.
+ */
+template <typename Key,
+          typename Ty,
+          typename Hash,
+          typename KeyEqual,
+          class BytesAllocator,
+          size_t MaxLoadFactor100>
+class swiss_table : public WrapHash<Hash>, public WrapKeyEqual<KeyEqual> {
+ public:
+  static constexpr bool is_flat = true;
+  static constexpr bool is_map = !is_void<Ty>::value;
+  static constexpr bool is_set = !is_map;
+  static constexpr bool is_transparent =
+      has_is_transparent<Hash>::value && has_is_transparent<KeyEqual>::value;
+
+  using key_type = Key;
+  using mapped_type = Ty;
+  using value_type = conditional_t<is_set, Key, pair<Key, Ty>>;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using allocator_type = BytesAllocator;
+  using hash_type = size_t;
+  using Self = swiss_table<Key,
+                           Ty,
+                           Hash,
+                           KeyEqual,
+                           BytesAllocator,
+                           MaxLoadFactor100>;
+
+ private:
+  static_assert(MaxLoadFactor100 > 10 && MaxLoadFactor100 < 100,
+                "MaxLoadFactor100 needs to be >10 && < 100");
+  static_assert(is_nothrow_move_constructible_v<value_type>,
+                "value_type must be nothrow move constructible");
+
+  using WHash = WrapHash<Hash>;
+  using WKeyEqual = WrapKeyEqual<KeyEqual>;
+  using AlBytesTraits = allocator_traits<allocator_type>;
+
+  static constexpr size_t GROUP_WIDTH{ctrl_group::WIDTH};
+  static constexpr size_t CLONED_BYTES{GROUP_WIDTH - 1};
+  static constexpr size_t MIN_CAPACITY{(GROUP_WIDTH << 1) - 1};
+
+  // Triangular probing over groups visits every group of a 2^n table
+  class probe_sequence {
+   public:
+    probe_sequence(size_t hash, size_t mask) noexcept
+        : m_mask{mask}, m_offset{hash & mask} {}
+
+    [[nodiscard]] size_t offset() const noexcept { return m_offset; }
+
+    [[nodiscard]] size_t offset(size_t idx) const noexcept {
+      return (m_offset + idx) & m_mask;
+    }
+
+    void next() noexcept {
+      m_index += GROUP_WIDTH;
+      m_offset = (m_offset + m_index) & m_mask;
+    }
+
+   private:
+    size_t m_mask;
+    size_t m_offset;
+    size_t m_index{0};
+  };
+
+  template <bool IsConst>
+  class Iter {
+   public:
+    using difference_type = ptrdiff_t;
+    using value_type = typename Self::value_type;
+    using reference = conditional_t<IsConst, value_type const&, value_type&>;
+    using pointer = conditional_t<IsConst, value_type const*, value_type*>;
+    using iterator_category = forward_iterator_tag;
+
+    Iter() = default;
+
+    template <bool OtherIsConst,
+              typename = typename enable_if<IsConst && !OtherIsConst>::type>
+    // NOLINTNEXTLINE(hicpp-explicit-conversions)
+    Iter(Iter<OtherIsConst> const& other) noexcept
+        : m_ctrl(other.m_ctrl), m_slot(other.m_slot) {}
+
+    Iter& operator++() noexcept {
+      ++m_ctrl;
+      ++m_slot;
+      skip_free_slots();
+      return *this;
+    }
+
+    Iter operator++(int) noexcept {
+      Iter tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    reference operator*() const { return *m_slot; }
+
+    pointer operator->() const { return m_slot; }
+
+    template <bool O>
+    bool operator==(Iter<O> const& o) const noexcept {
+      return m_ctrl == o.m_ctrl;
+    }
+
+    template <bool O>
+    bool operator!=(Iter<O> const& o) const noexcept {
+      return m_ctrl != o.m_ctrl;
+    }
+
+   private:
+    Iter(const ctrl_t* ctrl, pointer slot) noexcept
+        : m_ctrl{ctrl}, m_slot{slot} {}
+
+    // Stops at a full slot or at the sentinel
+    void skip_free_slots() noexcept {
+      while (*m_ctrl < CTRL_SENTINEL) {
+        const uint32_t shift{
+            ctrl_group{m_ctrl}.count_leading_empty_or_deleted()};
+        m_ctrl += shift;
+        m_slot += shift;
+      }
+    }
+
+    template <bool>
+    friend class Iter;
+    friend class swiss_table;
+
+    const ctrl_t* m_ctrl{nullptr};
+    pointer m_slot{nullptr};
+  };
+
+ public:
+  using iterator = Iter<false>;
+  using const_iterator = Iter<true>;
+
+ public:
+  swiss_table() noexcept(noexcept(Hash()) && noexcept(KeyEqual()))
+      : WHash(), WKeyEqual() {}
+
+  // Nothing is allocated until the first insertion, as in Table
+  explicit swiss_table(
+      [[maybe_unused]] size_t bucket_count,
+      const Hash& h = Hash{},
+      const KeyEqual& equal =
+          KeyEqual{}) noexcept(noexcept(Hash(h)) && noexcept(KeyEqual(equal)))
+      : WHash(h), WKeyEqual(equal) {}
+
+  template <class BytesAlloc>
+  explicit swiss_table(
+      [[maybe_unused]] size_t bucket_count,
+      const Hash& h = Hash{},
+      const KeyEqual& equal = KeyEqual{},
+      BytesAlloc&& alloc =
+          BytesAlloc{}) noexcept(noexcept(Hash(h)) && noexcept(KeyEqual(equal)))
+      : WHash(h), WKeyEqual(equal), m_alc(forward<BytesAlloc>(alloc)) {}
+
+  template <typename InputIt>
+  swiss_table(InputIt first,
+              InputIt last,
+              [[maybe_unused]] size_t bucket_count = 0,
+              const Hash& h = Hash{},
+              const KeyEqual& equal = KeyEqual{})
+      : WHash(h), WKeyEqual(equal) {
+    insert_range_or_destroy(first, last);
+  }
+
+  template <typename InputIt, class BytesAlloc>
+  swiss_table(InputIt first,
+              InputIt last,
+              [[maybe_unused]] size_t bucket_count = 0,
+              const Hash& h = Hash{},
+              const KeyEqual& equal = KeyEqual{},
+              BytesAlloc&& alloc = BytesAlloc{})
+      : WHash(h), WKeyEqual(equal), m_alc(forward<BytesAlloc>(alloc)) {
+    insert_range_or_destroy(first, last);
+  }
+
+  swiss_table(swiss_table&& other) noexcept
+      : WHash(move(static_cast<WHash&>(other))),
+        WKeyEqual(move(static_cast<WKeyEqual&>(other))),
+        m_alc(move(other.m_alc)) {
+    steal(other);
+  }
+
+  swiss_table& operator=(swiss_table&& other) noexcept {
+    if (this != addressof(other)) {
+      destroy();
+      WHash::operator=(move(static_cast<WHash&>(other)));
+      WKeyEqual::operator=(move(static_cast<WKeyEqual&>(other)));
+      m_alc = move(other.m_alc);
+      steal(other);
+    }
+    return *this;
+  }
+
+  swiss_table(const swiss_table& other)
+      : WHash(static_cast<const WHash&>(other)),
+        WKeyEqual(static_cast<const WKeyEqual&>(other)),
+        m_alc(AlBytesTraits::select_on_container_copy_construction(
+            other.m_alc)) {
+    reserve(other.size());
+    insert_range_or_destroy(other.begin(), other.end());
+  }
+
+  // NOLINTNEXTLINE(bugprone-unhandled-self-assignment,cert-oop54-cpp)
+  swiss_table& operator=(const swiss_table& other) {
+    if (this != addressof(other)) {
+      swiss_table tmp{other};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  ~swiss_table() noexcept { destroy(); }
+
+  void swap(swiss_table& other) noexcept {
+    using ktl::swap;
+    swap(static_cast<WHash&>(*this), static_cast<WHash&>(other));
+    swap(static_cast<WKeyEqual&>(*this), static_cast<WKeyEqual&>(other));
+    swap(m_alc, other.m_alc);
+    swap(m_slots, other.m_slots);
+    swap(m_ctrl, other.m_ctrl);
+    swap(m_size, other.m_size);
+    swap(m_capacity, other.m_capacity);
+    swap(m_growth_left, other.m_growth_left);
+  }
+
+  // Destroys all elements, keeping the storage
+  void clear() noexcept {
+    if (!m_capacity) {
+      return;
+    }
+    destroy_slots();
+    reset_ctrl();
+    m_size = 0;
+    m_growth_left = calc_max_size(m_capacity);
+  }
+
+  bool operator==(const swiss_table& other) const {
+    if (other.size() != size()) {
+      return false;
+    }
+    for (const auto& entry : other) {
+      if (!has(entry)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator!=(const swiss_table& other) const {
+    return !operator==(other);
+  }
+
+  template <typename Q = mapped_type>
+  typename enable_if<!is_void<Q>::value, Q&>::type operator[](
+      const key_type& key) {
+    return try_emplace_impl(key).first->second;
+  }
+
+  template <typename Q = mapped_type>
+  typename enable_if<!is_void<Q>::value, Q&>::type operator[](key_type&& key) {
+    return try_emplace_impl(move(key)).first->second;
+  }
+
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(value_type(*first));
+    }
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> emplace(Args&&... args) {
+    value_type value(forward<Args>(args)...);
+    return insert(move(value));
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    return try_emplace_impl(key, forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+    return try_emplace_impl(move(key), forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace([[maybe_unused]] const_iterator hint,
+                                   const key_type& key,
+                                   Args&&... args) {
+    return try_emplace_impl(key, forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  pair<iterator, bool> try_emplace([[maybe_unused]] const_iterator hint,
+                                   key_type&& key,
+                                   Args&&... args) {
+    return try_emplace_impl(move(key), forward<Args>(args)...);
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign(const key_type& key, Mapped&& obj) {
+    return insert_or_assign_impl(key, forward<Mapped>(obj));
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign(key_type&& key, Mapped&& obj) {
+    return insert_or_assign_impl(move(key), forward<Mapped>(obj));
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign([[maybe_unused]] const_iterator hint,
+                                        const key_type& key,
+                                        Mapped&& obj) {
+    return insert_or_assign_impl(key, forward<Mapped>(obj));
+  }
+
+  template <typename Mapped>
+  pair<iterator, bool> insert_or_assign([[maybe_unused]] const_iterator hint,
+                                        key_type&& key,
+                                        Mapped&& obj) {
+    return insert_or_assign_impl(move(key), forward<Mapped>(obj));
+  }
+
+  pair<iterator, bool> insert(const value_type& keyval) {
+    return insert_impl(keyval);
+  }
+
+  pair<iterator, bool> insert(value_type&& keyval) {
+    return insert_impl(move(keyval));
+  }
+
+  // Returns 1 if key is found, 0 otherwise.
+  size_t count(const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return find_index(key) != m_capacity ? 1 : 0;
+  }
+
+  template <typename OtherKey, typename MySelf = Self>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<MySelf::is_transparent, size_t>::type count(
+      const OtherKey& key) const {
+    return find_index(key) != m_capacity ? 1 : 0;
+  }
+
+  bool contains(const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return bool_cast(count(key));
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<Self_::is_transparent, bool>::type contains(
+      const OtherKey& key) const {
+    return bool_cast(count(key));
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <typename Q = mapped_type>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<!is_void<Q>::value, Q&>::type at(key_type const& key) {
+    const size_t idx{find_index(key)};
+    if (idx == m_capacity) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return m_slots[idx].second;
+  }
+
+  // Throws out_of_range if element cannot be found
+  template <typename Q = mapped_type>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<!is_void<Q>::value, Q const&>::type at(
+      key_type const& key) const {
+    const size_t idx{find_index(key)};
+    if (idx == m_capacity) {
+      throw_exception<out_of_range>("key not found");
+    }
+    return m_slots[idx].second;
+  }
+
+  const_iterator find(
+      const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return make_iterator(find_index(key));
+  }
+
+  template <typename OtherKey>
+  const_iterator find(const OtherKey& key,
+                      is_transparent_tag /*unused*/) const {
+    return make_iterator(find_index(key));
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  typename enable_if<Self_::is_transparent,  // NOLINT(modernize-use-nodiscard)
+                     const_iterator>::type   // NOLINT(modernize-use-nodiscard)
+  find(const OtherKey& key) const {          // NOLINT(modernize-use-nodiscard)
+    return make_iterator(find_index(key));
+  }
+
+  iterator find(const key_type& key) {
+    return make_iterator(find_index(key));
+  }
+
+  template <typename OtherKey>
+  iterator find(const OtherKey& key, is_transparent_tag /*unused*/) {
+    return make_iterator(find_index(key));
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  typename enable_if<Self_::is_transparent, iterator>::type find(
+      const OtherKey& key) {
+    return make_iterator(find_index(key));
+  }
+
+  // Returns the hash used by the table for the key. It doesn't depend on the
+  // table state, so it may be computed once and reused across rehashes.
+  hash_type hash_key(
+      const key_type& key) const {  // NOLINT(modernize-use-nodiscard)
+    return hash_key_impl(key);
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  // NOLINTNEXTLINE(modernize-use-nodiscard)
+  typename enable_if<Self_::is_transparent, hash_type>::type hash_key(
+      const OtherKey& key) const {
+    return hash_key_impl(key);
+  }
+
+  // Same as find(), but with the hash obtained from hash_key()
+  const_iterator find_with_hash(
+      const key_type& key,
+      hash_type hash) const {  // NOLINT(modernize-use-nodiscard)
+    return make_iterator(find_index(key, hash));
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  typename enable_if<Self_::is_transparent,  // NOLINT(modernize-use-nodiscard)
+                     const_iterator>::type   // NOLINT(modernize-use-nodiscard)
+  find_with_hash(const OtherKey& key, hash_type hash) const {
+    return make_iterator(find_index(key, hash));
+  }
+
+  iterator find_with_hash(const key_type& key, hash_type hash) {
+    return make_iterator(find_index(key, hash));
+  }
+
+  template <typename OtherKey, typename Self_ = Self>
+  typename enable_if<Self_::is_transparent, iterator>::type find_with_hash(
+      const OtherKey& key,
+      hash_type hash) {
+    return make_iterator(find_index(key, hash));
+  }
+
+  // Stores find(keys[i]) to out[i] for each of count keys. The first groups
+  // are prefetched in batches, so lookups of the batch don't wait for each
+  // other.
+  void find_many(const key_type* keys,
+                 size_t count,
+                 const_iterator* out) const {
+    find_many_impl(keys, count, [this, out](size_t pos, size_t idx) {
+      out[pos] = make_iterator(idx);
+    });
+  }
+
+  void find_many(const key_type* keys, size_t count, iterator* out) {
+    find_many_impl(keys, count, [this, out](size_t pos, size_t idx) {
+      out[pos] = make_iterator(idx);
+    });
+  }
+
+  iterator begin() {
+    iterator it{m_ctrl, m_slots};
+    it.skip_free_slots();
+    return it;
+  }
+  const_iterator begin() const {  // NOLINT(modernize-use-nodiscard)
+    return cbegin();
+  }
+  const_iterator cbegin() const {  // NOLINT(modernize-use-nodiscard)
+    const_iterator it{m_ctrl, m_slots};
+    it.skip_free_slots();
+    return it;
+  }
+
+  iterator end() { return make_iterator(m_capacity); }
+  const_iterator end() const {  // NOLINT(modernize-use-nodiscard)
+    return cend();
+  }
+  const_iterator cend() const {  // NOLINT(modernize-use-nodiscard)
+    return make_iterator(m_capacity);
+  }
+
+  iterator erase(const_iterator pos) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    return erase(iterator{pos.m_ctrl, const_cast<value_type*>(pos.m_slot)});
+  }
+
+  // Erases element at pos, returns iterator to the next element.
+  iterator erase(iterator pos) {
+    erase_at(static_cast<size_t>(pos.m_ctrl - m_ctrl));
+    return ++pos;
+  }
+
+  size_t erase(const key_type& key) {
+    const size_t idx{find_index(key)};
+    if (idx == m_capacity) {
+      return 0;
+    }
+    erase_at(idx);
+    return 1;
+  }
+
+  // Rebuilds the table for the specified number of elements (but not less
+  // than size()), dropping the tombstones. Use rehash(0) to shrink to fit.
+  void rehash(size_t count) {
+    if (count == 0 && m_size == 0) {
+      destroy();
+      init();
+      return;
+    }
+    resize(calc_capacity((max)(count, m_size)));
+  }
+
+  // Makes sure that count elements fit without rehashing
+  void reserve(size_t count) {
+    if (count > m_size + m_growth_left) {
+      resize(calc_capacity(count));
+    }
+  }
+
+  size_type size() const noexcept {  // NOLINT(modernize-use-nodiscard)
+    return m_size;
+  }
+
+  size_type max_size() const noexcept {  // NOLINT(modernize-use-nodiscard)
+    return static_cast<size_type>(-1);
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return !bool_cast(m_size); }
+
+  [[nodiscard]] size_t mask() const noexcept { return m_capacity; }
+
+ private:
+  template <typename Q = mapped_type>
+  [[nodiscard]] typename enable_if<!is_void<Q>::value, bool>::type has(
+      const value_type& e) const {
+    auto it = find(e.first);
+    return it != end() && it->second == e.second;
+  }
+
+  template <typename Q = mapped_type>
+  [[nodiscard]] typename enable_if<is_void<Q>::value, bool>::type has(
+      const value_type& e) const {
+    return find(e) != end();
+  }
+
+  [[nodiscard]] static const key_type& get_key(
+      const value_type& value) noexcept {
+    if constexpr (is_map) {
+      return value.first;
+    } else {
+      return value;
+    }
+  }
+
+  template <typename HashKey>
+  [[nodiscard]] size_t hash_key_impl(const HashKey& key) const {
+    // Hashes other than ktl::hash are mixed as in Table
+    using Mix = typename conditional<is_same_v<hash<key_type>, hasher>,
+                                     identity_hash<size_t>, hash<size_t>>::type;
+    return Mix{}(WHash::operator()(key));
+  }
+
+  [[nodiscard]] static size_t get_h1(size_t hash) noexcept { return hash >> 7; }
+
+  [[nodiscard]] static ctrl_t get_h2(size_t hash) noexcept {
+    return static_cast<ctrl_t>(hash & 0x7F);
+  }
+
+  iterator make_iterator(size_t idx) noexcept {
+    return iterator{m_ctrl + idx, m_slots + idx};
+  }
+
+  const_iterator make_iterator(size_t idx) const noexcept {
+    return const_iterator{m_ctrl + idx, m_slots + idx};
+  }
+
+  // Returns m_capacity if the key isn't found
+  template <typename OtherKey>
+  [[nodiscard]] size_t find_index(const OtherKey& key) const {
+    return find_index(key, hash_key_impl(key));
+  }
+
+  template <typename OtherKey>
+  [[nodiscard]] size_t find_index(const OtherKey& key, size_t hash) const {
+    probe_sequence seq{get_h1(hash), m_capacity};
+    for (;;) {
+      const ctrl_group group{m_ctrl + seq.offset()};
+      for (const uint32_t idx : group.match(get_h2(hash))) {
+        const size_t candidate{seq.offset(idx)};
+        if (WKeyEqual::operator()(key, get_key(m_slots[candidate]))) {
+          return candidate;
+        }
+      }
+      if (group.match_empty()) {
+        return m_capacity;
+      }
+      seq.next();
+    }
+  }
+
+  template <typename OtherKey, typename Fn>
+  void find_many_impl(const OtherKey* keys, size_t count, Fn&& fn) const {
+    constexpr size_t BATCH_SIZE{16};
+
+    size_t hashes[BATCH_SIZE];
+    for (size_t first = 0; first < count; first += BATCH_SIZE) {
+      const size_t batch{(min)(count - first, BATCH_SIZE)};
+      for (size_t idx = 0; idx < batch; ++idx) {
+        hashes[idx] = hash_key_impl(keys[first + idx]);
+        const size_t offset{get_h1(hashes[idx]) & m_capacity};
+        prefetch(m_ctrl + offset);
+        prefetch(m_slots + offset);
+      }
+      for (size_t idx = 0; idx < batch; ++idx) {
+        fn(first + idx, find_index(keys[first + idx], hashes[idx]));
+      }
+    }
+  }
+
+  [[nodiscard]] size_t find_first_non_full(size_t hash) const noexcept {
+    probe_sequence seq{get_h1(hash), m_capacity};
+    for (;;) {
+      if (const auto mask = ctrl_group{m_ctrl + seq.offset()}
+                                .match_empty_or_deleted();
+          mask) {
+        return seq.offset(mask.lowest());
+      }
+      seq.next();
+    }
+  }
+
+  // Returns a free slot for the hash, growing the table if needed. The slot
+  // is committed by commit_insert() after the element is constructed
+  size_t prepare_insert(size_t hash) {
+    size_t idx{find_first_non_full(hash)};
+    if (m_growth_left == 0 && m_ctrl[idx] != CTRL_DELETED) {
+      if (m_capacity && m_size <= calc_max_size(m_capacity) / 2) {
+        resize(m_capacity);  // Too many tombstones
+      } else {
+        resize(m_capacity ? m_capacity * 2 + 1 : MIN_CAPACITY);
+      }
+      idx = find_first_non_full(hash);
+    }
+    return idx;
+  }
+
+  void commit_insert(size_t idx, size_t hash) noexcept {
+    m_growth_left -= m_ctrl[idx] == CTRL_EMPTY ? 1 : 0;
+    set_ctrl(idx, get_h2(hash));
+    ++m_size;
+  }
+
+  template <typename Arg>
+  pair<iterator, bool> insert_impl(Arg&& keyval) {
+    const key_type& key{get_key(keyval)};
+    const size_t hash{hash_key_impl(key)};
+    if (const size_t found = find_index(key, hash); found != m_capacity) {
+      return {make_iterator(found), false};
+    }
+    const size_t idx{prepare_insert(hash)};
+    construct_at(m_slots + idx, forward<Arg>(keyval));
+    commit_insert(idx, hash);
+    return {make_iterator(idx), true};
+  }
+
+  template <typename OtherKey, typename... Args>
+  pair<iterator, bool> try_emplace_impl(OtherKey&& key, Args&&... args) {
+    const size_t hash{hash_key_impl(key)};
+    if (const size_t found = find_index(key, hash); found != m_capacity) {
+      return {make_iterator(found), false};
+    }
+    const size_t idx{prepare_insert(hash)};
+    if constexpr (is_map) {
+      construct_at(m_slots + idx, piecewise_construct,
+                   forward_as_tuple(forward<OtherKey>(key)),
+                   forward_as_tuple(forward<Args>(args)...));
+    } else {
+      construct_at(m_slots + idx, forward<OtherKey>(key));
+    }
+    commit_insert(idx, hash);
+    return {make_iterator(idx), true};
+  }
+
+  template <typename OtherKey, typename Mapped>
+  pair<iterator, bool> insert_or_assign_impl(OtherKey&& key, Mapped&& obj) {
+    auto it = find(key);
+    if (it == end()) {
+      return try_emplace_impl(forward<OtherKey>(key), forward<Mapped>(obj));
+    }
+    it->second = forward<Mapped>(obj);
+    return {it, false};
+  }
+
+  template <typename InputIt>
+  void insert_range_or_destroy(InputIt first, InputIt last) {
+    try {
+      insert(first, last);
+    } catch (...) {
+      destroy();
+      throw;
+    }
+  }
+
+  void erase_at(size_t idx) noexcept {
+    destroy_at(m_slots + idx);
+    --m_size;
+
+    // The slot may become empty if no probe sequence could have passed
+    // through it, i.e. there was an empty slot in every group containing it
+    const size_t idx_before{(idx - GROUP_WIDTH) & m_capacity};
+    const auto empty_after{ctrl_group{m_ctrl + idx}.match_empty()};
+    const auto empty_before{ctrl_group{m_ctrl + idx_before}.match_empty()};
+    const bool was_never_full{empty_before && empty_after &&
+                              empty_after.trailing_zeros() +
+                                      empty_before.leading_zeros() <
+                                  GROUP_WIDTH};
+    set_ctrl(idx, was_never_full ? CTRL_EMPTY : CTRL_DELETED);
+    m_growth_left += was_never_full ? 1 : 0;
+  }
+
+  void set_ctrl(size_t idx, ctrl_t value) noexcept {
+    m_ctrl[idx] = value;
+    m_ctrl[((idx - CLONED_BYTES) & m_capacity) + CLONED_BYTES] = value;
+  }
+
+  void reset_ctrl() noexcept {
+    memset(m_ctrl, static_cast<uint8_t>(CTRL_EMPTY),
+           m_capacity + GROUP_WIDTH);
+    m_ctrl[m_capacity] = CTRL_SENTINEL;
+  }
+
+  // Moves all elements into a new storage with the specified capacity
+  void resize(size_t capacity) {
+    value_type* const old_slots{m_slots};
+    ctrl_t* const old_ctrl{m_ctrl};
+    const size_t old_capacity{m_capacity};
+
+    allocate(capacity);
+    m_growth_left = calc_max_size(m_capacity) - m_size;
+    for (size_t idx = 0; idx < old_capacity; ++idx) {
+      if (is_full(old_ctrl[idx])) {
+        value_type& value{old_slots[idx]};
+        const size_t hash{hash_key_impl(get_key(value))};
+        const size_t target{find_first_non_full(hash)};
+        construct_at(m_slots + target, move(value));
+        destroy_at(addressof(value));
+        set_ctrl(target, get_h2(hash));
+      }
+    }
+    if (old_capacity) {
+      deallocate(old_slots, old_capacity);
+    }
+  }
+
+  void allocate(size_t capacity) {
+    auto* const buffer{AlBytesTraits::allocate_bytes(
+        m_alc, calc_bytes_count(capacity))};
+    m_slots = reinterpret_cast<value_type*>(buffer);
+    m_ctrl = reinterpret_cast<ctrl_t*>(m_slots + capacity);
+    m_capacity = capacity;
+    reset_ctrl();
+  }
+
+  void deallocate(value_type* slots, size_t capacity) noexcept {
+    AlBytesTraits::deallocate_bytes(m_alc, slots, calc_bytes_count(capacity));
+  }
+
+  void destroy_slots() noexcept {
+    if constexpr (!is_trivially_destructible_v<value_type>) {
+      for (size_t idx = 0; idx < m_capacity; ++idx) {
+        if (is_full(m_ctrl[idx])) {
+          destroy_at(m_slots + idx);
+        }
+      }
+    }
+  }
+
+  void destroy() noexcept {
+    if (m_capacity) {
+      destroy_slots();
+      deallocate(m_slots, m_capacity);
+    }
+  }
+
+  void init() noexcept {
+    m_slots = nullptr;
+    m_ctrl = get_empty_ctrl();
+    m_size = 0;
+    m_capacity = 0;
+    m_growth_left = 0;
+  }
+
+  void steal(swiss_table& other) noexcept {
+    m_slots = other.m_slots;
+    m_ctrl = other.m_ctrl;
+    m_size = other.m_size;
+    m_capacity = other.m_capacity;
+    m_growth_left = other.m_growth_left;
+    other.init();
+  }
+
+  [[nodiscard]] static size_t calc_max_size(size_t capacity) noexcept {
+    if (capacity <= (numeric_limits<size_t>::max)() / 100) {
+      return capacity * MaxLoadFactor100 / 100;
+    }
+    return (capacity / 100) * MaxLoadFactor100;
+  }
+
+  [[nodiscard]] static size_t calc_capacity(size_t element_count) {
+    size_t capacity{MIN_CAPACITY};
+    while (calc_max_size(capacity) < element_count) {
+      if (capacity > (numeric_limits<size_t>::max)() / 2) {
+        throw_exception<overflow_error>("swiss table overflow");
+      }
+      capacity = capacity * 2 + 1;
+    }
+    return capacity;
+  }
+
+  [[nodiscard]] static size_t calc_bytes_count(size_t capacity) {
+    const size_t ctrl_bytes{capacity + GROUP_WIDTH};
+    if (capacity > ((numeric_limits<size_t>::max)() - ctrl_bytes) /
+                       sizeof(value_type)) {
+      throw_exception<overflow_error>("swiss table overflow");
+    }
+    return capacity * sizeof(value_type) + ctrl_bytes;
+  }
+
+  [[nodiscard]] static ctrl_t* get_empty_ctrl() noexcept {
+    // Never written: tables without storage have zero capacity
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+    return const_cast<ctrl_t*>(empty_ctrl_group<GROUP_WIDTH>::bytes.value);
+  }
+
+ private:
+  allocator_type m_alc{};
+  value_type* m_slots{nullptr};
+  ctrl_t* m_ctrl{get_empty_ctrl()};
+  size_t m_size{0};
+  size_t m_capacity{0};
+  size_t m_growth_left{0};
+};
+
+template <typename Key,
+          typename Ty,
+          typename Hash,
+          typename KeyEqual,
+          class BytesAllocator,
+          size_t MaxLoadFactor100>
+void swap(
+    swiss_table<Key, Ty, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>&
+        lhs,
+    swiss_table<Key, Ty, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>&
+        rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace un::details
+}  // namespace ktl
@@ -132,6 +132,19 @@ template <class InputIt, class OutputIt>
 struct is_memcpyable_range
     : bool_constant<is_memcpyable_range_v<InputIt, OutputIt>> {};
 
+// An object of a trivially relocatable type may be moved to another place
+// with memcpy() instead of a move construction followed by a destruction.
+// Specialize it for the types which don't store pointers to themselves
+template <class Ty>
+struct is_trivially_relocatable : is_memcpyable<Ty> {};
+
+template <class Ty>
+struct is_trivially_relocatable<const Ty> : is_trivially_relocatable<Ty> {};
+
+template <class Ty>
+inline constexpr bool is_trivially_relocatable_v =
+    is_trivially_relocatable<Ty>::value;
+
 #define INVOKE_EXPR \
   fn::details::invoker<Fn>::invoke(declval<Fn>(), declval<Types>()...)
 
@@ -199,4 +212,9 @@ inline constexpr bool is_nothrow_invocable_r_v =
     is_nothrow_invocable_r<void_t<>, Ret, Fn, Types...>::value;
 
 #undef INVOKE_EXPR
+
+// The builtin is provided by MSVC, Clang and GCC in all language modes
+[[nodiscard]] constexpr bool is_constant_evaluated() noexcept {
+  return __builtin_is_constant_evaluated();
+}
 }  // namespace ktl
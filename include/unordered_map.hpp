@@ -1,7 +1,10 @@
 ﻿#pragma once
 #include <basic_types.hpp>
+#include <frozen_table_impl.hpp>
 #include <hash.hpp>
 #include <hash_table_impl.hpp>
+#include <incremental_table_impl.hpp>
+#include <swiss_table_impl.hpp>
 
 namespace ktl {
 
@@ -23,6 +26,96 @@ template <class Key,
 using unordered_flat_map_non_paged = un::details::
     Table<true, Key, Ty, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
 
+// Flat map with SIMD group probing; see swiss_table for details
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80>
+using unordered_swiss_map = un::details::
+    swiss_table<Key, Ty, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80>
+using unordered_swiss_map_non_paged = un::details::
+    swiss_table<Key, Ty, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
+
+// Flat map which spreads rehashing over the following insertions and erasures
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80,
+          size_t MigrationStep = 4>
+using unordered_incremental_map =
+    un::details::incremental_table<Key,
+                                   Ty,
+                                   Hash,
+                                   KeyEqual,
+                                   BytesAllocator,
+                                   MaxLoadFactor100,
+                                   MigrationStep>;
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80,
+          size_t MigrationStep = 4>
+using unordered_incremental_map_non_paged =
+    un::details::incremental_table<Key,
+                                   Ty,
+                                   Hash,
+                                   KeyEqual,
+                                   BytesAllocator,
+                                   MaxLoadFactor100,
+                                   MigrationStep>;
+
+// Immutable map with a perfect hash; see frozen_table for details
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>>
+using frozen_map =
+    un::details::frozen_table<Key, Ty, Hash, KeyEqual, BytesAllocator>;
+
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>>
+using frozen_map_non_paged =
+    un::details::frozen_table<Key, Ty, Hash, KeyEqual, BytesAllocator>;
+
+template <class Key,
+          class Ty,
+          size_t N,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>>
+using fixed_frozen_map =
+    un::details::fixed_frozen_table<Key, Ty, N, Hash, KeyEqual>;
+
+// constexpr auto map{make_frozen_map<int, char>({{1, 'a'}, {2, 'b'}})};
+template <class Key,
+          class Ty,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          size_t N>
+constexpr fixed_frozen_map<Key, Ty, N, Hash, KeyEqual> make_frozen_map(
+    const pair<Key, Ty> (&values)[N],
+    const Hash& h = Hash{},
+    const KeyEqual& equal = KeyEqual{}) {
+  return fixed_frozen_map<Key, Ty, N, Hash, KeyEqual>(values, h, equal);
+}
+
 template <class Key,
           class Ty,
           class Hash = hash<Key>,
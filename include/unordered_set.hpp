@@ -1,7 +1,10 @@
 ﻿#pragma once
 #include <basic_types.hpp>
+#include <frozen_table_impl.hpp>
 #include <hash.hpp>
 #include <hash_table_impl.hpp>
+#include <incremental_table_impl.hpp>
+#include <swiss_table_impl.hpp>
 
 namespace ktl {
 template <class Key,
@@ -20,6 +23,54 @@ template <class Key,
 using unordered_flat_set_non_paged = un::details::
     Table<true, Key, void, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
 
+// Flat set with SIMD group probing; see swiss_table for details
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80>
+using unordered_swiss_set = un::details::
+    swiss_table<Key, void, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
+
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80>
+using unordered_swiss_set_non_paged = un::details::
+    swiss_table<Key, void, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
+
+// Flat set which spreads rehashing over the following insertions and erasures
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80,
+          size_t MigrationStep = 4>
+using unordered_incremental_set =
+    un::details::incremental_table<Key,
+                                   void,
+                                   Hash,
+                                   KeyEqual,
+                                   BytesAllocator,
+                                   MaxLoadFactor100,
+                                   MigrationStep>;
+
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>,
+          size_t MaxLoadFactor100 = 80,
+          size_t MigrationStep = 4>
+using unordered_incremental_set_non_paged =
+    un::details::incremental_table<Key,
+                                   void,
+                                   Hash,
+                                   KeyEqual,
+                                   BytesAllocator,
+                                   MaxLoadFactor100,
+                                   MigrationStep>;
+
 template <class Key,
           class Hash = hash<Key>,
           class KeyEqual = equal_to<Key>,
@@ -36,6 +87,40 @@ template <class Key,
 using unordered_node_set_non_paged = un::details::
     Table<false, Key, void, Hash, KeyEqual, BytesAllocator, MaxLoadFactor100>;
 
+// Immutable set with a perfect hash; see frozen_table for details
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_paged_allocator<byte>>
+using frozen_set =
+    un::details::frozen_table<Key, void, Hash, KeyEqual, BytesAllocator>;
+
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          class BytesAllocator = basic_non_paged_allocator<byte>>
+using frozen_set_non_paged =
+    un::details::frozen_table<Key, void, Hash, KeyEqual, BytesAllocator>;
+
+template <class Key,
+          size_t N,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>>
+using fixed_frozen_set =
+    un::details::fixed_frozen_table<Key, void, N, Hash, KeyEqual>;
+
+// constexpr auto set{make_frozen_set({1, 2, 3})};
+template <class Key,
+          class Hash = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          size_t N>
+constexpr fixed_frozen_set<Key, N, Hash, KeyEqual> make_frozen_set(
+    const Key (&values)[N],
+    const Hash& h = Hash{},
+    const KeyEqual& equal = KeyEqual{}) {
+  return fixed_frozen_set<Key, N, Hash, KeyEqual>(values, h, equal);
+}
+
 template <class Key,
           class Hash = hash<Key>,
           class KeyEqual = equal_to<Key>,
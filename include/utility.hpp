@@ -242,7 +242,7 @@ constexpr bool bool_cast(Ty&& val) noexcept(
 }
 
 template <typename T>
-T rotr(T x, unsigned k) {
+constexpr T rotr(T x, unsigned k) noexcept {
   return (x >> k) | (x << (8U * sizeof(T) - k));
 }
 
@@ -19,8 +19,169 @@ using std::vector;
 #include <utility.hpp>
 
 namespace ktl {
+namespace vec::details {
+template <class Ty, class Allocator>
+struct growth_policies {
+  using value_type = Ty;
+  using allocator_type = Allocator;
+  using allocator_traits_type = allocator_traits<allocator_type>;
+  using pointer = typename allocator_traits_type::pointer;
+  using size_type = typename allocator_traits_type::size_type;
+
+  // Trivially relocatable objects are transferred by memmove() and the old
+  // buffer isn't touched after that
+  static constexpr bool relocates_trivially{
+      mm::details::enable_relocation_without_allocator_v<value_type,
+                                                         allocator_type>};
+
+  static constexpr auto make_dummy_construct_helper() {
+    return []([[maybe_unused]] allocator_type& alloc,
+              [[maybe_unused]] pointer buffer,
+              size_t old_size) { return old_size; };
+  }
+
+  static constexpr auto make_construct_at_helper(size_type pos) {
+    return [pos](allocator_type& alloc, pointer buffer, auto&&... args) {
+      allocator_traits_type::construct(alloc, buffer + pos,
+                                       forward<decltype(args)>(args)...);
+      return 1u;
+    };
+  }
+
+  static constexpr auto make_range_construct_helper(size_type pos) {
+    return [pos](allocator_type& alloc, pointer buffer, auto first,
+                 size_type count) {
+      uninitialized_copy_n_unchecked(first, count, buffer + pos, alloc);
+      return count;
+    };
+  }
+
+  static constexpr auto make_default_construct_helper(size_type pos) {
+    return [pos](allocator_type& alloc, pointer buffer, size_type count) {
+      uninitialized_default_construct_n(buffer + pos, count, alloc);
+      return count;
+    };
+  }
+
+  static constexpr auto make_construct_fill_helper(size_type pos) {
+    return [pos](allocator_type& alloc, pointer buffer, const Ty& value,
+                 size_t count) {
+      uninitialized_fill_n(buffer + pos, count, value, alloc);
+      return count;
+    };
+  }
+
+  static constexpr auto make_cloner() noexcept {
+    return [](allocator_type& alloc, pointer dst, const auto& other) noexcept {
+      const size_type object_count{other.size()};
+      uninitialized_copy_n_unchecked(other.data(), object_count, dst, alloc);
+      return object_count;
+    };
+  }
+
+  static constexpr auto make_taker() noexcept {
+    return [](allocator_type& alloc, pointer dst, auto&& other) noexcept {
+      const size_type object_count{other.size()};
+      uninitialized_move_n_unchecked(other.data(), object_count, dst, alloc);
+      return object_count;
+    };
+  }
+
+  // Transfer policies return the number of objects which are left alive in
+  // the source buffer and must be destroyed by the caller
+  static constexpr auto make_transfer_without_shift() noexcept {
+    if constexpr (relocates_trivially) {
+      return [](allocator_type& alloc, pointer dst, size_type count,
+                const pointer src) noexcept -> size_type {
+        uninitialized_relocate_n(src, count, dst, alloc);
+        return 0;
+      };
+    } else if constexpr (is_nothrow_move_constructible_v<value_type> ||
+                         !is_copy_constructible_v<value_type>) {
+      return [](allocator_type& alloc, pointer dst, size_type count,
+                const pointer src) {
+        uninitialized_move_n_unchecked(src, count, dst, alloc);
+        return count;
+      };
+    } else {
+      return [](allocator_type& alloc, pointer dst, size_type count,
+                const pointer src) {
+        uninitialized_copy_n_unchecked(src, count, dst, alloc);
+        return count;
+      };
+    }
+  }
+
+  static constexpr auto make_transfer_with_shift_right(
+      size_type left_bound,
+      size_type right_bound) noexcept {
+    return [left_bound, right_bound](allocator_type& alloc, pointer dst,
+                                     size_type count, const pointer src) {
+      return make_transfer_without_shift()(alloc, dst, left_bound, src) +
+             make_transfer_without_shift()(alloc, dst + right_bound,
+                                           count - left_bound,
+                                           src + left_bound);
+    };
+  }
+
+  static constexpr auto make_dummy_transfer() noexcept {
+    return []([[maybe_unused]] allocator_type& alloc,
+              [[maybe_unused]] pointer dst, size_type count,
+              [[maybe_unused]] const pointer src) noexcept { return count; };
+  }
+
+  // Relocates the tail of the buffer to make room for count objects at the
+  // offset and constructs them there. The tail is returned back on failure
+  template <class ConstructPolicy, class... Types>
+  static void relocate_and_construct(allocator_type& alloc,
+                                     pointer buffer,
+                                     size_type size,
+                                     size_type offset,
+                                     size_type count,
+                                     ConstructPolicy construction_handler,
+                                     Types&&... args) {
+    pointer gap{buffer + offset};
+    const size_type tail_length{size - offset};
+    uninitialized_relocate_n(gap, tail_length, gap + count, alloc);
+    try {
+      construction_handler(alloc, buffer, forward<Types>(args)...);
+    } catch (...) {
+      uninitialized_relocate_n(gap + count, tail_length, gap, alloc);
+      throw;
+    }
+  }
+
+  // Destroys count objects at the offset and relocates the tail in their place
+  static void destroy_and_relocate(allocator_type& alloc,
+                                   pointer buffer,
+                                   size_type size,
+                                   size_type offset,
+                                   size_type count) noexcept {
+    pointer gap{buffer + offset};
+    destroy_n(gap, count, alloc);
+    uninitialized_relocate_n(gap + count, size - offset - count, gap, alloc);
+  }
+
+  static pointer allocate_buffer(allocator_type& alc, size_type obj_count) {
+    return allocator_traits_type::allocate(alc, obj_count);
+  }
+
+  static void deallocate_buffer(allocator_type& alc,
+                                pointer buffer,
+                                size_type obj_count) noexcept {
+    if constexpr (allocator_traits_type::enable_delete_null::value) {
+      allocator_traits_type::deallocate(alc, buffer, obj_count);
+    } else {
+      if (buffer) {
+        allocator_traits_type::deallocate(alc, buffer, obj_count);
+      }
+    }
+  }
+};
+}  // namespace vec::details
+
 template <class Ty, class Allocator = basic_paged_allocator<Ty> >
-class vector {
+class vector : private vec::details::growth_policies<Ty, Allocator> {
  public:
   using value_type = Ty;
 
@@ -36,6 +197,21 @@ class vector {
   using const_iterator = const_pointer;
 
  private:
+  using policies = vec::details::growth_policies<Ty, Allocator>;
+
+  using policies::allocate_buffer;
+  using policies::deallocate_buffer;
+  using policies::make_cloner;
+  using policies::make_construct_at_helper;
+  using policies::make_construct_fill_helper;
+  using policies::make_default_construct_helper;
+  using policies::make_dummy_construct_helper;
+  using policies::make_dummy_transfer;
+  using policies::make_range_construct_helper;
+  using policies::make_taker;
+  using policies::make_transfer_with_shift_right;
+  using policies::make_transfer_without_shift;
+
   struct Impl {
     constexpr explicit Impl() noexcept = default;
 
@@ -311,16 +487,19 @@ class vector {
       grow<true>(
           calc_optimal_growth(required), make_construct_fill_helper(offset),
           make_transfer_with_shift_right(offset, offset + count), value, count);
+    } else if (pos == end()) {
+      append_n_without_grow(count, value);
     } else {
-      if (pos == end()) {
-        append_n_without_grow(value, count);
+      Ty tmp{value};  // It's required to construct value to avoid moved-from
+                      // state aster shift
+      if constexpr (policies::relocates_trivially) {
+        insert_relocating(offset, count, make_construct_fill_helper(offset),
+                          tmp, count);
       } else {
-        Ty tmp{value};  // It's required to construct value to avoid moved-from
-                        // state aster shift
         insert_n_without_grow(count, tmp, offset);
       }
     }
-    return begin() + current_size;
+    return begin() + offset;
   }
 
   template <
@@ -350,6 +529,10 @@ class vector {
       grow<true>(calc_growth(), make_construct_at_helper(offset),
                  make_transfer_with_shift_right(offset, offset + 1),
                  forward<Types>(args)...);
+    } else if constexpr (policies::relocates_trivially) {
+      Ty tmp{forward<Types>(args)...};
+      insert_relocating(offset, 1, make_construct_at_helper(offset),
+                        move(tmp));
     } else {
       Ty tmp{forward<Types>(args)...};
       pointer buffer{data()};
@@ -417,6 +600,39 @@ class vector {
                 count - size());
   }
 
+  // The new elements of trivial types are left uninitialized and must be
+  // overwritten before reading. It saves a pass over large I/O buffers
+  void resize_uninitialized(size_type count) {
+    verify_uninitialized_storage_is_allowed();
+    resize_impl(count, make_dummy_construct_helper(), size());
+  }
+
+  // Appends count uninitialized elements and returns a pointer to the first
+  // of them. The capacity grows geometrically as with push_back()
+  pointer append_uninitialized(size_type count) {
+    verify_uninitialized_storage_is_allowed();
+    const size_type current_size{size()};
+    if (const size_type required = current_size + count;
+        required > capacity()) {
+      grow<false>(calc_optimal_growth(required), make_dummy_construct_helper(),
+                  make_transfer_without_shift(), current_size);
+    }
+    get_size() += count;
+    return data() + current_size;
+  }
+
+  // Calls op(data(), count) on a buffer of at least count elements, where the
+  // elements after size() are uninitialized, and sets the size to the value
+  // returned by op which must not exceed count
+  template <class Operation>
+  void resize_and_overwrite(size_type count, Operation op) {
+    verify_uninitialized_storage_is_allowed();
+    reserve(count);
+    const auto new_size{static_cast<size_type>(op(data(), count))};
+    assert_with_msg(new_size <= count, "too many elements are written");
+    get_size() = new_size;
+  }
+
   void swap(vector& other) noexcept(
       allocator_traits_type::propagate_on_container_swap::value ||
       allocator_traits_type::is_always_equal::value) {
@@ -427,6 +643,12 @@ class vector {
   }
 
  private:
+  static constexpr void verify_uninitialized_storage_is_allowed() noexcept {
+    static_assert(is_trivially_default_constructible_v<value_type> &&
+                      is_trivially_destructible_v<value_type>,
+                  "uninitialized elements are allowed only for trivial types");
+  }
+
   void destroy_and_deallocate() {
     destroy_n(begin(), size(), get_alloc());
     deallocate_buffer(get_alloc(), data(), capacity());
@@ -521,13 +743,12 @@ class vector {
       // With move_iterator it's possible to lose optimization for the
       // trivially copyable types
       const size_type other_size{other.size()};
+      clear();
       if (other_size > capacity()) {
-        grow_unchecked(other_size, make_taker(), make_transfer_without_shift(),
-                       move(other));
+        grow_unchecked<true>(other_size, make_taker(), make_dummy_transfer(),
+                             move(other));
       } else {
-        auto last{move(other.begin(), other.end(), begin())};
-        destroy(last, end(), get_alloc());
-        get_size() = other_size;
+        get_size() = make_taker()(get_alloc(), data(), move(other));
       }
       other.clear();
     }
@@ -564,14 +785,16 @@ class vector {
                  make_range_construct_helper(offset),
                  make_transfer_with_shift_right(offset, offset + range_length),
                  first, range_length);
+    } else if (pos == end()) {
+      append_range_without_grow(first, range_length);
+    } else if constexpr (policies::relocates_trivially) {
+      insert_relocating(offset, range_length,
+                        make_range_construct_helper(offset), first,
+                        range_length);
     } else {
-      if (pos == end()) {
-        append_range_without_grow(first, range_length);
-      } else {
-        insert_range_without_grow(first, range_length, offset);
-      }
+      insert_range_without_grow(first, range_length, offset);
     }
-    return begin() + current_size;
+    return begin() + offset;
   }
 
   void append_n_without_grow(size_type count, const Ty& value) {
@@ -652,9 +875,28 @@ class vector {
     }
   }
 
+  template <class ConstructPolicy, class... Types>
+  void insert_relocating(size_type offset,
+                         size_type count,
+                         ConstructPolicy construction_handler,
+                         Types&&... args) {
+    policies::relocate_and_construct(get_alloc(), data(), size(), offset, count,
+                                     construction_handler,
+                                     forward<Types>(args)...);
+    get_size() += count;
+  }
+
   iterator erase_impl(size_type offset, size_type count) {
+    allocator_type& alloc{get_alloc()};
     pointer buffer{data()};
-    shift_left(buffer + offset, buffer + size(), count);
+    const size_type current_size{size()};
+    if constexpr (policies::relocates_trivially) {
+      policies::destroy_and_relocate(alloc, buffer, current_size, offset,
+                                     count);
+    } else {
+      shift_left(buffer + offset, buffer + current_size, count);
+      destroy_n(buffer + current_size - count, count, alloc);
+    }
     get_size() -= count;
     return begin() + offset;
   }
@@ -760,8 +1002,9 @@ class vector {
     auto alc_guard{make_alloc_temporary_guard(new_buffer, alloc, new_capacity)};
     const size_type size_adjustment{
         construction_handler(alloc, new_buffer, forward<Types>(args)...)};
-    transfer_handler(alloc, new_buffer, old_size, old_buffer);
-    destroy_and_deallocate();
+    destroy_n(old_buffer,
+              transfer_handler(alloc, new_buffer, old_size, old_buffer), alloc);
+    deallocate_buffer(alloc, old_buffer, capacity());
     alc_guard.release();
 
     if constexpr (AdjustSize) {
@@ -789,108 +1032,6 @@ class vector {
     return old_capacity == 0 ? MIN_CAPACITY : old_capacity * GROWTH_MULTIPLIER;
   }
 
-  static constexpr auto make_dummy_construct_helper() {
-    return []([[maybe_unused]] allocator_type& alloc,
-              [[maybe_unused]] pointer buffer,
-              size_t old_size) { return old_size; };
-  }
-
-  static constexpr auto make_construct_at_helper(size_type pos) {
-    return [pos](allocator_type& alloc, pointer buffer, auto&&... args) {
-      allocator_traits_type::construct(alloc, buffer + pos,
-                                       forward<decltype(args)>(args)...);
-      return 1u;
-    };
-  }
-
-  static constexpr auto make_range_construct_helper(size_type pos) {
-    return [pos](allocator_type& alloc, pointer buffer, auto first,
-                 size_type count) {
-      uninitialized_copy_n_unchecked(first, count, buffer + pos, alloc);
-      return count;
-    };
-  }
-
-  static constexpr auto make_default_construct_helper(size_type pos) {
-    return [pos](allocator_type& alloc, pointer buffer, size_type count) {
-      uninitialized_default_construct_n(buffer + pos, count, alloc);
-      return count;
-    };
-  }
-
-  static constexpr auto make_construct_fill_helper(size_type pos) {
-    return [pos](allocator_type& alloc, pointer buffer, const Ty& value,
-                 size_t count) {
-      uninitialized_fill_n(buffer + pos, count, value, alloc);
-      return count;
-    };
-  }
-
-  static constexpr auto make_cloner() noexcept {
-    return [](allocator_type& alloc, pointer dst,
-              const vector& other) noexcept {
-      const size_type object_count{other.size()};
-      uninitialized_copy_n_unchecked(other.data(), object_count, dst, alloc);
-      return object_count;
-    };
-  }
-
-  static constexpr auto make_taker() noexcept {
-    return [](allocator_type& alloc, pointer dst, vector&& other) noexcept {
-      const size_type object_count{other.size()};
-      uninitialized_move_n_unchecked(other.data(), object_count, dst, alloc);
-      return object_count;
-    };
-  }
-
-  static constexpr auto make_transfer_without_shift() noexcept {
-    if constexpr (is_nothrow_move_constructible_v<value_type> ||
-                  !is_copy_constructible_v<value_type>) {
-      return [](allocator_type& alloc, pointer dst, size_type count,
-                const pointer src) {
-        uninitialized_move_n_unchecked(src, count, dst, alloc);
-      };
-    } else {
-      return [](allocator_type& alloc, pointer dst, size_type count,
-                const pointer src) {
-        uninitialized_copy_n_unchecked(src, count, dst, alloc);
-      };
-    }
-  }
-
-  static constexpr auto make_transfer_with_shift_right(
-      size_type left_bound,
-      size_type right_bound) noexcept {
-    return [left_bound, right_bound](allocator_type& alloc, pointer dst,
-                                     size_type count, const pointer src) {
-      make_transfer_without_shift()(alloc, dst, left_bound, src);
-      make_transfer_without_shift()(alloc, dst + right_bound,
-                                    count - left_bound, src + left_bound);
-    };
-  }
-
-  static constexpr auto make_dummy_transfer() noexcept {
-    return []([[maybe_unused]] allocator_type& alloc,
-              [[maybe_unused]] pointer dst, [[maybe_unused]] size_type count,
-              [[maybe_unused]] const pointer src) noexcept {};
-  }
-
-  static pointer allocate_buffer(allocator_type& alc, size_type obj_count) {
-    return allocator_traits_type::allocate(alc, obj_count);
-  }
-
-  static void deallocate_buffer(allocator_type& alc,
-                                pointer buffer,
-                                size_type obj_count) noexcept {
-    if constexpr (allocator_traits_type::enable_delete_null::value) {
-      allocator_traits_type::deallocate(alc, buffer, obj_count);
-    } else {
-      if (buffer) {
-        allocator_traits_type::deallocate(alc, buffer, obj_count);
-      }
-    }
-  }
-
  private:
   compressed_pair<allocator_type, Impl> m_impl;
 };
@@ -937,5 +1078,691 @@ bool operator>=(const vector<Ty, Allocator>& lhs,
                 const vector<Ty, Allocator>& rhs) {
   return !(lhs < rhs);
 }
+
+// Keeps up to N elements in the inline storage and spills to the allocator
+// only when it grows past N
+template <class Ty, size_t N, class Allocator = basic_paged_allocator<Ty> >
+class small_vector : private vec::details::growth_policies<Ty, Allocator> {
+ public:
+  using value_type = Ty;
+
+  using allocator_type = Allocator;
+  using allocator_traits_type = allocator_traits<allocator_type>;
+  using pointer = typename allocator_traits_type::pointer;
+  using const_pointer = typename allocator_traits_type::const_pointer;
+  using reference = typename allocator_traits_type::reference;
+  using const_reference = typename allocator_traits_type::const_reference;
+  using size_type = typename allocator_traits_type::size_type;
+
+  using iterator = pointer;
+  using const_iterator = const_pointer;
+
+  static constexpr size_type inline_capacity{N};
+
+ private:
+  using policies = vec::details::growth_policies<Ty, Allocator>;
+
+  using policies::allocate_buffer;
+  using policies::deallocate_buffer;
+  using policies::make_construct_at_helper;
+  using policies::make_construct_fill_helper;
+  using policies::make_default_construct_helper;
+  using policies::make_dummy_construct_helper;
+  using policies::make_dummy_transfer;
+  using policies::make_range_construct_helper;
+  using policies::make_transfer_with_shift_right;
+  using policies::make_transfer_without_shift;
+
+  struct Impl {
+    pointer buffer{nullptr};
+    size_type size{0};
+    size_type capacity{0};
+  };
+
+  using storage_type = aligned_storage_t<sizeof(Ty), alignof(Ty)>;
+
+ public:
+  static_assert(N > 0, "inline capacity must be positive");
+  static_assert(is_same_v<Ty, typename allocator_traits_type::value_type>,
+                "Incompatible allocator");
+
+ private:
+  template <class InputIt>
+  using forward_or_greater_t =
+      is_base_of<forward_iterator_tag,
+                 typename iterator_traits<InputIt>::iterator_category>;
+
+  static constexpr size_type GROWTH_MULTIPLIER{2};
+
+ public:
+  small_vector() noexcept(is_nothrow_default_constructible_v<allocator_type>) {
+    reset_to_inline();
+  }
+
+  explicit small_vector(const allocator_type& alloc) noexcept(
+      is_nothrow_copy_constructible_v<allocator_type>)
+      : m_impl{one_then_variadic_args{}, alloc} {
+    reset_to_inline();
+  }
+
+  explicit small_vector(size_type object_count,
+                        const allocator_type& alloc = allocator_type{})
+      : small_vector(alloc) {
+    resize(object_count);
+  }
+
+  small_vector(size_type object_count,
+               const Ty& value,
+               const allocator_type& alloc = allocator_type{})
+      : small_vector(alloc) {
+    assign(object_count, value);
+  }
+
+  template <class InputIt,
+            enable_if_t<is_base_of_v<input_iterator_tag,
+                                     typename iterator_traits<
+                                         InputIt>::iterator_category>,
+                        int> = 0>
+  small_vector(InputIt first,
+               InputIt last,
+               const allocator_type& alloc = allocator_type{})
+      : small_vector(alloc) {
+    assign(first, last);
+  }
+
+  small_vector(const small_vector& other)
+      : small_vector(
+            allocator_traits_type::select_on_container_copy_construction(
+                other.get_alloc())) {
+    assign(other.begin(), other.end());
+  }
+
+  small_vector(small_vector&& other) noexcept(
+      is_nothrow_move_constructible_v<allocator_type>&&
+          is_nothrow_move_constructible_v<value_type>)
+      : m_impl{one_then_variadic_args{}, move(other.get_alloc())} {
+    reset_to_inline();
+    take_contents(other);
+  }
+
+  small_vector& operator=(const small_vector& other) {
+    if (addressof(other) != this) {
+      if constexpr (allocator_traits_type::
+                        propagate_on_container_copy_assignment::value) {
+        if (!alc::details::allocators_are_equal(get_alloc(),
+                                                other.get_alloc())) {
+          destroy_and_deallocate();
+          reset_to_inline();
+        }
+        get_alloc() = other.get_alloc();
+      }
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+
+  // Inline elements can't be stolen, so they are moved one by one even if
+  // the allocators are equal
+  small_vector& operator=(small_vector&& other) noexcept(
+      is_nothrow_move_constructible_v<value_type> &&
+      (allocator_traits_type::propagate_on_container_move_assignment::value ||
+       allocator_traits_type::is_always_equal::value)) {
+    constexpr bool propagate{
+        allocator_traits_type::propagate_on_container_move_assignment::value};
+    if (addressof(other) != this) {
+      if (propagate ||
+          alc::details::allocators_are_equal(get_alloc(), other.get_alloc())) {
+        destroy_and_deallocate();
+        reset_to_inline();
+        if constexpr (propagate) {
+          get_alloc() = move(other.get_alloc());
+        }
+        take_contents(other);
+      } else {
+        const size_type other_size{other.size()};
+        clear();
+        reserve(other_size);
+        destroy_n(other.data(),
+                  make_transfer_without_shift()(get_alloc(), data(), other_size,
+                                                other.data()),
+                  other.get_alloc());
+        get_size() = other_size;
+        other.get_size() = 0;
+      }
+    }
+    return *this;
+  }
+
+  ~small_vector() noexcept { destroy_and_deallocate(); }
+
+  void assign(size_type count, const Ty& value) {
+    clear();
+    if (count > capacity()) {
+      grow<true>(count, make_construct_fill_helper(0), make_dummy_transfer(),
+                 value, count);
+    } else {
+      get_size() =
+          make_construct_fill_helper(0)(get_alloc(), data(), value, count);
+    }
+  }
+
+  template <
+      class InputIt,
+      enable_if_t<
+          is_base_of_v<input_iterator_tag,
+                       typename iterator_traits<InputIt>::iterator_category>,
+          int> = 0>
+  void assign(InputIt first, InputIt last) {
+    clear();
+    append_range(first, last, forward_or_greater_t<InputIt>{});
+  }
+
+  const allocator_type& get_allocator() const noexcept { return get_alloc(); }
+
+  reference at(size_type idx) {
+    return cont::details::at_index_verified(data(), idx, size());
+  }
+
+  const_reference at(size_type idx) const {
+    return cont::details::at_index_verified(data(), idx, size());
+  }
+
+  reference operator[](size_type idx) noexcept {
+    assert_with_msg(idx < size(), "index is out of range");
+    return data()[idx];
+  }
+
+  const_reference operator[](size_type idx) const noexcept {
+    assert_with_msg(idx < size(), "index is out of range");
+    return data()[idx];
+  }
+
+  reference front() noexcept {
+    assert_with_msg(!empty(), "front() called at empty vector");
+    return data()[0];
+  }
+
+  reference back() noexcept {
+    assert_with_msg(!empty(), "back() called at empty vector");
+    return data()[size() - 1];
+  }
+
+  const_reference front() const noexcept {
+    assert_with_msg(!empty(), "front() called at empty vector");
+    return data()[0];
+  }
+
+  const_reference back() const noexcept {
+    assert_with_msg(!empty(), "back() called at empty vector");
+    return data()[size() - 1];
+  }
+
+  pointer data() noexcept { return m_impl.get_second().buffer; }
+  const_pointer data() const noexcept { return m_impl.get_second().buffer; }
+
+  iterator begin() noexcept { return data(); }
+  iterator end() noexcept { return data() + size(); }
+
+  const_iterator begin() const noexcept { return cbegin(); }
+  const_iterator end() const noexcept { return cend(); }
+  const_iterator cbegin() const noexcept { return data(); }
+  const_iterator cend() const noexcept { return data() + size(); }
+
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept { return m_impl.get_second().size; }
+
+  constexpr size_type max_size() const noexcept {
+    return (numeric_limits<size_type>::max)() - 1;
+  }
+
+  size_type capacity() const noexcept { return m_impl.get_second().capacity; }
+
+  // True while the elements live in the inline storage
+  bool is_inline() const noexcept { return data() == inline_data(); }
+
+  void reserve(size_type new_capacity) {
+    if (new_capacity > capacity()) {
+      grow<false>(new_capacity, make_dummy_construct_helper(),
+                  make_transfer_without_shift(), size());
+    }
+  }
+
+  // Moves the elements back to the inline storage if they fit
+  void shrink_to_fit() {
+    const size_type current_size{size()};
+    if (is_inline() || capacity() == current_size) {
+      return;
+    }
+    if (current_size > N) {
+      grow<false>(current_size, make_dummy_construct_helper(),
+                  make_transfer_without_shift(), current_size);
+    } else {
+      allocator_type& alloc{get_alloc()};
+      pointer heap_buffer{data()};
+      const size_type heap_capacity{capacity()};
+      destroy_n(heap_buffer,
+                make_transfer_without_shift()(alloc, inline_data(),
+                                              current_size, heap_buffer),
+                alloc);
+      deallocate_buffer(alloc, heap_buffer, heap_capacity);
+      get_buffer() = inline_data();
+      get_capacity() = N;
+    }
+  }
+
+  void clear() noexcept {
+    destroy_n(begin(), size(), get_alloc());
+    get_size() = 0;
+  }
+
+  iterator insert(const_iterator pos, const Ty& value) {
+    return emplace(pos, value);
+  }
+
+  iterator insert(const_iterator pos, Ty&& value) {
+    return emplace(pos, move(value));
+  }
+
+  iterator insert(const_iterator pos, size_type count, const Ty& value) {
+    const size_type current_size{size()};
+    const auto offset{static_cast<size_type>(pos - cbegin())};
+
+    if (const size_type required = current_size + count;
+        required > capacity()) {
+      grow<true>(
+          calc_optimal_growth(required), make_construct_fill_helper(offset),
+          make_transfer_with_shift_right(offset, offset + count), value, count);
+    } else if constexpr (policies::relocates_trivially) {
+      Ty tmp{value};
+      insert_relocating(offset, count, make_construct_fill_helper(offset), tmp,
+                        count);
+    } else {
+      get_size() += make_construct_fill_helper(current_size)(
+          get_alloc(), data(), value, count);
+      pointer buffer{data()};
+      rotate(buffer + offset, buffer + current_size, buffer + size());
+    }
+    return begin() + offset;
+  }
+
+  template <
+      class InputIt,
+      enable_if_t<
+          is_base_of_v<input_iterator_tag,
+                       typename iterator_traits<InputIt>::iterator_category>,
+          int> = 0>
+  iterator insert(const_iterator pos, InputIt first, InputIt last) {
+    const size_type current_size{size()};
+    const auto offset{static_cast<size_type>(pos - cbegin())};
+
+    if constexpr (forward_or_greater_t<InputIt>::value) {
+      const auto range_length{static_cast<size_type>(distance(first, last))};
+      if (const size_type required = current_size + range_length;
+          required > capacity()) {
+        grow<true>(
+            calc_optimal_growth(required), make_range_construct_helper(offset),
+            make_transfer_with_shift_right(offset, offset + range_length),
+            first, range_length);
+        return begin() + offset;
+      } else if constexpr (policies::relocates_trivially) {
+        insert_relocating(offset, range_length,
+                          make_range_construct_helper(offset), first,
+                          range_length);
+        return begin() + offset;
+      }
+    }
+    append_range(first, last, forward_or_greater_t<InputIt>{});
+    pointer buffer{data()};
+    rotate(buffer + offset, buffer + current_size, buffer + size());
+    return begin() + offset;
+  }
+
+  template <class... Types>
+  iterator emplace(const_iterator pos, Types&&... args) {
+    const size_type current_size{size()};
+    const auto offset{static_cast<size_type>(pos - cbegin())};
+
+    if (offset == current_size) {
+      emplace_back(forward<Types>(args)...);
+    } else if (current_size == capacity()) {
+      grow<true>(calc_growth(), make_construct_at_helper(offset),
+                 make_transfer_with_shift_right(offset, offset + 1),
+                 forward<Types>(args)...);
+    } else if constexpr (policies::relocates_trivially) {
+      Ty tmp{forward<Types>(args)...};
+      insert_relocating(offset, 1, make_construct_at_helper(offset),
+                        move(tmp));
+    } else {
+      Ty tmp{forward<Types>(args)...};
+      pointer buffer{data()};
+      make_construct_at_helper(current_size)(get_alloc(), buffer,
+                                             move_if_noexcept(back()));
+      ++get_size();
+      shift_right(buffer + offset, buffer + current_size, 1);
+      buffer[offset] = move(tmp);
+    }
+    return begin() + offset;
+  }
+
+  iterator erase(const_iterator pos) {
+    assert_with_msg(pos != end(), "can't dereference end iterator");
+    return erase_impl(static_cast<size_type>(pos - cbegin()), 1);
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    assert_with_msg(first <= last, "transposed iterator range");
+    assert_with_msg(first >= cbegin() && last <= cend(),
+                    "iterator range does not belong to the vector");
+    return erase_impl(static_cast<size_type>(first - cbegin()),
+                      static_cast<size_type>(last - first));
+  }
+
+  void push_back(const Ty& value) { emplace_back(value); }
+
+  void push_back(Ty&& value) { emplace_back(move(value)); }
+
+  template <class... Types>
+  reference emplace_back(Types&&... args) {
+    const size_type current_size{size()};
+    if (current_size == capacity()) {
+      grow<true>(calc_growth(), make_construct_at_helper(current_size),
+                 make_transfer_without_shift(), forward<Types>(args)...);
+    } else {
+      make_construct_at_helper(current_size)(get_alloc(), data(),
+                                             forward<Types>(args)...);
+      ++get_size();
+    }
+    return back();
+  }
+
+  void pop_back() {
+    assert_with_msg(!empty(), "pop_back() called at empty vector");
+    allocator_traits_type::destroy(get_alloc(), addressof(back()));
+    --get_size();
+  }
+
+  void resize(size_type count) {
+    resize_impl(count, make_default_construct_helper(size()), count - size());
+  }
+
+  void resize(size_type count, const Ty& value) {
+    resize_impl(count, make_construct_fill_helper(size()), value,
+                count - size());
+  }
+
+  // The new elements of trivial types are left uninitialized and must be
+  // overwritten before reading. It saves a pass over large I/O buffers
+  void resize_uninitialized(size_type count) {
+    verify_uninitialized_storage_is_allowed();
+    resize_impl(count, make_dummy_construct_helper(), size());
+  }
+
+  // Appends count uninitialized elements and returns a pointer to the first
+  // of them. The capacity grows geometrically as with push_back()
+  pointer append_uninitialized(size_type count) {
+    verify_uninitialized_storage_is_allowed();
+    const size_type current_size{size()};
+    if (const size_type required = current_size + count;
+        required > capacity()) {
+      grow<false>(calc_optimal_growth(required), make_dummy_construct_helper(),
+                  make_transfer_without_shift(), current_size);
+    }
+    get_size() += count;
+    return data() + current_size;
+  }
+
+  // Calls op(data(), count) on a buffer of at least count elements, where the
+  // elements after size() are uninitialized, and sets the size to the value
+  // returned by op which must not exceed count
+  template <class Operation>
+  void resize_and_overwrite(size_type count, Operation op) {
+    verify_uninitialized_storage_is_allowed();
+    reserve(count);
+    const auto new_size{static_cast<size_type>(op(data(), count))};
+    assert_with_msg(new_size <= count, "too many elements are written");
+    get_size() = new_size;
+  }
+
+  void swap(small_vector& other) noexcept(
+      is_nothrow_move_constructible_v<value_type> &&
+      (allocator_traits_type::propagate_on_container_swap::value ||
+       allocator_traits_type::is_always_equal::value)) {
+    if (addressof(other) == this) {
+      return;
+    }
+    assert_with_msg(
+        allocator_traits_type::propagate_on_container_swap::value ||
+            get_alloc() == other.get_alloc(),
+        "vectors are not swappable due to incompatible allocators");
+    if (!is_inline() && !other.is_inline()) {
+      ktl::swap(m_impl.get_second(), other.m_impl.get_second());
+    } else {
+      small_vector tmp{move(other)};
+      other.take_contents(*this);
+      take_contents(tmp);
+    }
+    if constexpr (allocator_traits_type::propagate_on_container_swap::value) {
+      ktl::swap(get_alloc(), other.get_alloc());
+    }
+  }
+
+ private:
+  static constexpr void verify_uninitialized_storage_is_allowed() noexcept {
+    static_assert(is_trivially_default_constructible_v<value_type> &&
+                      is_trivially_destructible_v<value_type>,
+                  "uninitialized elements are allowed only for trivial types");
+  }
+
+  void reset_to_inline() noexcept {
+    m_impl.get_second() = Impl{inline_data(), 0, N};
+  }
+
+  // Steals the heap buffer of the other vector or moves its inline elements.
+  // The vector must be empty and inline, the other one is left so
+  void take_contents(small_vector& other) {
+    if (other.is_inline()) {
+      const size_type other_size{other.size()};
+      uninitialized_relocate_n(other.data(), other_size, data(), get_alloc());
+      get_size() = other_size;
+      other.get_size() = 0;
+    } else {
+      m_impl.get_second() = other.m_impl.get_second();
+      other.reset_to_inline();
+    }
+  }
+
+  void destroy_and_deallocate() noexcept {
+    destroy_n(begin(), size(), get_alloc());
+    if (!is_inline()) {
+      deallocate_buffer(get_alloc(), data(), capacity());
+    }
+  }
+
+  template <class InputIt>
+  void append_range(InputIt first, InputIt last, false_type) {
+    for (; first != last; first = next(first)) {
+      emplace_back(*first);
+    }
+  }
+
+  template <class ForwardIt>
+  void append_range(ForwardIt first, ForwardIt last, true_type) {
+    const size_type current_size{size()},
+        range_length{static_cast<size_type>(distance(first, last))};
+    if (const size_type required = current_size + range_length;
+        required > capacity()) {
+      grow<true>(calc_optimal_growth(required),
+                 make_range_construct_helper(current_size),
+                 make_transfer_without_shift(), first, range_length);
+    } else {
+      get_size() += make_range_construct_helper(current_size)(
+          get_alloc(), data(), first, range_length);
+    }
+  }
+
+  template <class ConstructPolicy, class... Types>
+  void insert_relocating(size_type offset,
+                         size_type count,
+                         ConstructPolicy construction_handler,
+                         Types&&... args) {
+    policies::relocate_and_construct(get_alloc(), data(), size(), offset, count,
+                                     construction_handler,
+                                     forward<Types>(args)...);
+    get_size() += count;
+  }
+
+  iterator erase_impl(size_type offset, size_type count) {
+    allocator_type& alloc{get_alloc()};
+    pointer buffer{data()};
+    const size_type current_size{size()};
+    if constexpr (policies::relocates_trivially) {
+      policies::destroy_and_relocate(alloc, buffer, current_size, offset,
+                                     count);
+    } else {
+      shift_left(buffer + offset, buffer + current_size, count);
+      destroy_n(buffer + current_size - count, count, alloc);
+    }
+    get_size() -= count;
+    return begin() + offset;
+  }
+
+  template <class ConstructionPolicy, class... Types>
+  void resize_impl(size_type count,
+                   ConstructionPolicy construction_handler,
+                   Types&&... args) {
+    const size_type current_size{size()};
+    if (count < current_size) {
+      destroy_n(begin() + count, current_size - count, get_alloc());
+    } else if (count > current_size) {
+      if (count <= capacity()) {
+        construction_handler(get_alloc(), data(), forward<Types>(args)...);
+      } else {
+        grow<false>(count, construction_handler, make_transfer_without_shift(),
+                    forward<Types>(args)...);
+      }
+    }
+    get_size() = count;
+  }
+
+  allocator_type& get_alloc() noexcept { return m_impl.get_first(); }
+
+  const allocator_type& get_alloc() const noexcept {
+    return m_impl.get_first();
+  }
+
+  pointer& get_buffer() noexcept { return m_impl.get_second().buffer; }
+
+  size_type& get_size() noexcept { return m_impl.get_second().size; }
+
+  size_type& get_capacity() noexcept { return m_impl.get_second().capacity; }
+
+  pointer inline_data() noexcept {
+    return reinterpret_cast<pointer>(m_storage);
+  }
+
+  const_pointer inline_data() const noexcept {
+    return reinterpret_cast<const_pointer>(m_storage);
+  }
+
+  template <bool AdjustSize,
+            class TransferPolicy,
+            class ConstructPolicy,
+            class... Types>
+  void grow(size_type new_capacity,
+            ConstructPolicy construction_handler,
+            TransferPolicy transfer_handler,
+            Types&&... args) {
+    throw_exception_if_not<length_error>(new_capacity <= max_size(),
+                                         "vector is too large");
+    allocator_type& alloc{get_alloc()};
+    const size_type old_size{size()};
+    pointer new_buffer{allocate_buffer(alloc, new_capacity)};
+
+    auto alc_guard{make_alloc_temporary_guard(new_buffer, alloc, new_capacity)};
+    const size_type size_adjustment{
+        construction_handler(alloc, new_buffer, forward<Types>(args)...)};
+    pointer old_buffer{data()};
+    destroy_n(old_buffer,
+              transfer_handler(alloc, new_buffer, old_size, old_buffer), alloc);
+    if (!is_inline()) {
+      deallocate_buffer(alloc, old_buffer, capacity());
+    }
+    alc_guard.release();
+
+    if constexpr (AdjustSize) {
+      get_size() += size_adjustment;
+    }
+
+    get_buffer() = new_buffer;
+    get_capacity() = new_capacity;
+  }
+
+  constexpr size_type calc_optimal_growth(size_type required) noexcept {
+    return (max)(calc_growth(), required);
+  }
+
+  constexpr size_type calc_growth() noexcept {
+    const size_type current_capacity{capacity()}, max_capacity{max_size()};
+    if (current_capacity == max_capacity) {
+      return max_capacity + 1;
+    }
+    if (current_capacity > max_capacity / GROWTH_MULTIPLIER) {
+      return max_capacity;
+    }
+    return current_capacity * GROWTH_MULTIPLIER;
+  }
+
+ private:
+  compressed_pair<allocator_type, Impl> m_impl;
+  storage_type m_storage[N];
+};
+
+template <class Ty, size_t N, class Allocator>
+void swap(small_vector<Ty, N, Allocator>& lhs,
+          small_vector<Ty, N, Allocator>& rhs) noexcept(
+    noexcept(lhs.swap(rhs))) {
+  lhs.swap(rhs);
+}
+
+template <class Ty, size_t N, class Allocator>
+bool operator==(const small_vector<Ty, N, Allocator>& lhs,
+                const small_vector<Ty, N, Allocator>& rhs) {
+  return lhs.size() == rhs.size() && equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <class Ty, size_t N, class Allocator>
+bool operator!=(const small_vector<Ty, N, Allocator>& lhs,
+                const small_vector<Ty, N, Allocator>& rhs) {
+  return !(lhs == rhs);
+}
+
+template <class Ty, size_t N, class Allocator>
+bool operator<(const small_vector<Ty, N, Allocator>& lhs,
+               const small_vector<Ty, N, Allocator>& rhs) {
+  return lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                                 less<Ty>{});
+}
+
+template <class Ty, size_t N, class Allocator>
+bool operator<=(const small_vector<Ty, N, Allocator>& lhs,
+                const small_vector<Ty, N, Allocator>& rhs) {
+  return !(rhs < lhs);
+}
+
+template <class Ty, size_t N, class Allocator>
+bool operator>(const small_vector<Ty, N, Allocator>& lhs,
+               const small_vector<Ty, N, Allocator>& rhs) {
+  return rhs < lhs;
+}
+
+template <class Ty, size_t N, class Allocator>
+bool operator>=(const small_vector<Ty, N, Allocator>& lhs,
+                const small_vector<Ty, N, Allocator>& rhs) {
+  return !(lhs < rhs);
+}
+
+template <class Ty, size_t N>
+using small_vector_non_paged =
+    small_vector<Ty, N, basic_non_paged_allocator<Ty> >;
 }  // namespace ktl
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,43 @@
+// Formatting library for C++ - formatters for KTL containers diagnostics
+//
+// For the license information refer to format.h.
+
+#ifndef FMT_CONTAINERS_H_
+#define FMT_CONTAINERS_H_
+
+#include <hash_table_impl.hpp>
+
+#include "format.hpp"
+
+FMT_BEGIN_NAMESPACE
+FMT_MODULE_EXPORT_BEGIN
+
+#ifdef KTL_HASH_TABLE_STATS
+template <>
+struct formatter<ktl::hash_table_stats> {
+  template <typename ParseContext>
+  constexpr auto parse(ParseContext& ctx) -> decltype(ctx.begin()) {
+    return ctx.begin();
+  }
+
+  template <typename FormatContext>
+  auto format(const ktl::hash_table_stats& stats, FormatContext& ctx)
+      -> decltype(ctx.out()) {
+    return format_to(
+        ctx.out(),
+        "size={} buckets={} load={}% max_info={} max_probe={} probes=[{}] "
+        "rehashes={} info_overflows={} table_bytes={} pool_bytes={} "
+        "pool_blocks={}",
+        stats.size, stats.bucket_count, stats.load_factor_percent,
+        stats.max_info, stats.max_probe_distance,
+        join(stats.probe_histogram, ", "), stats.rehash_count,
+        stats.info_overflow_count, stats.table_bytes, stats.pool_bytes,
+        stats.pool_blocks);
+  }
+};
+#endif
+
+FMT_MODULE_EXPORT_END
+FMT_END_NAMESPACE
+
+#endif  // FMT_CONTAINERS_H_
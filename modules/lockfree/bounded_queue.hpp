@@ -0,0 +1,489 @@
+#pragma once
+#include <allocator.hpp>
+#include <atomic.hpp>
+#include <basic_types.hpp>
+#include <crt_attributes.hpp>
+#include <iterator.hpp>
+#include <ktlexcept.hpp>
+#include <limits.hpp>
+#include <memory_impl.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#include <ntddk.h>
+
+namespace ktl::lockfree {
+/*
+ * Bounded multi-producer, multi-consumer queue over a ring of cells
+ * (D. Vyukov, "Bounded MPMC queue", 2011).
+ *
+ * Each cell carries a sequence number which tells whether it is ready
+ * to be written at the given enqueue position or to be read at the given
+ * dequeue position, so producers and consumers synchronize with a single CAS
+ * on their own position and never touch each other's cache line on the fast
+ * path. The ring is allocated once in the constructor; push and pop never
+ * allocate and are allowed at any IRQL the storage is accessible at.
+ *
+ * Unlike mpmc_queue, Ty isn't required to be trivially destructible, but
+ * it must be nothrow move-assignable and the constructor selected for push
+ * must not throw: a claimed cell can't be given back.
+ */
+template <class Ty, template <typename, align_val_t> class BasicAllocator>
+class bounded_mpmc_queue : public non_relocatable {
+ public:
+  using value_type = Ty;
+  using reference = Ty&;
+  using const_reference = const Ty&;
+  using pointer = Ty*;
+  using const_pointer = const Ty*;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  static constexpr size_type MIN_CAPACITY{2};
+
+ private:
+  struct cell {
+    explicit cell(size_type position) noexcept : sequence{position} {}
+
+    Ty* get_value() noexcept { return reinterpret_cast<Ty*>(&storage); }
+
+    atomic<size_type> sequence;
+    aligned_storage_t<sizeof(Ty), alignof(Ty)> storage;
+  };
+
+  ALIGN(crt::CACHE_LINE_SIZE) struct aligned_position {
+    atomic<size_type>& get() noexcept { return value; }
+    const atomic<size_type>& get() const noexcept { return value; }
+
+    atomic<size_type> value{0};
+  };
+
+  static constexpr auto CELL_ALIGNMENT{
+      static_cast<align_val_t>((max)(crt::CACHE_LINE_SIZE, alignof(cell)))};
+
+  using internal_allocator_type = BasicAllocator<cell, CELL_ALIGNMENT>;
+  using allocator_traits_type = allocator_traits<internal_allocator_type>;
+
+ public:
+  using allocator_type = internal_allocator_type;
+
+ public:
+  // Capacity is rounded up to the nearest power of 2
+  explicit bounded_mpmc_queue(size_type capacity) { initialize(capacity); }
+
+  template <class Allocator = allocator_type>
+  bounded_mpmc_queue(size_type capacity, Allocator&& alloc)
+      : m_alc(forward<Allocator>(alloc)) {
+    initialize(capacity);
+  }
+
+  // Must not be called concurrently with push or pop
+  ~bounded_mpmc_queue() noexcept {
+    const size_type capacity{get_capacity()};
+    for (size_type pos = m_dequeue_pos.get().load<memory_order_relaxed>();;
+         ++pos) {
+      cell& target{m_cells[pos & m_mask]};
+      if (target.sequence.load<memory_order_acquire>() != pos + 1) {
+        break;
+      }
+      destroy_at(target.get_value());
+      target.sequence.store<memory_order_relaxed>(pos + capacity);
+    }
+    for (size_type idx = 0; idx < capacity; ++idx) {
+      destroy_at(m_cells + idx);
+    }
+    allocator_traits_type::deallocate(m_alc, m_cells, capacity);
+  }
+
+  template <class... Types,
+            enable_if_t<is_nothrow_constructible_v<Ty, Types...>, int> = 0>
+  bool try_emplace(Types&&... args) noexcept {
+    size_type pos;
+    if (!claim<true>(pos, 1)) {
+      return false;
+    }
+    publish(pos, forward<Types>(args)...);
+    return true;
+  }
+
+  template <class U = Ty,
+            enable_if_t<is_nothrow_copy_constructible_v<U>, int> = 0>
+  bool try_push(const Ty& value) noexcept {
+    return try_emplace(value);
+  }
+
+  template <class U = Ty,
+            enable_if_t<is_nothrow_move_constructible_v<U>, int> = 0>
+  bool try_push(Ty&& value) noexcept {
+    return try_emplace(move(value));
+  }
+
+  bool try_pop(Ty& value) noexcept {
+    size_type pos;
+    if (!claim<false>(pos, 1)) {
+      return false;
+    }
+    consume(pos, value);
+    return true;
+  }
+
+  /*
+   * Pushes as many elements of [first, last) as there are free cells right
+   * after the current enqueue position, claiming all of them by a single CAS.
+   * The range is measured before the cells are claimed, so it must be
+   * a forward one. Returns the number of elements taken from the range
+   */
+  template <class ForwardIt>
+  size_type try_push_bulk(ForwardIt first, ForwardIt last) noexcept {
+    static_assert(
+        is_base_of_v<forward_iterator_tag,
+                     typename iterator_traits<ForwardIt>::iterator_category>,
+        "ForwardIt must be a forward iterator");
+    static_assert(
+        is_nothrow_constructible_v<Ty, decltype(*first)>,
+        "Ty must be nothrow constructible from the range elements");
+
+    size_type pos;
+    const size_type claimed{
+        claim<true>(pos, static_cast<size_type>(distance(first, last)))};
+    for (size_type idx = 0; idx < claimed; ++idx, ++first) {
+      publish(pos + idx, *first);
+    }
+    return claimed;
+  }
+
+  // Pops up to max_count elements by a single CAS. Returns the popped count
+  template <class OutputIt>
+  size_type try_pop_bulk(OutputIt out, size_type max_count) noexcept {
+    size_type pos;
+    const size_type claimed{claim<false>(pos, max_count)};
+    for (size_type idx = 0; idx < claimed; ++idx, ++out) {
+      consume(pos + idx, *out);
+    }
+    return claimed;
+  }
+
+  [[nodiscard]] size_type capacity() const noexcept { return get_capacity(); }
+
+  // The result may be outdated by the time it is returned
+  [[nodiscard]] size_type size_approx() const noexcept {
+    const size_type dequeue_pos{
+        m_dequeue_pos.get().load<memory_order_relaxed>()};
+    const size_type enqueue_pos{
+        m_enqueue_pos.get().load<memory_order_relaxed>()};
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  [[nodiscard]] bool empty_approx() const noexcept {
+    return size_approx() == 0;
+  }
+
+ private:
+  void initialize(size_type capacity) {
+    static_assert(is_nothrow_move_assignable_v<Ty>,
+                  "Ty must be nothrow move assignable");
+
+    throw_exception_if_not<length_error>(
+        capacity <= (numeric_limits<size_type>::max)() / 2 + 1,
+        "capacity is too large");
+    size_type rounded_capacity{MIN_CAPACITY};
+    while (rounded_capacity < capacity) {
+      rounded_capacity <<= 1;
+    }
+
+    m_cells = allocator_traits_type::allocate(m_alc, rounded_capacity);
+    for (size_type idx = 0; idx < rounded_capacity; ++idx) {
+      construct_at(m_cells + idx, idx);
+    }
+    m_mask = rounded_capacity - 1;
+  }
+
+  [[nodiscard]] size_type get_capacity() const noexcept { return m_mask + 1; }
+
+  /*
+   * Claims up to max_count consecutive cells starting at the current position
+   * of the producers (ForPush) or the consumers. A cell is ready if its
+   * sequence number equals the position for producers or the position + 1
+   * for consumers. Sequence numbers of the cells ahead of the position only
+   * move towards readiness, so the cells counted before the CAS are still
+   * ready after it succeeds
+   */
+  template <bool ForPush>
+  size_type claim(size_type& pos, size_type max_count) noexcept {
+    if (max_count == 0) {
+      return 0;
+    }
+    auto& position{ForPush ? m_enqueue_pos.get() : m_dequeue_pos.get()};
+    constexpr size_type READY_OFFSET{ForPush ? 0 : 1};
+
+    pos = position.load<memory_order_relaxed>();
+    for (;;) {
+      size_type ready_count{0};
+      difference_type diff{0};
+      while (ready_count < max_count && ready_count <= m_mask) {
+        const size_type expected{pos + ready_count + READY_OFFSET};
+        const size_type sequence{
+            m_cells[(pos + ready_count) & m_mask]
+                .sequence.load<memory_order_acquire>()};
+        diff = static_cast<difference_type>(sequence - expected);
+        if (diff != 0) {
+          break;
+        }
+        ++ready_count;
+      }
+
+      if (ready_count > 0) {
+        if (position.compare_exchange_weak(pos, pos + ready_count)) {
+          return ready_count;
+        }
+      } else if (diff < 0) {
+        return 0;  // The queue is full (for producers) or empty
+      } else {
+        pos = position.load<memory_order_relaxed>();  // Fell behind
+      }
+    }
+  }
+
+  template <class... Types>
+  void publish(size_type pos, Types&&... args) noexcept {
+    cell& target{m_cells[pos & m_mask]};
+    construct_at(target.get_value(), forward<Types>(args)...);
+    target.sequence.store<memory_order_release>(pos + 1);
+  }
+
+  template <class OtherTy>
+  void consume(size_type pos, OtherTy& value) noexcept {
+    cell& target{m_cells[pos & m_mask]};
+    Ty* const stored{target.get_value()};
+    value = move(*stored);
+    destroy_at(stored);
+    target.sequence.store<memory_order_release>(pos + get_capacity());
+  }
+
+ private:
+  aligned_position m_enqueue_pos{};
+  aligned_position m_dequeue_pos{};
+  cell* m_cells{nullptr};
+  size_type m_mask{0};
+  internal_allocator_type m_alc{};
+};
+
+template <class Ty>
+using bounded_queue = bounded_mpmc_queue<Ty, aligned_paged_allocator>;
+
+template <class Ty>
+using bounded_queue_non_paged =
+    bounded_mpmc_queue<Ty, aligned_non_paged_allocator>;
+
+/*
+ * Wait-free single-producer, single-consumer ring.
+ *
+ * The producer owns the tail index and the consumer owns the head one; each
+ * side also keeps a cached copy of the other side's index on its own cache
+ * line and rereads the shared index only when the cached copy says that
+ * the ring is full (or empty). Thus, in the steady state every operation
+ * touches only the cache line of its own side and the slot itself.
+ *
+ * Exactly one thread may push and exactly one thread may pop at a time.
+ * Ty may have throwing constructors and assignments: an element is published
+ * only after it has been constructed and released only after it has been
+ * moved out.
+ *
+ * The ring is non-paged by default as the producer is usually a DPC.
+ */
+template <class Ty,
+          template <typename, align_val_t>
+          class BasicAllocator = aligned_non_paged_allocator>
+class spsc_queue : public non_relocatable {
+ public:
+  using value_type = Ty;
+  using reference = Ty&;
+  using const_reference = const Ty&;
+  using pointer = Ty*;
+  using const_pointer = const Ty*;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  static constexpr size_type MIN_CAPACITY{2};
+
+ private:
+  using storage_type = aligned_storage_t<sizeof(Ty), alignof(Ty)>;
+
+  static constexpr auto STORAGE_ALIGNMENT{static_cast<align_val_t>(
+      (max)(crt::CACHE_LINE_SIZE, alignof(storage_type)))};
+
+  ALIGN(crt::CACHE_LINE_SIZE) struct side_state {
+    atomic<size_type> position{0};  // Owned by this side
+    size_type cached_opposite{0};   // Last seen position of the other side
+  };
+
+  // Publishes the position on scope exit, even if a constructor has thrown
+  class position_guard {
+   public:
+    position_guard(atomic<size_type>& position, size_type value) noexcept
+        : m_position{position}, m_value{value} {}
+
+    ~position_guard() noexcept {
+      m_position.store<memory_order_release>(m_value);
+    }
+
+    position_guard(const position_guard&) = delete;
+    position_guard& operator=(const position_guard&) = delete;
+
+    size_type get() const noexcept { return m_value; }
+    void advance() noexcept { ++m_value; }
+
+   private:
+    atomic<size_type>& m_position;
+    size_type m_value;
+  };
+
+  using internal_allocator_type =
+      BasicAllocator<storage_type, STORAGE_ALIGNMENT>;
+  using allocator_traits_type = allocator_traits<internal_allocator_type>;
+
+ public:
+  using allocator_type = internal_allocator_type;
+
+ public:
+  // Capacity is rounded up to the nearest power of 2
+  explicit spsc_queue(size_type capacity) { initialize(capacity); }
+
+  template <class Allocator = allocator_type>
+  spsc_queue(size_type capacity, Allocator&& alloc)
+      : m_alc(forward<Allocator>(alloc)) {
+    initialize(capacity);
+  }
+
+  // Must not be called concurrently with push or pop
+  ~spsc_queue() noexcept {
+    const size_type tail{m_producer.position.load<memory_order_acquire>()};
+    for (size_type head = m_consumer.position.load<memory_order_relaxed>();
+         head != tail; ++head) {
+      destroy_at(get_slot(head));
+    }
+    allocator_traits_type::deallocate(m_alc, m_slots, get_capacity());
+  }
+
+  template <class... Types>
+  bool try_emplace(Types&&... args) {
+    const size_type tail{m_producer.position.load<memory_order_relaxed>()};
+    if (get_free_count(tail) == 0) {
+      return false;
+    }
+    construct_at(get_slot(tail), forward<Types>(args)...);
+    m_producer.position.store<memory_order_release>(tail + 1);
+    return true;
+  }
+
+  bool try_push(const Ty& value) { return try_emplace(value); }
+  bool try_push(Ty&& value) { return try_emplace(move(value)); }
+
+  bool try_pop(Ty& value) {
+    const size_type head{m_consumer.position.load<memory_order_relaxed>()};
+    if (get_ready_count(head) == 0) {
+      return false;
+    }
+    Ty* const stored{get_slot(head)};
+    value = move(*stored);
+    destroy_at(stored);
+    m_consumer.position.store<memory_order_release>(head + 1);
+    return true;
+  }
+
+  /*
+   * Returns the number of elements taken from [first, last). The range is
+   * measured before the slots are filled, so it must be a forward one
+   */
+  template <class ForwardIt>
+  size_type try_push_bulk(ForwardIt first, ForwardIt last) {
+    static_assert(
+        is_base_of_v<forward_iterator_tag,
+                     typename iterator_traits<ForwardIt>::iterator_category>,
+        "ForwardIt must be a forward iterator");
+    const size_type tail{m_producer.position.load<memory_order_relaxed>()};
+    const auto wanted{static_cast<size_type>(distance(first, last))};
+    const size_type count{(min)(wanted, get_free_count(tail, wanted))};
+    position_guard guard{m_producer.position, tail};
+    for (; guard.get() != tail + count; ++first) {
+      construct_at(get_slot(guard.get()), *first);
+      guard.advance();
+    }
+    return count;
+  }
+
+  // Pops up to max_count elements. Returns the popped count
+  template <class OutputIt>
+  size_type try_pop_bulk(OutputIt out, size_type max_count) {
+    const size_type head{m_consumer.position.load<memory_order_relaxed>()};
+    const size_type count{(min)(max_count, get_ready_count(head, max_count))};
+    position_guard guard{m_consumer.position, head};
+    for (; guard.get() != head + count; ++out) {
+      Ty* const stored{get_slot(guard.get())};
+      *out = move(*stored);
+      destroy_at(stored);
+      guard.advance();
+    }
+    return count;
+  }
+
+  [[nodiscard]] size_type capacity() const noexcept { return get_capacity(); }
+
+  // The result may be outdated by the time it is returned
+  [[nodiscard]] size_type size_approx() const noexcept {
+    const size_type head{m_consumer.position.load<memory_order_relaxed>()};
+    const size_type tail{m_producer.position.load<memory_order_relaxed>()};
+    return tail - head;
+  }
+
+  [[nodiscard]] bool empty_approx() const noexcept {
+    return size_approx() == 0;
+  }
+
+ private:
+  void initialize(size_type capacity) {
+    throw_exception_if_not<length_error>(
+        capacity <= (numeric_limits<size_type>::max)() / 2 + 1,
+        "capacity is too large");
+    size_type rounded_capacity{MIN_CAPACITY};
+    while (rounded_capacity < capacity) {
+      rounded_capacity <<= 1;
+    }
+    m_slots = allocator_traits_type::allocate(m_alc, rounded_capacity);
+    m_mask = rounded_capacity - 1;
+  }
+
+  [[nodiscard]] size_type get_capacity() const noexcept { return m_mask + 1; }
+
+  Ty* get_slot(size_type pos) const noexcept {
+    return reinterpret_cast<Ty*>(m_slots + (pos & m_mask));
+  }
+
+  // Called by the producer only
+  size_type get_free_count(size_type tail, size_type wanted = 1) noexcept {
+    const size_type capacity{get_capacity()};
+    if (capacity - (tail - m_producer.cached_opposite) < wanted) {
+      m_producer.cached_opposite =
+          m_consumer.position.load<memory_order_acquire>();
+    }
+    return capacity - (tail - m_producer.cached_opposite);
+  }
+
+  // Called by the consumer only
+  size_type get_ready_count(size_type head, size_type wanted = 1) noexcept {
+    if (m_consumer.cached_opposite - head < wanted) {
+      m_consumer.cached_opposite =
+          m_producer.position.load<memory_order_acquire>();
+    }
+    return m_consumer.cached_opposite - head;
+  }
+
+ private:
+  side_state m_producer{};
+  side_state m_consumer{};
+  storage_type* m_slots{nullptr};
+  size_type m_mask{0};
+  internal_allocator_type m_alc{};
+};
+
+}  // namespace ktl::lockfree
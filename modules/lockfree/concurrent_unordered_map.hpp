@@ -0,0 +1,541 @@
+#pragma once
+#include "epoch_reclamation.hpp"
+
+#include <allocator.hpp>
+#include <atomic.hpp>
+#include <basic_types.hpp>
+#include <crt_attributes.hpp>
+#include <functional.hpp>
+#include <hash.hpp>
+#include <memory_impl.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#include <ntddk.h>
+
+namespace ktl::lockfree {
+/*
+ * Hash map with lock-free lookups and striped locks for writers.
+ *
+ * Buckets are singly-linked chains of immutable nodes. Readers walk them
+ * inside an epoch critical section without any locks or CAS, writers
+ * serialize on one of STRIPE_COUNT spinlocks selected by the low bits of
+ * the hash and publish their changes with release stores; unlinked nodes are
+ * retired through default_epoch_domain. Assigning a value replaces the node.
+ *
+ * The table grows incrementally: when a stripe gets too dense, a table twice
+ * as large is installed and the buckets of the old one are migrated a few at
+ * a time by the subsequent writers. Each node of a bucket is copied into
+ * the new table before the old bucket is marked as moved, so readers, which
+ * look into the old table first, never miss an element.
+ *
+ * All operations run at DISPATCH_LEVEL, so the map itself, its keys and values
+ * must be non-paged; callers must be at IRQL <= DISPATCH_LEVEL. Nodes are
+ * reclaimed without access to the map, so BasicAllocator must be stateless.
+ */
+template <class Key,
+          class Value,
+          class Hasher = hash<Key>,
+          class KeyEqual = equal_to<Key>,
+          template <typename, align_val_t> class BasicAllocator =
+              aligned_non_paged_allocator>
+class concurrent_unordered_map : non_relocatable {
+ public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using hasher = Hasher;
+  using key_equal = KeyEqual;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  static constexpr size_type STRIPE_COUNT{64};
+  static constexpr size_type MIN_BUCKET_COUNT{STRIPE_COUNT};
+  static constexpr size_type MAX_LOAD_FACTOR{2};
+  static constexpr size_type MIGRATION_BATCH_SIZE{8};  // Buckets per write
+
+ private:
+  // The retirement header is kept apart from the fields which readers may
+  // still access
+  struct node : epoch_retired_object {
+    template <class KeyTy, class ValueTy>
+    node(size_type hash_, KeyTy&& key_, ValueTy&& value_)
+        : hash{hash_},
+          key(forward<KeyTy>(key_)),
+          value(forward<ValueTy>(value_)) {}
+
+    atomic<node*> next{nullptr};
+    size_type hash;
+    Key key;
+    Value value;
+  };
+
+  using bucket = atomic<node*>;
+
+  struct table : epoch_retired_object {
+    explicit table(size_type bucket_count_) noexcept
+        : bucket_count{bucket_count_} {}
+
+    size_type bucket_count;
+    bucket* buckets{nullptr};
+    atomic<table*> prev{nullptr};  // Table being migrated into this one
+    atomic<table*> next{nullptr};  // Table this one is migrated into
+    atomic<size_type> migration_cursor{0};
+    atomic<size_type> migrated_count{0};
+
+    [[nodiscard]] bucket& get_bucket(size_type hash) const noexcept {
+      return buckets[hash & (bucket_count - 1)];
+    }
+  };
+
+  ALIGN(crt::CACHE_LINE_SIZE) struct stripe {
+    KSPIN_LOCK lock{};
+    atomic<size_type> size{0};
+  };
+
+  class stripe_lock_guard {
+   public:
+    explicit stripe_lock_guard(stripe& target) noexcept : m_stripe{target} {
+      KeAcquireSpinLockAtDpcLevel(addressof(m_stripe.lock));
+    }
+
+    ~stripe_lock_guard() noexcept {
+      KeReleaseSpinLockFromDpcLevel(addressof(m_stripe.lock));
+    }
+
+    stripe_lock_guard(const stripe_lock_guard&) = delete;
+    stripe_lock_guard& operator=(const stripe_lock_guard&) = delete;
+
+   private:
+    stripe& m_stripe;
+  };
+
+  using node_allocator_type =
+      BasicAllocator<node, static_cast<align_val_t>(alignof(node))>;
+  using node_allocator_traits_type = allocator_traits<node_allocator_type>;
+  using table_allocator_type =
+      BasicAllocator<table, static_cast<align_val_t>(alignof(table))>;
+  using table_allocator_traits_type = allocator_traits<table_allocator_type>;
+  using bucket_allocator_type =
+      BasicAllocator<bucket, static_cast<align_val_t>(crt::CACHE_LINE_SIZE)>;
+  using bucket_allocator_traits_type = allocator_traits<bucket_allocator_type>;
+
+ public:
+  explicit concurrent_unordered_map(size_type bucket_count = MIN_BUCKET_COUNT,
+                                    const Hasher& hasher_ = Hasher{},
+                                    const KeyEqual& key_equal_ = KeyEqual{})
+      : m_hasher(hasher_), m_key_equal(key_equal_) {
+    static_assert(node_allocator_traits_type::is_always_equal::value,
+                  "BasicAllocator must be stateless");
+    size_type rounded_count{MIN_BUCKET_COUNT};
+    while (rounded_count < bucket_count) {
+      rounded_count <<= 1;
+    }
+    default_epoch_domain.initialize();
+    m_table.store<memory_order_release>(create_table(rounded_count));
+  }
+
+  // Must not be called concurrently with other operations
+  ~concurrent_unordered_map() noexcept {
+    table* const current{m_table.load<memory_order_acquire>()};
+    if (table* const prev = current->prev.load<memory_order_acquire>(); prev) {
+      destroy_table(prev, true);
+    }
+    destroy_table(current, true);
+  }
+
+  // Returns false if the key already exists
+  template <class KeyTy, class ValueTy>
+  bool insert(KeyTy&& key, ValueTy&& value) {
+    return insert_impl<false>(forward<KeyTy>(key), forward<ValueTy>(value));
+  }
+
+  // Returns true if the key has been inserted and false if assigned
+  template <class KeyTy, class ValueTy>
+  bool insert_or_assign(KeyTy&& key, ValueTy&& value) {
+    return insert_impl<true>(forward<KeyTy>(key), forward<ValueTy>(value));
+  }
+
+  bool erase(const Key& key) {
+    const size_type hash{m_hasher(key)};
+    epoch_guard guard;
+    help_migrate();
+
+    stripe& target_stripe{get_stripe(hash)};
+    node* removed{nullptr};
+    {
+      stripe_lock_guard lock{target_stripe};
+      bucket& target{prepare_bucket(hash)};
+      node* prev{nullptr};
+      for (node* current = target.load<memory_order_relaxed>(); current;
+           current = current->next.load<memory_order_relaxed>()) {
+        if (current->hash == hash && m_key_equal(current->key, key)) {
+          unlink(target, prev, current);
+          removed = current;
+          target_stripe.size.store<memory_order_relaxed>(
+              target_stripe.size.load<memory_order_relaxed>() - 1);
+          break;
+        }
+        prev = current;
+      }
+    }
+    if (removed) {
+      retire_node(removed);
+    }
+    return removed != nullptr;
+  }
+
+  // Copies the value into the output. Returns false if there is no such key
+  template <class OutputTy>
+  bool find(const Key& key, OutputTy& value) const {
+    return visit(key, [&value](const Value& found) { value = found; });
+  }
+
+  bool contains(const Key& key) const {
+    return visit(key, [](const Value&) {});
+  }
+
+  /*
+   * Calls fn with a const reference to the value inside a critical section,
+   * i.e. at DISPATCH_LEVEL. Returns false if there is no such key
+   */
+  template <class Fn>
+  bool visit(const Key& key, Fn fn) const {
+    const size_type hash{m_hasher(key)};
+    epoch_guard guard;
+    if (const node* found = find_node(hash, key); found) {
+      fn(found->value);
+      return true;
+    }
+    return false;
+  }
+
+  // The result may be outdated by the time it is returned
+  [[nodiscard]] size_type size() const noexcept {
+    size_type result{0};
+    for (const auto& target : m_stripes) {
+      result += target.size.load<memory_order_relaxed>();
+    }
+    return result;
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+  [[nodiscard]] size_type bucket_count() const noexcept {
+    return m_table.load<memory_order_acquire>()->bucket_count;
+  }
+
+ private:
+  template <bool Assign, class KeyTy, class ValueTy>
+  bool insert_impl(KeyTy&& key, ValueTy&& value) {
+    const size_type hash{m_hasher(key)};
+    node* const new_node{
+        create_node(hash, forward<KeyTy>(key), forward<ValueTy>(value))};
+
+    epoch_guard guard;
+    help_migrate();
+
+    stripe& target_stripe{get_stripe(hash)};
+    node* replaced{nullptr};
+    table* overloaded{nullptr};
+    {
+      stripe_lock_guard lock{target_stripe};
+      bucket& target{prepare_bucket_or_destroy(hash, new_node)};
+      node* prev{nullptr};
+      node* current{target.load<memory_order_relaxed>()};
+      for (; current; current = current->next.load<memory_order_relaxed>()) {
+        if (current->hash == hash && m_key_equal(current->key, new_node->key)) {
+          break;
+        }
+        prev = current;
+      }
+
+      if (!current) {
+        new_node->next.store<memory_order_relaxed>(
+            target.load<memory_order_relaxed>());
+        target.store<memory_order_release>(new_node);
+        const size_type stripe_size{
+            target_stripe.size.load<memory_order_relaxed>() + 1};
+        target_stripe.size.store<memory_order_relaxed>(stripe_size);
+
+        table* const current_table{m_table.load<memory_order_relaxed>()};
+        if (stripe_size >
+            current_table->bucket_count / STRIPE_COUNT * MAX_LOAD_FACTOR) {
+          overloaded = current_table;
+        }
+      } else if constexpr (Assign) {
+        new_node->next.store<memory_order_relaxed>(
+            current->next.load<memory_order_relaxed>());
+        if (prev) {
+          prev->next.store<memory_order_release>(new_node);
+        } else {
+          target.store<memory_order_release>(new_node);
+        }
+        replaced = current;
+      } else {
+        replaced = new_node;  // Has never been published
+      }
+    }
+
+    if (replaced == new_node) {
+      destroy_node(new_node);
+      return false;
+    }
+    if (replaced) {
+      retire_node(replaced);
+      return false;
+    }
+    if (overloaded) {
+      grow(overloaded);
+    }
+    return true;
+  }
+
+  // Must be called inside a critical section
+  const node* find_node(size_type hash, const Key& key) const noexcept {
+    table* current_table{m_table.load<memory_order_acquire>()};
+    for (;;) {
+      // Elements are copied into the new table before the old bucket is
+      // marked as moved, so the old table must be checked first
+      if (table* const prev = current_table->prev.load<memory_order_acquire>();
+          prev) {
+        node* const head{prev->get_bucket(hash).load<memory_order_acquire>()};
+        if (head != get_moved_marker()) {
+          if (const node* found = find_in_chain(head, hash, key); found) {
+            return found;
+          }
+        }
+      }
+      node* const head{
+          current_table->get_bucket(hash).load<memory_order_acquire>()};
+      if (head != get_moved_marker()) {
+        return find_in_chain(head, hash, key);
+      }
+      // The table has been replaced after the lookup started
+      current_table = current_table->next.load<memory_order_acquire>();
+    }
+  }
+
+  const node* find_in_chain(node* head,
+                            size_type hash,
+                            const Key& key) const noexcept {
+    for (node* current = head; current;
+         current = current->next.load<memory_order_acquire>()) {
+      if (current->hash == hash && m_key_equal(current->key, key)) {
+        return current;
+      }
+    }
+    return nullptr;
+  }
+
+  /*
+   * Must be called under the stripe lock. The stripe of a key covers its
+   * buckets in both tables because bucket counts are multiples of
+   * STRIPE_COUNT, and no table can be installed while the lock is held
+   */
+  bucket& prepare_bucket(size_type hash) {
+    table* const current_table{m_table.load<memory_order_relaxed>()};
+    if (table* const prev = current_table->prev.load<memory_order_acquire>();
+        prev) {
+      migrate_bucket(*prev, *current_table, hash & (prev->bucket_count - 1));
+    }
+    return current_table->get_bucket(hash);
+  }
+
+  bucket& prepare_bucket_or_destroy(size_type hash, node* new_node) {
+    try {
+      return prepare_bucket(hash);
+    } catch (...) {
+      destroy_node(new_node);
+      throw;
+    }
+  }
+
+  // Migrates up to MIGRATION_BATCH_SIZE buckets of the old table, if any
+  void help_migrate() {
+    table* const current_table{m_table.load<memory_order_acquire>()};
+    table* const prev{current_table->prev.load<memory_order_acquire>()};
+    if (!prev) {
+      return;
+    }
+    for (size_type count = 0; count < MIGRATION_BATCH_SIZE; ++count) {
+      const size_type idx{prev->migration_cursor++};
+      if (idx >= prev->bucket_count) {
+        break;
+      }
+      stripe_lock_guard lock{get_stripe(idx)};
+      migrate_bucket(*prev, *current_table, idx);
+    }
+  }
+
+  // Must be called under the stripe lock of the bucket
+  void migrate_bucket(table& old_table, table& new_table, size_type idx) {
+    bucket& source{old_table.buckets[idx]};
+    node* const head{source.load<memory_order_relaxed>()};
+    if (head == get_moved_marker()) {
+      return;
+    }
+
+    // Copies are created before anything is published, so a failure leaves
+    // both tables intact
+    node* copies{nullptr};
+    try {
+      for (node* current = head; current;
+           current = current->next.load<memory_order_relaxed>()) {
+        node* const copy{create_node(current->hash, current->key,
+                                     current->value)};
+        copy->next.store<memory_order_relaxed>(copies);
+        copies = copy;
+      }
+    } catch (...) {
+      destroy_chain(copies);
+      throw;
+    }
+    while (node* const copy = copies) {
+      copies = copy->next.load<memory_order_relaxed>();
+      bucket& target{new_table.get_bucket(copy->hash)};
+      copy->next.store<memory_order_relaxed>(
+          target.load<memory_order_relaxed>());
+      target.store<memory_order_release>(copy);
+    }
+    source.store<memory_order_release>(get_moved_marker());
+
+    for (node* current = head; current;) {
+      node* const next{current->next.load<memory_order_relaxed>()};
+      retire_node(current);
+      current = next;
+    }
+    if (++old_table.migrated_count == old_table.bucket_count) {
+      new_table.prev.store<memory_order_release>(nullptr);
+      default_epoch_domain.retire(&old_table, &reclaim_table);
+    }
+  }
+
+  // Installs a table twice as large unless the previous migration is pending
+  void grow(table* expected) {
+    if (expected->prev.load<memory_order_acquire>() ||
+        m_table.load<memory_order_acquire>() != expected) {
+      return;
+    }
+    table* const new_table{create_table(expected->bucket_count * 2)};
+    bool installed{false};
+
+    // Writers hold at most one stripe lock at a time, so taking all of them
+    // in order can't deadlock
+    for (auto& target : m_stripes) {
+      KeAcquireSpinLockAtDpcLevel(addressof(target.lock));
+    }
+    if (m_table.load<memory_order_relaxed>() == expected &&
+        !expected->prev.load<memory_order_relaxed>()) {
+      new_table->prev.store<memory_order_relaxed>(expected);
+      expected->next.store<memory_order_release>(new_table);
+      m_table.store<memory_order_release>(new_table);
+      installed = true;
+    }
+    for (auto& target : m_stripes) {
+      KeReleaseSpinLockFromDpcLevel(addressof(target.lock));
+    }
+    if (!installed) {
+      destroy_table(new_table, false);
+    }
+  }
+
+  void unlink(bucket& target, node* prev, node* current) noexcept {
+    node* const next{current->next.load<memory_order_relaxed>()};
+    if (prev) {
+      prev->next.store<memory_order_release>(next);
+    } else {
+      target.store<memory_order_release>(next);
+    }
+  }
+
+  stripe& get_stripe(size_type hash) noexcept {
+    return m_stripes[hash & (STRIPE_COUNT - 1)];
+  }
+
+  static node* get_moved_marker() noexcept {
+    return reinterpret_cast<node*>(uintptr_t{1});
+  }
+
+  template <class KeyTy, class ValueTy>
+  static node* create_node(size_type hash, KeyTy&& key, ValueTy&& value) {
+    node_allocator_type alloc;
+    node* const ptr{node_allocator_traits_type::allocate(alloc, 1)};
+    try {
+      construct_at(ptr, hash, forward<KeyTy>(key), forward<ValueTy>(value));
+    } catch (...) {
+      node_allocator_traits_type::deallocate(alloc, ptr, 1);
+      throw;
+    }
+    return ptr;
+  }
+
+  static void destroy_node(node* target) noexcept {
+    destroy_at(target);
+    node_allocator_type alloc;
+    node_allocator_traits_type::deallocate(alloc, target, 1);
+  }
+
+  static void destroy_chain(node* head) noexcept {
+    while (head) {
+      node* const next{head->next.load<memory_order_relaxed>()};
+      destroy_node(head);
+      head = next;
+    }
+  }
+
+  static void retire_node(node* target) {
+    default_epoch_domain.retire(target, &reclaim_node);
+  }
+
+  static void reclaim_node(epoch_retired_object* obj) noexcept {
+    destroy_node(static_cast<node*>(obj));
+  }
+
+  static table* create_table(size_type bucket_count) {
+    table_allocator_type table_alloc;
+    table* const result{table_allocator_traits_type::allocate(table_alloc, 1)};
+    construct_at(result, bucket_count);
+    try {
+      bucket_allocator_type bucket_alloc;
+      result->buckets =
+          bucket_allocator_traits_type::allocate(bucket_alloc, bucket_count);
+    } catch (...) {
+      destroy_at(result);
+      table_allocator_traits_type::deallocate(table_alloc, result, 1);
+      throw;
+    }
+    for (size_type idx = 0; idx < bucket_count; ++idx) {
+      construct_at(result->buckets + idx, nullptr);
+    }
+    return result;
+  }
+
+  static void destroy_table(table* target, bool with_nodes) noexcept {
+    for (size_type idx = 0; idx < target->bucket_count; ++idx) {
+      bucket& current{target->buckets[idx]};
+      if (node* const head = current.load<memory_order_relaxed>();
+          with_nodes && head != get_moved_marker()) {
+        destroy_chain(head);
+      }
+      destroy_at(addressof(current));
+    }
+    bucket_allocator_type bucket_alloc;
+    bucket_allocator_traits_type::deallocate(bucket_alloc, target->buckets,
+                                             target->bucket_count);
+    destroy_at(target);
+    table_allocator_type table_alloc;
+    table_allocator_traits_type::deallocate(table_alloc, target, 1);
+  }
+
+  // Nodes of the migrated table have been retired one by one
+  static void reclaim_table(epoch_retired_object* obj) noexcept {
+    destroy_table(static_cast<table*>(obj), false);
+  }
+
+ private:
+  atomic<table*> m_table{nullptr};
+  Hasher m_hasher;
+  KeyEqual m_key_equal;
+  stripe m_stripes[STRIPE_COUNT]{};
+};
+}  // namespace ktl::lockfree
@@ -0,0 +1,401 @@
+#pragma once
+#include <allocator.hpp>
+#include <atomic.hpp>
+#include <basic_types.hpp>
+#include <crt_attributes.hpp>
+#include <irql.hpp>
+#include <memory_impl.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#include <ntddk.h>
+
+namespace ktl::lockfree {
+/*
+ * Header of an object waiting for reclamation. It must not overlap the data
+ * which can still be read by the threads inside critical sections
+ */
+struct epoch_retired_object {
+  using reclaimer_type = void (*)(epoch_retired_object*) noexcept;
+
+  epoch_retired_object* next{nullptr};
+  reclaimer_type reclaim{nullptr};
+};
+
+namespace details {
+struct epoch_retired_list {
+  epoch_retired_object* head{nullptr};
+  size_t count{0};
+  uint64_t epoch{0};
+
+  void push(epoch_retired_object* obj) noexcept {
+    obj->next = head;
+    head = obj;
+    ++count;
+  }
+
+  void splice_to(epoch_retired_list& target) noexcept {
+    while (epoch_retired_object* obj = head) {
+      head = obj->next;
+      target.push(obj);
+    }
+    count = 0;
+  }
+};
+
+ALIGN(crt::CACHE_LINE_SIZE) struct epoch_record {
+  static constexpr size_t LIMBO_LIST_COUNT{3};
+
+  atomic<uint64_t> active_epoch{0};  // 0 if the processor is quiescent
+  size_t nesting{0};
+  size_t pending_count{0};
+  epoch_retired_list limbo[LIMBO_LIST_COUNT]{};
+  epoch_retired_list ready{};  // Already safe to reclaim
+};
+}  // namespace details
+
+/*
+ * Epoch-based reclamation (K. Fraser, "Practical lock-freedom", 2004) with
+ * one record per processor instead of one per thread.
+ *
+ * A critical section raises IRQL to DISPATCH_LEVEL, so the thread can't be
+ * preempted or migrated and the processor announces the global epoch until
+ * the outermost section is left. An object unlinked from a shared structure
+ * is retired into the limbo list of the current epoch and reclaimed once
+ * the global epoch has advanced twice, i.e. after every processor has passed
+ * through a quiescent state. The epoch advances only when all active
+ * processors have announced the current one.
+ *
+ * Reclamation happens when the outermost critical section is left, at the IRQL
+ * the section was entered at. Objects are reclaimed in batches to amortize the
+ * scan of the records. If more than max_pending_count objects of
+ * the processor are still waiting and the caller is below DISPATCH_LEVEL,
+ * it waits for a grace period, so pending memory stays bounded by
+ * max_pending_count per processor plus whatever is retired at DISPATCH_LEVEL
+ * while other processors stay in long critical sections.
+ *
+ * Critical sections may be entered at IRQL <= DISPATCH_LEVEL only and must not
+ * touch pageable memory. The domain is constant-initialized; processor records
+ * are allocated by initialize() which is called implicitly on first use.
+ */
+class epoch_domain : non_relocatable {
+ public:
+  static constexpr size_t DEFAULT_MAX_PENDING_COUNT{1024};  // Per processor
+  static constexpr size_t RECLAIM_BATCH_SIZE{64};
+
+ private:
+  using record = details::epoch_record;
+  using record_allocator_type =
+      aligned_non_paged_allocator<record,
+                                  static_cast<align_val_t>(alignof(record))>;
+  using record_allocator_traits_type = allocator_traits<record_allocator_type>;
+
+ public:
+  constexpr explicit epoch_domain(
+      size_t max_pending_count = DEFAULT_MAX_PENDING_COUNT) noexcept
+      : m_max_pending_count{max_pending_count} {}
+
+  // All critical sections must be left before
+  ~epoch_domain() noexcept {
+    record* const records{m_records.load<memory_order_acquire>()};
+    if (!records) {
+      return;
+    }
+    const size_t record_count{m_record_count.load<memory_order_relaxed>()};
+    for (size_t idx = 0; idx < record_count; ++idx) {
+      auto& target{records[idx]};
+      for (auto& list : target.limbo) {
+        list.splice_to(target.ready);
+      }
+      reclaim_list(target.ready);
+      destroy_at(records + idx);
+    }
+    record_allocator_type alloc;
+    record_allocator_traits_type::deallocate(alloc, records, record_count);
+  }
+
+  // Thread-safe and idempotent. Throws bad_alloc on failure
+  void initialize() {
+    if (m_records.load<memory_order_acquire>()) {
+      return;
+    }
+    const size_t record_count{
+        KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS)};
+    record_allocator_type alloc;
+    record* const records{
+        record_allocator_traits_type::allocate(alloc, record_count)};
+    for (size_t idx = 0; idx < record_count; ++idx) {
+      construct_at(records + idx);
+    }
+    m_record_count.store<memory_order_relaxed>(record_count);
+
+    record* expected{nullptr};
+    if (!m_records.compare_exchange_strong(expected, records)) {
+      for (size_t idx = 0; idx < record_count; ++idx) {
+        destroy_at(records + idx);
+      }
+      record_allocator_traits_type::deallocate(alloc, records, record_count);
+    }
+  }
+
+  // Must be called inside a critical section or at IRQL <= DISPATCH_LEVEL
+  void retire(epoch_retired_object* obj,
+              epoch_retired_object::reclaimer_type reclaimer) {
+    obj->reclaim = reclaimer;
+    irql_t prev_irql;
+    record& target{enter(prev_irql)};
+    const uint64_t epoch{m_epoch.load<memory_order_acquire>()};
+    auto& list{target.limbo[epoch % record::LIMBO_LIST_COUNT]};
+    if (list.epoch != epoch) {
+      // The list belongs to the epoch which is at least 3 steps behind
+      target.pending_count -= list.count;
+      list.splice_to(target.ready);
+      list.epoch = epoch;
+    }
+    list.push(obj);
+    ++target.pending_count;
+    leave(target, prev_irql);
+  }
+
+  /*
+   * Waits until everything retired so far has been reclaimed. The thread
+   * visits every active processor, because the limbo lists are accessible
+   * only from their own processors. Must be called outside of critical
+   * sections at IRQL < DISPATCH_LEVEL
+   */
+  void synchronize() {
+    initialize();
+    const size_t processor_count{
+        KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS)};
+    for (size_t idx = 0; idx < processor_count; ++idx) {
+      PROCESSOR_NUMBER processor;
+      if (!NT_SUCCESS(KeGetProcessorNumberFromIndex(
+              static_cast<ULONG>(idx), addressof(processor)))) {
+        continue;
+      }
+      GROUP_AFFINITY affinity{};
+      affinity.Group = processor.Group;
+      affinity.Mask = KAFFINITY{1} << processor.Number;
+      GROUP_AFFINITY prev_affinity;
+      KeSetSystemGroupAffinityThread(addressof(affinity),
+                                     addressof(prev_affinity));
+      wait_for_pending_count(0);
+      KeRevertToUserGroupAffinityThread(addressof(prev_affinity));
+    }
+  }
+
+  [[nodiscard]] size_t get_max_pending_count() const noexcept {
+    return m_max_pending_count;
+  }
+
+ private:
+  friend class epoch_guard;
+
+  record& enter(irql_t& prev_irql) {
+    initialize();
+    prev_irql = raise_irql(DISPATCH_LEVEL);
+    record& target{get_current_record()};
+    if (target.nesting++ == 0) {
+      // Interlocked exchange is a full barrier: the announcement must be
+      // visible before any shared pointer is read
+      target.active_epoch.exchange(m_epoch.load<memory_order_acquire>());
+    }
+    return target;
+  }
+
+  void leave(record& target, irql_t prev_irql) noexcept {
+    if (--target.nesting != 0) {
+      return;
+    }
+    target.active_epoch.store<memory_order_release>(0);
+
+    details::epoch_retired_list reclaimable{};
+    if (target.pending_count + target.ready.count >= RECLAIM_BATCH_SIZE) {
+      try_advance();
+      collect(target, reclaimable);
+    }
+    const bool overflow{target.pending_count > m_max_pending_count};
+    lower_irql(prev_irql);
+
+    reclaim_list(reclaimable);
+    if (overflow && prev_irql < DISPATCH_LEVEL) {
+      wait_for_pending_count(m_max_pending_count);
+    }
+  }
+
+  // Unless the thread is pinned, it may migrate between the iterations
+  void wait_for_pending_count(size_t max_pending_count) noexcept {
+    for (;;) {
+      details::epoch_retired_list reclaimable{};
+      const irql_t prev_irql{raise_irql(DISPATCH_LEVEL)};
+      record& target{get_current_record()};
+      try_advance();
+      collect(target, reclaimable);
+      const bool done{target.pending_count <= max_pending_count};
+      lower_irql(prev_irql);
+
+      reclaim_list(reclaimable);
+      if (done) {
+        break;
+      }
+      YieldProcessor();
+    }
+  }
+
+  // Must be called at DISPATCH_LEVEL
+  record& get_current_record() const noexcept {
+    const size_t idx{KeGetCurrentProcessorNumberEx(nullptr)};
+    return m_records.load<memory_order_relaxed>()[idx];
+  }
+
+  void try_advance() noexcept {
+    uint64_t epoch{m_epoch.load<memory_order_acquire>()};
+    record* const records{m_records.load<memory_order_relaxed>()};
+    const size_t record_count{m_record_count.load<memory_order_relaxed>()};
+    for (size_t idx = 0; idx < record_count; ++idx) {
+      const uint64_t active_epoch{
+          records[idx].active_epoch.load<memory_order_acquire>()};
+      if (active_epoch != 0 && active_epoch != epoch) {
+        return;
+      }
+    }
+    m_epoch.compare_exchange_strong(epoch, epoch + 1);
+  }
+
+  // Must be called at DISPATCH_LEVEL outside of a critical section
+  void collect(record& target,
+               details::epoch_retired_list& reclaimable) noexcept {
+    const uint64_t epoch{m_epoch.load<memory_order_acquire>()};
+    for (auto& list : target.limbo) {
+      if (list.count > 0 && list.epoch + 2 <= epoch) {
+        target.pending_count -= list.count;
+        list.splice_to(target.ready);
+      }
+    }
+    target.ready.splice_to(reclaimable);
+  }
+
+  static void reclaim_list(details::epoch_retired_list& list) noexcept {
+    while (epoch_retired_object* obj = list.head) {
+      list.head = obj->next;
+      obj->reclaim(obj);
+    }
+    list.count = 0;
+  }
+
+ private:
+  ALIGN(crt::CACHE_LINE_SIZE) atomic<uint64_t> m_epoch{1};
+  atomic<record*> m_records{nullptr};
+  atomic<size_t> m_record_count{0};
+  size_t m_max_pending_count;
+};
+
+/*
+ * Domain used by default-constructed guards and allocators. Constant-
+ * initialized, so it can be used from constructors of other global objects
+ */
+inline epoch_domain default_epoch_domain{};
+
+// Critical section: retired objects can't be reclaimed until it is left
+class epoch_guard : non_relocatable {
+ public:
+  epoch_guard() : epoch_guard(default_epoch_domain) {}
+
+  explicit epoch_guard(epoch_domain& domain)
+      : m_domain{domain}, m_record{domain.enter(m_prev_irql)} {}
+
+  ~epoch_guard() noexcept { m_domain.leave(m_record, m_prev_irql); }
+
+ private:
+  epoch_domain& m_domain;
+  irql_t m_prev_irql{};
+  details::epoch_record& m_record;
+};
+
+/*
+ * Node allocator for the lock-free containers which returns memory
+ * to BasicNodeAllocator through default_epoch_domain instead of keeping it in
+ * a free list. The containers enter a critical_section around every
+ * operation which reads the shared nodes, so such operations run
+ * at DISPATCH_LEVEL and the nodes must be non-paged.
+ *
+ * Reclaimers can't reach the container, so BasicNodeAllocator must be
+ * stateless.
+ */
+template <class Ty,
+          align_val_t Align,
+          template <typename, align_val_t>
+          class BasicNodeAllocator>
+class reclaiming_node_allocator {
+ public:
+  using value_type = Ty;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+ private:
+  static constexpr auto NODE_ALIGNMENT{static_cast<align_val_t>(
+      (max)(crt::CACHE_LINE_SIZE, static_cast<size_type>(Align)))};
+
+  // The header is kept apart from the node: readers may still access it
+  struct memory_block {
+    epoch_retired_object header;
+    aligned_storage_t<sizeof(Ty), static_cast<size_type>(NODE_ALIGNMENT)>
+        storage;
+  };
+
+ public:
+  using allocator_type = BasicNodeAllocator<memory_block, NODE_ALIGNMENT>;
+  using allocator_traits_type = allocator_traits<allocator_type>;
+
+  using propagate_on_container_copy_assignment = false_type;
+  using propagate_on_container_move_assignment = false_type;
+  using propagate_on_container_swap = false_type;
+  using is_always_equal = false_type;
+
+  class critical_section : public epoch_guard {
+   public:
+    explicit critical_section(reclaiming_node_allocator& alc)
+        : epoch_guard{alc.get_domain()} {}
+  };
+
+ public:
+  reclaiming_node_allocator() noexcept = default;
+  reclaiming_node_allocator(const allocator_type&) noexcept {}
+  reclaiming_node_allocator(allocator_type&&) noexcept {}
+
+  // Nodes aren't cached, so there is nothing to preallocate
+  template <class Allocator = allocator_type>
+  reclaiming_node_allocator(size_type, Allocator&& = Allocator{}) noexcept {}
+
+  reclaiming_node_allocator(const reclaiming_node_allocator&) = delete;
+  reclaiming_node_allocator& operator=(const reclaiming_node_allocator&) =
+      delete;
+
+  Ty* allocate() {
+    static_assert(allocator_traits_type::is_always_equal::value,
+                  "BasicNodeAllocator must be stateless");
+    get_domain().initialize();
+    allocator_type alloc;
+    memory_block* const block{allocator_traits_type::allocate(alloc, 1)};
+    construct_at(&block->header);
+    return reinterpret_cast<Ty*>(&block->storage);
+  }
+
+  void deallocate(Ty* ptr) {
+    auto* const block{reinterpret_cast<memory_block*>(
+        reinterpret_cast<byte*>(ptr) - offsetof(memory_block, storage))};
+    get_domain().retire(&block->header, &reclaim);
+  }
+
+  [[nodiscard]] epoch_domain& get_domain() const noexcept {
+    return default_epoch_domain;
+  }
+
+ private:
+  static void reclaim(epoch_retired_object* obj) noexcept {
+    allocator_type alloc;
+    allocator_traits_type::deallocate(
+        alloc, reinterpret_cast<memory_block*>(obj), 1);
+  }
+};
+}  // namespace ktl::lockfree
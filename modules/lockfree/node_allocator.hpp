@@ -175,4 +175,293 @@ class node_allocator {
   compressed_pair<allocator_type, memory_block_header>
       m_freelist{};  // aligned tagged pointer
 };
+
+namespace details {
+// Node allocators which free memory while the container is alive require
+// the container to enter critical_section before reading shared nodes
+template <class NodeAllocator>
+struct empty_critical_section {
+  constexpr explicit empty_critical_section(NodeAllocator&) noexcept {}
+};
+
+template <class NodeAllocator, class = void>
+struct node_critical_section_selector {
+  using type = empty_critical_section<NodeAllocator>;
+};
+
+template <class NodeAllocator>
+struct node_critical_section_selector<
+    NodeAllocator,
+    void_t<typename NodeAllocator::critical_section>> {
+  using type = typename NodeAllocator::critical_section;
+};
+
+template <class NodeAllocator>
+using node_critical_section_t =
+    typename node_critical_section_selector<NodeAllocator>::type;
+
+// Treiber stack primitives over tagged pointers; each successful CAS increments
+// the tag to avoid ABA problem
+template <class Node>
+struct tagged_freelist {
+  using node_pointer = tagged_pointer<Node>;
+  using node_pointer_holder = atomic<typename node_pointer::placeholder_type>;
+
+  static Node* pop(node_pointer_holder& head) noexcept {
+    auto old_top_value{head.load<memory_order_consume>()};
+    for (;;) {
+      auto old_top{node_pointer{old_top_value}};
+      if (!old_top) {
+        return nullptr;
+      }
+      Node* new_top_ptr{
+          node_pointer{old_top->next.load<memory_order_relaxed>()}
+              .get_pointer()};
+      node_pointer new_top{new_top_ptr, old_top.get_next_tag()};
+
+      // old_top_value may be rewritten
+      if (head.compare_exchange_weak(old_top_value, new_top.get_value())) {
+        return old_top.get_pointer();
+      }
+    }
+  }
+
+  // Publishes a privately linked chain [first, last] with a single CAS
+  static void push(node_pointer_holder& head,
+                   Node* first,
+                   Node* last) noexcept {
+    auto old_top_value{head.load<memory_order_relaxed>()};
+    for (;;) {
+      last->next.store<memory_order_relaxed>(old_top_value);
+      node_pointer new_top{first, node_pointer{old_top_value}.get_next_tag()};
+
+      // old_top_value may be rewritten
+      if (head.compare_exchange_weak(old_top_value, new_top.get_value())) {
+        return;
+      }
+    }
+  }
+
+  // Detaches the whole stack at once
+  static Node* detach(node_pointer_holder& head) noexcept {
+    auto old_top_value{head.load<memory_order_consume>()};
+    for (;;) {
+      auto old_top{node_pointer{old_top_value}};
+      if (!old_top) {
+        return nullptr;
+      }
+      node_pointer empty_top{nullptr, old_top.get_next_tag()};
+      if (head.compare_exchange_weak(old_top_value, empty_top.get_value())) {
+        return old_top.get_pointer();
+      }
+    }
+  }
+
+  // Only for chains which aren't reachable by other threads
+  static Node* next_of(Node* node) noexcept {
+    auto next{node_pointer{node->next.load<memory_order_relaxed>()}};
+    return next ? next.get_pointer() : nullptr;
+  }
+};
+}  // namespace details
+
+/*
+ * node_allocator with per-processor free lists. Nodes are freed to the list of
+ * the current processor and allocated from it; when it is empty, the
+ * allocator steals a batch of nodes from the neighbours before falling back
+ * to BasicNodeAllocator. Memory is returned to the system only on
+ * destruction.
+ */
+template <class Ty,
+          align_val_t Align,
+          template <typename, align_val_t>
+          class BasicNodeAllocator>
+class sharded_node_allocator {
+ public:
+  using value_type = Ty;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  static constexpr size_type STEAL_BATCH_SIZE{32};
+
+ private:
+  static constexpr auto NODE_ALIGNMENT{static_cast<align_val_t>(
+      (max)(crt::CACHE_LINE_SIZE, static_cast<size_type>(Align)))};
+  static constexpr auto SHARD_ALIGNMENT{
+      static_cast<align_val_t>(crt::CACHE_LINE_SIZE)};
+
+ private:
+  struct memory_block_header;
+  using freelist = details::tagged_freelist<memory_block_header>;
+  using node_pointer_holder = typename freelist::node_pointer_holder;
+
+  struct memory_block_header {
+    node_pointer_holder next{};
+  };
+
+  using memory_block =
+      aligned_storage_t<(max)(sizeof(memory_block_header), sizeof(Ty)), 1>;
+
+  ALIGN(crt::CACHE_LINE_SIZE) struct shard {
+    node_pointer_holder head{};
+  };
+
+ public:
+  using allocator_type = BasicNodeAllocator<memory_block, NODE_ALIGNMENT>;
+  using allocator_traits_type = allocator_traits<allocator_type>;
+
+  using propagate_on_container_copy_assignment = false_type;
+  using propagate_on_container_move_assignment = false_type;
+  using propagate_on_container_swap = false_type;
+  using is_always_equal = false_type;
+
+ private:
+  using shard_allocator_type = BasicNodeAllocator<shard, SHARD_ALIGNMENT>;
+  using shard_allocator_traits_type = allocator_traits<shard_allocator_type>;
+
+ public:
+  sharded_node_allocator() : sharded_node_allocator(allocator_type{}) {}
+
+  sharded_node_allocator(const allocator_type& alloc)
+      : m_storage{one_then_variadic_args{}, alloc} {
+    create_shards();
+  }
+
+  sharded_node_allocator(allocator_type&& alloc)
+      : m_storage{one_then_variadic_args{}, move(alloc)} {
+    create_shards();
+  }
+
+  template <class Allocator = allocator_type>
+  sharded_node_allocator(size_type initial_count,
+                         Allocator&& alloc = Allocator{})
+      : m_storage{one_then_variadic_args{}, forward<Allocator>(alloc)} {
+    create_shards();
+    try {
+      for (size_type idx = 0; idx < initial_count; ++idx) {
+        auto* block{as_header(create_memory_block())};
+        freelist::push(get_shard(idx % m_shard_count).head, block, block);
+      }
+    } catch (...) {
+      destroy_shards();
+      throw;
+    }
+  }
+
+  sharded_node_allocator(const sharded_node_allocator&) = delete;
+  sharded_node_allocator(sharded_node_allocator&&) = delete;
+  sharded_node_allocator& operator=(const sharded_node_allocator&) = delete;
+  sharded_node_allocator& operator=(sharded_node_allocator&&) = delete;
+
+  ~sharded_node_allocator() { destroy_shards(); }
+
+  Ty* allocate() {
+    const size_type home{get_home_shard()};
+    auto* block{freelist::pop(get_shard(home).head)};
+    if (!block) {
+      block = steal(home);
+    }
+    return block ? reinterpret_cast<Ty*>(block) : create_memory_block();
+  }
+
+  void deallocate(Ty* ptr) noexcept {
+    auto* block{as_header(ptr)};
+    freelist::push(get_shard(get_home_shard()).head, block, block);
+  }
+
+  [[nodiscard]] size_type get_shard_count() const noexcept {
+    return m_shard_count;
+  }
+
+ private:
+  void create_shards() {
+    const size_type shard_count{
+        KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS)};
+    shard_allocator_type shard_alloc;
+    shard* const shards{
+        shard_allocator_traits_type::allocate(shard_alloc, shard_count)};
+    for (size_type idx = 0; idx < shard_count; ++idx) {
+      construct_at(shards + idx);
+    }
+    get_shards() = shards;
+    m_shard_count = shard_count;
+  }
+
+  // Frees the blocks kept in the shards and the shards themselves
+  void destroy_shards() noexcept {
+    for (size_type idx = 0; idx < m_shard_count; ++idx) {
+      auto* block{freelist::detach(get_shard(idx).head)};
+      while (block) {
+        auto* next{freelist::next_of(block)};
+        destroy_memory_block(reinterpret_cast<Ty*>(block));
+        block = next;
+      }
+    }
+    shard_allocator_type shard_alloc;
+    shard_allocator_traits_type::deallocate(shard_alloc, get_shards(),
+                                            m_shard_count);
+  }
+
+  /*
+   * Pops the first node of a neighbour's list for the caller and moves up to
+   * STEAL_BATCH_SIZE next ones to the home shard. Nodes are taken one by one,
+   * so the rest of the victim's list is never detached or walked
+   */
+  memory_block_header* steal(size_type home) noexcept {
+    using node_pointer = typename freelist::node_pointer;
+
+    for (size_type offset = 1; offset < m_shard_count; ++offset) {
+      auto& victim{get_shard((home + offset) % m_shard_count)};
+      auto* const stolen{freelist::pop(victim.head)};
+      if (!stolen) {
+        continue;
+      }
+      memory_block_header* batch_first{nullptr};
+      memory_block_header* batch_last{nullptr};
+      for (size_type count = 0; count < STEAL_BATCH_SIZE; ++count) {
+        auto* const block{freelist::pop(victim.head)};
+        if (!block) {
+          break;
+        }
+        block->next.store<memory_order_relaxed>(
+            node_pointer{batch_first}.get_value());
+        if (!batch_last) {
+          batch_last = block;
+        }
+        batch_first = block;
+      }
+      if (batch_first) {
+        freelist::push(get_shard(home).head, batch_first, batch_last);
+      }
+      return stolen;
+    }
+    return nullptr;
+  }
+
+  size_type get_home_shard() const noexcept {
+    return KeGetCurrentProcessorNumberEx(nullptr) % m_shard_count;
+  }
+
+  Ty* create_memory_block() {
+    return reinterpret_cast<Ty*>(
+        allocator_traits_type::allocate(get_alloc(), 1));
+  }
+
+  void destroy_memory_block(Ty* target) noexcept {
+    allocator_traits_type::deallocate(
+        get_alloc(), reinterpret_cast<memory_block*>(target), 1);
+  }
+
+  static memory_block_header* as_header(Ty* ptr) noexcept {
+    return reinterpret_cast<memory_block_header*>(ptr);
+  }
+
+  allocator_type& get_alloc() noexcept { return m_storage.get_first(); }
+  shard*& get_shards() noexcept { return m_storage.get_second(); }
+  shard& get_shard(size_type idx) noexcept { return get_shards()[idx]; }
+
+ private:
+  compressed_pair<allocator_type, shard*> m_storage{};
+  size_type m_shard_count{0};
+};
 }  // namespace ktl::lockfree
\ No newline at end of file
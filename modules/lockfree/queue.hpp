@@ -1,5 +1,6 @@
 ﻿#pragma once
 // С " " вместо <> нет необходимости добавлять в зависимости lockfree/ целиком
+#include "epoch_reclamation.hpp"
 #include "node_allocator.hpp"
 
 #include <allocator.hpp>
@@ -8,12 +9,17 @@
 #include <basic_types.hpp>
 #include <crt_attributes.hpp>
 #include <limits.hpp>
+#include <memory_impl.hpp>
 #include <type_traits.hpp>
 
 #include <ntddk.h>
 
 namespace ktl::lockfree {
-template <class Ty, template <typename, align_val_t> class BasicNodeAllocator>
+template <class Ty,
+          template <typename, align_val_t>
+          class BasicNodeAllocator,
+          template <class, align_val_t, template <typename, align_val_t> class>
+          class NodeAllocator = node_allocator>
 class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
  public:
   using value_type = Ty;
@@ -54,10 +60,12 @@ class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
   };
 
   using internal_allocator_type =
-      node_allocator<node,
-                     static_cast<align_val_t>(NODE_ALIGNMENT),
-                     BasicNodeAllocator>;
+      NodeAllocator<node,
+                    static_cast<align_val_t>(NODE_ALIGNMENT),
+                    BasicNodeAllocator>;
   using allocator_traits_type = allocator_traits<internal_allocator_type>;
+  using critical_section_type =
+      details::node_critical_section_t<internal_allocator_type>;
 
  public:
   using allocator_type = typename internal_allocator_type::allocator_type;
@@ -103,6 +111,7 @@ class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
   bool push(const OtherTy& value) {
     auto* new_node{create_data_node(value)};
 
+    critical_section_type guard{m_alc};
     for (;;) {
       auto tail{node_pointer{m_tail.get_ptr().load<memory_order_acquire>()}};
       node* tail_ptr{tail.get_pointer()};
@@ -131,6 +140,7 @@ class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
                             is_nothrow_assignable_v<OtherTy&, Ty>,
                         int> = 0>
   bool pop(OtherTy& value) {
+    critical_section_type guard{m_alc};
     for (;;) {
       auto head{node_pointer{m_head.get_ptr().load<memory_order_acquire>()}};
       node* head_ptr{head.get_pointer()};
@@ -169,6 +179,151 @@ class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
     }
   }
 
+  /*
+   * Links the elements into a private chain and publishes it with a single
+   * CAS on the tail node. Other producers' elements can't get in between
+   */
+  template <class InputIt>
+  bool push_range(InputIt first, InputIt last) {
+    if (first == last) {
+      return true;
+    }
+    node* const chain_head{create_data_node(*first)};
+    node* chain_tail{chain_head};
+    try {
+      for (++first; first != last; ++first) {
+        node* const new_node{create_data_node(*first)};
+        node_pointer next{chain_tail->next.load<memory_order_relaxed>()};
+        chain_tail->next.store<memory_order_relaxed>(
+            node_pointer{new_node, next.get_next_tag()}.get_value());
+        chain_tail = new_node;
+      }
+    } catch (...) {
+      destroy_chain(chain_head, nullptr);
+      throw;
+    }
+
+    critical_section_type guard{m_alc};
+    for (;;) {
+      auto tail{node_pointer{m_tail.get_ptr().load<memory_order_acquire>()}};
+      node* tail_ptr{tail.get_pointer()};
+      auto next{node_pointer{tail_ptr->next.load<memory_order_acquire>()}};
+
+      node_pointer current_tail{m_tail.get_ptr().load<memory_order_acquire>()};
+      if (tail == current_tail) {
+        if (!next) {
+          node_pointer new_tail_next{chain_head, next.get_next_tag()};
+
+          if (cas_weak_helper(tail_ptr->next, next, new_tail_next)) {
+            // Other threads may have already moved the tail into the chain
+            node_pointer new_tail{chain_tail, tail.get_next_tag()};
+            cas_strong_helper(m_tail.get_ptr(), tail, new_tail);
+            return true;
+          }
+        } else {
+          node_pointer new_tail{next.get_pointer(), tail.get_next_tag()};
+          cas_strong_helper(m_tail.get_ptr(), tail, new_tail);
+        }
+      }
+    }
+  }
+
+  /*
+   * Pops up to max_count elements with a single CAS on the head. The values
+   * are speculatively copied before the CAS, so the output positions are
+   * rewritten on retry and OutputIt must be a forward iterator (or a pointer).
+   * Returns the popped count
+   */
+  template <class ForwardIt,
+            enable_if_t<is_nothrow_assignable_v<decltype(*declval<ForwardIt>()),
+                                                const Ty&>,
+                        int> = 0>
+  size_type pop_bulk(ForwardIt out, size_type max_count) {
+    if (max_count == 0) {
+      return 0;
+    }
+    critical_section_type guard{m_alc};
+    for (;;) {
+      auto head{node_pointer{m_head.get_ptr().load<memory_order_acquire>()}};
+      node* head_ptr{head.get_pointer()};
+
+      auto tail{node_pointer{m_tail.get_ptr().load<memory_order_acquire>()}};
+      auto next{node_pointer{head_ptr->next.load<memory_order_acquire>()}};
+
+      node_pointer current_head{m_head.get_ptr().load<memory_order_acquire>()};
+      if (head != current_head) {
+        continue;
+      }
+      if (head == tail) {
+        if (!next) {
+          return 0;
+        }
+        node_pointer new_tail{next.get_pointer(), tail.get_next_tag()};
+        cas_strong_helper(m_tail.get_ptr(), tail, new_tail);
+        continue;
+      }
+
+      // Never move the head past the tail observed above
+      node* last_ptr{head_ptr};
+      size_type count{0};
+      auto dst{out};
+      while (count < max_count && last_ptr != tail.get_pointer()) {
+        node* const next_ptr{
+            node_pointer{last_ptr->next.load<memory_order_acquire>()}
+                .get_pointer()};
+        if (!next_ptr) {
+          break;  // The node has been recycled by another consumer
+        }
+        *dst = next_ptr->value;
+        ++dst;
+        ++count;
+        last_ptr = next_ptr;
+      }
+      if (count == 0) {
+        continue;
+      }
+
+      node_pointer new_head{last_ptr, head.get_next_tag()};
+      if (cas_weak_helper(m_head.get_ptr(), head, new_head)) {
+        destroy_chain(head_ptr, last_ptr);
+        return count;
+      }
+    }
+  }
+
+  /*
+   * Detaches all the elements published up to the current tail with a single
+   * CAS and passes them to fn in FIFO order. fn must not throw. Returns
+   * the consumed count
+   */
+  template <class Fn>
+  size_type consume_all(Fn fn) {
+    node* head_ptr;
+    node* tail_ptr;
+    aligned_storage_t<sizeof(Ty), alignof(Ty)> last_value_storage;
+    Ty* const last_value{reinterpret_cast<Ty*>(addressof(last_value_storage))};
+    if (!detach_published(head_ptr, tail_ptr, last_value)) {
+      return 0;
+    }
+
+    // The detached nodes are owned by the caller and are walked outside of
+    // the critical section
+    size_type count{0};
+    for (node* current = head_ptr; current != tail_ptr; ++count) {
+      node* const next_ptr{
+          node_pointer{current->next.load<memory_order_relaxed>()}
+              .get_pointer()};
+      destroy_node(node_pointer{current, 0});
+      if (next_ptr == tail_ptr) {
+        fn(*last_value);
+      } else {
+        fn(next_ptr->value);
+      }
+      current = next_ptr;
+    }
+    return count;
+  }
+
   constexpr size_t max_size() const noexcept {
     return (numeric_limits<size_t>::max)();
   }
@@ -194,6 +349,53 @@ class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
     return allocator_traits_type::construct(m_alc, node, value);
   }
 
+  /*
+   * Moves the head to the observed tail. The tail node becomes the new dummy
+   * and may be recycled by another consumer as soon as the CAS succeeds,
+   * so its value is copied into the uninitialized last_value before. Ty is
+   * trivially destructible, so a retry just constructs it again
+   */
+  bool detach_published(node*& head_ptr, node*& tail_ptr, Ty* last_value) {
+    critical_section_type guard{m_alc};
+    for (;;) {
+      auto head{node_pointer{m_head.get_ptr().load<memory_order_acquire>()}};
+      head_ptr = head.get_pointer();
+
+      auto tail{node_pointer{m_tail.get_ptr().load<memory_order_acquire>()}};
+      tail_ptr = tail.get_pointer();
+      auto next{node_pointer{head_ptr->next.load<memory_order_acquire>()}};
+
+      node_pointer current_head{m_head.get_ptr().load<memory_order_acquire>()};
+      if (head != current_head) {
+        continue;
+      }
+      if (head == tail) {
+        if (!next) {
+          return false;
+        }
+        node_pointer new_tail{next.get_pointer(), tail.get_next_tag()};
+        cas_strong_helper(m_tail.get_ptr(), tail, new_tail);
+        continue;
+      }
+
+      construct_at(last_value, tail_ptr->value);
+      node_pointer new_head{tail_ptr, head.get_next_tag()};
+      if (cas_weak_helper(m_head.get_ptr(), head, new_head)) {
+        return true;
+      }
+    }
+  }
+
+  // Destroys nodes from first up to last (exclusive)
+  void destroy_chain(node* first, node* last) {
+    while (first != last) {
+      node* const next{
+          node_pointer{first->next.load<memory_order_relaxed>()}.get_pointer()};
+      destroy_node(node_pointer{first, 0});
+      first = next;
+    }
+  }
+
   void destroy_node(node_pointer target) {
     // node is guaranteed to be trivially destructible
     allocator_traits_type::deallocate_single_object(m_alc,
@@ -282,9 +484,130 @@ class mpmc_queue : public non_relocatable {  // multi-producer, multi-consumer
   internal_allocator_type m_alc{};
 };  // namespace ktl::lockfree
 
+/*
+ * Element of mpsc_queue must be derived from this hook. An element can be
+ * linked into only one queue at a time and must outlive its stay in it
+ */
+struct mpsc_queue_hook {
+  mpsc_queue_hook() noexcept = default;
+
+  // Copies of an element aren't linked anywhere
+  mpsc_queue_hook(const mpsc_queue_hook&) noexcept {}
+  mpsc_queue_hook& operator=(const mpsc_queue_hook&) noexcept { return *this; }
+
+  atomic<mpsc_queue_hook*> next{nullptr};
+};
+
+/*
+ * Intrusive multi-producer, single-consumer queue (D. Vyukov, "Intrusive
+ * MPSC node-based queue", 2010).
+ *
+ * push() is wait-free: producers swap the head with a single exchange,
+ * which can't suffer from ABA, so neither tagged pointers nor node recycling
+ * are needed. pop() is lock-free for the only consumer, but it may
+ * temporarily see the queue as empty while a producer is between
+ * the exchange and the link store. Nothing is allocated at all, so both ends
+ * are allowed at any IRQL the elements are accessible at.
+ */
+template <class Ty>
+class mpsc_queue : public non_relocatable {
+ public:
+  using value_type = Ty;
+  using reference = Ty&;
+  using const_reference = const Ty&;
+  using pointer = Ty*;
+  using const_pointer = const Ty*;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+ private:
+  using hook_type = mpsc_queue_hook;
+
+  ALIGN(crt::CACHE_LINE_SIZE) struct aligned_hook_pointer_holder {
+    atomic<hook_type*>& get_ptr() noexcept { return ptr; }
+    const atomic<hook_type*>& get_ptr() const noexcept { return ptr; }
+
+    atomic<hook_type*> ptr{nullptr};
+  };
+
+ public:
+  mpsc_queue() noexcept {
+    static_assert(is_base_of_v<hook_type, Ty>,
+                  "Ty must be derived from mpsc_queue_hook");
+    m_head.get_ptr().store<memory_order_relaxed>(&m_stub);
+  }
+
+  // May be called by any number of producers concurrently
+  void push(Ty& value) noexcept { push_hook(static_cast<hook_type&>(value)); }
+
+  // Returns nullptr if the queue is empty. Only one consumer is allowed
+  Ty* pop() noexcept {
+    hook_type* tail{m_tail.load<memory_order_relaxed>()};
+    hook_type* next{tail->next.load<memory_order_acquire>()};
+    if (tail == &m_stub) {
+      if (!next) {
+        return nullptr;
+      }
+      m_tail.store<memory_order_relaxed>(next);
+      tail = next;
+      next = next->next.load<memory_order_acquire>();
+    }
+    if (next) {
+      m_tail.store<memory_order_relaxed>(next);
+      return static_cast<Ty*>(tail);
+    }
+    if (tail != m_head.get_ptr().load<memory_order_acquire>()) {
+      return nullptr;  // A producer hasn't linked its element yet
+    }
+    push_hook(m_stub);
+    next = tail->next.load<memory_order_acquire>();
+    if (next) {
+      m_tail.store<memory_order_relaxed>(next);
+      return static_cast<Ty*>(tail);
+    }
+    return nullptr;
+  }
+
+  /*
+   * May be called by producers as well as by the consumer. The result may be
+   * outdated by the time it is returned
+   */
+  [[nodiscard]] bool empty_approx() const noexcept {
+    return m_tail.load<memory_order_relaxed>() == &m_stub &&
+           !m_stub.next.load<memory_order_acquire>();
+  }
+
+ private:
+  void push_hook(hook_type& hook) noexcept {
+    hook.next.store<memory_order_relaxed>(nullptr);
+    hook_type* const prev{m_head.get_ptr().exchange(&hook)};
+    prev->next.store<memory_order_release>(&hook);
+  }
+
+ private:
+  aligned_hook_pointer_holder m_head{};  // Producers' end
+  atomic<hook_type*> m_tail{&m_stub};    // Consumer's end, read by anyone
+  hook_type m_stub{};
+};
+
 template <class Ty>
 using queue = mpmc_queue<Ty, aligned_paged_allocator>;
 
 template <class Ty>
 using queue_non_paged = mpmc_queue<Ty, aligned_non_paged_allocator>;
+
+// Node free lists are sharded per processor to reduce contention
+template <class Ty>
+using sharded_queue =
+    mpmc_queue<Ty, aligned_paged_allocator, sharded_node_allocator>;
+
+template <class Ty>
+using sharded_queue_non_paged =
+    mpmc_queue<Ty, aligned_non_paged_allocator, sharded_node_allocator>;
+
+// Nodes are returned to the pool through default_epoch_domain
+template <class Ty>
+using reclaiming_queue = mpmc_queue<Ty,
+                                    aligned_non_paged_allocator,
+                                    reclaiming_node_allocator>;
 }  // namespace ktl::lockfree
@@ -0,0 +1,448 @@
+#pragma once
+#include <atomic.hpp>
+#include <basic_types.hpp>
+#include <chrono.hpp>
+#include <functional.hpp>
+#include <ktlexcept.hpp>
+#include <mutex.hpp>
+#include <new_delete.hpp>
+#include <optional.hpp>
+#include <thread.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#include "work_stealing_deque.hpp"
+
+#include <ntddk.h>
+
+namespace ktl::lockfree {
+namespace details {
+struct pool_task {
+  using executor_type = void (*)(pool_task*) noexcept;
+
+  explicit pool_task(executor_type executor_) noexcept : execute{executor_} {}
+
+  pool_task* next{nullptr};  // Link in the injection queue
+  executor_type execute;
+};
+
+/*
+ * Shared by a completion_handle and the tasks of a single submission.
+ * The tasks collectively hold one reference which is dropped by the last
+ * of them
+ */
+class completion_state : non_relocatable {
+ public:
+  explicit completion_state(size_t task_count) noexcept
+      : m_pending_count{task_count} {}
+
+  virtual ~completion_state() noexcept = default;
+
+  void complete(NTSTATUS status) noexcept {
+    if (!NT_SUCCESS(status)) {
+      NTSTATUS expected{STATUS_SUCCESS};
+      m_status.compare_exchange_strong(expected, status);  // The first error
+    }
+    if (--m_pending_count == 0) {
+      m_done.set();
+      release();
+    }
+  }
+
+  void release() noexcept {
+    if (--m_ref_count == 0) {
+      delete this;
+    }
+  }
+
+  [[nodiscard]] notify_event& get_event() noexcept { return m_done; }
+
+  [[nodiscard]] NTSTATUS get_status() const noexcept {
+    return m_status.load<memory_order_acquire>();
+  }
+
+ private:
+  atomic<size_t> m_ref_count{2};
+  atomic<size_t> m_pending_count;
+  atomic<NTSTATUS> m_status{STATUS_SUCCESS};
+  notify_event m_done;
+};
+
+template <class Fn>
+class bulk_state : public completion_state {
+ public:
+  template <class FnTy>
+  bulk_state(size_t task_count, FnTy&& fn)
+      : completion_state(task_count), m_fn(forward<FnTy>(fn)) {}
+
+  Fn& get_fn() noexcept { return m_fn; }
+
+ private:
+  Fn m_fn;
+};
+
+// Calls fn(idx) for each idx in [first, last)
+template <class Fn>
+struct chunk_task : pool_task {
+  chunk_task(bulk_state<Fn>& state_, size_t first_, size_t last_) noexcept
+      : pool_task(&run), state{addressof(state_)}, first{first_}, last{last_} {}
+
+  static void run(pool_task* task) noexcept {
+    auto* const self{static_cast<chunk_task*>(task)};
+    bulk_state<Fn>* const state{self->state};
+    NTSTATUS status{STATUS_SUCCESS};
+    try {
+      for (size_t idx = self->first; idx < self->last; ++idx) {
+        invoke(state->get_fn(), idx);
+      }
+    } catch (const exception& exc) {
+      status = exc.code();
+    } catch (...) {
+      status = STATUS_UNHANDLED_EXCEPTION;
+    }
+    delete self;
+    state->complete(status);
+  }
+
+  bulk_state<Fn>* state;
+  size_t first;
+  size_t last;
+};
+}  // namespace details
+
+/*
+ * Result of thread_pool::submit() or thread_pool::bulk_submit(). Destroying
+ * the handle doesn't cancel or wait for the submitted work
+ */
+class completion_handle : non_copyable {
+ public:
+  constexpr completion_handle() noexcept = default;
+
+  explicit completion_handle(details::completion_state* state) noexcept
+      : m_state{state} {}
+
+  completion_handle(completion_handle&& other) noexcept
+      : m_state{exchange(other.m_state, nullptr)} {}
+
+  completion_handle& operator=(completion_handle&& other) noexcept {
+    if (this != addressof(other)) {
+      reset();
+      m_state = exchange(other.m_state, nullptr);
+    }
+    return *this;
+  }
+
+  ~completion_handle() noexcept { reset(); }
+
+  [[nodiscard]] bool valid() const noexcept { return m_state != nullptr; }
+
+  [[nodiscard]] bool is_ready() const noexcept {
+    return m_state->get_event().is_signaled();
+  }
+
+  // IRQL < DISPATCH_LEVEL
+  void wait() const noexcept { m_state->get_event().wait(); }
+
+  template <class Rep, class Period>
+  bool wait_for(
+      const chrono::duration<Rep, Period>& wait_duration) const noexcept {
+    return m_state->get_event().wait_for(wait_duration) ==
+           cv_status::no_timeout;
+  }
+
+  /*
+   * Waits for completion and returns the code of the first exception thrown
+   * by the submitted work (STATUS_UNHANDLED_EXCEPTION for non-KTL ones) or
+   * STATUS_SUCCESS
+   */
+  NTSTATUS get_status() const noexcept {
+    wait();
+    return m_state->get_status();
+  }
+
+  void swap(completion_handle& other) noexcept {
+    ktl::swap(m_state, other.m_state);
+  }
+
+ private:
+  void reset() noexcept {
+    if (m_state) {
+      exchange(m_state, nullptr)->release();
+    }
+  }
+
+ private:
+  details::completion_state* m_state{nullptr};
+};
+
+inline void swap(completion_handle& lhs, completion_handle& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+/*
+ * Fixed-size pool of system threads with one work_stealing_deque per worker.
+ *
+ * Work submitted by a worker goes to its own deque and is executed LIFO,
+ * other work goes to a shared injection queue; idle workers take from the
+ * injection queue and then steal from the other deques. Workers sleep on
+ * a semaphore when there is nothing to do.
+ *
+ * Exceptions thrown by the submitted work are caught and reported through
+ * completion_handle::get_status(). The destructor (or shutdown()) waits until
+ * all submitted work is done, including the work it submits in turn.
+ *
+ * submit() and bulk_submit() may be called at IRQL <= DISPATCH_LEVEL, so
+ * the pool itself must be non-paged; work is executed at PASSIVE_LEVEL.
+ * Only the workers may submit while shutdown() is in progress.
+ */
+class thread_pool : non_relocatable {
+ public:
+  using size_type = size_t;
+
+  static constexpr size_type CHUNKS_PER_WORKER{4};  // For bulk_submit()
+
+ private:
+  using task_type = details::pool_task*;
+
+  struct worker {
+    work_stealing_deque<task_type> tasks;
+    system_thread thread;
+    uint32_t random_state{0};
+  };
+
+ public:
+  explicit thread_pool(
+      size_type worker_count = system_thread::hardware_concurrency()) {
+    start(worker_count);
+  }
+
+  // Every worker is restricted to the processors of the affinity
+  thread_pool(size_type worker_count, const GROUP_AFFINITY& affinity)
+      : m_affinity{affinity} {
+    start(worker_count);
+  }
+
+  ~thread_pool() noexcept {
+    shutdown();
+    delete[] m_workers;
+  }
+
+  template <class Fn>
+  completion_handle submit(Fn&& fn) {
+    return bulk_submit(
+        1, [fn = forward<Fn>(fn)](size_type) mutable { invoke(fn); });
+  }
+
+  /*
+   * Calls fn(idx) for each idx in [0, count), splitting the range into
+   * at most CHUNKS_PER_WORKER chunks per worker. The same fn is invoked
+   * from several workers concurrently
+   */
+  template <class Fn>
+  completion_handle bulk_submit(size_type count, Fn&& fn) {
+    using state_type = details::bulk_state<decay_t<Fn>>;
+    using chunk_type = details::chunk_task<decay_t<Fn>>;
+
+    throw_exception_if_not<kernel_error>(
+        !m_stopping.load<memory_order_relaxed>() || find_current_worker(),
+        STATUS_TOO_LATE, "thread pool is shutting down");
+
+    const size_type chunk_count{
+        (min)(count, m_worker_count * CHUNKS_PER_WORKER)};
+    auto* const state{new (non_paged_new)
+                          state_type{(max)(chunk_count, size_type{1}),
+                                     forward<Fn>(fn)}};
+    completion_handle handle{state};
+    if (chunk_count == 0) {
+      state->complete(STATUS_SUCCESS);
+      return handle;
+    }
+
+    task_type first{nullptr};
+    task_type last{nullptr};
+    try {
+      for (size_type idx = 0; idx < chunk_count; ++idx) {
+        auto* const chunk{new (non_paged_new) chunk_type{
+            *state, count * idx / chunk_count,
+            count * (idx + 1) / chunk_count}};
+        if (!first) {
+          first = chunk;
+        } else {
+          last->next = chunk;
+        }
+        last = chunk;
+      }
+    } catch (...) {
+      while (first) {
+        delete static_cast<chunk_type*>(exchange(first, first->next));
+      }
+      state->release();  // The reference of the tasks
+      throw;
+    }
+    enqueue(first, last, chunk_count);
+    return handle;
+  }
+
+  /*
+   * Waits until all submitted work is done and stops the workers.
+   * Must be called at PASSIVE_LEVEL and not from a worker
+   */
+  void shutdown() noexcept {
+    if (!m_workers || m_stopping.exchange(true)) {
+      return;
+    }
+    for (size_type idx = 0; idx < m_worker_count; ++idx) {
+      m_wakeup.release();
+    }
+    for (size_type idx = 0; idx < m_worker_count; ++idx) {
+      if (auto& thread = m_workers[idx].thread; thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+  [[nodiscard]] size_type get_worker_count() const noexcept {
+    return m_worker_count;
+  }
+
+ private:
+  void start(size_type worker_count) {
+    m_worker_count = (max)(worker_count, size_type{1});
+    m_workers = new (non_paged_new) worker[m_worker_count];
+    try {
+      for (size_type idx = 0; idx < m_worker_count; ++idx) {
+        auto& target{m_workers[idx]};
+        target.random_state = static_cast<uint32_t>(idx) * 2654435761u + 1;
+        target.thread = system_thread{[this, idx] { run_worker(idx); }};
+      }
+    } catch (...) {
+      shutdown();
+      delete[] exchange(m_workers, nullptr);
+      throw;
+    }
+  }
+
+  void run_worker(size_type idx) noexcept {
+    GROUP_AFFINITY prev_affinity;
+    if (m_affinity.has_value()) {
+      KeSetSystemGroupAffinityThread(addressof(*m_affinity),
+                                     addressof(prev_affinity));
+    }
+    for (;;) {
+      if (task_type task = find_task(idx); task) {
+        task->execute(task);
+        continue;
+      }
+      if (m_pending_count.load() == 0 &&
+          m_stopping.load<memory_order_acquire>()) {
+        break;
+      }
+      // Pairs with the increment of the pending count in enqueue()
+      ++m_idle_count;
+      if (m_pending_count.load() == 0 &&
+          !m_stopping.load<memory_order_acquire>()) {
+        m_wakeup.acquire();
+      }
+      --m_idle_count;
+    }
+    if (m_affinity.has_value()) {
+      KeRevertToUserGroupAffinityThread(addressof(prev_affinity));
+    }
+  }
+
+  task_type find_task(size_type idx) noexcept {
+    task_type task{nullptr};
+    auto& self{m_workers[idx]};
+    if (!self.tasks.pop(task) && !(task = take_injected()) &&
+        !steal(self, idx, task)) {
+      return nullptr;
+    }
+    --m_pending_count;
+    return task;
+  }
+
+  bool steal(worker& self, size_type idx, task_type& task) noexcept {
+    // xorshift32 spreads thieves over the victims
+    uint32_t state{self.random_state};
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    self.random_state = state;
+
+    const size_type first_victim{state % m_worker_count};
+    for (size_type offset = 0; offset < m_worker_count; ++offset) {
+      const size_type victim{(first_victim + offset) % m_worker_count};
+      if (victim != idx && m_workers[victim].tasks.steal(task)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void enqueue(task_type first, task_type last, size_type count) noexcept {
+    m_pending_count += count;
+    if (worker* const self = find_current_worker(); self) {
+      try {
+        // The pushed task may be stolen and destroyed right away
+        for (task_type next; first; first = next) {
+          next = first->next;
+          self->tasks.push(first);
+        }
+      } catch (...) {
+        // The deque couldn't grow: the rest goes to the injection queue
+      }
+    }
+    if (first) {
+      inject(first, last);
+    }
+    for (size_type woken = 0; woken < count && m_idle_count.load() > woken;
+         ++woken) {
+      m_wakeup.release();
+    }
+  }
+
+  void inject(task_type first, task_type last) noexcept {
+    lock_guard guard{m_injection_lock};
+    if (m_injected_tail) {
+      m_injected_tail->next = first;
+    } else {
+      m_injected_head = first;
+    }
+    m_injected_tail = last;
+  }
+
+  task_type take_injected() noexcept {
+    lock_guard guard{m_injection_lock};
+    task_type task{m_injected_head};
+    if (task) {
+      m_injected_head = task->next;
+      if (!m_injected_head) {
+        m_injected_tail = nullptr;
+      }
+    }
+    return task;
+  }
+
+  worker* find_current_worker() const noexcept {
+    const auto current_thread{PsGetCurrentThread()};
+    for (size_type idx = 0; idx < m_worker_count; ++idx) {
+      if (m_workers[idx].thread.native_handle() == current_thread) {
+        return m_workers + idx;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  worker* m_workers{nullptr};
+  size_type m_worker_count{0};
+  optional<GROUP_AFFINITY> m_affinity;
+  atomic<size_type> m_pending_count{0};  // Submitted, but not taken yet
+  atomic<size_type> m_idle_count{0};
+  atomic<bool> m_stopping{false};
+  semaphore m_wakeup{0};
+  spin_lock<> m_injection_lock;
+  task_type m_injected_head{nullptr};
+  task_type m_injected_tail{nullptr};
+};
+}  // namespace ktl::lockfree
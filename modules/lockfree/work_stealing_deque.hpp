@@ -0,0 +1,218 @@
+#pragma once
+#include <allocator.hpp>
+#include <atomic.hpp>
+#include <basic_types.hpp>
+#include <crt_attributes.hpp>
+#include <ktlexcept.hpp>
+#include <limits.hpp>
+#include <memory_impl.hpp>
+#include <type_traits.hpp>
+#include <utility.hpp>
+
+#include <ntddk.h>
+
+namespace ktl::lockfree {
+/*
+ * Work-stealing deque (D. Chase, Y. Lev, "Dynamic Circular Work-Stealing
+ * Deque", 2005; memory orders follow N. M. Le et al., "Correct and Efficient
+ * Work-Stealing for Weak Memory Models", 2013).
+ *
+ * The owner pushes and pops at the bottom without any interlocked operations
+ * except when only one element is left; any other thread may steal from the
+ * top with a single CAS. The ring doubles when it is full. Thieves may still
+ * read the previous ring, so replaced rings are kept until the deque is
+ * destroyed: their total size never exceeds the size of the current one.
+ *
+ * Elements are copied by racing readers, so Ty must be trivially copyable
+ * and fit into a lock-free atomic (pointers to tasks are the typical case).
+ */
+template <class Ty,
+          template <typename, align_val_t> class BasicAllocator =
+              aligned_non_paged_allocator>
+class work_stealing_deque : public non_relocatable {
+ public:
+  using value_type = Ty;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+
+  static constexpr size_type DEFAULT_CAPACITY{64};
+  static constexpr size_type MIN_CAPACITY{2};
+
+  static_assert(is_trivially_copyable_v<Ty> && atomic<Ty>::is_always_lock_free,
+                "Ty must be trivially copyable and lock-free atomic");
+
+ private:
+  using cell = atomic<Ty>;
+
+  struct ring {
+    explicit ring(size_type capacity) noexcept : mask{capacity - 1} {}
+
+    cell& get(difference_type position) const noexcept {
+      return cells[static_cast<size_type>(position) & mask];
+    }
+
+    [[nodiscard]] size_type get_capacity() const noexcept { return mask + 1; }
+
+    size_type mask;
+    cell* cells{nullptr};
+    ring* replaced{nullptr};  // Kept alive for thieves until destruction
+  };
+
+  ALIGN(crt::CACHE_LINE_SIZE) struct aligned_position {
+    atomic<difference_type>& get() noexcept { return value; }
+    const atomic<difference_type>& get() const noexcept { return value; }
+
+    atomic<difference_type> value{0};
+  };
+
+  using ring_allocator_type =
+      BasicAllocator<ring, static_cast<align_val_t>(alignof(ring))>;
+  using ring_allocator_traits_type = allocator_traits<ring_allocator_type>;
+  using cell_allocator_type =
+      BasicAllocator<cell, static_cast<align_val_t>(crt::CACHE_LINE_SIZE)>;
+  using cell_allocator_traits_type = allocator_traits<cell_allocator_type>;
+
+ public:
+  // Capacity is rounded up to the nearest power of 2
+  explicit work_stealing_deque(size_type capacity = DEFAULT_CAPACITY)
+      : m_ring{create_ring(round_capacity(capacity))} {}
+
+  // Must not be called concurrently with other operations
+  ~work_stealing_deque() noexcept {
+    ring* target{m_ring.load<memory_order_relaxed>()};
+    while (target) {
+      ring* const replaced{target->replaced};
+      destroy_ring(target);
+      target = replaced;
+    }
+  }
+
+  // Owner only. Throws bad_alloc if the ring is full and can't grow
+  void push(const Ty& value) {
+    const difference_type bottom{m_bottom.get().load<memory_order_relaxed>()};
+    const difference_type top{m_top.get().load<memory_order_acquire>()};
+    ring* current{m_ring.load<memory_order_relaxed>()};
+    if (bottom - top > static_cast<difference_type>(current->mask)) {
+      current = grow(current, top, bottom);
+    }
+    current->get(bottom).store<memory_order_relaxed>(value);
+    m_bottom.get().store<memory_order_release>(bottom + 1);
+  }
+
+  // Owner only. Takes the most recently pushed element
+  bool pop(Ty& value) noexcept {
+    const difference_type bottom{
+        m_bottom.get().load<memory_order_relaxed>() - 1};
+    ring* const current{m_ring.load<memory_order_relaxed>()};
+    m_bottom.get().store<memory_order_relaxed>(bottom);
+    atomic_thread_fence<memory_order_seq_cst>();
+
+    difference_type top{m_top.get().load<memory_order_relaxed>()};
+    if (top > bottom) {
+      m_bottom.get().store<memory_order_relaxed>(bottom + 1);
+      return false;
+    }
+    value = current->get(bottom).load<memory_order_relaxed>();
+    if (top < bottom) {
+      return true;
+    }
+    // The last element is contended by thieves
+    const bool taken{m_top.get().compare_exchange_strong(top, top + 1)};
+    m_bottom.get().store<memory_order_relaxed>(bottom + 1);
+    return taken;
+  }
+
+  /*
+   * Any thread. Takes the least recently pushed element. May fail spuriously
+   * if another thread takes the same element concurrently
+   */
+  bool steal(Ty& value) noexcept {
+    difference_type top{m_top.get().load<memory_order_acquire>()};
+    atomic_thread_fence<memory_order_seq_cst>();
+    const difference_type bottom{m_bottom.get().load<memory_order_acquire>()};
+    if (top >= bottom) {
+      return false;
+    }
+    ring* const current{m_ring.load<memory_order_acquire>()};
+    const Ty candidate{current->get(top).load<memory_order_relaxed>()};
+    if (!m_top.get().compare_exchange_strong(top, top + 1)) {
+      return false;
+    }
+    value = candidate;
+    return true;
+  }
+
+  [[nodiscard]] size_type capacity() const noexcept {
+    return m_ring.load<memory_order_relaxed>()->get_capacity();
+  }
+
+  // The result may be outdated by the time it is returned
+  [[nodiscard]] size_type size_approx() const noexcept {
+    const difference_type bottom{m_bottom.get().load<memory_order_relaxed>()};
+    const difference_type top{m_top.get().load<memory_order_relaxed>()};
+    return bottom > top ? static_cast<size_type>(bottom - top) : 0;
+  }
+
+  [[nodiscard]] bool empty_approx() const noexcept {
+    return size_approx() == 0;
+  }
+
+ private:
+  static size_type round_capacity(size_type capacity) {
+    constexpr size_type MAX_CAPACITY{
+        (numeric_limits<size_type>::max)() / sizeof(cell) / 2 + 1};
+    throw_exception_if_not<length_error>(capacity <= MAX_CAPACITY,
+                                         "deque capacity is too large");
+    size_type rounded{MIN_CAPACITY};
+    while (rounded < capacity) {
+      rounded <<= 1;
+    }
+    return rounded;
+  }
+
+  ring* grow(ring* current, difference_type top, difference_type bottom) {
+    ring* const grown{create_ring(round_capacity(current->get_capacity() * 2))};
+    for (difference_type pos = top; pos < bottom; ++pos) {
+      grown->get(pos).store<memory_order_relaxed>(
+          current->get(pos).load<memory_order_relaxed>());
+    }
+    grown->replaced = current;
+    m_ring.store<memory_order_release>(grown);
+    return grown;
+  }
+
+  ring* create_ring(size_type capacity) {
+    ring* const target{ring_allocator_traits_type::allocate(m_ring_alc, 1)};
+    construct_at(target, capacity);
+    try {
+      target->cells =
+          cell_allocator_traits_type::allocate(m_cell_alc, capacity);
+    } catch (...) {
+      ring_allocator_traits_type::deallocate(m_ring_alc, target, 1);
+      throw;
+    }
+    for (size_type idx = 0; idx < capacity; ++idx) {
+      construct_at(target->cells + idx);
+    }
+    return target;
+  }
+
+  void destroy_ring(ring* target) noexcept {
+    const size_type capacity{target->get_capacity()};
+    for (size_type idx = 0; idx < capacity; ++idx) {
+      destroy_at(target->cells + idx);
+    }
+    cell_allocator_traits_type::deallocate(m_cell_alc, target->cells,
+                                           capacity);
+    destroy_at(target);
+    ring_allocator_traits_type::deallocate(m_ring_alc, target, 1);
+  }
+
+ private:
+  aligned_position m_top;
+  aligned_position m_bottom;
+  ring_allocator_type m_ring_alc{};
+  cell_allocator_type m_cell_alc{};
+  atomic<ring*> m_ring;
+};
+}  // namespace ktl::lockfree
@@ -3,8 +3,10 @@
 #include <algorithm>
 namespace ktl {
 using std::binary_search;
+using std::lower_bound;
 using std::max;
 using std::min;
+using std::upper_bound;
 }  // namespace ktl
 #else
 #include <iterator_impl.hpp>
@@ -35,6 +37,81 @@ constexpr bool binary_search(ForwardIt first, ForwardIt last, const Ty& value) {
   return binary_search(first, last, value, less<>{});
 }
 
+namespace algo::details {
+template <class ForwardIt>
+inline constexpr bool is_random_access_v =
+    is_base_of_v<random_access_iterator_tag,
+                 typename iterator_traits<ForwardIt>::iterator_category>;
+
+// Random access ranges are halved without branching on the comparison
+// result, which compiles to a conditional move instead of a hard to predict
+// jump. IsBefore(elem) tells whether elem precedes the bound
+template <class ForwardIt, class IsBefore>
+constexpr ForwardIt partition_point_impl(ForwardIt first,
+                                         ForwardIt last,
+                                         IsBefore is_before) {
+  auto count{distance(first, last)};
+  if constexpr (is_random_access_v<ForwardIt>) {
+    if (count == 0) {
+      return first;
+    }
+    while (count > 1) {
+      const auto half{count / 2};
+      first = is_before(first[half]) ? first + half : first;
+      count -= half;
+    }
+    return first + static_cast<decltype(count)>(is_before(*first));
+  } else {
+    while (0 < count) {
+      const auto count_half{count / 2};
+      if (auto middle = next(first, count_half); is_before(*middle)) {
+        first = next(middle);
+        count -= count_half + 1;
+      } else {
+        count = count_half;
+      }
+    }
+    return first;
+  }
+}
+}  // namespace algo::details
+
+template <class ForwardIt, class Ty, class Compare>
+constexpr ForwardIt lower_bound(ForwardIt first,
+                                ForwardIt last,
+                                const Ty& value,
+                                Compare comp) {
+  return algo::details::partition_point_impl(
+      first, last, [&value, &comp](const auto& elem) -> bool {
+        return comp(elem, value);
+      });
+}
+
+template <class ForwardIt, class Ty>
+constexpr ForwardIt lower_bound(ForwardIt first,
+                                ForwardIt last,
+                                const Ty& value) {
+  return lower_bound(first, last, value, less<>{});
+}
+
+template <class ForwardIt, class Ty, class Compare>
+constexpr ForwardIt upper_bound(ForwardIt first,
+                                ForwardIt last,
+                                const Ty& value,
+                                Compare comp) {
+  return algo::details::partition_point_impl(
+      first, last, [&value, &comp](const auto& elem) -> bool {
+        return !comp(value, elem);
+      });
+}
+
+template <class ForwardIt, class Ty>
+constexpr ForwardIt upper_bound(ForwardIt first,
+                                ForwardIt last,
+                                const Ty& value) {
+  return upper_bound(first, last, value, less<>{});
+}
+
 template <class Ty1, class Ty2>
 constexpr decltype(auto)(min)(const Ty1& lhs,
                               const Ty2& rhs) noexcept(noexcept(rhs < lhs)) {
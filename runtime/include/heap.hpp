@@ -30,6 +30,7 @@ inline constexpr auto MAX_ALLOCATION_ALIGNMENT{static_cast<align_val_t>(MEMORY_P
 // clang-format on
 
 void initialize_heap() noexcept;
+void finalize_heap() noexcept;
 }  // namespace crt
 
 namespace heap::details {
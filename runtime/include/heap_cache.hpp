@@ -0,0 +1,374 @@
+#pragma once
+#include <basic_types.hpp>
+
+namespace ktl::heap::details {
+/*
+ * Per-processor magazine cache for small blocks (J. Bonwick, J. Adams,
+ * "Magazines and Vmem", 2001).
+ *
+ * Each processor owns a pair of magazines (loaded and previous) per pool kind
+ * and size class, so that the fast path touches only processor-local data.
+ * Full and empty magazines are exchanged with a depot protected by a spinlock;
+ * the backing pool is touched only in batches when the depot runs dry or
+ * accumulates too many full magazines.
+ *
+ * Backend requirements:
+ *  - POOL_KIND_COUNT and CACHE_LINE_SIZE constants;
+ *  - cpu_pin: RAII guard which prevents the caller from migrating to another
+ *    processor and provides get_index();
+ *  - lock_type: constexpr-constructible lock with lock()/unlock() usable while
+ *    the processor is pinned;
+ *  - get_processor_count();
+ *  - allocate_block(pool_kind, bytes)/free_block(block, pool_kind) to access
+ *    the backing pool;
+ *  - allocate_metadata(bytes)/free_metadata(ptr) returning memory aligned
+ *    to CACHE_LINE_SIZE and accessible while the processor is pinned.
+ *
+ * The kernel backend is in heap.cpp. heap_cache_host.hpp provides
+ * a malloc-backed user-mode one, which tests/heap/host_cache_benchmark.cpp
+ * uses to run the cache on a development machine.
+ *
+ * The cache is constant-initialized, so it can be used before global
+ * constructors have been invoked. Until initialize() succeeds (or after
+ * finalize()), all requests are passed straight to the backend.
+ */
+template <class Backend>
+class magazine_cache {
+ public:
+  using backend_type = Backend;
+
+  static constexpr size_t POOL_KIND_COUNT{Backend::POOL_KIND_COUNT};
+  static constexpr size_t MAGAZINE_CAPACITY{32};
+  static constexpr size_t REFILL_BATCH_SIZE{MAGAZINE_CAPACITY / 2};
+  static constexpr size_t MAX_FULL_MAGAZINES_IN_DEPOT{8};
+
+ private:
+  static constexpr size_t SIZE_CLASSES[]{32,  48,  64,  96,  128, 192,
+                                         256, 384, 512, 768, 1024};
+
+ public:
+  static constexpr size_t SIZE_CLASS_COUNT{sizeof(SIZE_CLASSES) /
+                                           sizeof(SIZE_CLASSES[0])};
+  static constexpr size_t NO_SIZE_CLASS{SIZE_CLASS_COUNT};
+  static constexpr size_t MAX_BLOCK_SIZE{SIZE_CLASSES[SIZE_CLASS_COUNT - 1]};
+
+ private:
+  struct magazine {
+    magazine* next;
+    size_t rounds;
+    void* blocks[MAGAZINE_CAPACITY];
+  };
+
+  struct magazine_list {
+    magazine* head{nullptr};
+    size_t count{0};
+  };
+
+  struct depot {
+    typename Backend::lock_type lock{};
+    magazine_list full{};
+    magazine_list empty{};
+  };
+
+  struct magazine_pair {
+    magazine* loaded;
+    magazine* previous;
+  };
+
+  struct alignas(Backend::CACHE_LINE_SIZE) cpu_cache {
+    magazine_pair slots[POOL_KIND_COUNT][SIZE_CLASS_COUNT];
+  };
+
+ public:
+  constexpr magazine_cache() noexcept = default;
+  magazine_cache(const magazine_cache&) = delete;
+  magazine_cache& operator=(const magazine_cache&) = delete;
+
+  static constexpr size_t get_size_class(size_t block_size) noexcept {
+    for (size_t idx = 0; idx < SIZE_CLASS_COUNT; ++idx) {
+      if (block_size <= SIZE_CLASSES[idx]) {
+        return idx;
+      }
+    }
+    return NO_SIZE_CLASS;
+  }
+
+  static constexpr size_t get_block_size(size_t size_class) noexcept {
+    return SIZE_CLASSES[size_class];
+  }
+
+  bool initialize() noexcept {
+    const size_t cpu_count{Backend::get_processor_count()};
+    auto* cpus{static_cast<cpu_cache*>(
+        Backend::allocate_metadata(cpu_count * sizeof(cpu_cache)))};
+    if (!cpus) {
+      return false;
+    }
+    for (size_t idx = 0; idx < cpu_count; ++idx) {
+      cpus[idx] = cpu_cache{};
+    }
+    m_cpu_count = cpu_count;
+    m_cpus = cpus;
+    return true;
+  }
+
+  // Must be called when no other allocations are in flight
+  void finalize() noexcept {
+    cpu_cache* const cpus{m_cpus};
+    if (!cpus) {
+      return;
+    }
+    m_cpus = nullptr;
+
+    for (size_t pool_kind = 0; pool_kind < POOL_KIND_COUNT; ++pool_kind) {
+      for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT;
+           ++size_class) {
+        for (size_t idx = 0; idx < m_cpu_count; ++idx) {
+          auto& [loaded, previous]{cpus[idx].slots[pool_kind][size_class]};
+          destroy_magazine(loaded, pool_kind);
+          destroy_magazine(previous, pool_kind);
+        }
+        auto& target_depot{m_depots[pool_kind][size_class]};
+        destroy_magazine_list(target_depot.full, pool_kind);
+        destroy_magazine_list(target_depot.empty, pool_kind);
+      }
+    }
+    Backend::free_metadata(cpus);
+    m_cpu_count = 0;
+  }
+
+  void* allocate(size_t pool_kind, size_t size_class) noexcept {
+    if (m_cpus) {
+      typename Backend::cpu_pin pin;
+      if (auto* slot = get_slot(pin, pool_kind, size_class); slot) {
+        if (void* block = pop_round(*slot); block) {
+          return block;
+        }
+        if (void* block = reload_from_depot(*slot, pool_kind, size_class);
+            block) {
+          return block;
+        }
+      }
+    }
+    return refill(pool_kind, size_class);
+  }
+
+  void deallocate(void* block, size_t pool_kind, size_t size_class) noexcept {
+    magazine* spare{nullptr};
+    while (m_cpus) {
+      bool cached{false};
+      magazine* excess{nullptr};
+      {
+        typename Backend::cpu_pin pin;
+        auto* slot{get_slot(pin, pool_kind, size_class)};
+        if (!slot) {
+          break;
+        }
+        cached = push_round(*slot, block) ||
+                 unload_to_depot(*slot, block, pool_kind, size_class, spare,
+                                 excess);
+      }
+      if (excess) {
+        destroy_magazine(excess, pool_kind);
+      }
+      if (cached) {
+        return;
+      }
+      // The depot has no empty magazines: allocate one and try again
+      if (spare = allocate_magazine(); !spare) {
+        break;
+      }
+    }
+    if (spare) {
+      Backend::free_metadata(spare);
+    }
+    Backend::free_block(block, pool_kind);
+  }
+
+ private:
+  magazine_pair* get_slot(const typename Backend::cpu_pin& pin,
+                          size_t pool_kind,
+                          size_t size_class) const noexcept {
+    const size_t cpu_idx{pin.get_index()};
+    if (cpu_idx >= m_cpu_count) {  // Processor has been hot-added
+      return nullptr;
+    }
+    return &m_cpus[cpu_idx].slots[pool_kind][size_class];
+  }
+
+  static void* pop_round(magazine_pair& slot) noexcept {
+    auto& [loaded, previous]{slot};
+    if (loaded && loaded->rounds > 0) {
+      return loaded->blocks[--loaded->rounds];
+    }
+    if (previous && previous->rounds > 0) {
+      swap_magazines(loaded, previous);
+      return loaded->blocks[--loaded->rounds];
+    }
+    return nullptr;
+  }
+
+  static bool push_round(magazine_pair& slot, void* block) noexcept {
+    auto& [loaded, previous]{slot};
+    if (loaded && loaded->rounds < MAGAZINE_CAPACITY) {
+      loaded->blocks[loaded->rounds++] = block;
+      return true;
+    }
+    if (previous && previous->rounds < MAGAZINE_CAPACITY) {
+      swap_magazines(loaded, previous);
+      loaded->blocks[loaded->rounds++] = block;
+      return true;
+    }
+    return false;
+  }
+
+  static void swap_magazines(magazine*& lhs, magazine*& rhs) noexcept {
+    magazine* const tmp{lhs};
+    lhs = rhs;
+    rhs = tmp;
+  }
+
+  // Both magazines of the slot are empty (or absent)
+  void* reload_from_depot(magazine_pair& slot,
+                          size_t pool_kind,
+                          size_t size_class) noexcept {
+    auto& [lock, full, empty]{m_depots[pool_kind][size_class]};
+    lock.lock();
+    magazine* const mag{pop_magazine(full)};
+    if (mag) {
+      if (slot.loaded) {
+        push_magazine(empty, slot.loaded);
+      }
+      slot.loaded = mag;
+    }
+    lock.unlock();
+    return mag ? pop_round(slot) : nullptr;
+  }
+
+  // Both magazines of the slot are full (or absent). On success the block is
+  // placed into an empty magazine taken from the depot or into the spare one,
+  // which is consumed in any case. If the depot overflows, one of the full
+  // magazines is detached into 'excess' and must be destroyed by the caller
+  // after unpinning
+  bool unload_to_depot(magazine_pair& slot,
+                       void* block,
+                       size_t pool_kind,
+                       size_t size_class,
+                       magazine*& spare,
+                       magazine*& excess) noexcept {
+    auto& [lock, full, empty]{m_depots[pool_kind][size_class]};
+    lock.lock();
+    magazine* mag{pop_magazine(empty)};
+    if (!mag) {
+      mag = spare;
+    } else if (spare) {
+      push_magazine(empty, spare);
+    }
+    spare = nullptr;
+    if (mag) {
+      if (slot.previous) {
+        push_magazine(full, slot.previous);
+        if (full.count > MAX_FULL_MAGAZINES_IN_DEPOT) {
+          excess = pop_magazine(full);
+        }
+      }
+      slot.previous = slot.loaded;
+      slot.loaded = mag;
+      mag->blocks[mag->rounds++] = block;
+    }
+    lock.unlock();
+    return mag != nullptr;
+  }
+
+  void* refill(size_t pool_kind, size_t size_class) noexcept {
+    const size_t block_size{get_block_size(size_class)};
+    void* const result{Backend::allocate_block(pool_kind, block_size)};
+    if (!result || !m_cpus) {
+      return result;
+    }
+
+    magazine* const mag{take_empty_magazine(pool_kind, size_class)};
+    if (!mag) {
+      return result;
+    }
+    while (mag->rounds < REFILL_BATCH_SIZE) {
+      void* const block{Backend::allocate_block(pool_kind, block_size)};
+      if (!block) {
+        break;
+      }
+      mag->blocks[mag->rounds++] = block;
+    }
+
+    typename Backend::cpu_pin pin;
+    auto& [lock, full, empty]{m_depots[pool_kind][size_class]};
+    lock.lock();
+    push_magazine(mag->rounds > 0 ? full : empty, mag);
+    lock.unlock();
+    return result;
+  }
+
+  magazine* take_empty_magazine(size_t pool_kind, size_t size_class) noexcept {
+    magazine* mag;
+    {
+      typename Backend::cpu_pin pin;
+      auto& target_depot{m_depots[pool_kind][size_class]};
+      target_depot.lock.lock();
+      mag = pop_magazine(target_depot.empty);
+      target_depot.lock.unlock();
+    }
+    return mag ? mag : allocate_magazine();
+  }
+
+  static magazine* allocate_magazine() noexcept {
+    auto* mag{static_cast<magazine*>(
+        Backend::allocate_metadata(sizeof(magazine)))};
+    if (mag) {
+      mag->next = nullptr;
+      mag->rounds = 0;
+    }
+    return mag;
+  }
+
+  // Returns blocks of the magazine to the backing pool. Called without
+  // pinning because the backend may require a lower IRQL to free
+  static void drain_magazine(magazine& mag, size_t pool_kind) noexcept {
+    while (mag.rounds > 0) {
+      Backend::free_block(mag.blocks[--mag.rounds], pool_kind);
+    }
+  }
+
+  static void destroy_magazine(magazine* mag, size_t pool_kind) noexcept {
+    if (mag) {
+      drain_magazine(*mag, pool_kind);
+      Backend::free_metadata(mag);
+    }
+  }
+
+  static void destroy_magazine_list(magazine_list& list,
+                                    size_t pool_kind) noexcept {
+    while (magazine* mag = pop_magazine(list)) {
+      destroy_magazine(mag, pool_kind);
+    }
+  }
+
+  static void push_magazine(magazine_list& list, magazine* mag) noexcept {
+    mag->next = list.head;
+    list.head = mag;
+    ++list.count;
+  }
+
+  static magazine* pop_magazine(magazine_list& list) noexcept {
+    magazine* const mag{list.head};
+    if (mag) {
+      list.head = mag->next;
+      --list.count;
+    }
+    return mag;
+  }
+
+ private:
+  cpu_cache* m_cpus{nullptr};
+  size_t m_cpu_count{0};
+  depot m_depots[POOL_KIND_COUNT][SIZE_CLASS_COUNT]{};
+};
+}  // namespace ktl::heap::details
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#include <heap_cache.hpp>
+
+namespace ktl::heap::details {
+/*
+ * User-mode backend of magazine_cache for benchmarks and experiments on
+ * a development machine; the kernel backend lives in heap.cpp.
+ *
+ * Threads can't be pinned to processors in user mode, so the "processor"
+ * index is a hash of the thread id and cpu_pin owns a mutex of that index
+ * while it's alive. Threads mapped to the same index share its magazines
+ * and serialize on the mutex, which keeps the per-processor data private
+ * as the cache requires. Blocks and metadata come from malloc().
+ */
+struct host_heap_cache_backend {
+  static constexpr size_t POOL_KIND_COUNT{1};
+  static constexpr size_t CACHE_LINE_SIZE{64};
+  static constexpr size_t MAX_PROCESSOR_COUNT{64};
+
+  class cpu_pin {
+   public:
+    cpu_pin() noexcept
+        : m_index{std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+                  get_processor_count()} {
+      get_pin_lock(m_index).lock();
+    }
+
+    ~cpu_pin() noexcept { get_pin_lock(m_index).unlock(); }
+
+    cpu_pin(const cpu_pin&) = delete;
+    cpu_pin& operator=(const cpu_pin&) = delete;
+
+    [[nodiscard]] size_t get_index() const noexcept { return m_index; }
+
+   private:
+    static std::mutex& get_pin_lock(size_t index) noexcept {
+      static std::mutex pin_locks[MAX_PROCESSOR_COUNT];
+      return pin_locks[index];
+    }
+
+   private:
+    size_t m_index;
+  };
+
+  using lock_type = std::mutex;  // constexpr-constructible
+
+  // hardware_concurrency() may issue a system call, so it's queried once
+  static size_t get_processor_count() noexcept {
+    static const size_t processor_count{[] {
+      const size_t count{std::thread::hardware_concurrency()};
+      if (count == 0) {
+        return size_t{1};
+      }
+      return count < MAX_PROCESSOR_COUNT ? count : MAX_PROCESSOR_COUNT;
+    }()};
+    return processor_count;
+  }
+
+  static void* allocate_block([[maybe_unused]] size_t pool_kind,
+                              size_t bytes_count) noexcept {
+    return std::malloc(bytes_count);
+  }
+
+  static void free_block(void* block,
+                         [[maybe_unused]] size_t pool_kind) noexcept {
+    std::free(block);
+  }
+
+  // aligned_alloc() requires the size to be a multiple of the alignment
+  static void* allocate_metadata(size_t bytes_count) noexcept {
+    const size_t aligned_size{(bytes_count + CACHE_LINE_SIZE - 1) /
+                              CACHE_LINE_SIZE * CACHE_LINE_SIZE};
+#ifdef _MSC_VER
+    return _aligned_malloc(aligned_size, CACHE_LINE_SIZE);
+#else
+    return std::aligned_alloc(CACHE_LINE_SIZE, aligned_size);
+#endif
+  }
+
+  static void free_metadata(void* ptr) noexcept {
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+  }
+};
+
+using host_heap_cache = magazine_cache<host_heap_cache_backend>;
+}  // namespace ktl::heap::details
@@ -38,6 +38,13 @@ EXTERN_C unsigned char _BitScanReverse64(unsigned long* index,
 #define BITSCANREVERSE _BitScanReverse64
 #endif
 
+#if (BITNESS == 64)
+EXTERN_C unsigned __int64 _umul128(unsigned __int64 multiplier,
+                                   unsigned __int64 multiplicand,
+                                   unsigned __int64* high_product);
+#pragma intrinsic(_umul128)
+#endif
+
 EXTERN_C char _InterlockedExchange8(volatile char* place, char new_value);
 #pragma intrinsic(_InterlockedExchange8)
 #ifndef InterlockedExchange8
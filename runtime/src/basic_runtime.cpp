@@ -57,6 +57,7 @@ void STDCALL KtlDriverUnload(DRIVER_OBJECT* driver_object) noexcept {
     drv_unload(driver_object);
   }
   ktl::crt::invoke_global_destructors();
+  ktl::crt::finalize_heap();
 }
 
 namespace ktl::crt {
@@ -2,11 +2,174 @@
 #include <exception.hpp>
 #include <heap.hpp>
 #include <irql.hpp>
+#include <limits_impl.hpp>
+
+#ifdef KTL_ENABLE_HEAP_CACHE
+#include <heap_cache.hpp>
+#endif
 
 namespace ktl {
 namespace crt {
+#ifdef KTL_ENABLE_HEAP_CACHE
+namespace details {
+// NOLINTNEXTLINE(clang-diagnostic-four-char-constants)
+inline constexpr pool_tag_t HEAP_CACHE_TAG{'cLTK'};  //!< Reversed 'KTLc'
+
+inline constexpr pool_type_t CACHED_POOL_TYPES[]{
+    NonPagedPoolExecute, PagedPool, NonPagedPoolNx};
+inline constexpr size_t CACHED_POOL_TYPES_COUNT{sizeof(CACHED_POOL_TYPES) /
+                                                sizeof(CACHED_POOL_TYPES[0])};
+
+struct heap_cache_backend {
+  static constexpr size_t POOL_KIND_COUNT{CACHED_POOL_TYPES_COUNT};
+  static constexpr size_t CACHE_LINE_SIZE{crt::CACHE_LINE_SIZE};
+
+  class cpu_pin {
+   public:
+    cpu_pin() noexcept : m_prev_irql{get_current_irql()} {
+      if (m_prev_irql < DISPATCH_LEVEL) {
+        raise_irql(DISPATCH_LEVEL);
+      }
+    }
+
+    ~cpu_pin() noexcept {
+      if (m_prev_irql < DISPATCH_LEVEL) {
+        lower_irql(m_prev_irql);
+      }
+    }
+
+    cpu_pin(const cpu_pin&) = delete;
+    cpu_pin& operator=(const cpu_pin&) = delete;
+
+    [[nodiscard]] static size_t get_index() noexcept {
+      return KeGetCurrentProcessorNumberEx(nullptr);
+    }
+
+   private:
+    irql_t m_prev_irql;
+  };
+
+  class lock_type {
+   public:
+    constexpr lock_type() noexcept = default;
+
+    void lock() noexcept { KeAcquireSpinLockAtDpcLevel(&m_lock); }
+    void unlock() noexcept { KeReleaseSpinLockFromDpcLevel(&m_lock); }
+
+   private:
+    KSPIN_LOCK m_lock{};
+  };
+
+  static size_t get_processor_count() noexcept {
+    return KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS);
+  }
+
+  // Cached blocks are always owned by DEFAULT_HEAP_TAG
+  static void* allocate_block(size_t pool_kind, size_t bytes_count) noexcept {
+    return ExAllocatePoolUninitialized(CACHED_POOL_TYPES[pool_kind],
+                                       bytes_count, DEFAULT_HEAP_TAG);
+  }
+
+  static void free_block(void* block,
+                         [[maybe_unused]] size_t pool_kind) noexcept {
+    ExFreePoolWithTag(block, DEFAULT_HEAP_TAG);
+  }
+
+  static void* allocate_metadata(size_t bytes_count) noexcept {
+    return ExAllocatePoolUninitialized(NonPagedPoolNxCacheAligned, bytes_count,
+                                       HEAP_CACHE_TAG);
+  }
+
+  static void free_metadata(void* ptr) noexcept {
+    ExFreePoolWithTag(ptr, HEAP_CACHE_TAG);
+  }
+};
+
+using heap_cache_t = heap::details::magazine_cache<heap_cache_backend>;
+
+/*
+ * Cached blocks are prefixed by a header because unsized operator delete
+ * doesn't know the size of the block being freed
+ */
+struct alignas(static_cast<size_t>(DEFAULT_ALLOCATION_ALIGNMENT))
+    cached_block_header {
+  uint16_t pool_kind;
+  uint16_t size_class;
+};
+
+inline constexpr size_t NO_POOL_KIND{heap_cache_t::POOL_KIND_COUNT};
+
+static heap_cache_t heap_cache;  // Constant-initialized
+
+static constexpr size_t get_pool_kind(pool_type_t pool_type) noexcept {
+  for (size_t idx = 0; idx < CACHED_POOL_TYPES_COUNT; ++idx) {
+    if (CACHED_POOL_TYPES[idx] == pool_type) {
+      return idx;
+    }
+  }
+  return NO_POOL_KIND;
+}
+
+/*
+ * Only default-tagged allocations with the default alignment are cached. Blocks
+ * with user-provided tags always go directly to the pool, so tag-based
+ * accounting (PoolMon, Driver Verifier) for them is not affected
+ */
+static constexpr bool is_cacheable(pool_tag_t pool_tag,
+                                   align_val_t alignment) noexcept {
+  return pool_tag == DEFAULT_HEAP_TAG &&
+         alignment <= DEFAULT_ALLOCATION_ALIGNMENT;
+}
+
+static void* allocate_cached(size_t bytes_count,
+                             pool_type_t pool_type) noexcept {
+  constexpr size_t header_size{sizeof(cached_block_header)};
+  if (bytes_count > (numeric_limits<size_t>::max)() - header_size) {
+    return nullptr;
+  }
+  const size_t block_size{bytes_count + header_size};
+  const size_t pool_kind{get_pool_kind(pool_type)};
+  const size_t size_class{pool_kind != NO_POOL_KIND
+                              ? heap_cache_t::get_size_class(block_size)
+                              : heap_cache_t::NO_SIZE_CLASS};
+
+  void* const block{
+      size_class != heap_cache_t::NO_SIZE_CLASS
+          ? heap_cache.allocate(pool_kind, size_class)
+          : ExAllocatePoolUninitialized(pool_type, block_size,
+                                        DEFAULT_HEAP_TAG)};
+  if (!block) {
+    return nullptr;
+  }
+  auto* header{static_cast<cached_block_header*>(block)};
+  header->pool_kind = static_cast<uint16_t>(pool_kind);
+  header->size_class = static_cast<uint16_t>(size_class);
+  return header + 1;
+}
+
+static void deallocate_cached(void* memory_block) noexcept {
+  auto* header{static_cast<cached_block_header*>(memory_block) - 1};
+  if (const auto [pool_kind, size_class]{*header};
+      size_class != heap_cache_t::NO_SIZE_CLASS) {
+    heap_cache.deallocate(header, pool_kind, size_class);
+  } else {
+    ExFreePoolWithTag(header, DEFAULT_HEAP_TAG);
+  }
+}
+}  // namespace details
+#endif
+
 void initialize_heap() noexcept {
   ExInitializeDriverRuntime(DrvRtPoolNxOptIn);
+#ifdef KTL_ENABLE_HEAP_CACHE
+  details::heap_cache.initialize();  // Blocks bypass the cache on failure
+#endif
+}
+
+void finalize_heap() noexcept {
+#ifdef KTL_ENABLE_HEAP_CACHE
+  details::heap_cache.finalize();
+#endif
 }
 
 static constexpr std::align_val_t get_max_alignment_for_pool(
@@ -39,6 +202,12 @@ static void* allocate_impl(const alloc_request& request) noexcept {
       "of global executive spinlock to protect NT Virtual Memory Manager's PFN "
       "database");
 
+#ifdef KTL_ENABLE_HEAP_CACHE
+  if (details::is_cacheable(pool_tag, alignment)) {
+    return details::allocate_cached(bytes_count, pool_type);
+  }
+#endif
+
   if (request.alignment <= get_max_alignment_for_pool(pool_type)) {
     return ExAllocatePoolUninitialized(pool_type, bytes_count, pool_tag);
   }
@@ -51,9 +220,19 @@ static void* allocate_impl(const alloc_request& request) noexcept {
   return ExAllocatePoolUninitialized(pool_type, page_aligned_size, pool_tag);
 }
 
-static void deallocate_impl(void* memory_block, pool_tag_t pool_tag) noexcept {
+static void deallocate_impl(const free_request& request) noexcept {
+  [[maybe_unused]] const auto [memory_block, bytes_count, alignment,
+                              pool_tag]{request};
+
   crt_assert_with_msg(memory_block, "invalid memory block");
   crt_assert_with_msg(pool_tag != 0, "pool tag must not be equal to zero");
+
+#ifdef KTL_ENABLE_HEAP_CACHE
+  if (details::is_cacheable(pool_tag, alignment)) {
+    details::deallocate_cached(memory_block);
+    return;
+  }
+#endif
   ExFreePoolWithTag(memory_block, pool_tag);
 }
 }  // namespace crt
@@ -75,8 +254,8 @@ void* allocate_memory<OnAllocationFailure::ThrowException>(
 }
 
 void deallocate_memory(free_request request) noexcept {
-  if (auto* ptr = request.memory_block; ptr) {
-    crt::deallocate_impl(ptr, request.pool_tag);
+  if (request.memory_block) {
+    crt::deallocate_impl(request);
   }
 }
 }  // namespace ktl
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include <intrinsic.hpp>
+#include <slab_allocator.hpp>
+
+#include <ntddk.h>
+
+namespace ktl {
+namespace mm::details {
+// The first bytes of a slab hold a pointer to its descriptor
+static constexpr size_t SLAB_HEADER_SIZE{slab_heap::OBJECT_ALIGNMENT};
+static constexpr size_t MAX_OBJECTS_PER_SLAB{
+    (slab_heap::SLAB_SIZE - SLAB_HEADER_SIZE) / SLAB_OBJECT_SIZES[0]};
+
+static constexpr size_t BITMAP_WORD_BITS{32};
+static constexpr size_t BITMAP_SIZE{
+    (MAX_OBJECTS_PER_SLAB + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS};
+
+struct slab_descriptor {
+  slab_descriptor* prev;
+  slab_descriptor* next;
+  byte* objects;
+  uint32_t free_mask[BITMAP_SIZE];  // Set bits stand for free objects
+  uint16_t size_class;
+  uint16_t capacity;
+  uint16_t used;
+};
+
+static slab_descriptor* get_slab(void* ptr) noexcept {
+  const auto address{reinterpret_cast<uintptr_t>(ptr)};
+  const auto slab_begin{address & ~(slab_heap::SLAB_SIZE - 1)};
+  return *reinterpret_cast<slab_descriptor**>(slab_begin);
+}
+
+static void link_slab(slab_descriptor*& head, slab_descriptor* slab) noexcept {
+  slab->prev = nullptr;
+  slab->next = head;
+  if (head) {
+    head->prev = slab;
+  }
+  head = slab;
+}
+
+static void unlink_slab(slab_descriptor*& head,
+                        slab_descriptor* slab) noexcept {
+  if (slab->prev) {
+    slab->prev->next = slab->next;
+  } else {
+    head = slab->next;
+  }
+  if (slab->next) {
+    slab->next->prev = slab->prev;
+  }
+  slab->prev = nullptr;
+  slab->next = nullptr;
+}
+
+static size_t acquire_free_slot(slab_descriptor& slab) noexcept {
+  for (size_t idx = 0; idx < BITMAP_SIZE; ++idx) {
+    if (auto& word = slab.free_mask[idx]; word) {
+      unsigned long bit;
+      _BitScanForward(&bit, word);
+      word &= word - 1;
+      return idx * BITMAP_WORD_BITS + bit;
+    }
+  }
+  return MAX_OBJECTS_PER_SLAB;  // Unreachable for partial slabs
+}
+
+static void release_slot(slab_descriptor& slab, size_t slot) noexcept {
+  slab.free_mask[slot / BITMAP_WORD_BITS] |= 1u << (slot % BITMAP_WORD_BITS);
+}
+
+class slab_lock_guard {
+ public:
+  explicit slab_lock_guard(KSPIN_LOCK& lock) noexcept
+      : m_lock{lock}, m_prev_irql{KeAcquireSpinLockRaiseToDpc(&lock)} {}
+
+  ~slab_lock_guard() noexcept { KeReleaseSpinLock(&m_lock, m_prev_irql); }
+
+  slab_lock_guard(const slab_lock_guard&) = delete;
+  slab_lock_guard& operator=(const slab_lock_guard&) = delete;
+
+ private:
+  KSPIN_LOCK& m_lock;
+  KIRQL m_prev_irql;
+};
+}  // namespace mm::details
+
+slab_heap::~slab_heap() noexcept {
+  release_empty_slabs();
+}
+
+void* slab_heap::allocate(size_t bytes_count, align_val_t alignment) noexcept {
+  using namespace mm::details;
+
+  if (!is_slab_allocation(bytes_count, alignment)) {
+    return allocate_memory(alloc_request_builder{bytes_count, m_pool_type}
+                               .set_alignment(alignment)
+                               .set_pool_tag(m_pool_tag)
+                               .build());
+  }
+
+  const size_t size_class{get_size_class(bytes_count)};
+  auto& target{m_classes[size_class]};
+  {
+    slab_lock_guard guard{m_lock};
+    if (void* const object = take_object(target); object) {
+      return object;
+    }
+  }
+
+  // Slabs from the paged pool can't be allocated under the spinlock
+  slab_descriptor* const slab{create_slab(size_class)};
+  if (!slab) {
+    return nullptr;
+  }
+  slab_lock_guard guard{m_lock};
+  link_slab(target.partial, slab);
+  ++target.slab_count;
+  return take_object(target);
+}
+
+void slab_heap::deallocate(void* ptr,
+                           size_t bytes_count,
+                           align_val_t alignment) noexcept {
+  using namespace mm::details;
+
+  if (!ptr) {
+    return;
+  }
+  if (!is_slab_allocation(bytes_count, alignment)) {
+    deallocate_memory(free_request_builder{ptr, bytes_count}
+                          .set_alignment(alignment)
+                          .set_pool_tag(m_pool_tag)
+                          .build());
+    return;
+  }
+
+  slab_descriptor* const slab{get_slab(ptr)};  // Read before raising IRQL
+  const size_t slot{static_cast<size_t>(static_cast<byte*>(ptr) -
+                                        slab->objects - SLAB_HEADER_SIZE) /
+                    get_object_size(slab->size_class)};
+  slab_descriptor* released{nullptr};
+  {
+    slab_lock_guard guard{m_lock};
+    auto& target{m_classes[slab->size_class]};
+    if (slab->used == slab->capacity) {
+      link_slab(target.partial, slab);
+    }
+    release_slot(*slab, slot);
+    --target.object_count;
+
+    if (--slab->used == 0) {
+      unlink_slab(target.partial, slab);
+      if (target.empty_slab_count < m_max_empty_slabs) {
+        slab->next = target.empty;
+        target.empty = slab;
+        ++target.empty_slab_count;
+      } else {
+        --target.slab_count;
+        released = slab;
+      }
+    }
+  }
+  if (released) {
+    destroy_slab(released);
+  }
+}
+
+void slab_heap::release_empty_slabs() noexcept {
+  using namespace mm::details;
+
+  slab_descriptor* released{nullptr};
+  {
+    slab_lock_guard guard{m_lock};
+    for (auto& target : m_classes) {
+      while (slab_descriptor* const slab = target.empty) {
+        target.empty = slab->next;
+        slab->next = released;
+        released = slab;
+      }
+      target.slab_count -= target.empty_slab_count;
+      target.empty_slab_count = 0;
+    }
+  }
+  while (released) {
+    slab_descriptor* const next{released->next};
+    destroy_slab(released);
+    released = next;
+  }
+}
+
+slab_heap_stats slab_heap::get_stats() const noexcept {
+  slab_heap_stats stats{};
+  mm::details::slab_lock_guard guard{m_lock};
+  for (size_t size_class = 0; size_class < SIZE_CLASS_COUNT; ++size_class) {
+    const auto [slab_count, empty_slab_count, object_count,
+                object_capacity]{make_stats(size_class)};
+    stats.slab_count += slab_count;
+    stats.empty_slab_count += empty_slab_count;
+    stats.object_count += object_count;
+    stats.object_capacity += object_capacity;
+  }
+  return stats;
+}
+
+slab_heap_stats slab_heap::get_stats(size_t size_class) const noexcept {
+  mm::details::slab_lock_guard guard{m_lock};
+  return make_stats(size_class);
+}
+
+slab_heap_stats slab_heap::make_stats(size_t size_class) const noexcept {
+  const auto& target{m_classes[size_class]};
+  const size_t objects_per_slab{
+      (SLAB_SIZE - mm::details::SLAB_HEADER_SIZE) / get_object_size(size_class)};
+  return {target.slab_count, target.empty_slab_count, target.object_count,
+          target.slab_count * objects_per_slab};
+}
+
+// Must be called under the lock
+void* slab_heap::take_object(mm::details::slab_size_class& target) noexcept {
+  using namespace mm::details;
+
+  slab_descriptor* slab{target.partial};
+  if (!slab) {
+    slab = target.empty;
+    if (!slab) {
+      return nullptr;
+    }
+    target.empty = slab->next;
+    --target.empty_slab_count;
+    link_slab(target.partial, slab);
+  }
+
+  const size_t slot{acquire_free_slot(*slab)};
+  if (++slab->used == slab->capacity) {
+    unlink_slab(target.partial, slab);  // Full slabs aren't tracked
+  }
+  ++target.object_count;
+  return slab->objects + SLAB_HEADER_SIZE +
+         slot * get_object_size(slab->size_class);
+}
+
+mm::details::slab_descriptor* slab_heap::create_slab(
+    size_t size_class) noexcept {
+  using namespace mm::details;
+
+  auto* const slab{static_cast<slab_descriptor*>(allocate_memory(
+      alloc_request_builder{sizeof(slab_descriptor), NonPagedPoolNx}
+          .set_pool_tag(m_pool_tag)
+          .build()))};
+  if (!slab) {
+    return nullptr;
+  }
+  auto* const objects{static_cast<byte*>(
+      allocate_memory(alloc_request_builder{SLAB_SIZE, m_pool_type}
+                          .set_alignment(crt::MAX_ALLOCATION_ALIGNMENT)
+                          .set_pool_tag(m_pool_tag)
+                          .build()))};
+  if (!objects) {
+    deallocate_memory(free_request_builder{slab, sizeof(slab_descriptor)}
+                          .set_pool_tag(m_pool_tag)
+                          .build());
+    return nullptr;
+  }
+
+  const size_t capacity{(SLAB_SIZE - SLAB_HEADER_SIZE) /
+                        get_object_size(size_class)};
+  slab->prev = nullptr;
+  slab->next = nullptr;
+  slab->objects = objects;
+  slab->size_class = static_cast<uint16_t>(size_class);
+  slab->capacity = static_cast<uint16_t>(capacity);
+  slab->used = 0;
+  for (size_t idx = 0; idx < BITMAP_SIZE; ++idx) {
+    const size_t first_slot{idx * BITMAP_WORD_BITS};
+    if (first_slot + BITMAP_WORD_BITS <= capacity) {
+      slab->free_mask[idx] = ~0u;
+    } else if (first_slot < capacity) {
+      slab->free_mask[idx] = (1u << (capacity - first_slot)) - 1;
+    } else {
+      slab->free_mask[idx] = 0;
+    }
+  }
+  *reinterpret_cast<slab_descriptor**>(objects) = slab;
+  return slab;
+}
+
+void slab_heap::destroy_slab(mm::details::slab_descriptor* slab) noexcept {
+  deallocate_memory(free_request_builder{slab->objects, SLAB_SIZE}
+                        .set_alignment(crt::MAX_ALLOCATION_ALIGNMENT)
+                        .set_pool_tag(m_pool_tag)
+                        .build());
+  deallocate_memory(
+      free_request_builder{slab, sizeof(mm::details::slab_descriptor)}
+          .set_pool_tag(m_pool_tag)
+          .build());
+}
+}  // namespace ktl
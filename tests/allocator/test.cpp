@@ -0,0 +1,226 @@
+#include "test.hpp"
+
+#include <allocator.hpp>
+#include <chrono.hpp>
+#include <slab_allocator.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::allocator {
+namespace details {
+// NOLINTNEXTLINE(clang-diagnostic-four-char-constants)
+static constexpr crt::pool_tag_t POOL_TAG{'lATK'};
+
+// A small node of a tree built and thrown away at once, e.g. while parsing
+struct tree_node {
+  tree_node* parent;
+  uint64_t payload[3];
+};
+
+constexpr size_t NODE_COUNT{size_t{1} << 14};
+constexpr size_t ROUND_COUNT{64};
+
+// Allocates NODE_COUNT nodes with alloc, links them and returns the sum of
+// their payloads, so that the nodes can't be optimized out
+template <class Allocator>
+uint64_t build_tree(Allocator& alloc, tree_node** nodes) {
+  uint64_t sum{0};
+  for (size_t idx = 0; idx < NODE_COUNT; ++idx) {
+    tree_node* const node{alloc.allocate(1)};
+    node->parent = idx ? nodes[(idx - 1) / 2] : nullptr;
+    node->payload[0] = idx;
+    nodes[idx] = node;
+    sum += node->parent ? node->parent->payload[0] : 0;
+  }
+  return sum;
+}
+}  // namespace details
+
+void slab_size_classes() {
+  ASSERT_EQ(slab_heap::get_size_class(1), static_cast<size_t>(0))
+  ASSERT_EQ(slab_heap::get_size_class(16), static_cast<size_t>(0))
+  ASSERT_EQ(slab_heap::get_size_class(17), static_cast<size_t>(1))
+  ASSERT_EQ(slab_heap::get_size_class(100), static_cast<size_t>(5))
+  ASSERT_EQ(slab_heap::get_size_class(slab_heap::MAX_OBJECT_SIZE),
+            slab_heap::SIZE_CLASS_COUNT - 1)
+
+  for (size_t size_class = 0; size_class < slab_heap::SIZE_CLASS_COUNT;
+       ++size_class) {
+    const size_t object_size{slab_heap::get_object_size(size_class)};
+    ASSERT_EQ(slab_heap::get_size_class(object_size), size_class)
+    ASSERT_EQ(object_size % slab_heap::OBJECT_ALIGNMENT, static_cast<size_t>(0))
+  }
+
+  ASSERT_VALUE(slab_heap::is_slab_allocation(slab_heap::MAX_OBJECT_SIZE,
+                                             align_val_t{16}))
+  ASSERT_VALUE(!slab_heap::is_slab_allocation(slab_heap::MAX_OBJECT_SIZE + 1,
+                                              align_val_t{16}))
+  ASSERT_VALUE(!slab_heap::is_slab_allocation(16, align_val_t{64}))
+}
+
+void slab_heap_alloc_and_free() {
+  constexpr size_t OBJECT_SIZE{64};
+  constexpr size_t OBJECT_COUNT{200};
+  constexpr size_t MAX_EMPTY_SLABS{2};
+  constexpr auto ALIGNMENT{crt::DEFAULT_ALLOCATION_ALIGNMENT};
+
+  slab_heap heap{NonPagedPoolNx, details::POOL_TAG, MAX_EMPTY_SLABS};
+  const size_t size_class{slab_heap::get_size_class(OBJECT_SIZE)};
+  void* objects[OBJECT_COUNT];
+  for (auto& obj : objects) {
+    obj = heap.allocate(OBJECT_SIZE, ALIGNMENT);
+    ASSERT_VALUE(obj != nullptr)
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(obj) % slab_heap::OBJECT_ALIGNMENT,
+              static_cast<uintptr_t>(0))
+  }
+
+  auto stats{heap.get_stats(size_class)};
+  ASSERT_EQ(stats.object_count, OBJECT_COUNT)
+  ASSERT_EQ(stats.empty_slab_count, static_cast<size_t>(0))
+  ASSERT_VALUE(stats.object_capacity >= OBJECT_COUNT)
+  ASSERT_VALUE(stats.object_capacity - OBJECT_COUNT <
+               stats.object_capacity / stats.slab_count)
+  ASSERT_EQ(heap.get_stats().object_count, OBJECT_COUNT)
+
+  // Blocks which are too large bypass the slabs
+  void* const large{heap.allocate(slab_heap::MAX_OBJECT_SIZE + 1, ALIGNMENT)};
+  ASSERT_VALUE(large != nullptr)
+  ASSERT_EQ(heap.get_stats().object_count, OBJECT_COUNT)
+  heap.deallocate(large, slab_heap::MAX_OBJECT_SIZE + 1, ALIGNMENT);
+
+  const size_t slab_count{stats.slab_count};
+  for (auto* obj : objects) {
+    heap.deallocate(obj, OBJECT_SIZE, ALIGNMENT);
+  }
+  stats = heap.get_stats(size_class);
+  ASSERT_EQ(stats.object_count, static_cast<size_t>(0))
+  ASSERT_EQ(stats.slab_count, (min)(slab_count, MAX_EMPTY_SLABS))
+  ASSERT_EQ(stats.empty_slab_count, stats.slab_count)
+
+  // Empty slabs are reused before new ones are created
+  void* const reused{heap.allocate(OBJECT_SIZE, ALIGNMENT)};
+  ASSERT_VALUE(reused != nullptr)
+  stats = heap.get_stats(size_class);
+  ASSERT_EQ(stats.slab_count, (min)(slab_count, MAX_EMPTY_SLABS))
+  ASSERT_EQ(stats.object_count, static_cast<size_t>(1))
+  heap.deallocate(reused, OBJECT_SIZE, ALIGNMENT);
+
+  heap.release_empty_slabs();
+  stats = heap.get_stats();
+  ASSERT_EQ(stats.slab_count, static_cast<size_t>(0))
+  ASSERT_EQ(stats.empty_slab_count, static_cast<size_t>(0))
+  ASSERT_EQ(stats.object_capacity, static_cast<size_t>(0))
+}
+
+void slab_allocator_with_vector() {
+  constexpr int VALUE_COUNT{1000};
+
+  slab_heap heap{NonPagedPoolNx, details::POOL_TAG};
+  slab_non_paged_allocator<int> alloc{heap};
+  {
+    vector<int, slab_non_paged_allocator<int>> vec{alloc};
+    vec.reserve(4);
+    ASSERT_EQ(heap.get_stats().object_count, static_cast<size_t>(1))
+    for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+      vec.push_back(idx);
+    }
+    ASSERT_EQ(vec.size(), static_cast<size_t>(VALUE_COUNT))
+    for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+      ASSERT_EQ(vec[static_cast<size_t>(idx)], idx)
+    }
+    ASSERT_VALUE(vec.get_allocator() == alloc)
+
+    // Storage of 1000 ints is taken straight from the pool
+    ASSERT_EQ(heap.get_stats().object_count, static_cast<size_t>(0))
+    vec.resize(8);
+    vec.shrink_to_fit();
+    ASSERT_EQ(heap.get_stats().object_count, static_cast<size_t>(1))
+  }
+  ASSERT_EQ(heap.get_stats().object_count, static_cast<size_t>(0))
+}
+
+void monotonic_allocator_alloc() {
+  constexpr size_t VALUE_COUNT{1000};
+
+  inline_monotonic_buffer<256> buffer{NonPagedPoolNx, details::POOL_TAG};
+  monotonic_allocator<uint64_t> alloc{buffer};
+  uint64_t* const first{alloc.allocate(4)};
+  ASSERT_VALUE(first != nullptr)
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(first) % alignof(uint64_t),
+            static_cast<uintptr_t>(0))
+  ASSERT_EQ(buffer.get_remaining_bytes(), 256 - 4 * sizeof(uint64_t))
+  {
+    vector<uint64_t, monotonic_allocator<uint64_t>> vec{alloc};
+    for (size_t idx = 0; idx < VALUE_COUNT; ++idx) {
+      vec.push_back(idx);
+    }
+    for (size_t idx = 0; idx < VALUE_COUNT; ++idx) {
+      ASSERT_EQ(vec[idx], static_cast<uint64_t>(idx))
+    }
+  }
+  buffer.release();
+  ASSERT_EQ(buffer.get_remaining_bytes(), static_cast<size_t>(256))
+  ASSERT_VALUE(alloc.allocate(4) == first)
+}
+
+void monotonic_allocator_overflow() {
+  monotonic_buffer buffer{NonPagedPoolNx};
+  monotonic_allocator<uint64_t> alloc{buffer};
+  constexpr size_t max_count{(numeric_limits<size_t>::max)() /
+                             sizeof(uint64_t)};
+  bool overflow_caught{false};
+  try {
+    [[maybe_unused]] auto* ptr{alloc.allocate(max_count + 1)};
+  } catch (const bad_alloc&) {
+    overflow_caught = true;
+  }
+  ASSERT_VALUE(overflow_caught)
+
+  bool too_large_caught{false};
+  try {
+    [[maybe_unused]] auto* ptr{alloc.allocate(max_count)};
+  } catch (const bad_alloc&) {
+    too_large_caught = true;
+  }
+  ASSERT_VALUE(too_large_caught)
+  ASSERT_VALUE(alloc.allocate(1) != nullptr)
+}
+
+void monotonic_allocator_vs_paged_allocator() {
+  vector<details::tree_node*, basic_paged_allocator<details::tree_node*>>
+      nodes(details::NODE_COUNT, nullptr);
+  uint64_t monotonic_sum{0};
+  uint64_t paged_sum{0};
+
+  // The arena frees all the nodes at once on destruction
+  auto start{chrono::steady_clock::now()};
+  for (size_t round = 0; round < details::ROUND_COUNT; ++round) {
+    monotonic_buffer buffer{PagedPool};
+    monotonic_allocator<details::tree_node> alloc{buffer};
+    monotonic_sum += details::build_tree(alloc, nodes.data());
+  }
+  const auto monotonic_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+
+  start = chrono::steady_clock::now();
+  for (size_t round = 0; round < details::ROUND_COUNT; ++round) {
+    basic_paged_allocator<details::tree_node> alloc;
+    paged_sum += details::build_tree(alloc, nodes.data());
+    for (auto* node : nodes) {
+      alloc.deallocate(node, 1);
+    }
+  }
+  const auto paged_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+
+  ASSERT_VALUE(monotonic_sum == paged_sum)
+  tests::details::print(
+      "monotonic_allocator: {} trees of {} nodes in {} us, "
+      "basic_paged_allocator in {} us\n",
+      details::ROUND_COUNT, details::NODE_COUNT, monotonic_elapsed.count(),
+      paged_elapsed.count());
+}
+}  // namespace tests::allocator
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace tests::allocator {
+void slab_size_classes();
+void slab_heap_alloc_and_free();
+void slab_allocator_with_vector();
+void monotonic_allocator_alloc();
+void monotonic_allocator_overflow();
+void monotonic_allocator_vs_paged_allocator();
+}
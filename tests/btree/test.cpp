@@ -0,0 +1,316 @@
+#include "test.hpp"
+
+#include <chrono.hpp>
+#include <map.hpp>
+#include <set.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::btree {
+namespace details {
+constexpr int KEY_RANGE{256};
+constexpr size_t OPERATION_COUNT{8192};
+constexpr size_t CHECK_PERIOD{64};
+constexpr uint16_t MAX_DUPLICATES{3};
+
+// 3 values per node: every few erasures merge or rotate nodes
+constexpr size_t TINY_NODE_SIZE{0};
+// 4 values per node, so that a half-full node has 2 of them
+constexpr size_t SMALL_NODE_SIZE{2 * sizeof(void*) + 4 * sizeof(int)};
+
+template <size_t NodeSize>
+using tiny_set =
+    btree_set_non_paged<int, less<int>, basic_non_paged_allocator<byte>,
+                        NodeSize>;
+template <size_t NodeSize>
+using tiny_multiset =
+    btree_multiset_non_paged<int, less<int>, basic_non_paged_allocator<byte>,
+                             NodeSize>;
+template <size_t NodeSize>
+using tiny_map =
+    btree_map_non_paged<int, int, less<int>, basic_non_paged_allocator<byte>,
+                        NodeSize>;
+
+static_assert(tiny_set<TINY_NODE_SIZE>::SLOT_COUNT == 3);
+
+// Sorted reference: the number of copies of each key
+struct reference {
+  uint16_t counts[KEY_RANGE]{};
+  size_t size{0};
+};
+
+struct xorshift {
+  uint32_t state{0x9E3779B9u};
+
+  uint32_t next() noexcept {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  int next_key() noexcept { return static_cast<int>(next() % KEY_RANGE); }
+
+  bool next_bool(uint32_t percent) noexcept {
+    return static_cast<uint32_t>(next_key()) * 100 / KEY_RANGE < percent;
+  }
+};
+
+constexpr int BENCHMARK_KEY_COUNT{1 << 16};
+constexpr size_t LOOKUP_COUNT{size_t{1} << 20};
+constexpr size_t SCAN_COUNT{size_t{1} << 12};
+constexpr size_t SCAN_LENGTH{256};
+
+// Keys are even, so that half of the lookups miss; the sums are checked so
+// that no lookup or scan can be dropped
+template <class Map>
+void time_lookups_and_scans(const Map& map, const char* name) {
+  xorshift random;
+  const auto next_key{[&random] {
+    return static_cast<int>(random.next() % (2 * BENCHMARK_KEY_COUNT));
+  }};
+
+  size_t found_count{0};
+  size_t expected_count{0};
+  auto start{chrono::steady_clock::now()};
+  for (size_t lookup = 0; lookup < LOOKUP_COUNT; ++lookup) {
+    const int key{next_key()};
+    const auto it{map.find(key)};
+    if (it != map.end() && it->second == key * 2) {
+      ++found_count;
+    }
+    expected_count += key % 2 == 0;
+  }
+  const auto lookup_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_EQ(found_count, expected_count)
+
+  int64_t scan_sum{0};
+  int64_t expected_sum{0};
+  start = chrono::steady_clock::now();
+  for (size_t scan = 0; scan < SCAN_COUNT; ++scan) {
+    const int first_key{next_key()};
+    auto it{map.lower_bound(first_key)};
+    int expected_key{(first_key + 1) / 2 * 2};
+    for (size_t step = 0; step < SCAN_LENGTH && it != map.end();
+         ++step, ++it) {
+      scan_sum += it->second;
+      expected_sum += expected_key * 2;
+      expected_key += 2;
+    }
+  }
+  const auto scan_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_VALUE(scan_sum == expected_sum)
+
+  tests::details::print(
+      "{}: {} keys, {} lookups in {} us, {} scans of {} in {} us\n", name,
+      map.size(), LOOKUP_COUNT, lookup_elapsed.count(), SCAN_COUNT,
+      SCAN_LENGTH, scan_elapsed.count());
+}
+
+template <class Map>
+void fill_even_keys(Map& map) {
+  for (int key = 0; key < 2 * BENCHMARK_KEY_COUNT; key += 2) {
+    map.try_emplace(key, key * 2);
+  }
+}
+
+template <class Ty>
+int key_of(const Ty& value) {
+  if constexpr (is_same_v<Ty, int>) {
+    return value;
+  } else {
+    ASSERT_EQ(value.second, value.first * 2)
+    return value.first;
+  }
+}
+
+template <class Tree>
+void check_against_reference(const Tree& tree, const reference& ref) {
+  ASSERT_EQ(tree.size(), ref.size)
+  ASSERT_VALUE(tree.empty() == (ref.size == 0))
+
+  auto it{tree.begin()};
+  for (int key = 0; key < KEY_RANGE; ++key) {
+    for (uint16_t copy = 0; copy < ref.counts[key]; ++copy) {
+      ASSERT_VALUE(it != tree.end())
+      ASSERT_EQ(key_of(*it), key)
+      ++it;
+    }
+  }
+  ASSERT_VALUE(it == tree.end())
+
+  for (int key = KEY_RANGE; key-- > 0;) {
+    for (uint16_t copy = 0; copy < ref.counts[key]; ++copy) {
+      ASSERT_VALUE(it != tree.begin())
+      --it;
+      ASSERT_EQ(key_of(*it), key)
+    }
+  }
+  ASSERT_VALUE(it == tree.begin())
+}
+
+template <class Tree>
+void insert(Tree& tree, reference& ref, int key) {
+  const bool inserted{Tree::is_multi ? ref.counts[key] < MAX_DUPLICATES
+                                     : ref.counts[key] == 0};
+  if constexpr (Tree::is_map) {
+    if (inserted) {
+      const auto [it, success]{tree.try_emplace(key, key * 2)};
+      ASSERT_VALUE(success)
+      ASSERT_EQ(it->first, key)
+    } else {
+      ASSERT_VALUE(!tree.try_emplace(key, key * 2).second)
+    }
+  } else if constexpr (Tree::is_multi) {
+    if (inserted) {
+      ASSERT_EQ(*tree.insert(key), key)
+    }
+  } else {
+    const auto [it, success]{tree.insert(key)};
+    ASSERT_VALUE(success == inserted)
+    ASSERT_EQ(*it, key)
+  }
+  if (inserted) {
+    ++ref.counts[key];
+    ++ref.size;
+  }
+}
+
+// Erases by key or by iterator; the latter has to return the next value
+template <class Tree>
+void erase(Tree& tree, reference& ref, int key, bool by_iterator) {
+  if (by_iterator) {
+    const auto it{tree.lower_bound(key)};
+    if (it == tree.end()) {
+      return;
+    }
+    const int erased{key_of(*it)};
+    const auto next{tree.erase(it)};
+    ASSERT_VALUE(next == tree.lower_bound(erased))
+    --ref.counts[erased];
+    --ref.size;
+  } else {
+    ASSERT_EQ(tree.erase(key), static_cast<size_t>(ref.counts[key]))
+    ref.size -= ref.counts[key];
+    ref.counts[key] = 0;
+  }
+}
+
+/*
+ * Grows the tree with insertions prevailing, then shrinks it with erasures
+ * prevailing and finally erases the rest from the beginning, so that the
+ * root collapses down to an empty tree
+ */
+template <class Tree>
+void check_random_operations() {
+  Tree tree;
+  reference ref;
+  xorshift random;
+  for (size_t op = 0; op < OPERATION_COUNT; ++op) {
+    const uint32_t insert_percent{op < OPERATION_COUNT / 2 ? 70u : 30u};
+    const int key{random.next_key()};
+    if (random.next_bool(insert_percent)) {
+      insert(tree, ref, key);
+    } else {
+      erase(tree, ref, key, random.next_bool(50));
+    }
+    if (op % CHECK_PERIOD == 0) {
+      check_against_reference(tree, ref);
+    }
+  }
+  check_against_reference(tree, ref);
+
+  while (!tree.empty()) {
+    const int key{key_of(*tree.begin())};
+    const auto next{tree.erase(tree.begin())};
+    ASSERT_VALUE(next == tree.begin())
+    --ref.counts[key];
+    --ref.size;
+  }
+  check_against_reference(tree, ref);
+  ASSERT_VALUE(tree.begin() == tree.end())
+}
+}  // namespace details
+
+void set_against_reference() {
+  details::check_random_operations<
+      details::tiny_set<details::TINY_NODE_SIZE>>();
+  details::check_random_operations<
+      details::tiny_set<details::SMALL_NODE_SIZE>>();
+  details::check_random_operations<btree_set_non_paged<int>>();
+}
+
+void multiset_against_reference() {
+  details::check_random_operations<
+      details::tiny_multiset<details::TINY_NODE_SIZE>>();
+  details::check_random_operations<
+      details::tiny_multiset<details::SMALL_NODE_SIZE>>();
+}
+
+void map_against_reference() {
+  details::check_random_operations<
+      details::tiny_map<details::TINY_NODE_SIZE>>();
+  details::check_random_operations<
+      details::tiny_map<details::SMALL_NODE_SIZE>>();
+}
+
+void iterate_both_directions() {
+  constexpr int value_count{1000};
+
+  details::tiny_set<details::TINY_NODE_SIZE> set;
+  for (int value = value_count; value-- > 0;) {
+    set.insert(value * 2);
+  }
+
+  // Steps back and forth from every value cross node boundaries
+  for (int value = 1; value < value_count - 1; ++value) {
+    auto it{set.find(value * 2)};
+    ASSERT_VALUE(it != set.end())
+    ASSERT_EQ(*--it, value * 2 - 2)
+    ASSERT_EQ(*++it, value * 2)
+    ASSERT_EQ(*++it, value * 2 + 2)
+    ASSERT_EQ(*it--, value * 2 + 2)
+    ASSERT_EQ(*it, value * 2)
+  }
+
+  auto first{set.lower_bound(1)};
+  ASSERT_EQ(*first, 2)
+  ASSERT_VALUE(--first == set.begin())
+  auto last{set.upper_bound(value_count * 2)};
+  ASSERT_VALUE(last == set.end())
+  ASSERT_EQ(*--last, value_count * 2 - 2)
+  ASSERT_VALUE(++last == set.end())
+
+  // Walks meet in the middle
+  auto forward{set.begin()};
+  auto backward{set.end()};
+  for (int step = 0; step < value_count / 2; ++step) {
+    --backward;
+    ASSERT_EQ(*forward + *backward, value_count * 2 - 2)
+    ++forward;
+  }
+  ASSERT_VALUE(forward == backward)
+}
+
+void lookup_and_range_scan_latency() {
+  btree_map_non_paged<int, int> map;
+  details::fill_even_keys(map);
+  details::time_lookups_and_scans(map, "btree_map");
+
+  // Nodes of 3 values are close to a binary tree with a node per value
+  using tiny_map_type = details::tiny_map<details::TINY_NODE_SIZE>;
+  static_assert(tiny_map_type::SLOT_COUNT == 3);
+  tiny_map_type tiny_node_map;
+  details::fill_even_keys(tiny_node_map);
+  details::time_lookups_and_scans(tiny_node_map, "btree_map, 3 per node");
+
+  flat_map_non_paged<int, int> sorted_map;
+  sorted_map.reserve(details::BENCHMARK_KEY_COUNT);
+  details::fill_even_keys(sorted_map);
+  details::time_lookups_and_scans(sorted_map, "flat_map");
+}
+}  // namespace tests::btree
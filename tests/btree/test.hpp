@@ -0,0 +1,9 @@
+#pragma once
+
+namespace tests::btree {
+void set_against_reference();
+void multiset_against_reference();
+void map_against_reference();
+void iterate_both_directions();
+void lookup_and_range_scan_latency();
+}
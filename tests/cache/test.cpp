@@ -0,0 +1,141 @@
+#include "test.hpp"
+
+#include <cache.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::cache {
+namespace details {
+constexpr size_t CAPACITY{4};
+
+constexpr size_t SHARD_COUNT{16};
+constexpr size_t SHARD_CAPACITY{64};
+
+template <class Cache>
+void fill(Cache& cache) {
+  for (size_t idx = 0; idx < CAPACITY; ++idx) {
+    cache.put(static_cast<int>(idx), static_cast<int>(idx) * 10);
+  }
+}
+
+template <class Cache>
+void check_put_updates_existing_key() {
+  Cache cache{CAPACITY};
+  cache.put(1, 10);
+  cache.put(1, 20);
+  ASSERT_EQ(cache.size(), static_cast<size_t>(1))
+  ASSERT_EQ(*cache.peek(1), 20)
+
+  fill(cache);
+  ASSERT_EQ(cache.size(), CAPACITY)
+  cache.put(2, 200);
+  ASSERT_EQ(cache.size(), CAPACITY)
+  ASSERT_EQ(cache.stats().evictions, static_cast<size_t>(0))
+  ASSERT_EQ(*cache.get(2), 200)
+
+  // The entry is inserted again after erasure
+  ASSERT_VALUE(cache.erase(2))
+  ASSERT_VALUE(!cache.erase(2))
+  cache.put(2, 2000);
+  ASSERT_EQ(cache.size(), CAPACITY)
+  ASSERT_EQ(*cache.peek(2), 2000)
+  ASSERT_EQ(cache.stats().evictions, static_cast<size_t>(0))
+}
+}  // namespace details
+
+void lru_eviction_order() {
+  lru_cache_non_paged<int, int> cache{details::CAPACITY};
+  details::fill(cache);
+  ASSERT_EQ(*cache.get(0), 0)
+
+  // From the least recently used: 1, 2, 3, 0
+  cache.put(4, 40);
+  ASSERT_VALUE(!cache.contains(1))
+  cache.put(5, 50);
+  ASSERT_VALUE(!cache.contains(2))
+
+  // peek() doesn't refresh the entry, put() of the existing key does
+  ASSERT_EQ(*cache.peek(3), 30)
+  cache.put(0, 100);
+  cache.put(6, 60);
+  ASSERT_VALUE(!cache.contains(3))
+  cache.put(7, 70);
+  ASSERT_VALUE(!cache.contains(4))
+
+  constexpr int remaining[]{0, 5, 6, 7};
+  for (int key : remaining) {
+    ASSERT_VALUE(cache.contains(key))
+  }
+  ASSERT_EQ(*cache.peek(0), 100)
+  ASSERT_EQ(cache.size(), details::CAPACITY)
+  ASSERT_EQ(cache.stats().evictions, static_cast<size_t>(4))
+  ASSERT_EQ(cache.stats().hits, static_cast<size_t>(1))
+}
+
+void clock_eviction_order() {
+  clock_cache_non_paged<int, int> cache{details::CAPACITY};
+  details::fill(cache);
+
+  // The hand is at the entry of 0; hits give 0 and 2 the second chance
+  ASSERT_EQ(*cache.get(0), 0)
+  ASSERT_EQ(*cache.get(2), 20)
+  cache.put(4, 40);
+  ASSERT_VALUE(!cache.contains(1))
+  ASSERT_VALUE(cache.contains(0))
+  cache.put(5, 50);
+  ASSERT_VALUE(!cache.contains(3))
+  ASSERT_VALUE(cache.contains(2))
+
+  // Flags of 0 and 2 were cleared by the sweep
+  cache.put(6, 60);
+  ASSERT_VALUE(!cache.contains(0))
+  ASSERT_VALUE(cache.get(0) == nullptr)
+  cache.put(7, 70);
+  ASSERT_VALUE(!cache.contains(4))
+
+  constexpr int remaining[]{2, 5, 6, 7};
+  for (int key : remaining) {
+    ASSERT_VALUE(cache.contains(key))
+  }
+  ASSERT_EQ(cache.size(), details::CAPACITY)
+  ASSERT_EQ(cache.stats().evictions, static_cast<size_t>(4))
+  ASSERT_EQ(cache.stats().misses, static_cast<size_t>(1))
+}
+
+void put_updates_existing_key() {
+  details::check_put_updates_existing_key<lru_cache_non_paged<int, int>>();
+  details::check_put_updates_existing_key<clock_cache_non_paged<int, int>>();
+}
+
+void sharded_cache_distribution() {
+  constexpr size_t capacity{details::SHARD_COUNT * details::SHARD_CAPACITY};
+  sharded_cache<lru_cache_non_paged<int, int>, details::SHARD_COUNT> cache{
+      capacity};
+  ASSERT_EQ(cache.capacity(), capacity)
+
+  /*
+   * Sequential keys have to be spread over shards: half of the capacity
+   * fits without evictions unless some shard gets twice as many keys as the
+   * average
+   */
+  constexpr size_t key_count{capacity / 2};
+  for (size_t idx = 0; idx < key_count; ++idx) {
+    cache.put(static_cast<int>(idx), static_cast<int>(idx));
+  }
+  ASSERT_EQ(cache.size(), key_count)
+  ASSERT_EQ(cache.stats().evictions, static_cast<size_t>(0))
+  for (size_t idx = 0; idx < key_count; ++idx) {
+    const auto value{cache.get(static_cast<int>(idx))};
+    ASSERT_VALUE(value.has_value() && *value == static_cast<int>(idx))
+  }
+
+  // Overflow evicts within shards only
+  for (size_t idx = key_count; idx < 2 * capacity; ++idx) {
+    cache.put(static_cast<int>(idx), static_cast<int>(idx));
+  }
+  ASSERT_VALUE(cache.size() <= capacity)
+  ASSERT_EQ(cache.stats().evictions, 2 * capacity - cache.size())
+}
+}  // namespace tests::cache
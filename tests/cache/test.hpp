@@ -0,0 +1,8 @@
+#pragma once
+
+namespace tests::cache {
+void lru_eviction_order();
+void clock_eviction_order();
+void put_updates_existing_key();
+void sharded_cache_distribution();
+}
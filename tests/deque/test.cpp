@@ -0,0 +1,301 @@
+#include "test.hpp"
+
+#include <deque.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::deque {
+namespace details {
+constexpr size_t CHUNK_CAPACITY{3};
+constexpr size_t CHUNK_SIZE{CHUNK_CAPACITY * sizeof(int)};
+constexpr size_t MAX_INDEX_ALLOCATIONS{16};
+
+// Index blocks are never CHUNK_SIZE bytes long since the index holds at least
+// 8 pointers, so chunks and indices are counted separately
+struct counting_allocator : basic_non_paged_allocator<byte> {
+  static inline size_t chunk_allocations{0};
+  static inline size_t index_allocations{0};
+  static inline size_t index_bytes[MAX_INDEX_ALLOCATIONS]{};
+  static inline size_t live_blocks{0};
+
+  static void reset() noexcept {
+    chunk_allocations = 0;
+    index_allocations = 0;
+    live_blocks = 0;
+  }
+
+  byte* allocate_bytes(size_t bytes_count) {
+    if (bytes_count == CHUNK_SIZE) {
+      ++chunk_allocations;
+    } else {
+      if (index_allocations < MAX_INDEX_ALLOCATIONS) {
+        index_bytes[index_allocations] = bytes_count;
+      }
+      ++index_allocations;
+    }
+    byte* const block{
+        basic_non_paged_allocator<byte>::allocate_bytes(bytes_count)};
+    ++live_blocks;
+    return block;
+  }
+
+  void deallocate_bytes(byte* ptr, size_t bytes_count) noexcept {
+    --live_blocks;
+    basic_non_paged_allocator<byte>::deallocate_bytes(ptr, bytes_count);
+  }
+};
+
+using deque_type = deque_non_paged<int, counting_allocator, CHUNK_SIZE>;
+static_assert(deque_type::CHUNK_CAPACITY == CHUNK_CAPACITY);
+
+// xorshift32
+struct random_generator {
+  uint32_t operator()() noexcept {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  uint32_t state;
+};
+
+// Pushes at the back until a new chunk is taken from the allocator, so the
+// last element is the first one in its chunk
+inline void push_back_to_chunk_start(deque_type& dq, int& next_value) {
+  const size_t chunk_allocations{counting_allocator::chunk_allocations};
+  while (counting_allocator::chunk_allocations == chunk_allocations) {
+    dq.push_back(next_value++);
+  }
+}
+
+inline void push_front_to_chunk_start(deque_type& dq, int& next_value) {
+  const size_t chunk_allocations{counting_allocator::chunk_allocations};
+  while (counting_allocator::chunk_allocations == chunk_allocations) {
+    dq.push_front(next_value++);
+  }
+}
+}  // namespace details
+
+void push_pop_against_reference() {
+  constexpr size_t ops_count{4096};
+  details::counting_allocator::reset();
+  {
+    // The model is a window [head, tail) of a buffer which can't overflow
+    vector<int, basic_non_paged_allocator<int> > model(2 * ops_count + 1, 0);
+    size_t head{ops_count}, tail{ops_count};
+
+    details::deque_type dq;
+    details::random_generator rng{0x9e3779b9};
+    int next_value{0};
+    for (size_t op_idx = 0; op_idx < ops_count; ++op_idx) {
+      // Growing and shrinking phases move the ends across many chunks
+      const bool growing{(op_idx / 512) % 2 == 0};
+      const uint32_t op{rng() % 8};
+      if (op < (growing ? 3u : 2u)) {
+        dq.push_back(next_value);
+        model[tail++] = next_value++;
+      } else if (op < (growing ? 6u : 4u)) {
+        dq.push_front(next_value);
+        model[--head] = next_value++;
+      } else if (head == tail) {
+        ASSERT_VALUE(dq.empty())
+      } else if (op % 2 == 0) {
+        dq.pop_back();
+        --tail;
+      } else {
+        dq.pop_front();
+        ++head;
+      }
+
+      ASSERT_EQ(dq.size(), tail - head)
+      if (head != tail) {
+        ASSERT_EQ(dq.front(), model[head])
+        ASSERT_EQ(dq.back(), model[tail - 1])
+      }
+      if (op_idx % 64 == 0 || op_idx + 1 == ops_count) {
+        for (size_t idx = 0; idx < dq.size(); ++idx) {
+          ASSERT_EQ(dq[idx], model[head + idx])
+        }
+        size_t idx{head};
+        for (int value : dq) {
+          ASSERT_EQ(value, model[idx++])
+        }
+        ASSERT_EQ(idx, tail)
+      }
+    }
+  }
+  ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(0))
+}
+
+void reuse_spare_chunk_at_boundary() {
+  constexpr size_t cycle_count{100};
+  details::counting_allocator::reset();
+  {
+    details::deque_type dq;
+    int next_value{0};
+    dq.push_back(next_value++);
+
+    // The chunk released by pop_back() is kept and taken again by push_back()
+    details::push_back_to_chunk_start(dq, next_value);
+    const int last_in_chunk{dq[dq.size() - 2]};
+    const size_t back_chunk_allocations{
+        details::counting_allocator::chunk_allocations};
+    for (size_t cycle = 0; cycle < cycle_count; ++cycle) {
+      dq.pop_back();
+      ASSERT_EQ(dq.back(), last_in_chunk)
+      dq.push_back(next_value++);
+    }
+    ASSERT_EQ(details::counting_allocator::chunk_allocations,
+              back_chunk_allocations)
+    const int back_value{dq.back()};
+
+    details::push_front_to_chunk_start(dq, next_value);
+    const int first_in_chunk{dq[1]};
+    const size_t front_chunk_allocations{
+        details::counting_allocator::chunk_allocations};
+    for (size_t cycle = 0; cycle < cycle_count; ++cycle) {
+      dq.pop_front();
+      ASSERT_EQ(dq.front(), first_in_chunk)
+      dq.push_front(next_value++);
+    }
+    ASSERT_EQ(details::counting_allocator::chunk_allocations,
+              front_chunk_allocations)
+    ASSERT_EQ(dq.front(), next_value - 1)
+    ASSERT_EQ(dq.back(), back_value)
+  }
+  ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(0))
+}
+
+void recenter_and_double_index() {
+  constexpr size_t window_size{details::CHUNK_CAPACITY};
+  constexpr size_t slide_count{100 * details::CHUNK_CAPACITY};
+  details::counting_allocator::reset();
+  {
+    details::deque_type dq;
+    int next_value{0};
+    for (size_t idx = 0; idx < window_size; ++idx) {
+      dq.push_back(next_value++);
+    }
+    ASSERT_EQ(details::counting_allocator::index_allocations,
+              static_cast<size_t>(1))
+
+    // A window of a few chunks sliding over the index is moved back to its
+    // middle instead of reallocating the index
+    for (size_t idx = 0; idx < slide_count; ++idx) {
+      dq.push_back(next_value++);
+      dq.pop_front();
+      ASSERT_EQ(dq.front(), next_value - static_cast<int>(window_size))
+    }
+    for (size_t idx = 0; idx < slide_count; ++idx) {
+      dq.push_front(dq.front() - 1);
+      dq.pop_back();
+    }
+    ASSERT_EQ(details::counting_allocator::index_allocations,
+              static_cast<size_t>(1))
+    ASSERT_EQ(dq.size(), window_size)
+    for (size_t idx = 0; idx < window_size; ++idx) {
+      ASSERT_EQ(dq[idx], dq.front() + static_cast<int>(idx))
+    }
+
+    // The index is doubled when more than a half of it is used
+    constexpr size_t pushed_count{64 * details::CHUNK_CAPACITY};
+    const int first_value{dq.front()};
+    for (size_t idx = 0; idx < pushed_count; ++idx) {
+      dq.push_back(first_value + static_cast<int>(window_size + idx));
+    }
+    const size_t index_allocations{
+        details::counting_allocator::index_allocations};
+    ASSERT_VALUE(index_allocations > 1)
+    ASSERT_VALUE(index_allocations <= details::MAX_INDEX_ALLOCATIONS)
+    for (size_t idx = 1; idx < index_allocations; ++idx) {
+      ASSERT_EQ(details::counting_allocator::index_bytes[idx],
+                2 * details::counting_allocator::index_bytes[idx - 1])
+    }
+    ASSERT_EQ(dq.size(), window_size + pushed_count)
+    for (size_t idx = 0; idx < dq.size(); ++idx) {
+      ASSERT_EQ(dq[idx], first_value + static_cast<int>(idx))
+    }
+  }
+  ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(0))
+}
+
+void stable_addresses() {
+  constexpr size_t tracked_count{10 * details::CHUNK_CAPACITY};
+  constexpr size_t pushed_count{50 * details::CHUNK_CAPACITY};
+  details::counting_allocator::reset();
+  {
+    details::deque_type dq;
+    const int* addresses[tracked_count]{};
+    for (size_t idx = 0; idx < tracked_count; ++idx) {
+      addresses[idx] = addressof(dq.emplace_back(static_cast<int>(idx)));
+    }
+
+    // Neither the index growth nor the pops at the ends move the elements
+    const size_t index_allocations{
+        details::counting_allocator::index_allocations};
+    for (size_t idx = 0; idx < pushed_count; ++idx) {
+      dq.push_back(-1);
+      dq.push_front(-1);
+    }
+    ASSERT_VALUE(details::counting_allocator::index_allocations >
+                 index_allocations)
+    for (size_t idx = 0; idx < pushed_count; ++idx) {
+      dq.pop_back();
+      dq.pop_front();
+    }
+    dq.pop_front();
+    dq.pop_back();
+
+    ASSERT_EQ(dq.size(), tracked_count - 2)
+    for (size_t idx = 1; idx + 1 < tracked_count; ++idx) {
+      ASSERT_VALUE(addressof(dq[idx - 1]) == addresses[idx])
+      ASSERT_EQ(*addresses[idx], static_cast<int>(idx))
+    }
+  }
+  ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(0))
+}
+
+void clear_and_reuse() {
+  constexpr size_t element_count{20 * details::CHUNK_CAPACITY};
+  details::counting_allocator::reset();
+  {
+    details::deque_type dq;
+    for (size_t idx = 0; idx < element_count; ++idx) {
+      dq.push_back(static_cast<int>(idx));
+    }
+
+    // Only the index and the spare chunk are left
+    dq.clear();
+    ASSERT_VALUE(dq.empty())
+    ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(2))
+
+    // The first element is placed in the middle of a chunk, so there is room
+    // at both ends of the spare chunk
+    const size_t chunk_allocations{
+        details::counting_allocator::chunk_allocations};
+    const size_t index_allocations{
+        details::counting_allocator::index_allocations};
+    dq.push_back(1);
+    dq.push_front(0);
+    ASSERT_EQ(details::counting_allocator::chunk_allocations,
+              chunk_allocations)
+    ASSERT_EQ(details::counting_allocator::index_allocations,
+              index_allocations)
+    ASSERT_EQ(dq.size(), static_cast<size_t>(2))
+    ASSERT_EQ(dq.front(), 0)
+    ASSERT_EQ(dq.back(), 1)
+
+    dq.clear();
+    dq.shrink_to_fit();
+    ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(0))
+
+    dq.push_back(42);
+    ASSERT_EQ(dq.front(), 42)
+  }
+  ASSERT_EQ(details::counting_allocator::live_blocks, static_cast<size_t>(0))
+}
+}  // namespace tests::deque
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace tests::deque {
+void push_pop_against_reference();
+void reuse_spare_chunk_at_boundary();
+void recenter_and_double_index();
+void stable_addresses();
+void clear_and_reuse();
+}
@@ -1,11 +1,23 @@
+#include "allocator/test.hpp"
+#include "btree/test.hpp"
+#include "cache/test.hpp"
+#include "deque/test.hpp"
 #include "dynamic_init/test.hpp"
 #include "exception_dispatcher/test.hpp"
+#include "flat_map/test.hpp"
 #include "floating_point/test.hpp"
+#include "frozen_table/test.hpp"
+#include "hash/test.hpp"
+#include "hash_table/test.hpp"
 #include "heap/test.hpp"
+#include "incremental_table/test.hpp"
 #include "irql/test.hpp"
+#include "lockfree/test.hpp"
 #include "placement_new/test.hpp"
 #include "preload_init/test.hpp"
 #include "runner/test_runner.hpp"
+#include "swiss_table/test.hpp"
+#include "vector/test.hpp"
 
 #include <modules/fmt/compile.hpp>
 #include <modules/fmt/xchar.hpp>
@@ -67,11 +79,119 @@ void RunTests() {
 
   RUN_TEST(tr, tests::heap::alloc_and_free);
   RUN_TEST(tr, tests::heap::alloc_and_free_noexcept);
+  RUN_TEST(tr, tests::heap::alloc_and_free_default_tag);
+
+  RUN_TEST(tr, tests::allocator::slab_size_classes);
+  RUN_TEST(tr, tests::allocator::slab_heap_alloc_and_free);
+  RUN_TEST(tr, tests::allocator::slab_allocator_with_vector);
+  RUN_TEST(tr, tests::allocator::monotonic_allocator_alloc);
+  RUN_TEST(tr, tests::allocator::monotonic_allocator_overflow);
+  RUN_TEST(tr, tests::allocator::monotonic_allocator_vs_paged_allocator);
 
   RUN_TEST(tr, tests::irql::current);
   RUN_TEST(tr, tests::irql::raise_and_lower);
   RUN_TEST(tr, tests::irql::less_or_equal);
 
+  RUN_TEST(tr, tests::lockfree::retire_and_synchronize);
+  RUN_TEST(tr, tests::lockfree::retire_in_critical_section);
+  RUN_TEST(tr, tests::lockfree::tagged_freelist_push_pop_detach);
+  RUN_TEST(tr, tests::lockfree::sharded_node_allocator_steal);
+  RUN_TEST(tr, tests::lockfree::sharded_node_allocator_initial_count_failure);
+  RUN_TEST(tr, tests::lockfree::sharded_queue_scalability);
+  RUN_TEST(tr, tests::lockfree::bounded_queue_bulk_push_pop);
+  RUN_TEST(tr, tests::lockfree::bounded_queue_vs_queue);
+  RUN_TEST(tr, tests::lockfree::spsc_queue_bulk_push_pop);
+  RUN_TEST(tr, tests::lockfree::spsc_queue_push_pop);
+  RUN_TEST(tr, tests::lockfree::mpsc_queue_push_pop);
+  RUN_TEST(tr, tests::lockfree::spsc_and_mpsc_queue_latency);
+  RUN_TEST(tr, tests::lockfree::queue_push_range_pop_bulk_consume_all);
+  RUN_TEST(tr, tests::lockfree::queue_batch_size_cost);
+  RUN_TEST(tr, tests::lockfree::reclaiming_queue_push_and_pop);
+  RUN_TEST(tr, tests::lockfree::concurrent_map_insert_find_erase);
+  RUN_TEST(tr, tests::lockfree::concurrent_map_concurrent_readers_and_writers);
+  RUN_TEST(tr, tests::lockfree::concurrent_map_vs_synchronized_map);
+  RUN_TEST(tr, tests::lockfree::work_stealing_deque_push_pop_steal);
+  RUN_TEST(tr, tests::lockfree::thread_pool_bulk_submit);
+  RUN_TEST(tr, tests::lockfree::thread_pool_scalability);
+
+  RUN_TEST(tr, tests::swiss_table::match_control_groups);
+  RUN_TEST(tr, tests::swiss_table::insert_find_erase);
+  RUN_TEST(tr, tests::swiss_table::rehash_after_tombstones);
+  RUN_TEST(tr, tests::swiss_table::iterate_after_erase);
+  RUN_TEST(tr, tests::swiss_table::lookup_with_hash_and_find_many);
+  RUN_TEST(tr, tests::swiss_table::swiss_vs_robin_hood);
+
+  RUN_TEST(tr, tests::hash::wyhash_known_answers);
+  RUN_TEST(tr, tests::hash::hash_bytes_throughput);
+
+  RUN_TEST(tr, tests::frozen_table::frozen_map_lookup);
+  RUN_TEST(tr, tests::frozen_table::frozen_set_lookup);
+  RUN_TEST(tr, tests::frozen_table::reject_duplicates_and_collisions);
+  RUN_TEST(tr, tests::frozen_table::make_frozen_map_lookup);
+  RUN_TEST(tr, tests::frozen_table::frozen_map_vs_flat_map);
+
+  RUN_TEST(tr, tests::cache::lru_eviction_order);
+  RUN_TEST(tr, tests::cache::clock_eviction_order);
+  RUN_TEST(tr, tests::cache::put_updates_existing_key);
+  RUN_TEST(tr, tests::cache::sharded_cache_distribution);
+
+  RUN_TEST(tr, tests::btree::set_against_reference);
+  RUN_TEST(tr, tests::btree::multiset_against_reference);
+  RUN_TEST(tr, tests::btree::map_against_reference);
+  RUN_TEST(tr, tests::btree::iterate_both_directions);
+  RUN_TEST(tr, tests::btree::lookup_and_range_scan_latency);
+
+  RUN_TEST(tr, tests::vector::small_vector_inline_to_heap);
+  RUN_TEST(tr, tests::vector::small_vector_move_and_swap);
+  RUN_TEST(tr, tests::vector::small_vector_shrink_to_fit);
+  RUN_TEST(tr, tests::vector::small_vector_allocations);
+  RUN_TEST(tr, tests::vector::insert_and_emplace);
+  RUN_TEST(tr, tests::vector::fill_insert_without_growth);
+  RUN_TEST(tr, tests::vector::erase_middle_range);
+  RUN_TEST(tr, tests::vector::move_assignment_with_unequal_allocators);
+  RUN_TEST(tr, tests::vector::relocation_on_growth);
+  RUN_TEST(tr, tests::vector::unique_ptr_vector_growth);
+  RUN_TEST(tr, tests::vector::vector_uninitialized_storage);
+  RUN_TEST(tr, tests::vector::small_vector_uninitialized_storage);
+  RUN_TEST(tr, tests::vector::string_uninitialized_storage);
+
+  RUN_TEST(tr, tests::deque::push_pop_against_reference);
+  RUN_TEST(tr, tests::deque::reuse_spare_chunk_at_boundary);
+  RUN_TEST(tr, tests::deque::recenter_and_double_index);
+  RUN_TEST(tr, tests::deque::stable_addresses);
+  RUN_TEST(tr, tests::deque::clear_and_reuse);
+
+  RUN_TEST(tr, tests::flat_map::bulk_build_with_duplicates);
+  RUN_TEST(tr, tests::flat_map::insert_range_merges_present_keys);
+  RUN_TEST(tr, tests::flat_map::multimap_keeps_insertion_order);
+  RUN_TEST(tr, tests::flat_map::heterogeneous_lookup);
+  RUN_TEST(tr, tests::flat_map::sort_around_threshold);
+  RUN_TEST(tr, tests::flat_map::sort_adversarial_input);
+  RUN_TEST(tr, tests::flat_map::small_flat_map_vs_hash_map);
+
+  RUN_TEST(tr, tests::incremental_table::insert_find_erase_while_migrating);
+  RUN_TEST(tr, tests::incremental_table::erase_from_old_array);
+  RUN_TEST(tr, tests::incremental_table::iterate_both_arrays);
+  RUN_TEST(tr, tests::incremental_table::copy_move_swap_while_migrating);
+  RUN_TEST(tr, tests::incremental_table::reserve_and_rehash_finish_migration);
+  RUN_TEST(tr, tests::incremental_table::failed_allocation_keeps_table);
+  RUN_TEST(tr, tests::incremental_table::insert_latency);
+
+  RUN_TEST(tr, tests::hash_table::compact_releases_free_blocks);
+  RUN_TEST(tr, tests::hash_table::shrink_to_fit_empty_table);
+  RUN_TEST(tr, tests::hash_table::copy_assignment_between_sizes);
+  RUN_TEST(tr, tests::hash_table::min_load_factor_shrinks_on_erase_by_key);
+  RUN_TEST(tr, tests::hash_table::min_load_factor_out_of_range);
+  RUN_TEST(tr, tests::hash_table::failed_shrink_keeps_table);
+  RUN_TEST(tr, tests::hash_table::memory_over_time);
+  RUN_TEST(tr, tests::hash_table::image_round_trip);
+  RUN_TEST(tr, tests::hash_table::image_of_empty_table);
+  RUN_TEST(tr, tests::hash_table::image_rejects_mismatches);
+  RUN_TEST(tr, tests::hash_table::image_view_rejects_misaligned_and_other_hash);
+  RUN_TEST(tr, tests::hash_table::load_image_latency);
+  RUN_TEST(tr, tests::hash_table::stats_of_colliding_keys);
+  RUN_TEST(tr, tests::hash_table::lookup_with_hash_and_find_many);
+
   RUN_TEST(tr, tests::exception_dispatcher::throw_directly);
   RUN_TEST(tr, tests::exception_dispatcher::throw_in_nested_call);
   RUN_TEST(tr, tests::exception_dispatcher::throw_on_array_init);
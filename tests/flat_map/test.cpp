@@ -0,0 +1,410 @@
+#include "test.hpp"
+
+#include <algorithm.hpp>
+#include <chrono.hpp>
+#include <map.hpp>
+#include <set.hpp>
+#include <unordered_map.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::flat_map {
+namespace details {
+constexpr int KEY_RANGE{64};
+constexpr size_t VALUE_COUNT{512};
+constexpr size_t MAX_SORTED_COUNT{40};
+static_assert(MAX_SORTED_COUNT < static_cast<size_t>(KEY_RANGE));
+constexpr size_t ADVERSARY_SIZE{1024};
+
+using map_type = flat_map_non_paged<int, int>;
+using multimap_type = flat_multimap_non_paged<int, int>;
+using set_type = flat_set_non_paged<int>;
+using values_type = map_type::container_type;
+
+struct xorshift {
+  uint32_t state{0x9E3779B9u};
+
+  int next_key() noexcept {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<int>(state % KEY_RANGE);
+  }
+};
+
+constexpr size_t LOOKUP_COUNT{size_t{1} << 20};
+constexpr size_t BUILD_ROUND_COUNT{256};
+
+// Inserts the even keys below 2 * count in the order of idx * 37 % count,
+// which visits every idx for power of 2 counts
+template <class Map>
+void fill_shuffled(Map& map, size_t count) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    const auto key{static_cast<int>(idx * 37 % count) * 2};
+    map.emplace(key, key);
+  }
+}
+
+// Prints the time of BUILD_ROUND_COUNT builds and of LOOKUP_COUNT lookups,
+// half of which miss; the found values are checked so that no lookup can be
+// dropped
+template <class Map>
+void time_small_map(size_t count, const char* name) {
+  auto start{chrono::steady_clock::now()};
+  for (size_t round = 0; round < BUILD_ROUND_COUNT; ++round) {
+    Map map;
+    fill_shuffled(map, count);
+    ASSERT_EQ(map.size(), count)
+  }
+  const auto build_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+
+  Map map;
+  fill_shuffled(map, count);
+  size_t found_count{0};
+  start = chrono::steady_clock::now();
+  for (size_t lookup = 0; lookup < LOOKUP_COUNT; ++lookup) {
+    const auto key{static_cast<int>(lookup * 7919 % (2 * count))};
+    if (const auto it = map.find(key); it != map.end() && it->second == key) {
+      ++found_count;
+    }
+  }
+  const auto lookup_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_EQ(found_count, LOOKUP_COUNT / 2)
+
+  tests::details::print(
+      "{}: {} values, {} builds in {} us, {} lookups in {} us\n", name, count,
+      BUILD_ROUND_COUNT, build_elapsed.count(), LOOKUP_COUNT,
+      lookup_elapsed.count());
+}
+
+// Compared with plain ids, so lookups don't construct a key
+struct labeled_key {
+  int id;
+  int label;
+};
+
+constexpr bool operator<(const labeled_key& lhs,
+                         const labeled_key& rhs) noexcept {
+  return lhs.id < rhs.id;
+}
+
+constexpr bool operator<(const labeled_key& lhs, int rhs) noexcept {
+  return lhs.id < rhs;
+}
+
+constexpr bool operator<(int lhs, const labeled_key& rhs) noexcept {
+  return lhs < rhs.id;
+}
+
+template <class Tree>
+void check_sorted(const Tree& tree) {
+  for (auto it = tree.begin(); it != tree.end(); ++it) {
+    if (it != tree.begin()) {
+      const bool ordered{Tree::is_multi ? !(it->first < prev(it)->first)
+                                        : prev(it)->first < it->first};
+      ASSERT_VALUE(ordered)
+    }
+  }
+}
+
+enum class sort_pattern {
+  ascending,
+  descending,
+  constant,
+  few_values,
+  organ_pipe,
+  random,
+};
+
+constexpr sort_pattern SORT_PATTERNS[]{
+    sort_pattern::ascending,  sort_pattern::descending,
+    sort_pattern::constant,   sort_pattern::few_values,
+    sort_pattern::organ_pipe, sort_pattern::random};
+
+inline int make_sort_value(sort_pattern pattern,
+                           size_t idx,
+                           size_t count,
+                           xorshift& rng) noexcept {
+  switch (pattern) {
+    case sort_pattern::ascending:
+      return static_cast<int>(idx);
+    case sort_pattern::descending:
+      return static_cast<int>(count - idx);
+    case sort_pattern::constant:
+      return 7;
+    case sort_pattern::few_values:
+      return rng.next_key() % 4;
+    case sort_pattern::organ_pipe:
+      return static_cast<int>((min)(idx, count - idx));
+    default:
+      return rng.next_key();
+  }
+}
+
+// McIlroy's adversary for quicksort: the values are fixed lazily, so that
+// each pivot turns out to be one of the smallest values in the range. All
+// the values which aren't fixed yet ("gas") compare equal and greater than
+// the fixed ones, so the answers stay consistent
+struct adversary {
+  bool less(size_t lhs, size_t rhs) noexcept {
+    ++comparison_count;
+    if (values[lhs] == gas && values[rhs] == gas) {
+      values[lhs == candidate ? lhs : rhs] = fixed_count++;
+    }
+    if (values[lhs] == gas) {
+      candidate = lhs;
+    } else if (values[rhs] == gas) {
+      candidate = rhs;
+    }
+    return values[lhs] < values[rhs];
+  }
+
+  int* values;
+  int gas;
+  int fixed_count{0};
+  size_t candidate{0};
+  size_t comparison_count{0};
+};
+
+struct adversary_compare {
+  bool operator()(int lhs, int rhs) const noexcept {
+    return state->less(static_cast<size_t>(lhs), static_cast<size_t>(rhs));
+  }
+
+  adversary* state;
+};
+}  // namespace details
+
+void bulk_build_with_duplicates() {
+  details::values_type values;
+  uint16_t counts[details::KEY_RANGE]{};
+  details::xorshift rng;
+  for (size_t idx = 0; idx < details::VALUE_COUNT; ++idx) {
+    const int key{rng.next_key()};
+    values.emplace_back(key, key * 1000 + static_cast<int>(idx));
+    ++counts[key];
+  }
+  size_t distinct_count{0};
+  for (uint16_t count : counts) {
+    distinct_count += count != 0 ? 1 : 0;
+  }
+
+  // One of the values with an equivalent key is kept
+  const details::map_type map(values.begin(), values.end());
+  ASSERT_EQ(map.size(), distinct_count)
+  details::check_sorted(map);
+  for (const auto& value : map) {
+    ASSERT_EQ(value.second / 1000, value.first)
+  }
+  for (int key = 0; key < details::KEY_RANGE; ++key) {
+    ASSERT_EQ(map.count(key), static_cast<size_t>(counts[key] != 0 ? 1 : 0))
+  }
+
+  const details::multimap_type multimap(values.begin(), values.end());
+  ASSERT_EQ(multimap.size(), details::VALUE_COUNT)
+  details::check_sorted(multimap);
+  for (int key = 0; key < details::KEY_RANGE; ++key) {
+    ASSERT_EQ(multimap.count(key), static_cast<size_t>(counts[key]))
+  }
+
+  // The container constructor takes the values in any order as well
+  details::set_type::container_type keys;
+  for (const auto& value : values) {
+    keys.push_back(value.first);
+  }
+  const details::set_type set{move(keys)};
+  ASSERT_EQ(set.size(), distinct_count)
+  for (auto it = set.begin(); it != set.end(); ++it) {
+    ASSERT_VALUE(it == set.begin() || *prev(it) < *it)
+  }
+}
+
+void insert_range_merges_present_keys() {
+  // Each key appears twice in the range, 37 and 64 are coprime
+  details::values_type values;
+  for (int idx = 0; idx < 2 * details::KEY_RANGE; ++idx) {
+    values.emplace_back(idx * 37 % details::KEY_RANGE, 2);
+  }
+
+  details::map_type map;
+  for (int key = 0; key < details::KEY_RANGE; key += 2) {
+    map.emplace(key, 1);
+  }
+  map.insert(values.begin(), values.end());
+  ASSERT_EQ(map.size(), static_cast<size_t>(details::KEY_RANGE))
+  int expected_key{0};
+  for (const auto& value : map) {
+    ASSERT_EQ(value.first, expected_key)
+    ASSERT_EQ(value.second, expected_key % 2 == 0 ? 1 : 2)
+    ++expected_key;
+  }
+
+  // Keys which are already present are dropped
+  const details::map_type copy{map};
+  map.insert(values.begin(), values.end());
+  ASSERT_VALUE(map == copy)
+  map.insert(values.end(), values.end());
+  ASSERT_VALUE(map == copy)
+
+  // Equivalent keys from the range follow the present ones
+  details::multimap_type multimap;
+  for (int key = 0; key < details::KEY_RANGE; key += 2) {
+    multimap.emplace(key, 1);
+  }
+  multimap.insert(values.begin(), values.end());
+  ASSERT_EQ(multimap.size(),
+            static_cast<size_t>(details::KEY_RANGE / 2 +
+                                2 * details::KEY_RANGE))
+  details::check_sorted(multimap);
+  for (int key = 0; key < details::KEY_RANGE; ++key) {
+    const auto [first, last]{multimap.equal_range(key)};
+    const bool present{key % 2 == 0};
+    ASSERT_EQ(static_cast<size_t>(distance(first, last)),
+              static_cast<size_t>(present ? 3 : 2))
+    ASSERT_EQ(first->second, present ? 1 : 2)
+    ASSERT_EQ(prev(last)->second, 2)
+  }
+}
+
+void multimap_keeps_insertion_order() {
+  constexpr int key_count{8};
+  constexpr int value_count{256};
+  details::multimap_type multimap;
+  details::xorshift rng;
+  for (int seq = 0; seq < value_count; ++seq) {
+    multimap.emplace(rng.next_key() % key_count, seq);
+  }
+  ASSERT_EQ(multimap.size(), static_cast<size_t>(value_count))
+  details::check_sorted(multimap);
+
+  // Equal keys keep the order of insertion
+  for (int key = 0; key < key_count; ++key) {
+    const auto [first, last]{multimap.equal_range(key)};
+    for (auto it = first; it != last; ++it) {
+      ASSERT_VALUE(it == first || prev(it)->second < it->second)
+    }
+  }
+
+  // A wrong hint is ignored and the value goes after the equal ones
+  const auto it{multimap.emplace_hint(multimap.begin(), key_count - 1,
+                                      value_count)};
+  ASSERT_VALUE(next(it) == multimap.end())
+  ASSERT_EQ(it->second, value_count)
+
+  // A right one is used as is
+  const auto first_it{
+      multimap.emplace_hint(multimap.begin(), -1, value_count + 1)};
+  ASSERT_VALUE(first_it == multimap.begin())
+  details::check_sorted(multimap);
+
+  const size_t last_key_count{multimap.count(key_count - 1)};
+  ASSERT_EQ(multimap.erase(key_count - 1), last_key_count)
+  ASSERT_VALUE(!multimap.contains(key_count - 1))
+  ASSERT_EQ(multimap.size(), static_cast<size_t>(value_count + 2) -
+                                 last_key_count)
+}
+
+void heterogeneous_lookup() {
+  using labeled_map =
+      flat_map_non_paged<details::labeled_key, int, less<> >;
+  labeled_map map;
+  for (int id = 0; id < details::KEY_RANGE; id += 2) {
+    map.emplace(details::labeled_key{id, id * 10}, id);
+  }
+
+  const auto it{map.find(10)};
+  ASSERT_VALUE(it != map.end())
+  ASSERT_EQ(it->first.label, 100)
+  ASSERT_EQ(it->second, 10)
+  ASSERT_VALUE(map.find(11) == map.end())
+  ASSERT_VALUE(map.contains(20))
+  ASSERT_VALUE(!map.contains(-1))
+  ASSERT_EQ(map.count(7), static_cast<size_t>(0))
+  ASSERT_EQ(map.lower_bound(11)->first.id, 12)
+  ASSERT_EQ(map.upper_bound(12)->first.id, 14)
+  ASSERT_VALUE(map.upper_bound(details::KEY_RANGE) == map.end())
+
+  const auto [first, last]{map.equal_range(12)};
+  ASSERT_EQ(static_cast<size_t>(distance(first, last)), static_cast<size_t>(1))
+  ASSERT_EQ(first->first.label, 120)
+
+  const labeled_map& const_map{map};
+  ASSERT_VALUE(const_map.find(62) == prev(const_map.end()))
+}
+
+// Insertion sort handles up to 16 values, larger ranges are partitioned
+void sort_around_threshold() {
+  details::xorshift rng;
+  int sorted[details::MAX_SORTED_COUNT];
+  for (size_t count = 0; count <= details::MAX_SORTED_COUNT; ++count) {
+    for (auto pattern : details::SORT_PATTERNS) {
+      uint16_t counts[details::KEY_RANGE]{};
+      for (size_t idx = 0; idx < count; ++idx) {
+        sorted[idx] = details::make_sort_value(pattern, idx, count, rng);
+        ++counts[sorted[idx]];
+      }
+
+      sort(sorted, sorted + count);
+      for (size_t idx = 0; idx < count; ++idx) {
+        ASSERT_VALUE(idx == 0 || sorted[idx - 1] <= sorted[idx])
+        --counts[sorted[idx]];
+      }
+      for (uint16_t value_count : counts) {
+        ASSERT_EQ(value_count, static_cast<uint16_t>(0))
+      }
+
+      sort(sorted, sorted + count, greater<>{});
+      for (size_t idx = 1; idx < count; ++idx) {
+        ASSERT_VALUE(sorted[idx - 1] >= sorted[idx])
+      }
+    }
+  }
+}
+
+void sort_adversarial_input() {
+  constexpr int gas{static_cast<int>(details::ADVERSARY_SIZE)};
+  vector<int, basic_non_paged_allocator<int> > values(details::ADVERSARY_SIZE,
+                                                      gas);
+  vector<int, basic_non_paged_allocator<int> > items;
+  for (size_t idx = 0; idx < details::ADVERSARY_SIZE; ++idx) {
+    items.push_back(static_cast<int>(idx));
+  }
+
+  details::adversary state{values.data(), gas};
+  sort(items.begin(), items.end(), details::adversary_compare{&state});
+
+  // Plain quicksort takes about N^2 / 4 comparisons here, the heapsort fallback
+  // keeps them within O(N log N)
+  size_t log_size{0};
+  for (size_t count = details::ADVERSARY_SIZE; count > 1; count /= 2) {
+    ++log_size;
+  }
+  ASSERT_VALUE(state.comparison_count <=
+               8 * details::ADVERSARY_SIZE * log_size)
+
+  vector<uint8_t, basic_non_paged_allocator<uint8_t> > seen(
+      details::ADVERSARY_SIZE, 0);
+  for (size_t idx = 0; idx < details::ADVERSARY_SIZE; ++idx) {
+    const auto item{static_cast<size_t>(items[idx])};
+    ASSERT_VALUE(item < details::ADVERSARY_SIZE && seen[item] == 0)
+    seen[item] = 1;
+    ASSERT_VALUE(idx == 0 ||
+                 values[static_cast<size_t>(items[idx - 1])] <= values[item])
+  }
+}
+
+void small_flat_map_vs_hash_map() {
+  constexpr size_t MAX_COUNT{256};
+
+  for (size_t count = 8; count <= MAX_COUNT; count *= 2) {
+    details::time_small_map<details::map_type>(count, "flat_map");
+    details::time_small_map<unordered_flat_map_non_paged<int, int> >(
+        count, "unordered_flat_map");
+  }
+}
+}  // namespace tests::flat_map
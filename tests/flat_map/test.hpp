@@ -0,0 +1,11 @@
+#pragma once
+
+namespace tests::flat_map {
+void bulk_build_with_duplicates();
+void insert_range_merges_present_keys();
+void multimap_keeps_insertion_order();
+void heterogeneous_lookup();
+void sort_around_threshold();
+void sort_adversarial_input();
+void small_flat_map_vs_hash_map();
+}
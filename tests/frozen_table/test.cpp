@@ -0,0 +1,280 @@
+#include "test.hpp"
+
+#include <chrono.hpp>
+#include <unordered_map.hpp>
+#include <unordered_set.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::frozen_table {
+namespace details {
+constexpr size_t VALUE_COUNT{1000};
+constexpr size_t FIXED_VALUE_COUNT{128};
+constexpr int KEY_STEP{7};
+
+// Keys 2k and 2k + 1 have the same hash
+struct halving_hash {
+  constexpr size_t operator()(int value) const noexcept {
+    return static_cast<size_t>(value / 2);
+  }
+};
+
+template <class Table, class ForwardIt>
+bool throws_invalid_argument(ForwardIt first, ForwardIt last) {
+  try {
+    Table table(first, last);
+  } catch (const invalid_argument&) {
+    return true;
+  }
+  return false;
+}
+
+template <class Table, class ForwardIt>
+bool throws_runtime_error(ForwardIt first, ForwardIt last) {
+  try {
+    Table table(first, last);
+  } catch (const runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+// Counts the bytes held by the tables of the benchmark
+struct counting_allocator : basic_non_paged_allocator<byte> {
+  static inline size_t live_bytes{0};
+
+  byte* allocate_bytes(size_t bytes_count) {
+    byte* const block{
+        basic_non_paged_allocator<byte>::allocate_bytes(bytes_count)};
+    live_bytes += bytes_count;
+    return block;
+  }
+
+  void deallocate_bytes(byte* ptr, size_t bytes_count) noexcept {
+    live_bytes -= bytes_count;
+    basic_non_paged_allocator<byte>::deallocate_bytes(ptr, bytes_count);
+  }
+};
+
+constexpr size_t LOOKUP_COUNT{size_t{1} << 20};
+
+// Looks up LOOKUP_COUNT hits, then as many misses, and checks that every hit
+// has been found with its value so that no lookup can be dropped
+template <class Map>
+void time_lookups(const Map& map,
+                  size_t value_count,
+                  chrono::microseconds& hit_elapsed,
+                  chrono::microseconds& miss_elapsed) {
+  int64_t value_sum{0};
+  int64_t expected_sum{0};
+  auto start{chrono::steady_clock::now()};
+  for (size_t lookup = 0; lookup < LOOKUP_COUNT; ++lookup) {
+    const auto key{static_cast<int>(lookup * 7919 % value_count) * KEY_STEP};
+    if (const auto it = map.find(key); it != map.end()) {
+      value_sum += it->second;
+    }
+    expected_sum -= key;
+  }
+  hit_elapsed = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start);
+  ASSERT_VALUE(value_sum == expected_sum)
+
+  size_t found_count{0};
+  start = chrono::steady_clock::now();
+  for (size_t lookup = 0; lookup < LOOKUP_COUNT; ++lookup) {
+    const auto key{static_cast<int>(lookup * 7919 % value_count) * KEY_STEP};
+    found_count += map.count(key + 1);
+  }
+  miss_elapsed = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start);
+  ASSERT_EQ(found_count, static_cast<size_t>(0))
+}
+
+constexpr pair<int, char> LETTERS[]{{1, 'a'}, {2, 'b'}, {3, 'c'},
+                                    {5, 'e'}, {8, 'h'}, {13, 'm'}};
+constexpr auto CONSTEXPR_MAP{make_frozen_map(LETTERS)};
+
+static_assert(CONSTEXPR_MAP.size() == 6);
+static_assert(CONSTEXPR_MAP.at(8) == 'h');
+static_assert(CONSTEXPR_MAP.contains(13) && !CONSTEXPR_MAP.contains(4));
+
+constexpr int PRIMES[]{2, 3, 5, 7, 11, 13, 17, 19, 23, 29};
+constexpr auto CONSTEXPR_SET{make_frozen_set(PRIMES)};
+
+static_assert(CONSTEXPR_SET.contains(29) && !CONSTEXPR_SET.contains(9));
+}  // namespace details
+
+void frozen_map_lookup() {
+  vector<pair<int, int>> values;
+  int64_t expected_sum{0};
+  for (size_t idx = 0; idx < details::VALUE_COUNT; ++idx) {
+    const auto key{static_cast<int>(idx) * details::KEY_STEP};
+    values.push_back({key, -key});
+    expected_sum += key;
+  }
+  const frozen_map_non_paged<int, int> map(values.begin(), values.end());
+  ASSERT_EQ(map.size(), details::VALUE_COUNT)
+
+  for (const auto& [key, value] : values) {
+    const auto it{map.find(key)};
+    ASSERT_VALUE(it != map.end())
+    ASSERT_EQ(it->first, key)
+    ASSERT_EQ(map.at(key), value)
+  }
+  // Every entry is visited once
+  int64_t key_sum{0};
+  for (const auto& [key, value] : map) {
+    ASSERT_EQ(key, -value)
+    key_sum += key;
+  }
+  ASSERT_VALUE(key_sum == expected_sum)
+
+  for (size_t idx = 0; idx < details::VALUE_COUNT; ++idx) {
+    const auto key{static_cast<int>(idx) * details::KEY_STEP};
+    ASSERT_VALUE(map.find(key + 1) == map.end())
+    ASSERT_VALUE(!map.contains(-key - 1))
+  }
+  bool out_of_range_caught{false};
+  try {
+    [[maybe_unused]] const int& value{map.at(-1)};
+  } catch (const out_of_range&) {
+    out_of_range_caught = true;
+  }
+  ASSERT_VALUE(out_of_range_caught)
+
+  const auto copy{map};
+  ASSERT_EQ(copy.size(), map.size())
+  ASSERT_EQ(copy.at(details::KEY_STEP), -details::KEY_STEP)
+}
+
+void frozen_set_lookup() {
+  const frozen_set_non_paged<int> empty_set;
+  ASSERT_VALUE(empty_set.empty())
+  ASSERT_VALUE(empty_set.find(0) == empty_set.end())
+
+  vector<int> values;
+  for (size_t idx = 0; idx < details::VALUE_COUNT; ++idx) {
+    values.push_back(static_cast<int>(idx) * details::KEY_STEP);
+  }
+  const frozen_set_non_paged<int> set(values.begin(), values.end());
+  ASSERT_EQ(set.size(), details::VALUE_COUNT)
+  for (int key : values) {
+    ASSERT_EQ(set.count(key), static_cast<size_t>(1))
+    ASSERT_EQ(set.count(key + 3), static_cast<size_t>(0))
+  }
+  ASSERT_VALUE(!set.contains(-details::KEY_STEP))
+}
+
+void reject_duplicates_and_collisions() {
+  using halving_set = frozen_set_non_paged<int, details::halving_hash>;
+
+  constexpr int duplicates[]{1, 2, 3, 4, 2};
+  ASSERT_VALUE(details::throws_invalid_argument<frozen_set_non_paged<int>>(
+      begin(duplicates), end(duplicates)))
+  // Keys are compared only when hashes are equal
+  ASSERT_VALUE(details::throws_invalid_argument<halving_set>(
+      begin(duplicates), end(duplicates)))
+
+  // Different keys with equal hashes aren't reported as duplicates
+  constexpr int colliding[]{0, 2, 4, 5, 6};
+  ASSERT_VALUE(details::throws_runtime_error<halving_set>(begin(colliding),
+                                                          end(colliding)))
+
+  constexpr int distinct[]{0, 2, 4, 6, 8};
+  const halving_set set(begin(distinct), end(distinct));
+  ASSERT_VALUE(set.contains(4) && !set.contains(5))
+
+  bool duplicate_caught{false};
+  try {
+    [[maybe_unused]] const auto map{make_frozen_map<int, int>(
+        {{1, 1}, {2, 2}, {1, 3}})};
+  } catch (const invalid_argument&) {
+    duplicate_caught = true;
+  }
+  ASSERT_VALUE(duplicate_caught)
+}
+
+void make_frozen_map_lookup() {
+  for (const auto& [key, letter] : details::LETTERS) {
+    ASSERT_VALUE(details::CONSTEXPR_MAP.at(key) == letter)
+  }
+  ASSERT_VALUE(details::CONSTEXPR_MAP.find(4) == details::CONSTEXPR_MAP.end())
+  for (int key : details::PRIMES) {
+    ASSERT_VALUE(details::CONSTEXPR_SET.contains(key))
+    ASSERT_VALUE(!details::CONSTEXPR_SET.contains(key * 3))
+  }
+
+  // Built at runtime: the scratch is allocated from the pool
+  pair<int, int> values[details::FIXED_VALUE_COUNT];
+  for (size_t idx = 0; idx < details::FIXED_VALUE_COUNT; ++idx) {
+    const auto key{static_cast<int>(idx) * details::KEY_STEP};
+    values[idx] = {key, key + 1};
+  }
+  const auto map{make_frozen_map(values)};
+  ASSERT_EQ(map.size(), details::FIXED_VALUE_COUNT)
+  for (const auto& [key, value] : values) {
+    ASSERT_EQ(map.at(key), value)
+    ASSERT_VALUE(!map.contains(key + 1))
+  }
+}
+
+void frozen_map_vs_flat_map() {
+  constexpr size_t VALUE_COUNTS[]{64, 1024, 16384};
+
+  using frozen_map_type = frozen_map_non_paged<int, int, hash<int>,
+                                               equal_to<int>,
+                                               details::counting_allocator>;
+  using flat_map_type =
+      unordered_flat_map_non_paged<int, int, hash<int>, equal_to<int>,
+                                   details::counting_allocator>;
+
+  for (const size_t value_count : VALUE_COUNTS) {
+    vector<pair<int, int>> values;
+    for (size_t idx = 0; idx < value_count; ++idx) {
+      const auto key{static_cast<int>(idx) * details::KEY_STEP};
+      values.push_back({key, -key});
+    }
+
+    const size_t initial_bytes{details::counting_allocator::live_bytes};
+    auto start{chrono::steady_clock::now()};
+    const frozen_map_type frozen(values.begin(), values.end());
+    const auto frozen_build{chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start)};
+    const size_t frozen_bytes{details::counting_allocator::live_bytes -
+                              initial_bytes};
+    ASSERT_EQ(frozen_bytes, frozen.memory_usage())
+
+    start = chrono::steady_clock::now();
+    flat_map_type flat;
+    flat.reserve(value_count);
+    for (const auto& [key, value] : values) {
+      flat.emplace(key, value);
+    }
+    const auto flat_build{chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start)};
+    const size_t flat_bytes{details::counting_allocator::live_bytes -
+                            initial_bytes - frozen_bytes};
+
+    chrono::microseconds frozen_hits;
+    chrono::microseconds frozen_misses;
+    details::time_lookups(frozen, value_count, frozen_hits, frozen_misses);
+    chrono::microseconds flat_hits;
+    chrono::microseconds flat_misses;
+    details::time_lookups(flat, value_count, flat_hits, flat_misses);
+
+    tests::details::print(
+        "frozen_map: {} values, {} lookups, build {} us, hits {} us, "
+        "misses {} us, {} bytes\n",
+        value_count, details::LOOKUP_COUNT, frozen_build.count(),
+        frozen_hits.count(), frozen_misses.count(), frozen_bytes);
+    tests::details::print(
+        "unordered_flat_map: {} values, {} lookups, build {} us, hits {} us, "
+        "misses {} us, {} bytes\n",
+        value_count, details::LOOKUP_COUNT, flat_build.count(),
+        flat_hits.count(), flat_misses.count(), flat_bytes);
+  }
+}
+}  // namespace tests::frozen_table
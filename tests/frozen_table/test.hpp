@@ -0,0 +1,9 @@
+#pragma once
+
+namespace tests::frozen_table {
+void frozen_map_lookup();
+void frozen_set_lookup();
+void reject_duplicates_and_collisions();
+void make_frozen_map_lookup();
+void frozen_map_vs_flat_map();
+}
@@ -0,0 +1,126 @@
+#include "test.hpp"
+
+#include <chrono.hpp>
+#include <hash.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::hash {
+namespace details {
+struct seeded_answer {
+  const char* message;
+  size_t length;
+  uint64_t seed;
+  uint64_t expected;
+};
+
+struct sized_answer {
+  size_t length;
+  uint64_t expected;
+};
+
+// Test vectors published with wyhash final version 4: seed is the index
+constexpr seeded_answer REFERENCE_ANSWERS[]{
+    {"", 0, 0, UINT64_C(0x0409638ee2bde459)},
+    {"a", 1, 1, UINT64_C(0xa8412d091b5fe0a9)},
+    {"abc", 3, 2, UINT64_C(0x32dd92e4b2915153)},
+    {"message digest", 14, 3, UINT64_C(0x8619124089a3a16b)},
+    {"abcdefghijklmnopqrstuvwxyz", 26, 4, UINT64_C(0x7a43afb61d7f5f40)},
+    {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", 62, 5,
+     UINT64_C(0xff42329b90e50d58)},
+    {"1234567890123456789012345678901234567890"
+     "1234567890123456789012345678901234567890",
+     80, 6, UINT64_C(0xc39cab13b115aad3)},
+};
+
+/*
+ * Reference wyhash with the seed used by hash_bytes() over BUFFER_SIZE bytes
+ * of i * 131 + 7. Lengths are picked around the 0/1-3/4-16/17-48/48+ branches
+ */
+constexpr size_t BUFFER_SIZE{256};
+
+constexpr sized_answer DEFAULT_SEED_ANSWERS[]{
+    {0, UINT64_C(0x08815391ddc958f9)},   {1, UINT64_C(0xb86d4ff78fae0ceb)},
+    {2, UINT64_C(0x896f820654809989)},   {3, UINT64_C(0xcfdaa02a8de6375b)},
+    {4, UINT64_C(0x31cffc03737ae6df)},   {7, UINT64_C(0xe842ace387020565)},
+    {8, UINT64_C(0xb425934c5eb550ec)},   {16, UINT64_C(0x6116e8f3afddc175)},
+    {17, UINT64_C(0x808e1d09eab879bf)},  {32, UINT64_C(0xc23e0098ebf4e4ac)},
+    {48, UINT64_C(0x6be4d664ec4d7a5d)},  {49, UINT64_C(0x6f8e317cd1b47cfe)},
+    {96, UINT64_C(0x7bc5f3ef7ee481f5)},  {97, UINT64_C(0x66a5809a0ce2e4fe)},
+    {200, UINT64_C(0x7d88da73e93a52b8)},
+};
+
+constexpr size_t MAX_INPUT_SIZE{4096};
+constexpr size_t BYTES_PER_SIZE{size_t{1} << 26};
+
+// Hashes BYTES_PER_SIZE bytes in chunks of len bytes, starting at every
+// offset from 0 to 7, so that the input isn't always aligned
+template <class HashFn>
+uint64_t hash_chunks(const uint8_t* buffer,
+                     size_t len,
+                     HashFn hash_fn,
+                     chrono::microseconds& elapsed) noexcept {
+  const size_t call_count{BYTES_PER_SIZE / len};
+  uint64_t result{0};
+  const auto start{chrono::steady_clock::now()};
+  for (size_t call = 0; call < call_count; ++call) {
+    result = result * 31 + hash_fn(buffer + call % 8, len);
+  }
+  elapsed = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start);
+  return result;
+}
+}  // namespace details
+
+void wyhash_known_answers() {
+#if BITNESS == 64
+  for (const auto& answer : details::REFERENCE_ANSWERS) {
+    ASSERT_VALUE(hs::details::wyhash(answer.message, answer.length,
+                                     answer.seed) == answer.expected)
+  }
+
+  uint8_t buffer[details::BUFFER_SIZE];
+  for (size_t idx = 0; idx < details::BUFFER_SIZE; ++idx) {
+    buffer[idx] = static_cast<uint8_t>(idx * 131 + 7);
+  }
+  for (const auto& answer : details::DEFAULT_SEED_ANSWERS) {
+    ASSERT_VALUE(hs::details::wyhash(buffer, answer.length) == answer.expected)
+#ifndef KTL_HASH_BYTES_MURMUR
+    ASSERT_VALUE(hash_bytes(buffer, answer.length) == answer.expected)
+#endif
+  }
+#else
+  tests::details::print("wyhash is available on 64-bit targets only\n");
+#endif
+}
+
+void hash_bytes_throughput() {
+  static uint8_t buffer[details::MAX_INPUT_SIZE + 8];
+  for (size_t idx = 0; idx < size(buffer); ++idx) {
+    buffer[idx] = static_cast<uint8_t>(idx * 131 + 7);
+  }
+
+  // The results are printed, so the calls can't be dropped
+  for (size_t len = 8; len <= details::MAX_INPUT_SIZE; len *= 2) {
+    chrono::microseconds elapsed;
+    const uint64_t hash{details::hash_chunks(
+        buffer, len,
+        [](const void* ptr, size_t bytes) { return hash_bytes(ptr, bytes); },
+        elapsed)};
+    chrono::microseconds murmur_elapsed;
+    const uint64_t murmur_hash{details::hash_chunks(
+        buffer, len,
+        [](const void* ptr, size_t bytes) {
+          return hs::details::murmur_hash_64a(ptr, bytes);
+        },
+        murmur_elapsed)};
+    tests::details::print(
+        "hash_bytes: {} B inputs, {} MB in {} us ({:x}), murmur in {} us "
+        "({:x})\n",
+        len, details::BYTES_PER_SIZE >> 20, elapsed.count(), hash,
+        murmur_elapsed.count(), murmur_hash);
+  }
+}
+}  // namespace tests::hash
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace tests::hash {
+void wyhash_known_answers();
+void hash_bytes_throughput();
+}
@@ -0,0 +1,154 @@
+// Table and BulkPoolAllocator have extra members with KTL_HASH_TABLE_STATS, so
+// the tables of this file use key types which appear nowhere else
+#define KTL_HASH_TABLE_STATS
+
+#include "test.hpp"
+
+#include <unordered_map.hpp>
+
+#include <modules/fmt/containers.hpp>
+#include <test_runner.hpp>
+
+namespace tests::hash_table::details {
+struct stats_key {
+  uint32_t bucket;
+  uint32_t id;
+};
+
+constexpr bool operator==(stats_key lhs, stats_key rhs) noexcept {
+  return lhs.bucket == rhs.bucket && lhs.id == rhs.id;
+}
+}  // namespace tests::hash_table::details
+
+namespace ktl {
+// ktl::hash<Key> isn't mixed again, and the lowest 5 bits go to the info
+// byte, so each key lands exactly in its bucket
+template <>
+struct hash<tests::hash_table::details::stats_key> {
+  size_t operator()(
+      const tests::hash_table::details::stats_key& key) const noexcept {
+    return static_cast<size_t>(key.bucket) << 5;
+  }
+};
+}  // namespace ktl
+
+using namespace ktl;
+
+namespace tests::hash_table {
+namespace details {
+using stats_map_type = unordered_node_map_non_paged<stats_key, uint32_t>;
+using stats_value_type = stats_map_type::value_type;
+
+constexpr size_t HISTOGRAM_SIZE{hash_table_stats::HISTOGRAM_SIZE};
+
+constexpr size_t round_up(size_t value, size_t alignment) noexcept {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Pool blocks start with a header of the next block and the block size
+constexpr size_t pool_block_bytes(size_t node_count) noexcept {
+  constexpr size_t alignment{
+      (max)(alignof(stats_value_type), alignof(void*))};
+  return round_up(2 * sizeof(void*), alignment) +
+         node_count * round_up(sizeof(stats_value_type), alignment);
+}
+
+// Nodes of a node map are pointers; up to 255 of them follow the buckets so
+// that probing never wraps around
+constexpr size_t table_bytes(size_t bucket_count) noexcept {
+  const size_t node_count{bucket_count +
+                          (min)(bucket_count * 80 / 100, size_t{255})};
+  return node_count * sizeof(void*) + node_count + sizeof(uint64_t);
+}
+
+inline void insert_into_bucket(stats_map_type& map,
+                               uint32_t bucket,
+                               uint32_t count) {
+  for (uint32_t id = 0; id < count; ++id) {
+    ASSERT_VALUE(map.emplace(stats_key{bucket, id}, id).second)
+  }
+}
+}  // namespace details
+
+void stats_of_colliding_keys() {
+  using details::HISTOGRAM_SIZE;
+
+  details::stats_map_type map;
+  hash_table_stats stats{map.stats()};
+  ASSERT_EQ(stats.size, static_cast<size_t>(0))
+  ASSERT_EQ(stats.bucket_count, static_cast<size_t>(0))
+  ASSERT_EQ(stats.table_bytes, static_cast<size_t>(0))
+  ASSERT_EQ(stats.pool_blocks, static_cast<size_t>(0))
+
+  // 4 keys share bucket 0 and the 5th is alone in bucket 5 of 8
+  details::insert_into_bucket(map, 0, 4);
+  details::insert_into_bucket(map, 5, 1);
+  stats = map.stats();
+  ASSERT_EQ(stats.size, static_cast<size_t>(5))
+  ASSERT_EQ(stats.bucket_count, static_cast<size_t>(8))
+  ASSERT_EQ(stats.load_factor_percent, static_cast<size_t>(62))
+  ASSERT_EQ(stats.max_probe_distance, static_cast<size_t>(3))
+  ASSERT_EQ(stats.max_info, static_cast<size_t>(4 * 32))
+  const size_t expected_histogram[HISTOGRAM_SIZE]{2, 1, 1, 1};
+  for (size_t idx = 0; idx < HISTOGRAM_SIZE; ++idx) {
+    ASSERT_EQ(stats.probe_histogram[idx], expected_histogram[idx])
+  }
+  ASSERT_EQ(stats.rehash_count, static_cast<size_t>(0))
+  ASSERT_EQ(stats.info_overflow_count, static_cast<size_t>(0))
+  ASSERT_EQ(stats.table_bytes, details::table_bytes(8))
+  // The pool has taken blocks of 4 and 8 nodes
+  const size_t node_pool_bytes{details::pool_block_bytes(4) +
+                               details::pool_block_bytes(8)};
+  ASSERT_EQ(stats.pool_bytes, node_pool_bytes)
+  ASSERT_EQ(stats.pool_blocks, static_cast<size_t>(2))
+
+  const auto text{fmt::format("{}", stats)};
+  const auto expected_text{fmt::format(
+      "size=5 buckets=8 load=62% max_info=128 max_probe=3 "
+      "probes=[2, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0] rehashes=0 "
+      "info_overflows=0 table_bytes={} pool_bytes={} pool_blocks=2",
+      details::table_bytes(8), node_pool_bytes)};
+  ASSERT_EQ(text, expected_text)
+
+  // The old array goes to the pool, the distances stay the same
+  map.reserve(64);
+  stats = map.stats();
+  ASSERT_EQ(stats.bucket_count, static_cast<size_t>(128))
+  ASSERT_EQ(stats.load_factor_percent, static_cast<size_t>(3))
+  ASSERT_EQ(stats.max_probe_distance, static_cast<size_t>(3))
+  ASSERT_EQ(stats.rehash_count, static_cast<size_t>(1))
+  ASSERT_EQ(stats.table_bytes, details::table_bytes(128))
+  ASSERT_EQ(stats.pool_bytes, node_pool_bytes + details::table_bytes(8))
+  ASSERT_EQ(stats.pool_blocks, static_cast<size_t>(3))
+
+  // Counters describe the object itself and aren't copied
+  const details::stats_map_type copy{map};
+  const hash_table_stats copy_stats{copy.stats()};
+  ASSERT_EQ(copy_stats.size, static_cast<size_t>(5))
+  ASSERT_EQ(copy_stats.rehash_count, static_cast<size_t>(0))
+  ASSERT_EQ(copy_stats.max_probe_distance, static_cast<size_t>(3))
+
+  // 20 keys of one bucket overflow the info byte twice: the increment goes
+  // from 32 down to 8, so the distances are still computed right
+  details::stats_map_type crowded;
+  crowded.reserve(32);
+  details::insert_into_bucket(crowded, 0, 20);
+  stats = crowded.stats();
+  ASSERT_EQ(stats.size, static_cast<size_t>(20))
+  ASSERT_EQ(stats.bucket_count, static_cast<size_t>(64))
+  ASSERT_EQ(stats.info_overflow_count, static_cast<size_t>(2))
+  ASSERT_EQ(stats.max_probe_distance, static_cast<size_t>(19))
+  ASSERT_EQ(stats.max_info, static_cast<size_t>(20 * 8))
+  for (size_t idx = 0; idx < HISTOGRAM_SIZE - 1; ++idx) {
+    ASSERT_EQ(stats.probe_histogram[idx], static_cast<size_t>(1))
+  }
+  // The last entry counts distances 15 to 19
+  ASSERT_EQ(stats.probe_histogram[HISTOGRAM_SIZE - 1], static_cast<size_t>(5))
+  ASSERT_EQ(stats.rehash_count, static_cast<size_t>(1))
+  ASSERT_EQ(stats.pool_bytes, details::pool_block_bytes(4) +
+                                  details::pool_block_bytes(8) +
+                                  details::pool_block_bytes(16))
+  ASSERT_EQ(stats.pool_blocks, static_cast<size_t>(3))
+  tests::details::print("{}\n", stats);
+}
+}  // namespace tests::hash_table
@@ -0,0 +1,768 @@
+#include "test.hpp"
+
+#include <chrono.hpp>
+#include <unordered_map.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::hash_table {
+namespace details {
+constexpr size_t ELEMENT_COUNT{1000};
+
+// Every block comes from here: bucket arrays, pool blocks and the scratch
+// array of compact()
+struct counting_allocator : basic_non_paged_allocator<byte> {
+  static constexpr size_t UNLIMITED{(numeric_limits<size_t>::max)()};
+
+  static inline size_t live_bytes{0};
+  static inline size_t live_blocks{0};
+  static inline size_t allocations_left{UNLIMITED};
+
+  byte* allocate_bytes(size_t bytes_count) {
+    if (allocations_left == 0) {
+      throw bad_alloc{};
+    }
+    if (allocations_left != UNLIMITED) {
+      --allocations_left;
+    }
+    byte* const block{
+        basic_non_paged_allocator<byte>::allocate_bytes(bytes_count)};
+    live_bytes += bytes_count;
+    ++live_blocks;
+    return block;
+  }
+
+  void deallocate_bytes(byte* ptr, size_t bytes_count) noexcept {
+    live_bytes -= bytes_count;
+    --live_blocks;
+    basic_non_paged_allocator<byte>::deallocate_bytes(ptr, bytes_count);
+  }
+};
+
+struct hash_failure {};
+
+// Throws once calls_left runs out, e.g. while a shrinking table moves its
+// elements
+struct throwing_hash {
+  static inline size_t calls_left{counting_allocator::UNLIMITED};
+
+  size_t operator()(int key) const {
+    if (calls_left == 0) {
+      throw hash_failure{};
+    }
+    if (calls_left != counting_allocator::UNLIMITED) {
+      --calls_left;
+    }
+    return hash<int>{}(key);
+  }
+};
+
+using node_map_type = unordered_node_map_non_paged<int,
+                                                   int,
+                                                   hash<int>,
+                                                   equal_to<int>,
+                                                   counting_allocator>;
+using flat_map_type = unordered_flat_map_non_paged<int,
+                                                   int,
+                                                   hash<int>,
+                                                   equal_to<int>,
+                                                   counting_allocator>;
+using throwing_map_type = unordered_flat_map_non_paged<int,
+                                                       int,
+                                                       throwing_hash,
+                                                       equal_to<int>,
+                                                       counting_allocator>;
+
+template <class Map>
+void fill(Map& map, int first_key, int last_key) {
+  for (int key = first_key; key < last_key; ++key) {
+    ASSERT_VALUE(map.emplace(key, key * 2).second)
+  }
+}
+
+// The map holds key -> key * 2 for each key in [first_key, last_key)
+template <class Map>
+void check_range(const Map& map, int first_key, int last_key) {
+  ASSERT_EQ(map.size(), static_cast<size_t>(last_key - first_key))
+  for (int key = first_key; key < last_key; ++key) {
+    const auto it{map.find(key)};
+    ASSERT_VALUE(it != map.end())
+    ASSERT_EQ(it->second, key * 2)
+  }
+  size_t visited_count{0};
+  for ([[maybe_unused]] const auto& [key, value] : map) {
+    ++visited_count;
+  }
+  ASSERT_EQ(visited_count, map.size())
+}
+
+template <class Map>
+void erase_range(Map& map, int first_key, int last_key) {
+  for (int key = first_key; key < last_key; ++key) {
+    ASSERT_EQ(map.erase(key), static_cast<size_t>(1))
+  }
+}
+
+inline void check_no_leaks() {
+  ASSERT_EQ(counting_allocator::live_bytes, static_cast<size_t>(0))
+  ASSERT_EQ(counting_allocator::live_blocks, static_cast<size_t>(0))
+}
+
+using image_map_type = unordered_flat_map_non_paged<uint64_t, uint32_t>;
+using image_header = un::details::table_image_header;
+
+// Hashes differently depending on the seed
+struct seeded_hash {
+  size_t operator()(uint64_t key) const noexcept {
+    return hash<uint64_t>{}(key ^ seed);
+  }
+
+  uint64_t seed{0};
+};
+
+using seeded_map_type =
+    unordered_flat_map_non_paged<uint64_t, uint32_t, seeded_hash>;
+
+template <class Map>
+void fill_image_map(Map& map, size_t count) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    const uint64_t key{idx * UINT64_C(0x9E3779B97F4A7C15)};
+    ASSERT_VALUE(map.emplace(key, static_cast<uint32_t>(idx)).second)
+  }
+}
+
+template <class Map>
+vector<byte> make_image(const Map& map) {
+  vector<byte> image;
+  image.resize(map.image_size());
+  map.write_image(image.data(), image.size());
+  return image;
+}
+
+inline image_header read_header(const vector<byte>& image) {
+  image_header header;
+  memcpy(addressof(header), image.data(), sizeof(header));
+  return header;
+}
+
+// load_image() keeps the table unchanged and no view is created
+template <class Map>
+void expect_rejected(const void* image,
+                     size_t image_size,
+                     const char* message) {
+  using key_type = typename Map::key_type;
+  using mapped_type = typename Map::mapped_type;
+
+  Map map;
+  for (size_t idx = 0; idx < 16; ++idx) {
+    map.emplace(static_cast<key_type>(idx), static_cast<mapped_type>(idx));
+  }
+  const Map expected{map};
+  bool rejected{false};
+  try {
+    map.load_image(image, image_size);
+  } catch (const invalid_argument& exc) {
+    rejected = strcmp(exc.what(), message) == 0;
+  }
+  ASSERT_VALUE(rejected)
+  ASSERT_VALUE(map == expected)
+
+  rejected = false;
+  try {
+    [[maybe_unused]] const table_image_view<Map> view{image, image_size};
+  } catch (const invalid_argument& exc) {
+    rejected = strcmp(exc.what(), message) == 0;
+  }
+  ASSERT_VALUE(rejected)
+}
+
+// Even keys are inserted, odd ones and the last few are missing
+template <class Map>
+vector<typename Map::key_type> make_lookup_keys(size_t inserted_count) {
+  using key_type = typename Map::key_type;
+  vector<key_type> keys;
+  for (size_t idx = 0; idx < inserted_count * 2 + 7; ++idx) {
+    keys.push_back(key_type{static_cast<int>(idx)});
+  }
+  return keys;
+}
+
+// find_many() matches find() for batches which aren't multiples of 16 too
+template <class Map>
+void check_find_many(Map& map, const vector<typename Map::key_type>& keys) {
+  const Map& cmap{map};
+  for (const size_t count : {size_t{0}, size_t{1}, size_t{15}, size_t{16},
+                             size_t{17}, size_t{33}, keys.size()}) {
+    vector<typename Map::iterator> found;
+    found.resize(count);
+    map.find_many(keys.data(), count, found.data());
+    vector<typename Map::const_iterator> const_found;
+    const_found.resize(count);
+    cmap.find_many(keys.data(), count, const_found.data());
+    for (size_t idx = 0; idx < count; ++idx) {
+      ASSERT_VALUE(found[idx] == map.find(keys[idx]))
+      ASSERT_VALUE(const_found[idx] == cmap.find(keys[idx]))
+    }
+  }
+}
+
+template <class Map>
+void check_lookup_with_hash() {
+  constexpr size_t INSERTED_COUNT{100};
+  constexpr size_t GROWTH_FACTOR{10};
+
+  Map map;
+  const Map& cmap{map};
+  const auto keys{make_lookup_keys<Map>(INSERTED_COUNT)};
+  check_find_many(map, keys);
+  for (const auto& key : keys) {
+    ASSERT_VALUE(cmap.find_with_hash(key, cmap.hash_key(key)) == cmap.end())
+  }
+
+  for (size_t idx = 0; idx < INSERTED_COUNT * 2; idx += 2) {
+    ASSERT_VALUE(map.emplace(keys[idx], static_cast<int>(idx)).second)
+  }
+  check_find_many(map, keys);
+
+  // Hashes don't depend on the table state, so they survive rehashes
+  vector<typename Map::hash_type> hashes;
+  for (const auto& key : keys) {
+    hashes.push_back(cmap.hash_key(key));
+  }
+  const int first_extra_key{static_cast<int>(keys.size())};
+  const int last_extra_key{
+      static_cast<int>(INSERTED_COUNT * GROWTH_FACTOR) + first_extra_key};
+  for (int value = first_extra_key; value < last_extra_key; ++value) {
+    ASSERT_VALUE(map.emplace(typename Map::key_type{value}, value).second)
+  }
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    ASSERT_EQ(cmap.hash_key(keys[idx]), hashes[idx])
+    const auto it{map.find_with_hash(keys[idx], hashes[idx])};
+    ASSERT_VALUE(it == map.find(keys[idx]))
+    ASSERT_VALUE(cmap.find_with_hash(keys[idx], hashes[idx]) == it)
+    if (idx % 2 == 0 && idx < INSERTED_COUNT * 2) {
+      ASSERT_VALUE(it != map.end())
+      ASSERT_EQ(it->second, static_cast<int>(idx))
+    } else {
+      ASSERT_VALUE(it == map.end())
+    }
+  }
+  check_find_many(map, keys);
+}
+}  // namespace details
+
+void compact_releases_free_blocks() {
+  constexpr int KEY_COUNT{static_cast<int>(details::ELEMENT_COUNT)};
+  constexpr int FIRST_SURVIVOR{KEY_COUNT * 3 / 4};
+
+  {
+    details::node_map_type map;
+    details::fill(map, 0, KEY_COUNT);
+
+    // Nodes are taken from the pool blocks in insertion order, so the blocks
+    // of the first elements end up without live nodes
+    details::erase_range(map, 0, FIRST_SURVIVOR);
+    const size_t bytes_before{details::counting_allocator::live_bytes};
+    const size_t blocks_before{details::counting_allocator::live_blocks};
+
+    vector<const int*> survivors;
+    for (int key = FIRST_SURVIVOR; key < KEY_COUNT; ++key) {
+      survivors.push_back(addressof(map.at(key)));
+    }
+
+    map.shrink_to_fit();
+    ASSERT_VALUE(details::counting_allocator::live_bytes < bytes_before)
+    ASSERT_VALUE(details::counting_allocator::live_blocks < blocks_before)
+
+    // Live nodes aren't moved
+    for (int key = FIRST_SURVIVOR; key < KEY_COUNT; ++key) {
+      const int* const value{
+          survivors[static_cast<size_t>(key - FIRST_SURVIVOR)]};
+      ASSERT_EQ(addressof(map.at(key)), value)
+      ASSERT_EQ(*value, key * 2)
+    }
+    details::check_range(map, FIRST_SURVIVOR, KEY_COUNT);
+
+    // The free list is relinked without the released blocks
+    details::fill(map, 0, FIRST_SURVIVOR);
+    details::check_range(map, 0, KEY_COUNT);
+    details::erase_range(map, 0, KEY_COUNT);
+    map.shrink_to_fit();
+    details::check_no_leaks();
+  }
+  details::check_no_leaks();
+}
+
+void shrink_to_fit_empty_table() {
+  {
+    details::node_map_type map;
+    map.shrink_to_fit();
+    details::check_no_leaks();
+
+    details::fill(map, 0, static_cast<int>(details::ELEMENT_COUNT));
+    map.clear();
+    ASSERT_VALUE(details::counting_allocator::live_blocks > 0)
+
+    // Both the bucket array and the pool are released
+    map.shrink_to_fit();
+    details::check_no_leaks();
+    ASSERT_EQ(map.mask(), static_cast<size_t>(0))
+    ASSERT_VALUE(map.begin() == map.end())
+
+    details::fill(map, 0, static_cast<int>(details::ELEMENT_COUNT));
+    details::check_range(map, 0, static_cast<int>(details::ELEMENT_COUNT));
+  }
+  details::check_no_leaks();
+}
+
+void copy_assignment_between_sizes() {
+  constexpr int SMALL_COUNT{10};
+  constexpr int LARGE_COUNT{static_cast<int>(details::ELEMENT_COUNT)};
+
+  {
+    details::flat_map_type small_flat;
+    details::fill(small_flat, 0, SMALL_COUNT);
+    details::flat_map_type large_flat;
+    details::fill(large_flat, 0, LARGE_COUNT);
+    details::flat_map_type empty_flat;
+
+    // Arrays of another size are freed with the size they were allocated with
+    details::flat_map_type target_flat{small_flat};
+    target_flat = large_flat;
+    details::check_range(target_flat, 0, LARGE_COUNT);
+    target_flat = small_flat;
+    details::check_range(target_flat, 0, SMALL_COUNT);
+    target_flat = empty_flat;
+    ASSERT_VALUE(target_flat.empty())
+    target_flat = large_flat;
+    details::check_range(target_flat, 0, LARGE_COUNT);
+
+    details::node_map_type small_node;
+    details::fill(small_node, 0, SMALL_COUNT);
+    details::node_map_type large_node;
+    details::fill(large_node, 0, LARGE_COUNT);
+
+    details::node_map_type target_node{large_node};
+    target_node = small_node;
+    details::check_range(target_node, 0, SMALL_COUNT);
+    target_node = large_node;
+    details::check_range(target_node, 0, LARGE_COUNT);
+    target_node.clear();
+    target_node = small_node;
+    details::check_range(target_node, 0, SMALL_COUNT);
+  }
+  details::check_no_leaks();
+}
+
+void min_load_factor_shrinks_on_erase_by_key() {
+  constexpr size_t MIN_LOAD_FACTOR{10};
+  constexpr int KEY_COUNT{static_cast<int>(details::ELEMENT_COUNT)};
+
+  {
+    details::node_map_type map;
+    map.set_min_load_factor(MIN_LOAD_FACTOR);
+    ASSERT_EQ(map.min_load_factor(), MIN_LOAD_FACTOR)
+    details::fill(map, 0, KEY_COUNT);
+    const size_t bucket_count{map.mask() + 1};
+
+    // erase(iterator) never shrinks, even far below the threshold
+    int first_key{KEY_COUNT - 8};
+    for (auto it = map.begin(); it != map.end();) {
+      it = it->first < first_key ? map.erase(it) : ++it;
+    }
+    ASSERT_EQ(map.mask() + 1, bucket_count)
+    details::check_range(map, first_key, KEY_COUNT);
+
+    const size_t bytes_before{details::counting_allocator::live_bytes};
+    ASSERT_EQ(map.erase(first_key), static_cast<size_t>(1))
+    ++first_key;
+    ASSERT_VALUE(map.mask() + 1 < bucket_count)
+    ASSERT_VALUE(details::counting_allocator::live_bytes < bytes_before)
+    details::check_range(map, first_key, KEY_COUNT);
+
+    // The policy is copied along with the elements
+    const details::node_map_type copy{map};
+    ASSERT_EQ(copy.min_load_factor(), MIN_LOAD_FACTOR)
+
+    map.set_min_load_factor(0);
+    details::fill(map, 0, first_key);
+    const size_t grown_bucket_count{map.mask() + 1};
+    details::erase_range(map, 0, KEY_COUNT - 1);
+    ASSERT_EQ(map.mask() + 1, grown_bucket_count)
+    details::check_range(map, KEY_COUNT - 1, KEY_COUNT);
+  }
+  details::check_no_leaks();
+}
+
+void min_load_factor_out_of_range() {
+  details::node_map_type map;
+  constexpr size_t MAX_MIN_LOAD_FACTOR{80 / 4 - 1};
+  map.set_min_load_factor(MAX_MIN_LOAD_FACTOR);
+  ASSERT_EQ(map.min_load_factor(), MAX_MIN_LOAD_FACTOR)
+
+  for (const size_t percent :
+       {MAX_MIN_LOAD_FACTOR + 1, size_t{80}, size_t{100}}) {
+    bool exception_caught{false};
+    try {
+      map.set_min_load_factor(percent);
+    } catch (const invalid_argument&) {
+      exception_caught = true;
+    }
+    ASSERT_VALUE(exception_caught)
+    ASSERT_EQ(map.min_load_factor(), MAX_MIN_LOAD_FACTOR)
+  }
+
+  map.set_min_load_factor(0);
+  ASSERT_EQ(map.min_load_factor(), static_cast<size_t>(0))
+}
+
+void failed_shrink_keeps_table() {
+  using details::counting_allocator;
+  using details::throwing_hash;
+
+  constexpr int KEY_COUNT{static_cast<int>(details::ELEMENT_COUNT)};
+  constexpr int FIRST_SURVIVOR{KEY_COUNT - 8};
+
+  {
+    // Shrinking is skipped if the smaller array can't be allocated
+    details::flat_map_type map;
+    map.set_min_load_factor(10);
+    details::fill(map, 0, KEY_COUNT);
+    for (auto it = map.begin(); it != map.end();) {
+      it = it->first < FIRST_SURVIVOR ? map.erase(it) : ++it;
+    }
+    const size_t bucket_count{map.mask() + 1};
+
+    counting_allocator::allocations_left = 0;
+    const size_t erased_count{map.erase(FIRST_SURVIVOR)};
+    counting_allocator::allocations_left = counting_allocator::UNLIMITED;
+    ASSERT_EQ(erased_count, static_cast<size_t>(1))
+    ASSERT_EQ(map.mask() + 1, bucket_count)
+    details::check_range(map, FIRST_SURVIVOR + 1, KEY_COUNT);
+
+    ASSERT_EQ(map.erase(FIRST_SURVIVOR + 1), static_cast<size_t>(1))
+    ASSERT_VALUE(map.mask() + 1 < bucket_count)
+    details::check_range(map, FIRST_SURVIVOR + 2, KEY_COUNT);
+  }
+  details::check_no_leaks();
+
+  {
+    // Anything else is propagated and the table stays consistent
+    details::throwing_map_type map;
+    map.set_min_load_factor(10);
+    details::fill(map, 0, KEY_COUNT);
+    for (auto it = map.begin(); it != map.end();) {
+      it = it->first < FIRST_SURVIVOR ? map.erase(it) : ++it;
+    }
+    const size_t bucket_count{map.mask() + 1};
+
+    // erase() hashes the key, then the shrink hashes the first moved element
+    throwing_hash::calls_left = 1;
+    bool exception_caught{false};
+    try {
+      map.erase(FIRST_SURVIVOR);
+    } catch (const details::hash_failure&) {
+      exception_caught = true;
+    }
+    throwing_hash::calls_left = counting_allocator::UNLIMITED;
+    ASSERT_VALUE(exception_caught)
+    ASSERT_VALUE(map.mask() + 1 < bucket_count)
+    ASSERT_VALUE(map.size() < static_cast<size_t>(KEY_COUNT - FIRST_SURVIVOR))
+
+    size_t visited_count{0};
+    for ([[maybe_unused]] const auto& [key, value] : map) {
+      ++visited_count;
+    }
+    ASSERT_EQ(visited_count, map.size())
+  }
+  details::check_no_leaks();
+}
+
+void memory_over_time() {
+  constexpr int KEY_COUNT{1 << 16};
+  constexpr int WAVE_COUNT{8};
+
+  for (const size_t min_load_factor : {size_t{0}, size_t{10}}) {
+    details::node_map_type map;
+    map.set_min_load_factor(min_load_factor);
+    details::fill(map, 0, KEY_COUNT);
+    tests::details::print("min load factor {}: {} elements, {} KB\n",
+                          min_load_factor, map.size(),
+                          details::counting_allocator::live_bytes / 1024);
+
+    // Each wave erases half of the remaining elements in insertion order
+    int first_key{0};
+    for (int wave = 0; wave < WAVE_COUNT; ++wave) {
+      const int last_erased{first_key + (KEY_COUNT - first_key) / 2};
+      details::erase_range(map, first_key, last_erased);
+      first_key = last_erased;
+      tests::details::print("min load factor {}: {} elements, {} KB\n",
+                            min_load_factor, map.size(),
+                            details::counting_allocator::live_bytes / 1024);
+    }
+    details::check_range(map, first_key, KEY_COUNT);
+  }
+  details::check_no_leaks();
+}
+
+void image_round_trip() {
+  constexpr size_t ELEMENT_COUNT{details::ELEMENT_COUNT};
+
+  details::image_map_type map;
+  details::fill_image_map(map, ELEMENT_COUNT);
+
+  // Empty nodes and the header padding are zeroed, whatever the buffer held
+  vector<byte> image;
+  image.resize(map.image_size(), byte{0xCD});
+  map.write_image(image.data(), image.size());
+  const details::image_header header{details::read_header(image)};
+  ASSERT_EQ(header.num_elements, static_cast<uint64_t>(ELEMENT_COUNT))
+  ASSERT_EQ(header.mask, static_cast<uint64_t>(map.mask()))
+  ASSERT_EQ(header.data_offset + header.data_size, image.size())
+  for (size_t idx = sizeof(header); idx < header.data_offset; ++idx) {
+    ASSERT_EQ(image[idx], byte{0})
+  }
+
+  const size_t node_count{
+      static_cast<size_t>(header.data_size - sizeof(uint64_t)) /
+      (header.node_size + 1)};
+  const byte* const nodes{image.data() + header.data_offset};
+  const byte* const info{nodes + node_count * header.node_size};
+  size_t occupied_count{0};
+  for (size_t idx = 0; idx < node_count; ++idx) {
+    if (info[idx] != byte{0}) {
+      ++occupied_count;
+      continue;
+    }
+    for (size_t pos = 0; pos < header.node_size; ++pos) {
+      ASSERT_EQ(nodes[idx * header.node_size + pos], byte{0})
+    }
+  }
+  ASSERT_EQ(occupied_count, ELEMENT_COUNT)
+
+  // The loaded table replaces the content and keeps working as usual
+  details::image_map_type loaded;
+  loaded.emplace(1, 1);
+  loaded.load_image(image.data(), image.size());
+  ASSERT_VALUE(loaded == map)
+  ASSERT_EQ(loaded.mask(), map.mask())
+  ASSERT_VALUE(!loaded.contains(1))
+  for (size_t idx = 0; idx < ELEMENT_COUNT; ++idx) {
+    ASSERT_VALUE(loaded.emplace(idx * 2 + 1, static_cast<uint32_t>(idx)).second)
+  }
+  ASSERT_EQ(loaded.size(), ELEMENT_COUNT * 2)
+  ASSERT_VALUE(loaded.mask() > map.mask())
+
+  table_image_view<details::image_map_type> view{image.data(), image.size()};
+  ASSERT_EQ(view.size(), ELEMENT_COUNT)
+  for (const auto& [key, value] : map) {
+    const auto it{view.find(key)};
+    ASSERT_VALUE(it != view.end())
+    ASSERT_EQ(it->second, value)
+    ASSERT_EQ(view.count(key), static_cast<size_t>(1))
+  }
+  ASSERT_VALUE(!view.contains(1))
+  size_t visited_count{0};
+  for ([[maybe_unused]] const auto& [key, value] : view) {
+    ++visited_count;
+  }
+  ASSERT_EQ(visited_count, ELEMENT_COUNT)
+  ASSERT_VALUE(view.table() == map)
+
+  const table_image_view<details::image_map_type> moved{move(view)};
+  ASSERT_EQ(moved.size(), ELEMENT_COUNT)
+  ASSERT_VALUE(view.empty())
+  ASSERT_VALUE(view.begin() == view.end())
+
+  bool exception_caught{false};
+  try {
+    map.write_image(image.data(), image.size() - 1);
+  } catch (const length_error&) {
+    exception_caught = true;
+  }
+  ASSERT_VALUE(exception_caught)
+}
+
+void image_of_empty_table() {
+  // A table which never had elements has no array at all
+  const details::image_map_type empty;
+  const auto image{details::make_image(empty)};
+  const details::image_header header{details::read_header(image)};
+  ASSERT_EQ(header.data_size, static_cast<uint64_t>(0))
+  ASSERT_EQ(image.size(), static_cast<size_t>(header.data_offset))
+
+  details::image_map_type map;
+  details::fill_image_map(map, 16);
+  map.load_image(image.data(), image.size());
+  ASSERT_VALUE(map.empty())
+  ASSERT_EQ(map.mask(), static_cast<size_t>(0))
+  ASSERT_VALUE(map.begin() == map.end())
+  ASSERT_VALUE(!map.contains(0))
+  details::fill_image_map(map, 16);
+  ASSERT_EQ(map.size(), static_cast<size_t>(16))
+
+  const table_image_view<details::image_map_type> view{image.data(),
+                                                       image.size()};
+  ASSERT_VALUE(view.empty())
+  ASSERT_VALUE(view.begin() == view.end())
+  ASSERT_VALUE(!view.contains(0))
+
+  // A cleared table keeps its buckets
+  details::image_map_type cleared;
+  details::fill_image_map(cleared, details::ELEMENT_COUNT);
+  cleared.clear();
+  const auto cleared_image{details::make_image(cleared)};
+  map.load_image(cleared_image.data(), cleared_image.size());
+  ASSERT_VALUE(map.empty())
+  ASSERT_EQ(map.mask(), cleared.mask())
+  ASSERT_VALUE(map.begin() == map.end())
+
+  const table_image_view<details::image_map_type> cleared_view{
+      cleared_image.data(), cleared_image.size()};
+  ASSERT_VALUE(cleared_view.empty())
+  ASSERT_VALUE(cleared_view.begin() == cleared_view.end())
+  ASSERT_VALUE(!cleared_view.contains(0))
+}
+
+void image_rejects_mismatches() {
+  using details::image_header;
+  using details::image_map_type;
+
+  image_map_type map;
+  details::fill_image_map(map, details::ELEMENT_COUNT);
+  const auto image{details::make_image(map)};
+  const image_header header{details::read_header(image)};
+
+  details::expect_rejected<image_map_type>(
+      image.data(), sizeof(image_header) - 1, "image is truncated");
+  details::expect_rejected<image_map_type>(image.data(), image.size() - 1,
+                                           "image is truncated");
+
+  const auto expect_corrupted_rejected{
+      [&image, &header](auto corrupt, const char* message) {
+        vector<byte> corrupted{image};
+        image_header corrupted_header{header};
+        corrupt(corrupted_header);
+        memcpy(corrupted.data(), addressof(corrupted_header),
+               sizeof(corrupted_header));
+        details::expect_rejected<image_map_type>(
+            corrupted.data(), corrupted.size(), message);
+      }};
+
+  expect_corrupted_rejected([](image_header& hdr) { hdr.magic ^= 1; },
+                            "not a table image");
+  expect_corrupted_rejected([](image_header& hdr) { ++hdr.version; },
+                            "not a table image");
+
+  constexpr const char* ANOTHER_TYPE{
+      "image was written by another table type"};
+  expect_corrupted_rejected([](image_header& hdr) { hdr.node_size += 8; },
+                            ANOTHER_TYPE);
+  expect_corrupted_rejected(
+      [](image_header& hdr) { hdr.node_alignment *= 2; }, ANOTHER_TYPE);
+  expect_corrupted_rejected(
+      [](image_header& hdr) { hdr.max_load_factor = 50; }, ANOTHER_TYPE);
+  expect_corrupted_rejected([](image_header& hdr) { hdr.data_offset += 8; },
+                            ANOTHER_TYPE);
+  details::expect_rejected<unordered_flat_map_non_paged<uint32_t, uint32_t>>(
+      image.data(), image.size(), ANOTHER_TYPE);
+  details::expect_rejected<unordered_flat_map_non_paged<
+      uint64_t, uint32_t, hash<uint64_t>, equal_to<uint64_t>,
+      basic_non_paged_allocator<byte>, 50>>(image.data(), image.size(),
+                                            ANOTHER_TYPE);
+
+  constexpr const char* CORRUPTED{"image header is corrupted"};
+  expect_corrupted_rejected([](image_header& hdr) { --hdr.mask; }, CORRUPTED);
+  expect_corrupted_rejected(
+      [](image_header& hdr) { hdr.mask = (numeric_limits<uint64_t>::max)(); },
+      CORRUPTED);
+  expect_corrupted_rejected(
+      [](image_header& hdr) { hdr.num_elements = hdr.mask + 2; }, CORRUPTED);
+  expect_corrupted_rejected([](image_header& hdr) { ++hdr.info_inc; },
+                            CORRUPTED);
+  expect_corrupted_rejected([](image_header& hdr) { hdr.info_hash_shift = 32; },
+                            CORRUPTED);
+
+  expect_corrupted_rejected([](image_header& hdr) { --hdr.data_size; },
+                            "image is truncated");
+  expect_corrupted_rejected([](image_header& hdr) { hdr.data_size += 8; },
+                            "image is truncated");
+}
+
+void image_view_rejects_misaligned_and_other_hash() {
+  details::seeded_map_type map{0, details::seeded_hash{1}};
+  details::fill_image_map(map, details::ELEMENT_COUNT);
+  const auto image{details::make_image(map)};
+
+  // load_image() copies the nodes, so any alignment will do
+  vector<byte> shifted;
+  shifted.resize(image.size() + 1);
+  memcpy(shifted.data() + 1, image.data(), image.size());
+  details::seeded_map_type loaded{0, details::seeded_hash{1}};
+  loaded.load_image(shifted.data() + 1, image.size());
+  ASSERT_VALUE(loaded == map)
+
+  bool rejected{false};
+  try {
+    [[maybe_unused]] const table_image_view<details::seeded_map_type> view{
+        shifted.data() + 1, image.size(), details::seeded_hash{1}};
+  } catch (const invalid_argument& exc) {
+    rejected = strcmp(exc.what(), "image is misaligned") == 0;
+  }
+  ASSERT_VALUE(rejected)
+
+  {
+    const table_image_view<details::seeded_map_type> view{
+        image.data(), image.size(), details::seeded_hash{1}};
+    ASSERT_EQ(view.size(), details::ELEMENT_COUNT)
+    ASSERT_VALUE(view.table() == map)
+  }
+
+  rejected = false;
+  try {
+    [[maybe_unused]] const table_image_view<details::seeded_map_type> view{
+        image.data(), image.size(), details::seeded_hash{2}};
+  } catch (const invalid_argument& exc) {
+    rejected = strcmp(exc.what(), "image was built with another hash") == 0;
+  }
+  ASSERT_VALUE(rejected)
+}
+
+void load_image_latency() {
+  constexpr size_t ELEMENT_COUNT{1 << 20};
+
+  details::image_map_type map;
+  const auto insert_start{chrono::steady_clock::now()};
+  details::fill_image_map(map, ELEMENT_COUNT);
+  const auto insert_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - insert_start)};
+
+  const auto image{details::make_image(map)};
+  details::image_map_type loaded;
+  const auto load_start{chrono::steady_clock::now()};
+  loaded.load_image(image.data(), image.size());
+  const auto load_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - load_start)};
+  ASSERT_EQ(loaded.size(), ELEMENT_COUNT)
+
+  const auto view_start{chrono::steady_clock::now()};
+  const table_image_view<details::image_map_type> view{image.data(),
+                                                       image.size()};
+  const auto view_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - view_start)};
+  ASSERT_EQ(view.size(), ELEMENT_COUNT)
+
+  tests::details::print(
+      "image: {} elements, {} KB, insert {} us, load_image {} us, view {} us\n",
+      ELEMENT_COUNT, image.size() / 1024, insert_elapsed.count(),
+      load_elapsed.count(), view_elapsed.count());
+}
+
+void lookup_with_hash_and_find_many() {
+  details::check_lookup_with_hash<unordered_flat_map_non_paged<int, int>>();
+  details::check_lookup_with_hash<unordered_node_map_non_paged<int, int>>();
+}
+}  // namespace tests::hash_table
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace tests::hash_table {
+void compact_releases_free_blocks();
+void shrink_to_fit_empty_table();
+void copy_assignment_between_sizes();
+void min_load_factor_shrinks_on_erase_by_key();
+void min_load_factor_out_of_range();
+void failed_shrink_keeps_table();
+void memory_over_time();
+void image_round_trip();
+void image_of_empty_table();
+void image_rejects_mismatches();
+void image_view_rejects_misaligned_and_other_hash();
+void load_image_latency();
+void stats_of_colliding_keys();
+void lookup_with_hash_and_find_many();
+}
@@ -0,0 +1,98 @@
+/*
+ * User-mode benchmark of magazine_cache with the host backend. It isn't a part
+ * of the test driver; build and run it on a development machine:
+ *
+ *   c++ -std=c++17 -O2 -pthread -I runtime/include \
+ *       tests/heap/host_cache_benchmark.cpp -o host_cache_benchmark
+ *
+ * Every thread allocates a batch of blocks and frees them, round after round,
+ * through the cache and through malloc()/free() directly
+ */
+#include <heap_cache_host.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+using ktl::heap::details::host_heap_cache;
+
+constexpr size_t BLOCK_SIZE{64};
+constexpr size_t BATCH_SIZE{64};
+constexpr size_t ROUND_COUNT{1 << 14};
+
+host_heap_cache cache;  // Constant-initialized, as in the kernel
+
+template <class Allocate, class Deallocate>
+void run_rounds(Allocate allocate, Deallocate deallocate) {
+  void* blocks[BATCH_SIZE];
+  for (size_t round = 0; round < ROUND_COUNT; ++round) {
+    for (auto& block : blocks) {
+      block = allocate();
+      if (!block) {
+        std::abort();
+      }
+      *static_cast<volatile unsigned char*>(block) = 1;
+    }
+    for (auto* block : blocks) {
+      deallocate(block);
+    }
+  }
+}
+
+// Returns nanoseconds per allocation and deallocation pair
+template <class Allocate, class Deallocate>
+double time_threads(size_t thread_count,
+                    Allocate allocate,
+                    Deallocate deallocate) {
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count);
+  const auto start{std::chrono::steady_clock::now()};
+  for (size_t idx = 0; idx < thread_count; ++idx) {
+    threads.emplace_back(
+        [allocate, deallocate] { run_rounds(allocate, deallocate); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto elapsed{std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start)};
+  return static_cast<double>(elapsed.count()) /
+         static_cast<double>(thread_count * ROUND_COUNT * BATCH_SIZE);
+}
+}  // namespace
+
+int main() {
+  constexpr size_t SIZE_CLASS{host_heap_cache::get_size_class(BLOCK_SIZE)};
+  static_assert(SIZE_CLASS != host_heap_cache::NO_SIZE_CLASS);
+
+  if (!cache.initialize()) {
+    std::fputs("Failed to initialize the cache\n", stderr);
+    return 1;
+  }
+
+  const size_t max_thread_count{
+      host_heap_cache::backend_type::get_processor_count()};
+  for (size_t thread_count = 1;; thread_count *= 2) {
+    if (thread_count > max_thread_count) {
+      thread_count = max_thread_count;
+    }
+    const double cached_ns{time_threads(
+        thread_count, [] { return cache.allocate(0, SIZE_CLASS); },
+        [](void* block) { cache.deallocate(block, 0, SIZE_CLASS); })};
+    const double malloc_ns{time_threads(
+        thread_count, [] { return std::malloc(BLOCK_SIZE); },
+        [](void* block) { std::free(block); })};
+    std::printf(
+        "heap_cache: %zu threads, %zu B blocks, %.1f ns per pair, malloc "
+        "%.1f ns\n",
+        thread_count, BLOCK_SIZE, cached_ns, malloc_ns);
+    if (thread_count == max_thread_count) {
+      break;
+    }
+  }
+
+  cache.finalize();
+  return 0;
+}
@@ -83,4 +83,36 @@ void alloc_and_free() {
 void alloc_and_free_noexcept() {
   CHECK_ALLOC_AND_FREE(DoNothing)
 }
+
+void alloc_and_free_default_tag() {
+  constexpr size_t max_bytes_count{1536};
+  constexpr size_t blocks_count{64};
+  constexpr auto alignment{crt::DEFAULT_ALLOCATION_ALIGNMENT};
+  constexpr crt::pool_type_t pool_types[]{PagedPool, NonPagedPoolNx};
+
+  void* blocks[blocks_count]{};
+  const auto align_checker{details::make_align_checker<alignment>()};
+
+  for (const auto pool_type : pool_types) {
+    for (size_t bytes_count = 1; bytes_count <= max_bytes_count;
+         bytes_count += 37) {
+      for (auto& block : blocks) {
+        block = allocate_memory(alloc_request_builder{bytes_count, pool_type}
+                                    .set_alignment(alignment)
+                                    .set_pool_tag(crt::DEFAULT_HEAP_TAG)
+                                    .build());
+        ASSERT_VALUE(block != nullptr)
+        ASSERT_VALUE(align_checker(block))
+        memset(block, 0xCC, bytes_count);
+      }
+      for (size_t idx = 0; idx < blocks_count; ++idx) {
+        const size_t size_hint{idx % 2 ? bytes_count : 0};  // unsized delete
+        deallocate_memory(free_request_builder{blocks[idx], size_hint}
+                              .set_alignment(alignment)
+                              .set_pool_tag(crt::DEFAULT_HEAP_TAG)
+                              .build());
+      }
+    }
+  }
+}
 }  // namespace tests::heap
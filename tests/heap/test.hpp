@@ -19,6 +19,7 @@ static_assert(static_cast<size_t>(ktl::crt::DEFAULT_ALLOCATION_ALIGNMENT) == 8);
 
 void alloc_and_free();
 void alloc_and_free_noexcept();
+void alloc_and_free_default_tag();
 }
 
 
@@ -0,0 +1,392 @@
+#include "test.hpp"
+
+#include <algorithm.hpp>
+#include <chrono.hpp>
+#include <unordered_map.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+
+namespace tests::incremental_table {
+namespace details {
+constexpr size_t MIGRATION_STEP{4};
+constexpr size_t MIN_MIGRATED_SIZE{256};
+constexpr int KEY_OFFSET{1 << 20};
+
+// Right after the migration starts, the current array holds the elements
+// migrated by the insertion which started it and the inserted one
+constexpr size_t CURRENT_COUNT_AT_START{MIGRATION_STEP + 1};
+
+struct failing_allocator : basic_non_paged_allocator<byte> {
+  static constexpr size_t UNLIMITED{(numeric_limits<size_t>::max)()};
+
+  static inline size_t allocations_left{UNLIMITED};
+
+  byte* allocate_bytes(size_t bytes_count) {
+    if (allocations_left == 0) {
+      throw bad_alloc{};
+    }
+    if (allocations_left != UNLIMITED) {
+      --allocations_left;
+    }
+    return basic_non_paged_allocator<byte>::allocate_bytes(bytes_count);
+  }
+};
+
+using map_type = unordered_incremental_map_non_paged<int,
+                                                     int,
+                                                     hash<int>,
+                                                     equal_to<int>,
+                                                     failing_allocator,
+                                                     80,
+                                                     MIGRATION_STEP>;
+
+// Inserts key -> key * 2 from next_key on until the current array is full
+// and its elements are handed over to the old one
+inline void start_migration(map_type& map, int& next_key) {
+  for (;;) {
+    const bool was_rehashing{map.is_rehashing()};
+    ASSERT_VALUE(map.emplace(next_key, next_key * 2).second)
+    ++next_key;
+    if (!was_rehashing && map.is_rehashing() &&
+        map.size() > MIN_MIGRATED_SIZE) {
+      return;
+    }
+  }
+}
+
+inline void insert_until_migrated(map_type& map, int& next_key) {
+  while (map.is_rehashing()) {
+    ASSERT_VALUE(map.emplace(next_key, next_key * 2).second)
+    ++next_key;
+  }
+}
+
+// The map holds key -> key * 2 for each key in [first_key, last_key)
+inline void check_range(const map_type& map, int first_key, int last_key) {
+  ASSERT_EQ(map.size(), static_cast<size_t>(last_key - first_key))
+  for (int key = first_key; key < last_key; ++key) {
+    const auto it{map.find(key)};
+    ASSERT_VALUE(it != map.end())
+    ASSERT_EQ(it->second, key * 2)
+  }
+  ASSERT_VALUE(!map.contains(first_key - 1))
+  ASSERT_VALUE(!map.contains(last_key))
+}
+
+inline void check_present(const map_type& map,
+                          const vector<bool>& present,
+                          int key_count) {
+  size_t present_count{0};
+  for (int key = 0; key < key_count; ++key) {
+    ASSERT_EQ(map.contains(key), static_cast<bool>(present[key]))
+    if (present[key]) {
+      ASSERT_EQ(map.at(key), key * 2)
+      ++present_count;
+    }
+  }
+  ASSERT_EQ(map.size(), present_count)
+}
+
+inline map_type::iterator first_in_old_array(map_type& map) {
+  auto it{map.begin()};
+  for (size_t idx = 0; idx < CURRENT_COUNT_AT_START; ++idx) {
+    ++it;
+  }
+  return it;
+}
+
+template <class Map>
+void measure_insert_latency(const char* name, vector<long long>& latencies) {
+  Map map;
+  const size_t insert_count{latencies.size()};
+  for (size_t idx = 0; idx < insert_count; ++idx) {
+    const uint64_t key{idx * UINT64_C(0x9E3779B97F4A7C15)};
+    const auto start{chrono::steady_clock::now()};
+    map.emplace(key, idx);
+    latencies[idx] = (chrono::steady_clock::now() - start).count();
+  }
+  ASSERT_EQ(map.size(), insert_count)
+
+  sort(latencies.begin(), latencies.end());
+  tests::details::print(
+      "{}: {} inserts, p50 {} ns, p99 {} ns, p999 {} ns, max {} ns\n", name,
+      insert_count, latencies[insert_count / 2],
+      latencies[insert_count * 99 / 100], latencies[insert_count * 999 / 1000],
+      latencies[insert_count - 1]);
+}
+}  // namespace details
+
+void insert_find_erase_while_migrating() {
+  constexpr int KEY_RANGE{2048};
+
+  details::map_type map;
+  int next_key{0};
+  details::start_migration(map, next_key);
+
+  vector<bool> present;
+  present.resize(KEY_RANGE);
+  for (int key = 0; key < next_key; ++key) {
+    present[key] = true;
+  }
+
+  // Keys of both arrays are found and never inserted twice
+  for (int key = 0; key < next_key; ++key) {
+    const auto [it, inserted]{map.insert({key, -key})};
+    ASSERT_VALUE(!inserted)
+    ASSERT_EQ(it->second, key * 2)
+    ASSERT_EQ(map[key], key * 2)
+    ASSERT_VALUE(!map.insert_or_assign(key, key * 2).second)
+  }
+  ASSERT_VALUE(map.is_rehashing())
+
+  int erased_key{0};
+  size_t step_count{0};
+  while (map.is_rehashing()) {
+    ASSERT_VALUE(next_key < KEY_RANGE)
+    ASSERT_VALUE(map.try_emplace(next_key, next_key * 2).second)
+    present[next_key++] = true;
+    ASSERT_EQ(map.erase(erased_key), static_cast<size_t>(1))
+    ASSERT_EQ(map.erase(erased_key), static_cast<size_t>(0))
+    present[erased_key] = false;
+    erased_key += 3;
+    details::check_present(map, present, next_key);
+    ++step_count;
+  }
+
+  // Each step moves up to 3 * MIGRATION_STEP elements
+  ASSERT_VALUE(step_count > 1)
+  details::check_present(map, present, next_key);
+}
+
+void erase_from_old_array() {
+  {
+    details::map_type map;
+    int next_key{0};
+    details::start_migration(map, next_key);
+
+    vector<int> keys;
+    for (const auto& [key, value] : map) {
+      keys.push_back(key);
+    }
+    ASSERT_EQ(keys.size(), map.size())
+
+    // The first element of the old array is at the migration cursor
+    constexpr size_t FIRST_OLD{details::CURRENT_COUNT_AT_START};
+    const details::map_type::const_iterator cursor{
+        details::first_in_old_array(map)};
+    ASSERT_EQ(cursor->first, keys[FIRST_OLD])
+    const auto next{map.erase(cursor)};
+    ASSERT_VALUE(next != map.end())
+    ASSERT_EQ(next->first, keys[FIRST_OLD + 1])
+    ASSERT_VALUE(!map.contains(keys[FIRST_OLD]))
+
+    // The last element is the farthest from the cursor
+    ASSERT_EQ(map.erase(keys.back()), static_cast<size_t>(1))
+    ASSERT_EQ(map.erase(keys.back()), static_cast<size_t>(0))
+    ASSERT_VALUE(map.is_rehashing())
+
+    // The cursor is still valid, so the migration goes on
+    details::insert_until_migrated(map, next_key);
+    ASSERT_EQ(map.size(), static_cast<size_t>(next_key - 2))
+    for (int key = 0; key < next_key; ++key) {
+      const bool erased{key == keys[FIRST_OLD] || key == keys.back()};
+      ASSERT_EQ(map.contains(key), !erased)
+    }
+  }
+
+  // Erasing the whole old array through iterators ends the migration
+  details::map_type map;
+  int next_key{0};
+  details::start_migration(map, next_key);
+  const size_t initial_size{map.size()};
+
+  size_t erased_count{0};
+  for (auto it = details::first_in_old_array(map); it != map.end();) {
+    it = map.erase(it);
+    ++erased_count;
+  }
+  ASSERT_EQ(erased_count, initial_size - details::CURRENT_COUNT_AT_START)
+  ASSERT_VALUE(!map.is_rehashing())
+  ASSERT_EQ(map.size(), details::CURRENT_COUNT_AT_START)
+
+  size_t visited_count{0};
+  for (const auto& [key, value] : map) {
+    ASSERT_EQ(value, key * 2)
+    ++visited_count;
+  }
+  ASSERT_EQ(visited_count, details::CURRENT_COUNT_AT_START)
+}
+
+void iterate_both_arrays() {
+  details::map_type map;
+  int next_key{0};
+  details::start_migration(map, next_key);
+
+  vector<bool> visited;
+  visited.resize(static_cast<size_t>(next_key));
+  size_t visited_count{0};
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    ASSERT_VALUE(!visited[it->first])
+    visited[it->first] = true;
+    ASSERT_EQ(it->second, it->first * 2)
+    ASSERT_VALUE(map.find(it->first) == it)
+    ++visited_count;
+  }
+  ASSERT_EQ(visited_count, map.size())
+
+  // Values of both arrays can be changed through iterators
+  for (auto& [key, value] : map) {
+    value = -key;
+  }
+  const details::map_type& cmap{map};
+  visited_count = 0;
+  for (auto it = cmap.cbegin(); it != cmap.cend(); ++it) {
+    ASSERT_EQ(it->second, -it->first)
+    ++visited_count;
+  }
+  ASSERT_EQ(visited_count, cmap.size())
+
+  // erase() returns the next element, so every element is visited once
+  const size_t initial_size{map.size()};
+  visited_count = 0;
+  for (auto it = map.begin(); it != map.end(); ++visited_count) {
+    if (it->first % 2 != 0) {
+      it = map.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  ASSERT_EQ(visited_count, initial_size)
+  ASSERT_EQ(map.size(), static_cast<size_t>((next_key + 1) / 2))
+  for (int key = 0; key < next_key; ++key) {
+    ASSERT_EQ(map.contains(key), key % 2 == 0)
+  }
+}
+
+void copy_move_swap_while_migrating() {
+  details::map_type source;
+  int next_key{0};
+  details::start_migration(source, next_key);
+
+  // The copy is made without a pending migration
+  const details::map_type copy{source};
+  ASSERT_VALUE(!copy.is_rehashing())
+  ASSERT_VALUE(source.is_rehashing())
+  ASSERT_VALUE(copy == source)
+
+  // The cursor follows the arrays, so the migration goes on
+  details::map_type moved{move(source)};
+  ASSERT_VALUE(moved.is_rehashing())
+  ASSERT_VALUE(source.empty())
+  ASSERT_VALUE(!source.is_rehashing())
+  ASSERT_VALUE(moved == copy)
+  const int moved_first_key{next_key};
+  details::insert_until_migrated(moved, next_key);
+  details::check_range(moved, 0, next_key);
+  ASSERT_VALUE(source.emplace(0, 0).second)
+  ASSERT_EQ(source.size(), static_cast<size_t>(1))
+
+  details::map_type lhs;
+  int lhs_next_key{0};
+  details::start_migration(lhs, lhs_next_key);
+  details::map_type rhs;
+  int rhs_next_key{details::KEY_OFFSET};
+  details::start_migration(rhs, rhs_next_key);
+  swap(lhs, rhs);
+  ASSERT_VALUE(lhs.is_rehashing())
+  ASSERT_VALUE(rhs.is_rehashing())
+  details::insert_until_migrated(lhs, rhs_next_key);
+  details::insert_until_migrated(rhs, lhs_next_key);
+  details::check_range(lhs, details::KEY_OFFSET, rhs_next_key);
+  details::check_range(rhs, 0, lhs_next_key);
+
+  // Assignment replaces both arrays of a migrating table
+  details::map_type target;
+  int target_next_key{details::KEY_OFFSET};
+  details::start_migration(target, target_next_key);
+  target = copy;
+  ASSERT_VALUE(!target.is_rehashing())
+  details::check_range(target, 0, moved_first_key);
+
+  details::map_type migrating;
+  int migrating_next_key{0};
+  details::start_migration(migrating, migrating_next_key);
+  target = move(migrating);
+  ASSERT_VALUE(target.is_rehashing())
+  details::insert_until_migrated(target, migrating_next_key);
+  details::check_range(target, 0, migrating_next_key);
+}
+
+void reserve_and_rehash_finish_migration() {
+  details::map_type map;
+  int next_key{0};
+  details::start_migration(map, next_key);
+
+  const size_t reserved_count{map.size() * 2};
+  map.reserve(reserved_count);
+  ASSERT_VALUE(!map.is_rehashing())
+  details::check_range(map, 0, next_key);
+
+  // No migration starts until the reserved room is used up
+  while (map.size() < reserved_count) {
+    ASSERT_VALUE(map.emplace(next_key, next_key * 2).second)
+    ++next_key;
+    ASSERT_VALUE(!map.is_rehashing())
+  }
+
+  details::start_migration(map, next_key);
+  map.rehash(0);
+  ASSERT_VALUE(!map.is_rehashing())
+  details::check_range(map, 0, next_key);
+
+  map.clear();
+  ASSERT_VALUE(map.empty())
+  ASSERT_VALUE(map.begin() == map.end())
+}
+
+void failed_allocation_keeps_table() {
+  using details::failing_allocator;
+
+  details::map_type map;
+  int next_key{0};
+  details::start_migration(map, next_key);
+  details::insert_until_migrated(map, next_key);
+
+  // Insertions succeed until the next array has to be allocated
+  failing_allocator::allocations_left = 0;
+  bool exception_caught{false};
+  while (!exception_caught) {
+    try {
+      map.emplace(next_key, next_key * 2);
+      ++next_key;
+    } catch (const bad_alloc&) {
+      exception_caught = true;
+    }
+  }
+  failing_allocator::allocations_left = failing_allocator::UNLIMITED;
+
+  ASSERT_VALUE(!map.is_rehashing())
+  details::check_range(map, 0, next_key);
+
+  ASSERT_VALUE(map.emplace(next_key, next_key * 2).second)
+  ++next_key;
+  ASSERT_VALUE(map.is_rehashing())
+  details::insert_until_migrated(map, next_key);
+  details::check_range(map, 0, next_key);
+}
+
+void insert_latency() {
+  constexpr size_t INSERT_COUNT{1 << 17};
+
+  vector<long long> latencies;
+  latencies.resize(INSERT_COUNT);
+  details::measure_insert_latency<
+      unordered_flat_map_non_paged<uint64_t, uint64_t>>("flat", latencies);
+  details::measure_insert_latency<
+      unordered_incremental_map_non_paged<uint64_t, uint64_t>>("incremental",
+                                                               latencies);
+}
+}  // namespace tests::incremental_table
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace tests::incremental_table {
+void insert_find_erase_while_migrating();
+void erase_from_old_array();
+void iterate_both_arrays();
+void copy_move_swap_while_migrating();
+void reserve_and_rehash_finish_migration();
+void failed_allocation_keeps_table();
+void insert_latency();
+}
@@ -0,0 +1,903 @@
+#include "test.hpp"
+
+#include <modules/lockfree/bounded_queue.hpp>
+#include <modules/lockfree/concurrent_unordered_map.hpp>
+#include <modules/lockfree/epoch_reclamation.hpp>
+#include <modules/lockfree/node_allocator.hpp>
+#include <modules/lockfree/queue.hpp>
+#include <modules/lockfree/thread_pool.hpp>
+#include <modules/lockfree/work_stealing_deque.hpp>
+#include <modules/synchronized.hpp>
+
+#include <chrono.hpp>
+#include <unordered_map.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+using namespace ktl;
+using namespace ktl::lockfree;
+
+namespace tests::lockfree {
+namespace details {
+struct counted_object : epoch_retired_object {
+  size_t* reclaimed_count;
+};
+
+static void reclaim_counted(epoch_retired_object* obj) noexcept {
+  ++*static_cast<counted_object*>(obj)->reclaimed_count;
+}
+
+struct freelist_node {
+  using freelist = ktl::lockfree::details::tagged_freelist<freelist_node>;
+
+  freelist::node_pointer_holder next{};
+};
+
+struct allocation_counters {
+  size_t allocated;
+  size_t deallocated;
+  size_t limit;  // Allocations which succeed before bad_alloc is thrown
+};
+
+static allocation_counters counters{};
+
+// CPU-bound work which can't be folded by the compiler
+static uint32_t xorshift_rounds(size_t seed) noexcept {
+  constexpr size_t ROUND_COUNT{512};
+
+  auto state{static_cast<uint32_t>(seed) | 1u};
+  for (size_t round = 0; round < ROUND_COUNT; ++round) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+  }
+  return state;
+}
+
+// Cheap pseudo-random keys for the concurrent map tests
+static uint32_t next_random(uint32_t& state) noexcept {
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+// Runs op_count operations on worker_count workers and returns the elapsed
+// time without the creation of the pool
+template <class Operation>
+chrono::microseconds run_map_operations(size_t worker_count,
+                                        size_t op_count,
+                                        Operation op) {
+  thread_pool pool{worker_count};
+  const auto start{chrono::steady_clock::now()};
+  auto bulk{pool.bulk_submit(op_count, op)};
+  ASSERT_EQ(bulk.get_status(), STATUS_SUCCESS)
+  return chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start);
+}
+
+template <class Queue, class Ty>
+bool push_one(Queue& queue, const Ty& value) {
+  return queue.push(value);
+}
+
+template <class Queue, class Ty>
+bool pop_one(Queue& queue, Ty& value) {
+  return queue.pop(value);
+}
+
+template <class Ty, template <typename, align_val_t> class BasicAllocator>
+bool push_one(bounded_mpmc_queue<Ty, BasicAllocator>& queue,
+              const Ty& value) {
+  return queue.try_push(value);
+}
+
+template <class Ty, template <typename, align_val_t> class BasicAllocator>
+bool pop_one(bounded_mpmc_queue<Ty, BasicAllocator>& queue, Ty& value) {
+  return queue.try_pop(value);
+}
+
+// Each item pushes a value and pops one, possibly pushed by another worker.
+// Returns the elapsed time; the values are all accounted for afterwards
+template <class Queue, class... Types>
+chrono::microseconds run_push_pop_pairs(size_t worker_count,
+                                        size_t op_count,
+                                        Types&&... args) {
+  Queue queue(forward<Types>(args)...);
+  atomic<size_t> popped_count{0};
+  chrono::microseconds elapsed;
+  {
+    thread_pool pool{worker_count};
+    const auto start{chrono::steady_clock::now()};
+    auto bulk{pool.bulk_submit(op_count, [&queue, &popped_count](size_t idx) {
+      ASSERT_VALUE(push_one(queue, idx))
+      size_t value;
+      if (pop_one(queue, value)) {
+        ++popped_count;
+      }
+    })};
+    ASSERT_EQ(bulk.get_status(), STATUS_SUCCESS)
+    elapsed = chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start);
+  }
+  size_t value;
+  while (pop_one(queue, value)) {
+    ++popped_count;
+  }
+  ASSERT_EQ(popped_count.load(), op_count)
+  return elapsed;
+}
+
+// Both pushes and pops are counted
+constexpr uint64_t ops_per_second(size_t pair_count,
+                                  chrono::microseconds elapsed) noexcept {
+  return static_cast<uint64_t>(pair_count) * 2 * 1000000 /
+         (max)(static_cast<uint64_t>(elapsed.count()), uint64_t{1});
+}
+
+struct mpsc_element : mpsc_queue_hook {
+  size_t value;
+};
+
+inline int64_t timestamp_ns() noexcept {
+  return chrono::duration_cast<chrono::nanoseconds>(
+             chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Time from push to pop of the values, which carry their push timestamps
+struct latency_stats {
+  void add(int64_t pushed_ns) noexcept {
+    const int64_t latency{timestamp_ns() - pushed_ns};
+    ++count;
+    total_ns += latency;
+    max_ns = (max)(max_ns, latency);
+  }
+
+  [[nodiscard]] int64_t average_ns() const noexcept {
+    return count ? total_ns / static_cast<int64_t>(count) : 0;
+  }
+
+  size_t count{0};
+  int64_t total_ns{0};
+  int64_t max_ns{0};
+};
+
+template <class Queue>
+void check_range_operations() {
+  constexpr int VALUE_COUNT{100};
+  constexpr int POPPED_COUNT{10};
+
+  int values[VALUE_COUNT];
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    values[idx] = idx;
+  }
+
+  Queue queue;
+  ASSERT_VALUE(queue.push_range(values, values))
+  ASSERT_VALUE(queue.push_range(values, values + VALUE_COUNT))
+
+  int out[VALUE_COUNT];
+  ASSERT_EQ(queue.pop_bulk(out, 0), static_cast<size_t>(0))
+  ASSERT_EQ(queue.pop_bulk(out, POPPED_COUNT),
+            static_cast<size_t>(POPPED_COUNT))
+  for (int idx = 0; idx < POPPED_COUNT; ++idx) {
+    ASSERT_EQ(out[idx], idx)
+  }
+
+  int expected{POPPED_COUNT};
+  bool ordered{true};
+  const auto consume{[&expected, &ordered](int value) noexcept {
+    ordered = ordered && value == expected;
+    ++expected;
+  }};
+  ASSERT_EQ(queue.consume_all(consume),
+            static_cast<size_t>(VALUE_COUNT - POPPED_COUNT))
+  ASSERT_VALUE(ordered)
+  ASSERT_EQ(expected, VALUE_COUNT)
+  ASSERT_EQ(queue.consume_all(consume), static_cast<size_t>(0))
+  ASSERT_EQ(queue.pop_bulk(out, VALUE_COUNT), static_cast<size_t>(0))
+
+  // Only the value of the detached tail node is copied before the CAS
+  ASSERT_VALUE(queue.push(VALUE_COUNT))
+  ASSERT_EQ(queue.consume_all(consume), static_cast<size_t>(1))
+  ASSERT_VALUE(ordered)
+
+  // pop_bulk never moves the head past the tail
+  ASSERT_VALUE(queue.push_range(values, values + POPPED_COUNT))
+  ASSERT_EQ(queue.pop_bulk(out, VALUE_COUNT),
+            static_cast<size_t>(POPPED_COUNT))
+  int value;
+  ASSERT_VALUE(!queue.pop(value))
+}
+
+template <class Queue>
+void check_bulk_push_pop(Queue& queue) {
+  constexpr int VALUE_COUNT{12};
+  constexpr size_t CAPACITY{8};
+
+  int values[VALUE_COUNT];
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    values[idx] = idx;
+  }
+  int out[VALUE_COUNT];
+  ASSERT_EQ(queue.capacity(), CAPACITY)
+  ASSERT_EQ(queue.try_pop_bulk(out, VALUE_COUNT), static_cast<size_t>(0))
+
+  // Only the free cells are taken from the range
+  ASSERT_EQ(queue.try_push_bulk(values, values + VALUE_COUNT), CAPACITY)
+  ASSERT_EQ(queue.try_push_bulk(values, values + VALUE_COUNT),
+            static_cast<size_t>(0))
+  ASSERT_VALUE(!queue.try_push(VALUE_COUNT))
+  ASSERT_EQ(queue.size_approx(), CAPACITY)
+
+  ASSERT_EQ(queue.try_pop_bulk(out, 3), static_cast<size_t>(3))
+  for (int idx = 0; idx < 3; ++idx) {
+    ASSERT_EQ(out[idx], idx)
+  }
+
+  // The ring wraps around
+  ASSERT_EQ(queue.try_push_bulk(values + CAPACITY, values + VALUE_COUNT),
+            static_cast<size_t>(3))
+  ASSERT_EQ(queue.try_pop_bulk(out, VALUE_COUNT), CAPACITY)
+  for (int idx = 0; idx < static_cast<int>(CAPACITY); ++idx) {
+    ASSERT_EQ(out[idx], idx + 3)
+  }
+  ASSERT_EQ(queue.try_pop_bulk(out, VALUE_COUNT), static_cast<size_t>(0))
+  int value;
+  ASSERT_VALUE(!queue.try_pop(value))
+  ASSERT_VALUE(queue.empty_approx())
+}
+
+static void reset_counters(size_t limit) noexcept {
+  counters = {0, 0, limit};
+}
+
+template <class Ty, align_val_t Align>
+struct counting_allocator : aligned_non_paged_allocator<Ty, Align> {
+  using MyBase = aligned_non_paged_allocator<Ty, Align>;
+
+  Ty* allocate(size_t object_count) {
+    if (counters.allocated == counters.limit) {
+      throw bad_alloc{};
+    }
+    Ty* const ptr{MyBase::allocate(object_count)};
+    ++counters.allocated;
+    return ptr;
+  }
+
+  void deallocate(Ty* ptr, size_t object_count) noexcept {
+    ++counters.deallocated;
+    MyBase::deallocate(ptr, object_count);
+  }
+};
+
+using counting_node_allocator =
+    sharded_node_allocator<int,
+                           static_cast<align_val_t>(alignof(int)),
+                           counting_allocator>;
+}  // namespace details
+
+void retire_and_synchronize() {
+  constexpr size_t OBJECT_COUNT{16};
+
+  epoch_domain domain;
+  size_t reclaimed_count{0};
+  details::counted_object objects[OBJECT_COUNT];
+  for (auto& obj : objects) {
+    obj.reclaimed_count = addressof(reclaimed_count);
+    domain.retire(addressof(obj), &details::reclaim_counted);
+  }
+  domain.synchronize();
+  ASSERT_EQ(reclaimed_count, OBJECT_COUNT)
+}
+
+void retire_in_critical_section() {
+  epoch_domain domain;
+  size_t reclaimed_count{0};
+  details::counted_object obj;
+  obj.reclaimed_count = addressof(reclaimed_count);
+  {
+    epoch_guard guard{domain};
+    ASSERT_EQ(get_current_irql(), DISPATCH_LEVEL)
+    domain.retire(addressof(obj), &details::reclaim_counted);
+    ASSERT_EQ(reclaimed_count, 0)
+  }
+  ASSERT_EQ(get_current_irql(), PASSIVE_LEVEL)
+  domain.synchronize();
+  ASSERT_EQ(reclaimed_count, 1)
+}
+
+void tagged_freelist_push_pop_detach() {
+  using freelist = details::freelist_node::freelist;
+  using node_pointer = freelist::node_pointer;
+
+  details::freelist_node nodes[8];
+  freelist::node_pointer_holder head{};
+  ASSERT_VALUE(freelist::pop(head) == nullptr)
+
+  for (size_t idx = 0; idx < 4; ++idx) {
+    freelist::push(head, nodes + idx, nodes + idx);
+  }
+  for (size_t idx = 4; idx > 0; --idx) {
+    ASSERT_VALUE(freelist::pop(head) == nodes + idx - 1)
+  }
+  ASSERT_VALUE(freelist::pop(head) == nullptr)
+  ASSERT_EQ(node_pointer{head.load()}.get_tag(), 8)
+
+  // A privately linked chain is published at once
+  nodes[4].next.store(node_pointer{nodes + 5}.get_value());
+  nodes[5].next.store(node_pointer{nodes + 6}.get_value());
+  freelist::push(head, nodes + 4, nodes + 6);
+  freelist::push(head, nodes + 7, nodes + 7);
+
+  constexpr size_t DETACHED_ORDER[]{7, 4, 5, 6};
+  auto* node{freelist::detach(head)};
+  ASSERT_VALUE(freelist::pop(head) == nullptr)
+  for (const size_t idx : DETACHED_ORDER) {
+    ASSERT_VALUE(node == nodes + idx)
+    node = freelist::next_of(node);
+  }
+  ASSERT_VALUE(node == nullptr)
+}
+
+void sharded_node_allocator_steal() {
+  constexpr size_t BLOCKS_PER_SHARD{
+      2 * details::counting_node_allocator::STEAL_BATCH_SIZE + 1};
+
+  const size_t block_count{
+      KeQueryMaximumProcessorCountEx(ALL_PROCESSOR_GROUPS) * BLOCKS_PER_SHARD};
+  vector<int*> blocks;
+  blocks.reserve(block_count + 1);
+
+  details::reset_counters((numeric_limits<size_t>::max)());
+  {
+    details::counting_node_allocator alloc{block_count};
+    const size_t preallocated{details::counters.allocated};
+
+    // The home shard runs dry, so the rest is stolen from the neighbours
+    for (size_t idx = 0; idx < block_count; ++idx) {
+      blocks.push_back(alloc.allocate());
+    }
+    ASSERT_EQ(details::counters.allocated, preallocated)
+    blocks.push_back(alloc.allocate());
+    ASSERT_EQ(details::counters.allocated, preallocated + 1)
+
+    for (auto* block : blocks) {
+      alloc.deallocate(block);
+    }
+    blocks.clear();
+    for (size_t idx = 0; idx <= block_count; ++idx) {
+      blocks.push_back(alloc.allocate());
+    }
+    ASSERT_EQ(details::counters.allocated, preallocated + 1)
+    for (auto* block : blocks) {
+      alloc.deallocate(block);
+    }
+  }
+  ASSERT_EQ(details::counters.deallocated, details::counters.allocated)
+}
+
+void sharded_node_allocator_initial_count_failure() {
+  constexpr size_t SUCCESSFUL_ALLOCATIONS{10};
+
+  details::reset_counters(SUCCESSFUL_ALLOCATIONS);
+  bool exception_caught{false};
+  try {
+    details::counting_node_allocator alloc{2 * SUCCESSFUL_ALLOCATIONS};
+  } catch (const bad_alloc&) {
+    exception_caught = true;
+  }
+  ASSERT_VALUE(exception_caught)
+  ASSERT_EQ(details::counters.allocated, SUCCESSFUL_ALLOCATIONS)
+  ASSERT_EQ(details::counters.deallocated, SUCCESSFUL_ALLOCATIONS)
+}
+
+void sharded_queue_scalability() {
+  constexpr size_t PAIR_COUNT{1 << 18};
+
+  const size_t max_worker_count{system_thread::hardware_concurrency()};
+  for (size_t worker_count = 1;; worker_count *= 2) {
+    worker_count = (min)(worker_count, max_worker_count);
+    const auto shared_elapsed{
+        details::run_push_pop_pairs<queue_non_paged<size_t>>(worker_count,
+                                                             PAIR_COUNT)};
+    const auto sharded_elapsed{
+        details::run_push_pop_pairs<sharded_queue_non_paged<size_t>>(
+            worker_count, PAIR_COUNT)};
+    tests::details::print(
+        "queue: {} workers, {} ops/s with node_allocator, {} ops/s with "
+        "sharded_node_allocator\n",
+        worker_count, details::ops_per_second(PAIR_COUNT, shared_elapsed),
+        details::ops_per_second(PAIR_COUNT, sharded_elapsed));
+    if (worker_count == max_worker_count) {
+      break;
+    }
+  }
+}
+
+void bounded_queue_bulk_push_pop() {
+  bounded_queue<int> queue{8};
+  details::check_bulk_push_pop(queue);
+}
+
+void bounded_queue_vs_queue() {
+  constexpr size_t PAIR_COUNT{1 << 18};
+  // A pop fails while the next value is being published, so the values may
+  // pile up; the queue can hold all of them
+  constexpr size_t CAPACITY{PAIR_COUNT};
+
+  const size_t max_worker_count{system_thread::hardware_concurrency()};
+  for (size_t worker_count = 1;; worker_count *= 2) {
+    worker_count = (min)(worker_count, max_worker_count);
+    const auto bounded_elapsed{
+        details::run_push_pop_pairs<bounded_queue_non_paged<size_t>>(
+            worker_count, PAIR_COUNT, CAPACITY)};
+    const auto unbounded_elapsed{
+        details::run_push_pop_pairs<queue_non_paged<size_t>>(worker_count,
+                                                             PAIR_COUNT)};
+    tests::details::print(
+        "bounded_queue: {} workers, {} ops/s, queue {} ops/s\n",
+        worker_count, details::ops_per_second(PAIR_COUNT, bounded_elapsed),
+        details::ops_per_second(PAIR_COUNT, unbounded_elapsed));
+    if (worker_count == max_worker_count) {
+      break;
+    }
+  }
+}
+
+void spsc_queue_bulk_push_pop() {
+  spsc_queue<int> queue{8};
+  details::check_bulk_push_pop(queue);
+}
+
+void spsc_queue_push_pop() {
+  constexpr int VALUE_COUNT{1000};
+  constexpr int BATCH_SIZE{3};
+
+  spsc_queue<int> queue{4};
+  int value;
+  ASSERT_VALUE(!queue.try_pop(value))
+  for (int idx = 0; idx < VALUE_COUNT; idx += BATCH_SIZE) {
+    for (int offset = 0; offset < BATCH_SIZE; ++offset) {
+      ASSERT_VALUE(queue.try_emplace(idx + offset))
+    }
+    ASSERT_EQ(queue.size_approx(), static_cast<size_t>(BATCH_SIZE))
+    for (int offset = 0; offset < BATCH_SIZE; ++offset) {
+      ASSERT_VALUE(queue.try_pop(value))
+      ASSERT_EQ(value, idx + offset)
+    }
+  }
+  ASSERT_VALUE(queue.empty_approx())
+  ASSERT_VALUE(!queue.try_pop(value))
+}
+
+void mpsc_queue_push_pop() {
+  constexpr size_t VALUE_COUNT{1000};
+
+  vector<details::mpsc_element> elements;
+  elements.resize(VALUE_COUNT);
+  for (size_t idx = 0; idx < VALUE_COUNT; ++idx) {
+    elements[idx].value = idx;
+  }
+
+  mpsc_queue<details::mpsc_element> queue;
+  ASSERT_VALUE(queue.empty_approx())
+  ASSERT_VALUE(queue.pop() == nullptr)
+
+  // The stub is relinked each time the queue runs dry
+  for (size_t round = 0; round < 3; ++round) {
+    for (auto& element : elements) {
+      queue.push(element);
+    }
+    ASSERT_VALUE(!queue.empty_approx())
+    for (size_t idx = 0; idx < VALUE_COUNT; ++idx) {
+      auto* const element{queue.pop()};
+      ASSERT_VALUE(element == addressof(elements[idx]))
+    }
+    ASSERT_VALUE(queue.empty_approx())
+    ASSERT_VALUE(queue.pop() == nullptr)
+  }
+
+  // Concurrent producers, each element is pushed exactly once
+  {
+    thread_pool pool;
+    auto bulk{pool.bulk_submit(VALUE_COUNT, [&queue, &elements](size_t idx) {
+      queue.push(elements[idx]);
+      [[maybe_unused]] const bool empty{queue.empty_approx()};
+    })};
+    ASSERT_EQ(bulk.get_status(), STATUS_SUCCESS)
+  }
+  vector<bool> popped;
+  popped.resize(VALUE_COUNT);
+  for (size_t count = 0; count < VALUE_COUNT; ++count) {
+    auto* const element{queue.pop()};
+    ASSERT_VALUE(element != nullptr)
+    ASSERT_VALUE(!popped[element->value])
+    popped[element->value] = true;
+  }
+  ASSERT_VALUE(queue.pop() == nullptr)
+}
+
+void spsc_and_mpsc_queue_latency() {
+  constexpr size_t VALUE_COUNT{1 << 18};
+  constexpr size_t SPSC_CAPACITY{1024};
+
+  // The producers and the consumer spin on their own processors
+  const size_t processor_count{system_thread::hardware_concurrency()};
+  if (processor_count < 2) {
+    tests::details::print("spsc_queue: at least 2 processors are needed\n");
+    return;
+  }
+
+  {
+    spsc_queue<int64_t> queue{SPSC_CAPACITY};
+    details::latency_stats stats;
+    const auto start{chrono::steady_clock::now()};
+    system_thread producer{[&queue] {
+      for (size_t idx = 0; idx < VALUE_COUNT; ++idx) {
+        while (!queue.try_push(details::timestamp_ns())) {
+          YieldProcessor();
+        }
+      }
+    }};
+    for (size_t idx = 0; idx < VALUE_COUNT; ++idx) {
+      int64_t pushed_ns;
+      while (!queue.try_pop(pushed_ns)) {
+        YieldProcessor();
+      }
+      stats.add(pushed_ns);
+    }
+    producer.join();
+    const auto elapsed{chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start)};
+    ASSERT_VALUE(queue.empty_approx())
+    tests::details::print(
+        "spsc_queue: {} values in {} us, latency {} ns on average, {} ns at "
+        "most\n",
+        VALUE_COUNT, elapsed.count(), stats.average_ns(), stats.max_ns);
+  }
+
+  {
+    const size_t producer_count{processor_count - 1};
+    vector<details::mpsc_element> elements;
+    elements.resize(VALUE_COUNT);
+    mpsc_queue<details::mpsc_element> queue;
+    details::latency_stats stats;
+
+    vector<system_thread> producers;
+    producers.reserve(producer_count);
+    const auto start{chrono::steady_clock::now()};
+    for (size_t first = 0; first < producer_count; ++first) {
+      producers.emplace_back([&queue, &elements, first, producer_count] {
+        for (size_t idx = first; idx < VALUE_COUNT; idx += producer_count) {
+          elements[idx].value = static_cast<size_t>(details::timestamp_ns());
+          queue.push(elements[idx]);
+        }
+      });
+    }
+    while (stats.count < VALUE_COUNT) {
+      if (const auto* element = queue.pop(); element) {
+        stats.add(static_cast<int64_t>(element->value));
+      } else {
+        YieldProcessor();
+      }
+    }
+    for (auto& producer : producers) {
+      producer.join();
+    }
+    const auto elapsed{chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start)};
+    ASSERT_VALUE(queue.pop() == nullptr)
+    tests::details::print(
+        "mpsc_queue: {} producers, {} values in {} us, latency {} ns on "
+        "average, {} ns at most\n",
+        producer_count, VALUE_COUNT, elapsed.count(), stats.average_ns(),
+        stats.max_ns);
+  }
+}
+
+void queue_push_range_pop_bulk_consume_all() {
+  details::check_range_operations<queue<int>>();
+  details::check_range_operations<sharded_queue<int>>();
+}
+
+void queue_batch_size_cost() {
+  constexpr size_t VALUE_COUNT{1 << 18};
+  constexpr size_t BATCH_SIZES[]{1, 8, 64};
+  constexpr size_t MAX_BATCH_SIZE{64};
+
+  int batch[MAX_BATCH_SIZE];
+  for (const size_t batch_size : BATCH_SIZES) {
+    queue_non_paged<int> queue;
+    int64_t popped_sum{0};
+    const auto start{chrono::steady_clock::now()};
+    for (size_t first = 0; first < VALUE_COUNT; first += batch_size) {
+      for (size_t idx = 0; idx < batch_size; ++idx) {
+        batch[idx] = static_cast<int>(first + idx);
+      }
+      ASSERT_VALUE(queue.push_range(batch, batch + batch_size))
+      ASSERT_EQ(queue.pop_bulk(batch, batch_size), batch_size)
+      for (size_t idx = 0; idx < batch_size; ++idx) {
+        popped_sum += batch[idx];
+      }
+    }
+    const auto elapsed{chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - start)};
+    ASSERT_VALUE(popped_sum ==
+                 static_cast<int64_t>(VALUE_COUNT * (VALUE_COUNT - 1) / 2))
+    tests::details::print(
+        "queue: batches of {}, {} values, {} ns per pushed and popped value\n",
+        batch_size, VALUE_COUNT,
+        elapsed.count() / static_cast<int64_t>(VALUE_COUNT));
+  }
+}
+
+void reclaiming_queue_push_and_pop() {
+  constexpr int VALUE_COUNT{1000};
+
+  reclaiming_queue<int> queue;
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    queue.push(idx);
+  }
+  int value;
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    ASSERT_VALUE(queue.pop(value))
+    ASSERT_EQ(value, idx)
+  }
+  ASSERT_VALUE(!queue.pop(value))
+  default_epoch_domain.synchronize();
+}
+
+void concurrent_map_insert_find_erase() {
+  constexpr int VALUE_COUNT{1000};
+
+  {
+    concurrent_unordered_map<int, int> map;
+    for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+      ASSERT_VALUE(map.insert(idx, idx * 2))
+    }
+    ASSERT_EQ(map.size(), static_cast<size_t>(VALUE_COUNT))
+    ASSERT_VALUE(map.bucket_count() > decltype(map)::MIN_BUCKET_COUNT)
+    ASSERT_VALUE(!map.insert(0, 1))
+    ASSERT_VALUE(!map.insert_or_assign(0, 1))
+
+    int value;
+    for (int idx = 1; idx < VALUE_COUNT; ++idx) {
+      ASSERT_VALUE(map.find(idx, value))
+      ASSERT_EQ(value, idx * 2)
+    }
+    ASSERT_VALUE(map.find(0, value))
+    ASSERT_EQ(value, 1)
+
+    for (int idx = 0; idx < VALUE_COUNT; idx += 2) {
+      ASSERT_VALUE(map.erase(idx))
+    }
+    ASSERT_EQ(map.size(), static_cast<size_t>(VALUE_COUNT / 2))
+    for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+      ASSERT_EQ(map.contains(idx), idx % 2 != 0)
+    }
+    ASSERT_VALUE(!map.erase(0))
+  }
+  default_epoch_domain.synchronize();
+}
+
+void concurrent_map_concurrent_readers_and_writers() {
+  constexpr int STABLE_COUNT{256};
+  constexpr size_t WRITER_COUNT{4};
+  constexpr size_t READER_COUNT{4};
+  constexpr int KEYS_PER_WRITER{4096};
+  constexpr int ROUND_COUNT{4};
+  constexpr size_t LOOKUPS_PER_READER{1 << 18};
+  constexpr int KEY_COUNT{STABLE_COUNT +
+                          static_cast<int>(WRITER_COUNT) * KEYS_PER_WRITER};
+
+  {
+    concurrent_unordered_map<int, int> map;
+    for (int key = 0; key < STABLE_COUNT; ++key) {
+      ASSERT_VALUE(map.insert(key, key * 2))
+    }
+    const size_t initial_bucket_count{map.bucket_count()};
+
+    // Each writer owns its own range of keys, so the final contents are
+    // known; the readers run while the table grows under them
+    thread_pool pool;
+    auto bulk{pool.bulk_submit(
+        WRITER_COUNT + READER_COUNT, [&map](size_t idx) {
+          if (idx < WRITER_COUNT) {
+            const int first{STABLE_COUNT +
+                            static_cast<int>(idx) * KEYS_PER_WRITER};
+            for (int round = 0; round < ROUND_COUNT; ++round) {
+              for (int key = first; key < first + KEYS_PER_WRITER; ++key) {
+                ASSERT_VALUE(map.insert(key, key * 2))
+              }
+              for (int key = first; key < first + KEYS_PER_WRITER; key += 2) {
+                ASSERT_VALUE(map.erase(key))
+              }
+              if (round + 1 < ROUND_COUNT) {
+                for (int key = first + 1; key < first + KEYS_PER_WRITER;
+                     key += 2) {
+                  ASSERT_VALUE(map.erase(key))
+                }
+              }
+            }
+          } else {
+            auto state{static_cast<uint32_t>(idx)};
+            for (size_t lookup = 0; lookup < LOOKUPS_PER_READER; ++lookup) {
+              const auto key{static_cast<int>(details::next_random(state) %
+                                              KEY_COUNT)};
+              int value{-1};
+              if (lookup % 2 == 0) {
+                const bool found{map.find(key, value)};
+                ASSERT_VALUE(found || key >= STABLE_COUNT)
+                ASSERT_VALUE(!found || value == key * 2)
+              } else {
+                // The callback runs at DISPATCH_LEVEL, so it only copies
+                const bool found{
+                    map.visit(key, [&value](const int& v) { value = v; })};
+                ASSERT_VALUE(found || key >= STABLE_COUNT)
+                ASSERT_VALUE(!found || value == key * 2)
+              }
+            }
+          }
+        })};
+    ASSERT_EQ(bulk.get_status(), STATUS_SUCCESS)
+
+    // The last round leaves the odd offsets of every range
+    ASSERT_EQ(map.size(), static_cast<size_t>(STABLE_COUNT) +
+                              WRITER_COUNT * KEYS_PER_WRITER / 2)
+    for (int key = 0; key < KEY_COUNT; ++key) {
+      int value{-1};
+      const bool expected{key < STABLE_COUNT ||
+                          (key - STABLE_COUNT) % KEYS_PER_WRITER % 2 != 0};
+      ASSERT_EQ(map.find(key, value), expected)
+      ASSERT_VALUE(!expected || value == key * 2)
+    }
+    // 2 ^ 5 times more buckets means at least 5 migrations
+    ASSERT_VALUE(map.bucket_count() >= initial_bucket_count << 5)
+  }
+  default_epoch_domain.synchronize();
+}
+
+void concurrent_map_vs_synchronized_map() {
+  constexpr uint32_t KEY_COUNT{1 << 12};
+  constexpr size_t OP_COUNT{1 << 18};
+  constexpr size_t READ_PERCENTS[]{90, 50};
+
+  using locked_map_type =
+      synchronized_shared<unordered_flat_map_non_paged<uint32_t, uint32_t>>;
+
+  const size_t max_worker_count{system_thread::hardware_concurrency()};
+  for (const size_t read_percent : READ_PERCENTS) {
+    for (size_t worker_count = 1;; worker_count *= 2) {
+      worker_count = (min)(worker_count, max_worker_count);
+
+      // Writers insert or erase depending on the key, so the size stays
+      // around KEY_COUNT / 2
+      concurrent_unordered_map<uint32_t, uint32_t> concurrent_map;
+      locked_map_type locked_map;
+      for (uint32_t key = 0; key < KEY_COUNT; key += 2) {
+        ASSERT_VALUE(concurrent_map.insert(key, key))
+        ASSERT_VALUE(
+            locked_map.get_write_access().ref_to_value.emplace(key, key).second)
+      }
+
+      const auto concurrent_elapsed{details::run_map_operations(
+          worker_count, OP_COUNT,
+          [&concurrent_map, read_percent](size_t idx) {
+            auto state{static_cast<uint32_t>(idx)};
+            const uint32_t key{details::next_random(state) % KEY_COUNT};
+            if (idx % 100 < read_percent) {
+              uint32_t value;
+              if (concurrent_map.find(key, value)) {
+                ASSERT_EQ(value, key)
+              }
+            } else if (details::next_random(state) % 2 == 0) {
+              concurrent_map.insert(key, key);
+            } else {
+              concurrent_map.erase(key);
+            }
+          })};
+
+      const auto locked_elapsed{details::run_map_operations(
+          worker_count, OP_COUNT, [&locked_map, read_percent](size_t idx) {
+            auto state{static_cast<uint32_t>(idx)};
+            const uint32_t key{details::next_random(state) % KEY_COUNT};
+            if (idx % 100 < read_percent) {
+              const auto access{locked_map.get_read_access()};
+              const auto it{access.ref_to_value.find(key)};
+              if (it != access.ref_to_value.end()) {
+                ASSERT_EQ(it->second, key)
+              }
+            } else if (details::next_random(state) % 2 == 0) {
+              locked_map.get_write_access().ref_to_value.emplace(key, key);
+            } else {
+              locked_map.get_write_access().ref_to_value.erase(key);
+            }
+          })};
+
+      tests::details::print(
+          "concurrent_map: {}% reads, {} workers, {} ops in {} us, "
+          "synchronized_shared in {} us\n",
+          read_percent, worker_count, OP_COUNT, concurrent_elapsed.count(),
+          locked_elapsed.count());
+
+      if (worker_count == max_worker_count) {
+        break;
+      }
+    }
+  }
+  default_epoch_domain.synchronize();
+}
+
+void work_stealing_deque_push_pop_steal() {
+  constexpr int VALUE_COUNT{100};
+
+  work_stealing_deque<int> deque{4};
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    deque.push(idx);
+  }
+  ASSERT_EQ(deque.size_approx(), static_cast<size_t>(VALUE_COUNT))
+  int value;
+  ASSERT_VALUE(deque.steal(value))
+  ASSERT_EQ(value, 0)
+  ASSERT_VALUE(deque.pop(value))
+  ASSERT_EQ(value, VALUE_COUNT - 1)
+  for (int idx = VALUE_COUNT - 2; idx > 0; --idx) {
+    ASSERT_VALUE(deque.pop(value))
+    ASSERT_EQ(value, idx)
+  }
+  ASSERT_VALUE(!deque.pop(value))
+  ASSERT_VALUE(!deque.steal(value))
+}
+
+void thread_pool_bulk_submit() {
+  constexpr size_t ITEM_COUNT{10000};
+
+  atomic<size_t> counter{0};
+  {
+    thread_pool pool;
+    auto bulk{pool.bulk_submit(ITEM_COUNT, [&counter](size_t) { ++counter; })};
+    auto failed{pool.submit(
+        [] { throw kernel_error{STATUS_INVALID_PARAMETER, "task failed"}; })};
+    ASSERT_EQ(bulk.get_status(), STATUS_SUCCESS)
+    ASSERT_EQ(counter.load(), ITEM_COUNT)
+    ASSERT_EQ(failed.get_status(), STATUS_INVALID_PARAMETER)
+    ASSERT_VALUE(pool.bulk_submit(0, [](size_t) {}).is_ready())
+
+    pool.submit([&pool, &counter] {
+      pool.submit([&counter] { ++counter; });  // Goes to the worker's deque
+    });
+  }
+  ASSERT_EQ(counter.load(), ITEM_COUNT + 1)
+}
+
+void thread_pool_scalability() {
+  constexpr size_t ITEM_COUNT{1 << 16};
+
+  vector<uint32_t> results;
+  results.resize(ITEM_COUNT);
+  const size_t max_worker_count{system_thread::hardware_concurrency()};
+  for (size_t worker_count = 1;; worker_count *= 2) {
+    worker_count = (min)(worker_count, max_worker_count);
+    {
+      thread_pool pool{worker_count};
+      const auto start{chrono::steady_clock::now()};
+      auto bulk{pool.bulk_submit(ITEM_COUNT, [&results](size_t idx) {
+        results[idx] = details::xorshift_rounds(idx);
+      })};
+      ASSERT_EQ(bulk.get_status(), STATUS_SUCCESS)
+      const auto elapsed{chrono::duration_cast<chrono::microseconds>(
+          chrono::steady_clock::now() - start)};
+      tests::details::print("thread_pool: {} workers, {} items in {} us\n",
+                            worker_count, ITEM_COUNT, elapsed.count());
+    }
+    for (size_t idx = 0; idx < ITEM_COUNT; ++idx) {
+      ASSERT_EQ(results[idx], details::xorshift_rounds(idx))
+      results[idx] = 0;
+    }
+    if (worker_count == max_worker_count) {
+      break;
+    }
+  }
+}
+}  // namespace tests::lockfree
@@ -0,0 +1,25 @@
+#pragma once
+
+namespace tests::lockfree {
+void retire_and_synchronize();
+void retire_in_critical_section();
+void tagged_freelist_push_pop_detach();
+void sharded_node_allocator_steal();
+void sharded_node_allocator_initial_count_failure();
+void sharded_queue_scalability();
+void bounded_queue_bulk_push_pop();
+void bounded_queue_vs_queue();
+void spsc_queue_bulk_push_pop();
+void spsc_queue_push_pop();
+void mpsc_queue_push_pop();
+void spsc_and_mpsc_queue_latency();
+void queue_push_range_pop_bulk_consume_all();
+void queue_batch_size_cost();
+void reclaiming_queue_push_and_pop();
+void concurrent_map_insert_find_erase();
+void concurrent_map_concurrent_readers_and_writers();
+void concurrent_map_vs_synchronized_map();
+void work_stealing_deque_push_pop_steal();
+void thread_pool_bulk_submit();
+void thread_pool_scalability();
+}
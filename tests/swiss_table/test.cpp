@@ -0,0 +1,389 @@
+#include "test.hpp"
+
+#include <chrono.hpp>
+#include <unordered_map.hpp>
+#include <unordered_set.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+namespace tests::swiss_table::details {
+// ktl::hash<clustered_key> isn't mixed, so close values share the probe start
+struct clustered_key {
+  int value;
+};
+
+constexpr bool operator==(clustered_key lhs, clustered_key rhs) noexcept {
+  return lhs.value == rhs.value;
+}
+}  // namespace tests::swiss_table::details
+
+namespace ktl {
+template <>
+struct hash<tests::swiss_table::details::clustered_key> {
+  size_t operator()(
+      const tests::swiss_table::details::clustered_key& key) const noexcept {
+    return static_cast<size_t>(key.value);
+  }
+};
+}  // namespace ktl
+
+using namespace ktl;
+
+namespace tests::swiss_table {
+namespace details {
+using un::details::ctrl_t;
+using un::details::CTRL_DELETED;
+using un::details::CTRL_EMPTY;
+using un::details::CTRL_SENTINEL;
+
+constexpr size_t MAX_GROUP_WIDTH{16};
+
+template <class BitMask>
+uint32_t to_positions(BitMask mask) {
+  uint32_t positions{0};
+  for (const uint32_t pos : mask) {
+    positions |= 1u << pos;
+  }
+  return positions;
+}
+
+// Full bytes are multiples of 4, so SWAR match() has no false positives
+void fill_ctrl_bytes(ctrl_t* ctrl, uint32_t seed) {
+  for (size_t idx = 0; idx < MAX_GROUP_WIDTH; ++idx) {
+    seed = seed * 1664525u + 1013904223u;
+    const uint32_t kind{(seed >> 24) % 8};
+    if (kind < 2) {
+      ctrl[idx] = CTRL_EMPTY;
+    } else if (kind < 4) {
+      ctrl[idx] = CTRL_DELETED;
+    } else if (kind == 4) {
+      ctrl[idx] = CTRL_SENTINEL;
+    } else {
+      ctrl[idx] = static_cast<ctrl_t>((seed >> 8) % 32 * 4);
+    }
+  }
+}
+
+// Compares the group against the byte-by-byte results
+template <class Group>
+void check_group(const ctrl_t* ctrl) {
+  constexpr auto WIDTH{static_cast<uint32_t>(Group::WIDTH)};
+
+  const Group group{ctrl};
+  uint32_t empty_positions{0};
+  uint32_t free_positions{0};
+  uint32_t leading_free_count{0};
+  bool leading{true};
+  for (uint32_t idx = 0; idx < WIDTH; ++idx) {
+    const bool is_empty{ctrl[idx] == CTRL_EMPTY};
+    const bool is_free{is_empty || ctrl[idx] == CTRL_DELETED};
+    empty_positions |= static_cast<uint32_t>(is_empty) << idx;
+    free_positions |= static_cast<uint32_t>(is_free) << idx;
+    leading = leading && is_free;
+    leading_free_count += leading ? 1 : 0;
+
+    if (un::details::is_full(ctrl[idx])) {
+      uint32_t same_positions{0};
+      for (uint32_t other = 0; other < WIDTH; ++other) {
+        same_positions |= static_cast<uint32_t>(ctrl[other] == ctrl[idx])
+                          << other;
+      }
+      ASSERT_EQ(to_positions(group.match(ctrl[idx])), same_positions)
+    }
+  }
+  ASSERT_EQ(to_positions(group.match_empty()), empty_positions)
+  ASSERT_EQ(to_positions(group.match_empty_or_deleted()), free_positions)
+  ASSERT_EQ(group.count_leading_empty_or_deleted(), leading_free_count)
+
+  const auto empty{group.match_empty()};
+  if (empty) {
+    uint32_t highest{0};
+    for (uint32_t idx = 0; idx < WIDTH; ++idx) {
+      if (ctrl[idx] == CTRL_EMPTY) {
+        highest = idx;
+      }
+    }
+    ASSERT_EQ(empty.trailing_zeros(), empty.lowest())
+    ASSERT_EQ(empty.leading_zeros(), WIDTH - 1 - highest)
+  } else {
+    ASSERT_EQ(empty.trailing_zeros(), WIDTH)
+  }
+}
+
+// Even keys are inserted, odd ones and the last few are missing
+template <class Map>
+vector<typename Map::key_type> make_lookup_keys(size_t inserted_count) {
+  using key_type = typename Map::key_type;
+  vector<key_type> keys;
+  for (size_t idx = 0; idx < inserted_count * 2 + 7; ++idx) {
+    keys.push_back(key_type{static_cast<int>(idx)});
+  }
+  return keys;
+}
+
+// find_many() matches find() for batches which aren't multiples of 16 too
+template <class Map>
+void check_find_many(Map& map, const vector<typename Map::key_type>& keys) {
+  const Map& cmap{map};
+  for (const size_t count : {size_t{0}, size_t{1}, size_t{15}, size_t{16},
+                             size_t{17}, size_t{33}, keys.size()}) {
+    vector<typename Map::iterator> found;
+    found.resize(count);
+    map.find_many(keys.data(), count, found.data());
+    vector<typename Map::const_iterator> const_found;
+    const_found.resize(count);
+    cmap.find_many(keys.data(), count, const_found.data());
+    for (size_t idx = 0; idx < count; ++idx) {
+      ASSERT_VALUE(found[idx] == map.find(keys[idx]))
+      ASSERT_VALUE(const_found[idx] == cmap.find(keys[idx]))
+    }
+  }
+}
+
+template <class Map>
+void check_lookup_with_hash() {
+  constexpr size_t INSERTED_COUNT{100};
+  constexpr size_t GROWTH_FACTOR{10};
+
+  Map map;
+  const Map& cmap{map};
+  const auto keys{make_lookup_keys<Map>(INSERTED_COUNT)};
+  check_find_many(map, keys);
+  for (const auto& key : keys) {
+    ASSERT_VALUE(cmap.find_with_hash(key, cmap.hash_key(key)) == cmap.end())
+  }
+
+  for (size_t idx = 0; idx < INSERTED_COUNT * 2; idx += 2) {
+    ASSERT_VALUE(map.emplace(keys[idx], static_cast<int>(idx)).second)
+  }
+  check_find_many(map, keys);
+
+  // Hashes don't depend on the table state, so they survive rehashes
+  vector<typename Map::hash_type> hashes;
+  for (const auto& key : keys) {
+    hashes.push_back(cmap.hash_key(key));
+  }
+  const int first_extra_key{static_cast<int>(keys.size())};
+  const int last_extra_key{
+      static_cast<int>(INSERTED_COUNT * GROWTH_FACTOR) + first_extra_key};
+  for (int value = first_extra_key; value < last_extra_key; ++value) {
+    ASSERT_VALUE(map.emplace(typename Map::key_type{value}, value).second)
+  }
+  for (size_t idx = 0; idx < keys.size(); ++idx) {
+    ASSERT_EQ(cmap.hash_key(keys[idx]), hashes[idx])
+    const auto it{map.find_with_hash(keys[idx], hashes[idx])};
+    ASSERT_VALUE(it == map.find(keys[idx]))
+    ASSERT_VALUE(cmap.find_with_hash(keys[idx], hashes[idx]) == it)
+    if (idx % 2 == 0 && idx < INSERTED_COUNT * 2) {
+      ASSERT_VALUE(it != map.end())
+      ASSERT_EQ(it->second, static_cast<int>(idx))
+    } else {
+      ASSERT_VALUE(it == map.end())
+    }
+  }
+  check_find_many(map, keys);
+}
+
+// Multiplying by an odd constant is a bijection on uint32_t, so the keys of
+// different indices never collide
+constexpr uint32_t spread_key(size_t idx) noexcept {
+  return static_cast<uint32_t>(idx) * 0x9E3779B1u;
+}
+
+template <class Map>
+void time_table_operations(size_t count, const char* name) {
+  Map map;
+  auto start{chrono::steady_clock::now()};
+  for (size_t idx = 0; idx < count; ++idx) {
+    map.emplace(spread_key(idx), static_cast<uint32_t>(idx));
+  }
+  const auto insert_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_EQ(map.size(), count)
+
+  size_t found_count{0};
+  start = chrono::steady_clock::now();
+  for (size_t idx = 0; idx < count; ++idx) {
+    const auto it{map.find(spread_key(idx))};
+    found_count += it != map.end() && it->second == idx;
+  }
+  const auto hit_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_EQ(found_count, count)
+
+  start = chrono::steady_clock::now();
+  for (size_t idx = count; idx < 2 * count; ++idx) {
+    found_count += map.find(spread_key(idx)) != map.end();
+  }
+  const auto miss_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_EQ(found_count, count)
+
+  size_t erased_count{0};
+  start = chrono::steady_clock::now();
+  for (size_t idx = 0; idx < count; ++idx) {
+    erased_count += map.erase(spread_key(idx));
+  }
+  const auto erase_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  ASSERT_EQ(erased_count, count)
+  ASSERT_VALUE(map.empty())
+
+  tests::details::print(
+      "{}: {} keys, insert {} us, hit {} us, miss {} us, erase {} us\n", name,
+      count, insert_elapsed.count(), hit_elapsed.count(),
+      miss_elapsed.count(), erase_elapsed.count());
+}
+}  // namespace details
+
+void match_control_groups() {
+  constexpr uint32_t PATTERN_COUNT{1000};
+
+  details::ctrl_t ctrl[details::MAX_GROUP_WIDTH];
+  for (uint32_t seed = 0; seed < PATTERN_COUNT; ++seed) {
+    details::fill_ctrl_bytes(ctrl, seed);
+    details::check_group<un::details::ctrl_group_swar>(ctrl);
+#ifdef _M_AMD64
+    details::check_group<un::details::ctrl_group_sse2>(ctrl);
+#endif
+  }
+}
+
+void insert_find_erase() {
+  constexpr int VALUE_COUNT{1000};
+
+  unordered_swiss_map<int, int> map;
+  ASSERT_VALUE(map.find(0) == map.end())
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    ASSERT_VALUE(map.emplace(idx, idx * 2).second)
+  }
+  ASSERT_VALUE(!map.emplace(0, 1).second)
+  ASSERT_EQ(map.size(), static_cast<size_t>(VALUE_COUNT))
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    const auto it{map.find(idx)};
+    ASSERT_VALUE(it != map.end())
+    ASSERT_EQ(it->second, idx * 2)
+  }
+  ASSERT_VALUE(!map.contains(VALUE_COUNT))
+
+  for (int idx = 0; idx < VALUE_COUNT; idx += 3) {
+    ASSERT_EQ(map.erase(idx), static_cast<size_t>(1))
+  }
+  ASSERT_EQ(map.erase(0), static_cast<size_t>(0))
+  for (int idx = 0; idx < VALUE_COUNT; idx += 3) {
+    ASSERT_VALUE(map.try_emplace(idx, -idx).second)
+  }
+  ASSERT_EQ(map.size(), static_cast<size_t>(VALUE_COUNT))
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    ASSERT_EQ(map.at(idx), idx % 3 == 0 ? -idx : idx * 2)
+  }
+}
+
+void rehash_after_tombstones() {
+  constexpr int CLUSTER_SIZE{200};
+  constexpr int KEPT_STEP{32};
+  constexpr int SPREAD_COUNT{100};
+  constexpr int SPREAD_SHIFT{12};
+
+  using details::clustered_key;
+
+  unordered_swiss_set<clustered_key> set;
+  set.reserve(CLUSTER_SIZE);
+  const size_t capacity{set.mask()};
+
+  // Erasing from a dense cluster leaves tombstones which use up the growth
+  // budget, so the table is rebuilt in place instead of growing
+  for (int value = 0; value < CLUSTER_SIZE; ++value) {
+    ASSERT_VALUE(set.insert(clustered_key{value}).second)
+  }
+  for (int value = 0; value < CLUSTER_SIZE; ++value) {
+    if (value % KEPT_STEP != 0) {
+      ASSERT_EQ(set.erase(clustered_key{value}), static_cast<size_t>(1))
+    }
+  }
+  for (int idx = 1; idx <= SPREAD_COUNT; ++idx) {
+    ASSERT_VALUE(set.insert(clustered_key{idx << SPREAD_SHIFT}).second)
+  }
+  ASSERT_EQ(set.mask(), capacity)
+
+  constexpr int KEPT_COUNT{(CLUSTER_SIZE + KEPT_STEP - 1) / KEPT_STEP};
+  ASSERT_EQ(set.size(), static_cast<size_t>(KEPT_COUNT + SPREAD_COUNT))
+  for (int value = 0; value < CLUSTER_SIZE; ++value) {
+    ASSERT_EQ(set.contains(clustered_key{value}), value % KEPT_STEP == 0)
+  }
+  for (int idx = 1; idx <= SPREAD_COUNT; ++idx) {
+    ASSERT_VALUE(set.contains(clustered_key{idx << SPREAD_SHIFT}))
+  }
+
+  // Erased keys can be inserted again after the rebuild
+  for (int value = 0; value < CLUSTER_SIZE; ++value) {
+    ASSERT_EQ(set.insert(clustered_key{value}).second,
+              value % KEPT_STEP != 0)
+  }
+  ASSERT_EQ(set.size(), static_cast<size_t>(CLUSTER_SIZE + SPREAD_COUNT))
+  size_t visited_count{0};
+  for ([[maybe_unused]] const auto& key : set) {
+    ++visited_count;
+  }
+  ASSERT_EQ(visited_count, set.size())
+}
+
+void iterate_after_erase() {
+  constexpr int VALUE_COUNT{1000};
+
+  unordered_swiss_map<int, int> map;
+  for (int idx = 0; idx < VALUE_COUNT; ++idx) {
+    map.emplace(idx, idx);
+  }
+
+  // erase() returns the next element, so every element is visited once
+  size_t visited_count{0};
+  for (auto it = map.begin(); it != map.end(); ++visited_count) {
+    if (it->first % 2 == 0) {
+      it = map.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  ASSERT_EQ(visited_count, static_cast<size_t>(VALUE_COUNT))
+  ASSERT_EQ(map.size(), static_cast<size_t>(VALUE_COUNT / 2))
+
+  int key_sum{0};
+  size_t element_count{0};
+  for (const auto& [key, value] : map) {
+    ASSERT_VALUE(key % 2 != 0)
+    ASSERT_EQ(key, value)
+    key_sum += key;
+    ++element_count;
+  }
+  ASSERT_EQ(element_count, static_cast<size_t>(VALUE_COUNT / 2))
+  ASSERT_EQ(key_sum, (VALUE_COUNT / 2) * (VALUE_COUNT / 2))
+
+  for (auto it = map.begin(); it != map.end();) {
+    it = map.erase(it);
+  }
+  ASSERT_VALUE(map.empty())
+  ASSERT_VALUE(map.begin() == map.end())
+}
+
+void lookup_with_hash_and_find_many() {
+  details::check_lookup_with_hash<unordered_swiss_map<int, int>>();
+  // Close keys share the probe start, so lookups go through several groups
+  details::check_lookup_with_hash<
+      unordered_swiss_map<details::clustered_key, int>>();
+}
+
+void swiss_vs_robin_hood() {
+  constexpr size_t COUNTS[]{size_t{1} << 10, size_t{1} << 14, size_t{1} << 18};
+
+  for (const size_t count : COUNTS) {
+    details::time_table_operations<
+        unordered_swiss_map_non_paged<uint32_t, uint32_t>>(
+        count, "unordered_swiss_map");
+    details::time_table_operations<
+        unordered_flat_map_non_paged<uint32_t, uint32_t>>(
+        count, "unordered_flat_map");
+  }
+}
+}  // namespace tests::swiss_table
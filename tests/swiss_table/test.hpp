@@ -0,0 +1,10 @@
+#pragma once
+
+namespace tests::swiss_table {
+void match_control_groups();
+void insert_find_erase();
+void rehash_after_tombstones();
+void iterate_after_erase();
+void lookup_with_hash_and_find_many();
+void swiss_vs_robin_hood();
+}
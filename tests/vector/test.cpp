@@ -0,0 +1,706 @@
+#include "test.hpp"
+
+#include <chrono.hpp>
+#include <smart_pointer.hpp>
+#include <string.hpp>
+#include <vector.hpp>
+
+#include <test_runner.hpp>
+
+namespace tests::vector::details {
+// Counts live objects to catch leaked and doubly destroyed elements
+template <bool TriviallyRelocatable>
+struct counted_value {
+  static inline size_t live{0};
+  static inline size_t moves{0};
+  static inline size_t destroyed{0};
+
+  static void reset_counters() noexcept {
+    moves = 0;
+    destroyed = 0;
+  }
+
+  counted_value(int value_) noexcept : value{value_} { ++live; }
+  counted_value(const counted_value& other) noexcept : value{other.value} {
+    ++live;
+  }
+  counted_value(counted_value&& other) noexcept : value{other.value} {
+    ++live;
+    ++moves;
+  }
+  counted_value& operator=(const counted_value&) noexcept = default;
+  counted_value& operator=(counted_value&&) noexcept = default;
+  ~counted_value() noexcept {
+    --live;
+    ++destroyed;
+  }
+
+  int value;
+};
+
+using counted = counted_value<false>;
+using relocatable = counted_value<true>;
+}  // namespace tests::vector::details
+
+namespace ktl {
+template <>
+struct is_trivially_relocatable<tests::vector::details::relocatable>
+    : true_type {};
+}  // namespace ktl
+
+using namespace ktl;
+
+namespace tests::vector {
+namespace details {
+constexpr size_t INLINE_CAPACITY{4};
+
+// Never propagated; instances with different ids compare unequal
+template <class Ty>
+struct tracking_allocator : basic_non_paged_allocator<Ty> {
+  using propagate_on_container_copy_assignment = false_type;
+  using propagate_on_container_move_assignment = false_type;
+  using propagate_on_container_swap = false_type;
+  using is_always_equal = false_type;
+
+  explicit tracking_allocator(int id_) noexcept : id{id_} {}
+
+  int id;
+};
+
+template <class Ty>
+bool operator==(const tracking_allocator<Ty>& lhs,
+                const tracking_allocator<Ty>& rhs) noexcept {
+  return lhs.id == rhs.id;
+}
+
+template <class Ty>
+bool operator!=(const tracking_allocator<Ty>& lhs,
+                const tracking_allocator<Ty>& rhs) noexcept {
+  return !(lhs == rhs);
+}
+
+// Counts the buffers allocated by the benchmark
+template <class Ty>
+struct counting_allocator : basic_non_paged_allocator<Ty> {
+  static inline size_t allocation_count{0};
+
+  counting_allocator() noexcept = default;
+
+  template <class OtherTy>
+  counting_allocator(const counting_allocator<OtherTy>&) noexcept {}
+
+  Ty* allocate(size_t object_count) {
+    ++allocation_count;
+    return basic_non_paged_allocator<Ty>::allocate(object_count);
+  }
+};
+
+template <class Ty>
+using vector_type = ktl::vector<Ty, basic_non_paged_allocator<Ty> >;
+
+using small_vector_type = small_vector_non_paged<counted, INLINE_CAPACITY>;
+
+template <class Vector>
+void push_sequence(Vector& vec, int first, size_t count) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    vec.emplace_back(first + static_cast<int>(idx));
+  }
+}
+
+template <class Vector>
+void check_sequence(const Vector& vec, int first, size_t count) {
+  ASSERT_EQ(vec.size(), count)
+  for (size_t idx = 0; idx < count; ++idx) {
+    ASSERT_EQ(vec[idx].value, first + static_cast<int>(idx))
+  }
+}
+
+template <class Vector, size_t N>
+void check_values(const Vector& vec, const int (&expected)[N]) {
+  ASSERT_EQ(vec.size(), N)
+  for (size_t idx = 0; idx < N; ++idx) {
+    ASSERT_EQ(vec[idx].value, expected[idx])
+  }
+}
+
+template <class Ty>
+void insert_and_emplace() {
+  {
+    vector_type<Ty> vec;
+    vec.reserve(8);
+    push_sequence(vec, 0, 4);
+    const auto* buffer{vec.data()};
+
+    auto it{vec.emplace(vec.begin() + 2, 42)};
+    ASSERT_VALUE(it == vec.begin() + 2)
+    ASSERT_EQ(it->value, 42)
+
+    it = vec.insert(vec.begin() + 1, Ty{43});
+    ASSERT_VALUE(it == vec.begin() + 1)
+    ASSERT_EQ(it->value, 43)
+    ASSERT_VALUE(vec.data() == buffer)
+
+    constexpr int before_growth[]{0, 43, 1, 42, 2, 3};
+    check_values(vec, before_growth);
+
+    // The returned iterator must point into the new buffer
+    push_sequence(vec, 4, vec.capacity() - vec.size());
+    it = vec.emplace(vec.begin() + 3, 44);
+    ASSERT_VALUE(vec.data() != buffer)
+    ASSERT_VALUE(it == vec.begin() + 3)
+    ASSERT_EQ(it->value, 44)
+
+    constexpr int after_growth[]{0, 43, 1, 44, 42, 2, 3, 4, 5};
+    check_values(vec, after_growth);
+
+    // Emplacing at the end goes through emplace_back()
+    it = vec.emplace(vec.end(), 45);
+    ASSERT_VALUE(it == vec.end() - 1)
+    ASSERT_EQ(it->value, 45)
+    ASSERT_EQ(Ty::live, vec.size())
+  }
+  ASSERT_EQ(Ty::live, static_cast<size_t>(0))
+}
+
+template <class Ty>
+void fill_insert_without_growth() {
+  {
+    vector_type<Ty> vec;
+    vec.reserve(16);
+    push_sequence(vec, 0, 6);
+    const auto* buffer{vec.data()};
+
+    // Fewer inserted elements than the ones after the position
+    auto it{vec.insert(vec.begin() + 1, 2, Ty{7})};
+    ASSERT_VALUE(it == vec.begin() + 1)
+    constexpr int short_fill[]{0, 7, 7, 1, 2, 3, 4, 5};
+    check_values(vec, short_fill);
+
+    // More inserted elements than the ones after the position
+    it = vec.insert(vec.end() - 1, 3, Ty{8});
+    ASSERT_VALUE(it == vec.begin() + 7)
+    constexpr int long_fill[]{0, 7, 7, 1, 2, 3, 4, 8, 8, 8, 5};
+    check_values(vec, long_fill);
+
+    it = vec.insert(vec.end(), 2, Ty{9});
+    ASSERT_VALUE(it == vec.begin() + 11)
+    constexpr int append_fill[]{0, 7, 7, 1, 2, 3, 4, 8, 8, 8, 5, 9, 9};
+    check_values(vec, append_fill);
+
+    it = vec.insert(vec.begin(), 0, Ty{10});
+    ASSERT_VALUE(it == vec.begin())
+    ASSERT_VALUE(vec.data() == buffer)
+    ASSERT_EQ(Ty::live, vec.size())
+  }
+  ASSERT_EQ(Ty::live, static_cast<size_t>(0))
+}
+
+template <class Ty>
+void erase_middle_range() {
+  {
+    vector_type<Ty> vec;
+    push_sequence(vec, 0, 10);
+
+    Ty::reset_counters();
+    auto it{vec.erase(vec.begin() + 3, vec.begin() + 7)};
+    ASSERT_VALUE(it == vec.begin() + 3)
+    ASSERT_EQ(it->value, 7)
+    ASSERT_EQ(Ty::destroyed, static_cast<size_t>(4))
+    ASSERT_EQ(Ty::live, static_cast<size_t>(6))
+    constexpr int rest[]{0, 1, 2, 7, 8, 9};
+    check_values(vec, rest);
+
+    Ty::reset_counters();
+    it = vec.erase(vec.begin() + 1, vec.begin() + 1);
+    ASSERT_VALUE(it == vec.begin() + 1)
+    ASSERT_EQ(Ty::destroyed, static_cast<size_t>(0))
+
+    it = vec.erase(vec.begin() + 4, vec.end());
+    ASSERT_VALUE(it == vec.end())
+    ASSERT_EQ(Ty::destroyed, static_cast<size_t>(2))
+    ASSERT_EQ(Ty::live, static_cast<size_t>(4))
+  }
+  ASSERT_EQ(Ty::live, static_cast<size_t>(0))
+}
+
+// The appended storage is filled by the caller after each call
+inline void fill_bytes(uint8_t* first, size_t count, size_t start) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    first[idx] = static_cast<uint8_t>(start + idx);
+  }
+}
+
+template <class Vector>
+void check_bytes(const Vector& vec) {
+  for (size_t idx = 0; idx < vec.size(); ++idx) {
+    ASSERT_VALUE(vec[idx] == static_cast<uint8_t>(idx))
+  }
+}
+
+template <class Vector>
+void append_uninitialized_bytes(Vector& vec, size_t total, size_t chunk) {
+  while (vec.size() < total) {
+    const size_t old_size{vec.size()}, old_capacity{vec.capacity()};
+    uint8_t* tail{vec.append_uninitialized(chunk)};
+    ASSERT_VALUE(tail == vec.data() + old_size)
+    ASSERT_EQ(vec.size(), old_size + chunk)
+    if (old_size + chunk > old_capacity) {
+      ASSERT_VALUE(vec.capacity() >= 2 * old_capacity)
+    } else {
+      ASSERT_EQ(vec.capacity(), old_capacity)
+    }
+    fill_bytes(tail, chunk, old_size);
+  }
+  check_bytes(vec);
+}
+
+template <class Vector>
+void overwrite_uninitialized_bytes(Vector& vec) {
+  constexpr size_t kept{10}, written{100}, requested{300};
+  vec.resize_uninitialized(kept);
+  ASSERT_EQ(vec.size(), kept)
+  check_bytes(vec);
+
+  vec.resize_and_overwrite(
+      requested, [](uint8_t* buffer, [[maybe_unused]] size_t count) {
+        fill_bytes(buffer + kept, written, kept);
+        return kept + written;
+      });
+  ASSERT_EQ(vec.size(), kept + written)
+  ASSERT_VALUE(vec.capacity() >= requested)
+  check_bytes(vec);
+
+  vec.resize_uninitialized(requested + 1);
+  fill_bytes(vec.data() + kept + written, requested + 1 - kept - written,
+             kept + written);
+  ASSERT_EQ(vec.size(), requested + 1)
+  check_bytes(vec);
+}
+
+// Owns a pointer like unique_ptr, but isn't trivially relocatable, so growth
+// moves and destroys the elements one by one
+struct moved_pointer {
+  moved_pointer(unique_ptr<int>&& ptr_) noexcept : ptr{move(ptr_)} {}
+  moved_pointer(moved_pointer&& other) noexcept : ptr{move(other.ptr)} {}
+  moved_pointer& operator=(moved_pointer&&) noexcept = default;
+
+  unique_ptr<int> ptr;
+};
+
+// Moves the pointers of source to the end of a vector without reserve() and
+// returns the elapsed time
+template <class Ty>
+chrono::microseconds grow_pointer_vector(
+    vector_type<unique_ptr<int> >& source) {
+  vector_type<Ty> target;
+  const auto start{chrono::steady_clock::now()};
+  for (auto& ptr : source) {
+    target.emplace_back(move(ptr));
+  }
+  const auto elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+
+  ASSERT_EQ(target.size(), source.size())
+  for (size_t idx = 0; idx < target.size(); ++idx) {
+    if constexpr (is_same_v<Ty, moved_pointer>) {
+      ASSERT_EQ(*target[idx].ptr, static_cast<int>(idx))
+      source[idx] = move(target[idx].ptr);
+    } else {
+      ASSERT_EQ(*target[idx], static_cast<int>(idx))
+      source[idx] = move(target[idx]);
+    }
+  }
+  return elapsed;
+}
+
+// Builds round_count short-lived vectors of 0 to max_size values and returns
+// their sum, so that the work can't be dropped
+template <class Vector>
+int64_t build_short_vectors(size_t round_count, size_t max_size) {
+  int64_t sum{0};
+  for (size_t round = 0; round < round_count; ++round) {
+    Vector vec;
+    const size_t size{round % (max_size + 1)};
+    for (size_t idx = 0; idx < size; ++idx) {
+      vec.push_back(static_cast<int>(round + idx));
+    }
+    for (const int value : vec) {
+      sum += value;
+    }
+  }
+  return sum;
+}
+}  // namespace details
+
+void small_vector_inline_to_heap() {
+  {
+    details::small_vector_type vec;
+    ASSERT_VALUE(vec.is_inline())
+    ASSERT_EQ(vec.capacity(), details::INLINE_CAPACITY)
+
+    details::push_sequence(vec, 0, details::INLINE_CAPACITY);
+    ASSERT_VALUE(vec.is_inline())
+    const auto* inline_data{vec.data()};
+
+    vec.emplace_back(static_cast<int>(details::INLINE_CAPACITY));
+    ASSERT_VALUE(!vec.is_inline())
+    ASSERT_VALUE(vec.data() != inline_data)
+    ASSERT_VALUE(vec.capacity() > details::INLINE_CAPACITY)
+    details::check_sequence(vec, 0, details::INLINE_CAPACITY + 1);
+    ASSERT_EQ(details::counted::live, details::INLINE_CAPACITY + 1)
+
+    // The heap buffer is kept until shrink_to_fit()
+    vec.clear();
+    ASSERT_VALUE(!vec.is_inline())
+    ASSERT_EQ(details::counted::live, static_cast<size_t>(0))
+
+    details::small_vector_type reserved;
+    reserved.reserve(details::INLINE_CAPACITY);
+    ASSERT_VALUE(reserved.is_inline())
+    reserved.reserve(details::INLINE_CAPACITY + 1);
+    ASSERT_VALUE(!reserved.is_inline())
+  }
+  ASSERT_EQ(details::counted::live, static_cast<size_t>(0))
+}
+
+void small_vector_move_and_swap() {
+  constexpr size_t inline_size{details::INLINE_CAPACITY - 1};
+  constexpr size_t heap_size{details::INLINE_CAPACITY * 2};
+  {
+    details::small_vector_type inline_vec;
+    details::push_sequence(inline_vec, 0, inline_size);
+    details::small_vector_type heap_vec;
+    details::push_sequence(heap_vec, 100, heap_size);
+    const auto* heap_data{heap_vec.data()};
+
+    // Inline elements are moved one by one, the heap buffer is stolen
+    details::small_vector_type from_inline{move(inline_vec)};
+    ASSERT_VALUE(from_inline.is_inline())
+    details::check_sequence(from_inline, 0, inline_size);
+    ASSERT_VALUE(inline_vec.empty() && inline_vec.is_inline())
+
+    details::small_vector_type from_heap{move(heap_vec)};
+    ASSERT_VALUE(from_heap.data() == heap_data)
+    details::check_sequence(from_heap, 100, heap_size);
+    ASSERT_VALUE(heap_vec.empty() && heap_vec.is_inline())
+    ASSERT_EQ(heap_vec.capacity(), details::INLINE_CAPACITY)
+    ASSERT_EQ(details::counted::live, inline_size + heap_size)
+
+    // Inline and heap
+    swap(from_inline, from_heap);
+    ASSERT_VALUE(from_inline.data() == heap_data)
+    details::check_sequence(from_inline, 100, heap_size);
+    ASSERT_VALUE(from_heap.is_inline())
+    details::check_sequence(from_heap, 0, inline_size);
+
+    // Both inline
+    details::small_vector_type other_inline;
+    details::push_sequence(other_inline, 50, 1);
+    swap(from_heap, other_inline);
+    ASSERT_VALUE(from_heap.is_inline() && other_inline.is_inline())
+    details::check_sequence(from_heap, 50, 1);
+    details::check_sequence(other_inline, 0, inline_size);
+
+    // Both on the heap: buffers are exchanged
+    details::small_vector_type other_heap;
+    details::push_sequence(other_heap, 200, heap_size + 1);
+    const auto* other_heap_data{other_heap.data()};
+    swap(from_inline, other_heap);
+    ASSERT_VALUE(from_inline.data() == other_heap_data)
+    ASSERT_VALUE(other_heap.data() == heap_data)
+    details::check_sequence(from_inline, 200, heap_size + 1);
+    details::check_sequence(other_heap, 100, heap_size);
+
+    // Move assignment of inline elements releases the heap buffer
+    other_heap = move(other_inline);
+    ASSERT_VALUE(other_heap.is_inline())
+    details::check_sequence(other_heap, 0, inline_size);
+    ASSERT_VALUE(other_inline.empty())
+
+    other_inline = move(from_inline);
+    ASSERT_VALUE(other_inline.data() == other_heap_data)
+    ASSERT_VALUE(from_inline.empty() && from_inline.is_inline())
+    ASSERT_EQ(details::counted::live, 1 + inline_size + heap_size + 1)
+  }
+  ASSERT_EQ(details::counted::live, static_cast<size_t>(0))
+}
+
+void small_vector_shrink_to_fit() {
+  constexpr size_t heap_size{details::INLINE_CAPACITY * 3};
+  {
+    details::small_vector_type vec;
+    details::push_sequence(vec, 0, heap_size);
+    vec.erase(vec.begin() + 2, vec.end());
+    ASSERT_VALUE(!vec.is_inline())
+    ASSERT_EQ(details::counted::live, static_cast<size_t>(2))
+
+    vec.shrink_to_fit();
+    ASSERT_VALUE(vec.is_inline())
+    ASSERT_EQ(vec.capacity(), details::INLINE_CAPACITY)
+    details::check_sequence(vec, 0, 2);
+    ASSERT_EQ(details::counted::live, static_cast<size_t>(2))
+
+    // No-op for inline vectors
+    const auto* inline_data{vec.data()};
+    vec.shrink_to_fit();
+    ASSERT_VALUE(vec.data() == inline_data)
+
+    // Elements which don't fit stay on the heap with the exact capacity
+    details::push_sequence(vec, 2, heap_size - 2);
+    vec.reserve(heap_size * 4);
+    vec.shrink_to_fit();
+    ASSERT_VALUE(!vec.is_inline())
+    ASSERT_EQ(vec.capacity(), heap_size)
+    details::check_sequence(vec, 0, heap_size);
+  }
+  ASSERT_EQ(details::counted::live, static_cast<size_t>(0))
+}
+
+void insert_and_emplace() {
+  details::insert_and_emplace<details::counted>();
+  details::insert_and_emplace<details::relocatable>();
+}
+
+void fill_insert_without_growth() {
+  details::fill_insert_without_growth<details::counted>();
+  details::fill_insert_without_growth<details::relocatable>();
+}
+
+void erase_middle_range() {
+  details::erase_middle_range<details::counted>();
+  details::erase_middle_range<details::relocatable>();
+}
+
+void move_assignment_with_unequal_allocators() {
+  using allocator_type = details::tracking_allocator<details::counted>;
+  using vector_type = ktl::vector<details::counted, allocator_type>;
+  {
+    vector_type source{allocator_type{1}};
+    details::push_sequence(source, 0, 5);
+    const auto* source_buffer{source.data()};
+    vector_type target{allocator_type{2}};
+    details::push_sequence(target, 100, 1);
+
+    // The allocator isn't propagated, so the elements are moved one by one
+    details::counted::reset_counters();
+    target = move(source);
+    ASSERT_EQ(target.get_allocator().id, 2)
+    ASSERT_VALUE(target.data() != source_buffer)
+    details::check_sequence(target, 0, 5);
+    ASSERT_EQ(details::counted::moves, static_cast<size_t>(5))
+    ASSERT_VALUE(source.empty())
+    ASSERT_EQ(source.get_allocator().id, 1)
+    ASSERT_EQ(details::counted::live, static_cast<size_t>(5))
+
+    // Equal allocators let the buffer be stolen
+    vector_type other{allocator_type{2}};
+    const auto* target_buffer{target.data()};
+    details::counted::reset_counters();
+    other = move(target);
+    ASSERT_VALUE(other.data() == target_buffer)
+    details::check_sequence(other, 0, 5);
+    ASSERT_EQ(details::counted::moves, static_cast<size_t>(0))
+    ASSERT_EQ(details::counted::live, static_cast<size_t>(5))
+  }
+  ASSERT_EQ(details::counted::live, static_cast<size_t>(0))
+}
+
+void relocation_on_growth() {
+  static_assert(is_trivially_relocatable_v<details::relocatable>);
+  static_assert(!is_trivially_relocatable_v<details::counted>);
+  constexpr size_t initial_size{4};
+  {
+    details::vector_type<details::counted> counted_vec;
+    counted_vec.reserve(initial_size);
+    details::push_sequence(counted_vec, 0, initial_size);
+    details::vector_type<details::relocatable> relocatable_vec;
+    relocatable_vec.reserve(initial_size);
+    details::push_sequence(relocatable_vec, 0, initial_size);
+
+    // Moved-from objects are destroyed in the old buffer
+    details::counted::reset_counters();
+    counted_vec.emplace_back(static_cast<int>(initial_size));
+    ASSERT_EQ(details::counted::moves, initial_size)
+    ASSERT_EQ(details::counted::destroyed, initial_size)
+    details::check_sequence(counted_vec, 0, initial_size + 1);
+
+    // The objects are transferred by memmove()
+    details::relocatable::reset_counters();
+    relocatable_vec.emplace_back(static_cast<int>(initial_size));
+    ASSERT_EQ(details::relocatable::moves, static_cast<size_t>(0))
+    ASSERT_EQ(details::relocatable::destroyed, static_cast<size_t>(0))
+    details::check_sequence(relocatable_vec, 0, initial_size + 1);
+
+    // The tail is moved out of the way of the inserted elements...
+    details::counted::reset_counters();
+    counted_vec.insert(counted_vec.begin(), 2, details::counted{-1});
+    ASSERT_EQ(details::counted::moves, static_cast<size_t>(2))
+
+    // ...or shifted by memmove()
+    details::relocatable::reset_counters();
+    relocatable_vec.insert(relocatable_vec.begin(), 2,
+                           details::relocatable{-1});
+    ASSERT_EQ(details::relocatable::moves, static_cast<size_t>(0))
+    constexpr int shifted[]{-1, -1, 0, 1, 2, 3, 4};
+    details::check_values(counted_vec, shifted);
+    details::check_values(relocatable_vec, shifted);
+    ASSERT_EQ(details::relocatable::live, relocatable_vec.size())
+  }
+  ASSERT_EQ(details::counted::live, static_cast<size_t>(0))
+  ASSERT_EQ(details::relocatable::live, static_cast<size_t>(0))
+}
+
+void vector_uninitialized_storage() {
+  details::vector_type<uint8_t> vec;
+  vec.resize_uninitialized(3);
+  ASSERT_EQ(vec.size(), static_cast<size_t>(3))
+  details::fill_bytes(vec.data(), 3, 0);
+  details::append_uninitialized_bytes(vec, 3 + 7 * 30, 7);
+  details::overwrite_uninitialized_bytes(vec);
+}
+
+void small_vector_uninitialized_storage() {
+  constexpr size_t inline_capacity{16};
+  small_vector_non_paged<uint8_t, inline_capacity> vec;
+  const auto* inline_data{vec.data()};
+
+  // The inline buffer is used while the appended bytes fit into it
+  details::append_uninitialized_bytes(vec, inline_capacity, 8);
+  ASSERT_VALUE(vec.is_inline() && vec.data() == inline_data)
+
+  vec.resize_and_overwrite(inline_capacity, [](uint8_t*, size_t count) {
+    return count - 1;
+  });
+  ASSERT_VALUE(vec.is_inline())
+  ASSERT_EQ(vec.size(), inline_capacity - 1)
+
+  // The bytes written so far are moved to the heap
+  details::append_uninitialized_bytes(vec, inline_capacity * 4, 5);
+  ASSERT_VALUE(!vec.is_inline())
+  details::overwrite_uninitialized_bytes(vec);
+}
+
+void string_uninitialized_storage() {
+  using size_type = ansi_string_non_paged::size_type;
+  constexpr size_type sso_size{ansi_string_non_paged::SSO_BUFFER_CH_COUNT};
+  constexpr size_type appended{4}, requested{64}, written{40};
+
+  ansi_string_non_paged str;
+  const char* sso_buffer{str.data()};
+  ASSERT_EQ(str.capacity(), sso_size)
+
+  char* tail{str.append_uninitialized(3)};
+  ASSERT_VALUE(tail == str.data())
+  tail[0] = 'a';
+  tail[1] = 'b';
+  tail[2] = 'c';
+  ASSERT_EQ(str.size(), static_cast<size_type>(3))
+
+  // Up to the SSO buffer size no memory is allocated
+  str.resize_uninitialized(sso_size);
+  for (size_type idx = 3; idx < sso_size; ++idx) {
+    str.data()[idx] = 'd';
+  }
+  ASSERT_VALUE(str.data() == sso_buffer)
+  ASSERT_EQ(str.size(), sso_size)
+  ASSERT_EQ(str.capacity(), sso_size)
+
+  // The characters are copied from the SSO buffer to the heap
+  tail = str.append_uninitialized(appended);
+  ASSERT_VALUE(str.data() != sso_buffer)
+  ASSERT_VALUE(tail == str.data() + sso_size)
+  ASSERT_VALUE(str.capacity() >= sso_size + appended)
+  for (size_type idx = 0; idx < appended; ++idx) {
+    tail[idx] = 'e';
+  }
+  ASSERT_EQ(str.size(), static_cast<size_type>(sso_size + appended))
+
+  str.resize_and_overwrite(
+      requested, [](char* buffer, [[maybe_unused]] size_type count) {
+        for (size_type idx = sso_size + appended; idx < written; ++idx) {
+          buffer[idx] = 'f';
+        }
+        return written;
+      });
+  ASSERT_EQ(str.size(), written)
+  ASSERT_VALUE(str.capacity() >= requested)
+
+  const char* chars{str.data()};
+  ASSERT_VALUE(chars[0] == 'a' && chars[1] == 'b' && chars[2] == 'c')
+  for (size_type idx = 3; idx < written; ++idx) {
+    const char expected{idx < sso_size              ? 'd'
+                        : idx < sso_size + appended ? 'e'
+                                                    : 'f'};
+    ASSERT_VALUE(chars[idx] == expected)
+  }
+
+  // resize_and_overwrite() doesn't leave the SSO buffer for small sizes
+  ansi_string_non_paged small;
+  const char* small_buffer{small.data()};
+  small.resize_and_overwrite(sso_size, [](char* buffer, size_type) {
+    buffer[0] = 'g';
+    return static_cast<size_type>(1);
+  });
+  ASSERT_VALUE(small.data() == small_buffer)
+  ASSERT_EQ(small.size(), static_cast<size_type>(1))
+  ASSERT_VALUE(small.data()[0] == 'g')
+}
+
+void small_vector_allocations() {
+  constexpr size_t ROUND_COUNT{size_t{1} << 20};
+  constexpr size_t MAX_SIZE{8};
+
+  using allocator_type = details::counting_allocator<int>;
+  using heap_vector_type = ktl::vector<int, allocator_type>;
+  using inline_vector_type = small_vector<int, MAX_SIZE, allocator_type>;
+
+  allocator_type::allocation_count = 0;
+  auto start{chrono::steady_clock::now()};
+  const int64_t heap_sum{
+      details::build_short_vectors<heap_vector_type>(ROUND_COUNT, MAX_SIZE)};
+  const auto heap_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  const size_t heap_allocations{allocator_type::allocation_count};
+
+  allocator_type::allocation_count = 0;
+  start = chrono::steady_clock::now();
+  const int64_t inline_sum{
+      details::build_short_vectors<inline_vector_type>(ROUND_COUNT, MAX_SIZE)};
+  const auto inline_elapsed{chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start)};
+  const size_t inline_allocations{allocator_type::allocation_count};
+
+  ASSERT_VALUE(heap_sum == inline_sum)
+  // Every non-empty vector allocates at least once
+  ASSERT_VALUE(heap_allocations >= ROUND_COUNT / (MAX_SIZE + 1) * MAX_SIZE)
+  ASSERT_EQ(inline_allocations, static_cast<size_t>(0))
+
+  tests::details::print(
+      "vector: {} vectors of 0 to {} values, {} allocations in {} us\n",
+      ROUND_COUNT, MAX_SIZE, heap_allocations, heap_elapsed.count());
+  tests::details::print(
+      "small_vector: {} vectors of 0 to {} values, {} allocations in {} us\n",
+      ROUND_COUNT, MAX_SIZE, inline_allocations, inline_elapsed.count());
+}
+
+void unique_ptr_vector_growth() {
+  static_assert(is_trivially_relocatable_v<unique_ptr<int> >);
+  static_assert(!is_trivially_relocatable_v<details::moved_pointer>);
+  constexpr size_t ELEMENT_COUNT{size_t{1} << 18};
+
+  details::vector_type<unique_ptr<int> > source;
+  source.reserve(ELEMENT_COUNT);
+  for (size_t idx = 0; idx < ELEMENT_COUNT; ++idx) {
+    source.push_back(make_unique<int>(static_cast<int>(idx)));
+  }
+
+  const auto relocated_elapsed{
+      details::grow_pointer_vector<unique_ptr<int> >(source)};
+  const auto moved_elapsed{
+      details::grow_pointer_vector<details::moved_pointer>(source)};
+  tests::details::print(
+      "vector<unique_ptr>: {} push_backs, relocated in {} us, moved one by "
+      "one in {} us\n",
+      ELEMENT_COUNT, relocated_elapsed.count(), moved_elapsed.count());
+}
+}  // namespace tests::vector
@@ -0,0 +1,17 @@
+#pragma once
+
+namespace tests::vector {
+void small_vector_inline_to_heap();
+void small_vector_move_and_swap();
+void small_vector_shrink_to_fit();
+void small_vector_allocations();
+void insert_and_emplace();
+void fill_insert_without_growth();
+void erase_middle_range();
+void move_assignment_with_unequal_allocators();
+void relocation_on_growth();
+void unique_ptr_vector_growth();
+void vector_uninitialized_storage();
+void small_vector_uninitialized_storage();
+void string_uninitialized_storage();
+}